@@ -61,11 +61,16 @@ if(NOT
   option(QBDI_TOOLS_QBDIPRELOAD
          "Compile QBDIPRELOAD (not available on windows)" ON)
 
+  # Coverage in the drcov format (need QBDI_TOOLS_QBDIPRELOAD)
+  option(QBDI_TOOLS_COVERAGE
+         "Compile qbdi-coverage (need QBDI_TOOLS_QBDIPRELOAD)" ON)
+
   # Validator (compare execution between QBDIPreload and ptrace)
   option(QBDI_TOOLS_VALIDATOR
          "Compile the validator (need QBDI_TOOLS_QBDIPRELOAD)" OFF)
 else()
   set(QBDI_TOOLS_QBDIPRELOAD OFF)
+  set(QBDI_TOOLS_COVERAGE OFF)
   set(QBDI_TOOLS_VALIDATOR OFF)
 endif()
 
@@ -79,6 +84,9 @@ else()
   option(QBDI_TOOLS_PYQBDI "Compile python binding" OFF)
 endif()
 
+# decoder of the traces recorded by the VM
+option(QBDI_TOOLS_TRACE "Compile qbdi-trace, the trace decoder" ON)
+
 # binding QBDI for frida
 option(QBDI_TOOLS_FRIDAQBDI "Install frida-qbdi" ON)
 
@@ -101,6 +109,9 @@ if(NOT QBDI_STATIC_LIBRARY)
     message(
       FATAL_ERROR "Need QBDI_STATIC_LIBRARY to compile QBDI_TOOLS_VALIDATOR")
   endif()
+  if(QBDI_TOOLS_TRACE)
+    message(FATAL_ERROR "Need QBDI_STATIC_LIBRARY to compile QBDI_TOOLS_TRACE")
+  endif()
 endif()
 
 if(NOT QBDI_SHARED_LIBRARY)
@@ -109,6 +120,11 @@ if(NOT QBDI_SHARED_LIBRARY)
   endif()
 endif()
 
+if(QBDI_TOOLS_COVERAGE AND NOT QBDI_TOOLS_QBDIPRELOAD)
+  message(
+    FATAL_ERROR "Need QBDI_TOOLS_QBDIPRELOAD to compile QBDI_TOOLS_COVERAGE")
+endif()
+
 if(QBDI_TOOLS_VALIDATOR AND NOT QBDI_TOOLS_QBDIPRELOAD)
   message(
     FATAL_ERROR "Need QBDI_TOOLS_QBDIPRELOAD to compile QBDI_TOOLS_VALIDATOR")
@@ -141,8 +157,10 @@ if(NOT
     OR QBDI_PLATFORM_IOS
     OR QBDI_PLATFORM_ANDROID))
   message(STATUS "QBDI_TOOLS_QBDIPRELOAD: ${QBDI_TOOLS_QBDIPRELOAD}")
+  message(STATUS "QBDI_TOOLS_COVERAGE:   ${QBDI_TOOLS_COVERAGE}")
   message(STATUS "QBDI_TOOLS_VALIDATOR:  ${QBDI_TOOLS_VALIDATOR}")
 endif()
+message(STATUS "QBDI_TOOLS_TRACE:      ${QBDI_TOOLS_TRACE}")
 message(STATUS "QBDI_TOOLS_PYQBDI:     ${QBDI_TOOLS_PYQBDI}")
 message(STATUS "QBDI_TOOLS_FRIDAQBDI:  ${QBDI_TOOLS_FRIDAQBDI}")
 
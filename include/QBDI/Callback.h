@@ -144,6 +144,36 @@ typedef enum {
                   *   is used in the callback */
 } CallbackPriority;
 
+/*! Options of an InstCallback
+ */
+typedef enum {
+  _QBDI_EI(CB_FLAG_NONE) = 0,        /*!< The callback is called from the VM
+                                      *   after a break to the host. */
+  _QBDI_EI(CB_FLAG_INLINE_CALL) = 1, /*!< The callback is called directly by
+                                      *   the instrumented code, on the stack
+                                      *   of the host, without returning to
+                                      *   the VM. The callback must return
+                                      *   CONTINUE and should only read the
+                                      *   state. Only supported on X86 and
+                                      *   X86_64 with OPT_ENABLE_INLINE_CALL,
+                                      *   otherwise the callback is called
+                                      *   after a break to the host.
+                                      */
+  _QBDI_EI(CB_FLAG_ONE_SHOT) = 2,    /*!< The callback is called at most once
+                                      *   for each instrumented instruction.
+                                      *   Before the first call, the
+                                      *   instrumentation is replaced by a
+                                      *   jump over it in the ExecBlock,
+                                      *   without flushing the cache. The
+                                      *   instruction isn't instrumented by
+                                      *   this callback anymore, even if it
+                                      *   is translated again (after a
+                                      *   clearCache or in another sequence).
+                                      */
+} CallbackFlags;
+
+_QBDI_ENABLE_BITMASK_OPERATORS(CallbackFlags);
+
 typedef enum {
   _QBDI_EI(NO_EVENT) = 0,
   _QBDI_EI(SEQUENCE_ENTRY) = 1,            /*!< Triggered when the execution
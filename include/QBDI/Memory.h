@@ -73,6 +73,24 @@ QBDI_EXPORT qbdi_MemoryMap *qbdi_getRemoteProcessMaps(rword pid, bool full_path,
 QBDI_EXPORT qbdi_MemoryMap *qbdi_getCurrentProcessMaps(bool full_path,
                                                        size_t *size);
 
+/*! Get a list of all the memory maps (regions) of the current process from
+ * a snapshot kept by QBDI. The snapshot is read again when a module has been
+ * loaded or unloaded, or after qbdi_invalidateProcessMapsCache().
+ *
+ * @param[in]  full_path  Return the full path of the module in name field
+ * @param[out] size Will be set to the number of strings in the returned array.
+ *
+ * @return  An array of MemoryMap object.
+ */
+QBDI_EXPORT qbdi_MemoryMap *qbdi_getCachedProcessMaps(bool full_path,
+                                                      size_t *size);
+
+/*! Invalidate the snapshot of the memory maps of the current process. Should
+ * be called when the memory layout changes without loading or unloading a
+ * module (mmap, munmap, ...).
+ */
+QBDI_EXPORT void qbdi_invalidateProcessMapsCache();
+
 /*! Free an array of memory maps objects.
  *
  * @param[in] arr  An array of MemoryMap object.
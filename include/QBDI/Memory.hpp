@@ -101,6 +101,22 @@ QBDI_EXPORT std::vector<MemoryMap> getRemoteProcessMaps(QBDI::rword pid,
 QBDI_EXPORT std::vector<MemoryMap>
 getCurrentProcessMaps(bool full_path = false);
 
+/*! Get a list of all the memory maps (regions) of the current process from
+ * a snapshot kept by QBDI. The snapshot is read again when a module has been
+ * loaded or unloaded, or after invalidateProcessMapsCache().
+ *
+ * @param[in] full_path  Return the full path of the module in name field
+ * @return  A vector of MemoryMap object.
+ */
+QBDI_EXPORT std::vector<MemoryMap>
+getCachedProcessMaps(bool full_path = false);
+
+/*! Invalidate the snapshot of the memory maps of the current process. Should
+ * be called when the memory layout changes without loading or unloading a
+ * module (mmap, munmap, ...).
+ */
+QBDI_EXPORT void invalidateProcessMapsCache();
+
 /*! Get a list of all the module names loaded in the process memory.
  *
  * @return  A vector of string of module names.
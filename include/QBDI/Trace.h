@@ -0,0 +1,106 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QBDI_TRACE_H_
+#define QBDI_TRACE_H_
+
+#include <stdint.h>
+
+#include "QBDI/Bitmask.h"
+#include "QBDI/Platform.h"
+
+#ifdef __cplusplus
+namespace QBDI {
+#endif
+
+/*! Content of a trace recorded by the VM
+ */
+typedef enum {
+  _QBDI_EI(TRACE_SEQUENCE) = 1 << 0, /*!< Record the executed sequences */
+  _QBDI_EI(TRACE_MEMORY) = 1 << 1,   /*!< Record the address and the size of
+                                      * the memory accesses of each executed
+                                      * sequence. Enable the recording of the
+                                      * memory accesses in the VM.
+                                      */
+} TraceFlags;
+
+_QBDI_ENABLE_BITMASK_OPERATORS(TraceFlags)
+
+/* Binary format of a trace
+ * ========================
+ *
+ * A trace file begins with a TraceFileHeader, followed by segments. Each
+ * segment begins with a TraceSegmentHeader and contains TraceSegmentHeader.size
+ * bytes of records. A record begins with a TraceRecordTag byte, followed by
+ * unsigned LEB128 integers (varint). A signed value is zigzag encoded before
+ * the LEB128 encoding.
+ *
+ * The segments TRACE_SEGMENT_DICTIONARY contain the module and block
+ * definitions. A definition is written once, in a dictionary segment placed
+ * before the first data segment that uses it:
+ *  - TRACE_RECORD_MODULE: id, start address, end address, length of the name,
+ *    name (without the final null byte).
+ *  - TRACE_RECORD_BLOCK: id, module id + 1 (0 if the block isn't in a known
+ *    module), address, size in bytes, CPUMode, code of the block (size bytes).
+ *
+ * The segments TRACE_SEGMENT_DATA contain the execution. The deltas begin with
+ * 0 at the beginning of each data segment, so that every data segment can be
+ * decoded independently once the dictionaries are known:
+ *  - TRACE_RECORD_SEQUENCE: signed delta of the block id with the previous
+ *    sequence.
+ *  - TRACE_RECORD_MEMORY_READ and TRACE_RECORD_MEMORY_WRITE: signed delta of
+ *    the address with the previous memory access, size of the access (0 if the
+ *    size is unknown).
+ */
+
+#define QBDI_TRACE_MAGIC "QBDITRC"
+#define QBDI_TRACE_VERSION 1
+#define QBDI_TRACE_SEGMENT_MAGIC 0x47455351 /* "QSEG" */
+
+typedef struct {
+  char magic[8];       /*!< QBDI_TRACE_MAGIC, null terminated */
+  uint32_t version;    /*!< QBDI_TRACE_VERSION */
+  uint8_t rwordSize;   /*!< sizeof(rword) of the recorded process */
+  uint8_t reserved[3]; /*!< Zeros */
+} TraceFileHeader;
+
+typedef enum {
+  _QBDI_EI(TRACE_SEGMENT_DICTIONARY) = 0,
+  _QBDI_EI(TRACE_SEGMENT_DATA) = 1,
+} TraceSegmentKind;
+
+typedef struct {
+  uint32_t magic;  /*!< QBDI_TRACE_SEGMENT_MAGIC */
+  uint16_t kind;   /*!< TraceSegmentKind */
+  uint16_t flags;  /*!< Zeros */
+  uint32_t size;   /*!< Size of the records following this header */
+  uint32_t number; /*!< Index of the segment in the file */
+} TraceSegmentHeader;
+
+typedef enum {
+  _QBDI_EI(TRACE_RECORD_MODULE) = 1,
+  _QBDI_EI(TRACE_RECORD_BLOCK) = 2,
+  _QBDI_EI(TRACE_RECORD_SEQUENCE) = 3,
+  _QBDI_EI(TRACE_RECORD_MEMORY_READ) = 4,
+  _QBDI_EI(TRACE_RECORD_MEMORY_WRITE) = 5,
+} TraceRecordTag;
+
+#ifdef __cplusplus
+} // namespace QBDI
+#endif
+
+#endif // QBDI_TRACE_H_
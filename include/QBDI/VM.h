@@ -34,6 +34,7 @@
 #include "QBDI/Platform.h"
 #include "QBDI/Range.h"
 #include "QBDI/State.h"
+#include "QBDI/Trace.h"
 
 namespace QBDI {
 
@@ -53,6 +54,9 @@ private:
   uint32_t memCBID;
   uint32_t memReadGateCBID;
   uint32_t memWriteGateCBID;
+  // rules of the memory recording enabled by startTraceRecording
+  std::vector<uint32_t> traceMemReadRuleIDs;
+  std::vector<uint32_t> traceMemWriteRuleIDs;
   std::unique_ptr<
       std::vector<std::pair<uint32_t, std::unique_ptr<InstrCBInfo>>>>
       instrCBInfos;
@@ -275,6 +279,8 @@ public:
    *  state).
    *  This method will allocate a new stack and switch to this stack. The
    *  remaining space on the current stack will be use by the called method.
+   *  The stacks are kept by the VM and reused by the next calls, with a guard
+   *  page below each stack.
    *  This method mustn't be called if the VM already runs.
    *  The stack pointer in the state must'nt be used after the end of this
    *  method.
@@ -486,6 +492,21 @@ public:
   QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCallback cbk, void *data,
                                  int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback event for every instruction executed.
+   *
+   * @param[in] pos        Relative position of the event callback
+   *                       (PREINST / POSTINST).
+   * @param[in] cbk        A function pointer to the callback.
+   * @param[in] data       User defined data passed to the callback.
+   * @param[in] priority   The priority of the callback.
+   * @param[in] flags      The options of the callback (CallbackFlags).
+   *
+   * @return The id of the registered instrumentation
+   * (or VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCallback cbk, void *data,
+                                 int priority, CallbackFlags flags);
+
   /*! Register a callback event for every instruction executed.
    *
    * @param[in] pos        Relative position of the event callback
@@ -501,6 +522,22 @@ public:
   QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCbLambda &&cbk,
                                  int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback event for every instruction executed.
+   *
+   * @param[in] pos        Relative position of the event callback
+   *                       (PREINST / POSTINST).
+   * @param[in] cbk        A lambda function to the callback
+   * @param[in] priority   The priority of the callback.
+   * @param[in] flags      The options of the callback (CallbackFlags).
+   *
+   * @return The id of the registered instrumentation
+   * (or VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, const InstCbLambda &cbk,
+                                 int priority, CallbackFlags flags);
+  QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCbLambda &&cbk,
+                                 int priority, CallbackFlags flags);
+
   /*! Register a callback for when a specific address is executed.
    *
    * @param[in] address  Code address which will trigger the callback.
@@ -516,6 +553,22 @@ public:
                                      InstCallback cbk, void *data,
                                      int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback for when a specific address is executed.
+   *
+   * @param[in] address  Code address which will trigger the callback.
+   * @param[in] pos      Relative position of the callback (PREINST / POSTINST).
+   * @param[in] cbk      A function pointer to the callback.
+   * @param[in] data     User defined data passed to the callback.
+   * @param[in] priority The priority of the callback.
+   * @param[in] flags    The options of the callback (CallbackFlags).
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeAddrCB(rword address, InstPosition pos,
+                                     InstCallback cbk, void *data,
+                                     int priority, CallbackFlags flags);
+
   /*! Register a callback for when a specific address is executed.
    *
    * @param[in] address  Code address which will trigger the callback.
@@ -533,6 +586,24 @@ public:
                                      InstCbLambda &&cbk,
                                      int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback for when a specific address is executed.
+   *
+   * @param[in] address  Code address which will trigger the callback.
+   * @param[in] pos      Relative position of the callback (PREINST / POSTINST).
+   * @param[in] cbk      A lambda function to the callback
+   * @param[in] priority The priority of the callback.
+   * @param[in] flags    The options of the callback (CallbackFlags).
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeAddrCB(rword address, InstPosition pos,
+                                     const InstCbLambda &cbk, int priority,
+                                     CallbackFlags flags);
+  QBDI_EXPORT uint32_t addCodeAddrCB(rword address, InstPosition pos,
+                                     InstCbLambda &&cbk, int priority,
+                                     CallbackFlags flags);
+
   /*! Register a callback for when a specific address range is executed.
    *
    * @param[in] start    Start of the address range which will trigger
@@ -551,6 +622,25 @@ public:
                                       InstCallback cbk, void *data,
                                       int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback for when a specific address range is executed.
+   *
+   * @param[in] start    Start of the address range which will trigger
+   *                     the callback.
+   * @param[in] end      End of the address range which will trigger
+   *                     the callback.
+   * @param[in] pos      Relative position of the callback (PREINST / POSTINST).
+   * @param[in] cbk      A function pointer to the callback.
+   * @param[in] data     User defined data passed to the callback.
+   * @param[in] priority The priority of the callback.
+   * @param[in] flags    The options of the callback (CallbackFlags).
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeRangeCB(rword start, rword end, InstPosition pos,
+                                      InstCallback cbk, void *data,
+                                      int priority, CallbackFlags flags);
+
   /*! Register a callback for when a specific address range is executed.
    *
    * @param[in] start    Start of the address range which will trigger
@@ -571,6 +661,27 @@ public:
                                       InstCbLambda &&cbk,
                                       int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback for when a specific address range is executed.
+   *
+   * @param[in] start    Start of the address range which will trigger
+   *                     the callback.
+   * @param[in] end      End of the address range which will trigger
+   *                     the callback.
+   * @param[in] pos      Relative position of the callback (PREINST / POSTINST).
+   * @param[in] cbk      A lambda function to the callback
+   * @param[in] priority The priority of the callback.
+   * @param[in] flags    The options of the callback (CallbackFlags).
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeRangeCB(rword start, rword end, InstPosition pos,
+                                      const InstCbLambda &cbk, int priority,
+                                      CallbackFlags flags);
+  QBDI_EXPORT uint32_t addCodeRangeCB(rword start, rword end, InstPosition pos,
+                                      InstCbLambda &&cbk, int priority,
+                                      CallbackFlags flags);
+
   /*! Register a callback event for every memory access matching the type
    * bitfield made by the instructions.
    *
@@ -714,6 +825,19 @@ public:
    */
   QBDI_EXPORT bool deleteInstrumentation(uint32_t id);
 
+  /*! Enable or disable an instrumentation without flushing the cache. The
+   * instrumented code of the callbacks of a disabled instrumentation is
+   * replaced by a jump over it in the cache and restored when the
+   * instrumentation is enabled again. The code translated while the
+   * instrumentation is disabled is still instrumented.
+   *
+   * @param[in] id       The id of the instrumentation.
+   * @param[in] enabled  The new state of the instrumentation.
+   *
+   * @return  True if the id is valid.
+   */
+  QBDI_EXPORT bool setInstrumentationEnabled(uint32_t id, bool enabled);
+
   /*! Remove all the registered instrumentations.
    *
    */
@@ -775,6 +899,26 @@ public:
    */
   QBDI_EXPORT std::vector<MemoryAccess> getBBMemoryAccess() const;
 
+  /*! Record a compact binary trace of the execution in a file (see
+   *  QBDI/Trace.h for the format). The sequences are recorded by the VM at
+   *  each sequence entry, without any callback. A previous trace is closed.
+   *
+   * @param[in] path   The path of the trace file. The file is truncated if
+   *                   it already exists.
+   * @param[in] flags  The content of the trace. QBDI::TRACE_MEMORY enables
+   *                   the recording of the memory accesses.
+   *
+   * @return True if the trace file has been created.
+   */
+  QBDI_EXPORT bool startTraceRecording(const char *path,
+                                       TraceFlags flags = TRACE_SEQUENCE);
+
+  /*! Write the pending records and close the current trace file. The
+   *  recording of the memory accesses enabled by startTraceRecording is
+   *  disabled, unless it has been requested with recordMemoryAccess.
+   */
+  QBDI_EXPORT void stopTraceRecording();
+
   /*! Pre-cache a known basic block
    *  This method mustn't be called if the VM already runs.
    *
@@ -28,6 +28,7 @@
 #include "QBDI/Options.h"
 #include "QBDI/Platform.h"
 #include "QBDI/State.h"
+#include "QBDI/Trace.h"
 
 #ifdef __cplusplus
 namespace QBDI {
@@ -452,6 +453,24 @@ QBDI_EXPORT uint32_t qbdi_addMnemonicCB(VMInstanceRef instance,
 QBDI_EXPORT uint32_t qbdi_addCodeCB(VMInstanceRef instance, InstPosition pos,
                                     InstCallback cbk, void *data, int priority);
 
+/*! Register a callback event for a specific instruction event with options.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] pos       Relative position of the event callback
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] priority  The priority of the callback.
+ * @param[in] flags     The options of the callback (CallbackFlags).
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeCBWithFlags(VMInstanceRef instance,
+                                             InstPosition pos, InstCallback cbk,
+                                             void *data, int priority,
+                                             CallbackFlags flags);
+
 /*! Register a callback for when a specific address is executed.
  *
  * @param[in] instance  VM instance.
@@ -469,6 +488,27 @@ QBDI_EXPORT uint32_t qbdi_addCodeAddrCB(VMInstanceRef instance, rword address,
                                         InstPosition pos, InstCallback cbk,
                                         void *data, int priority);
 
+/*! Register a callback with options for when a specific address is executed.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] address   Code address which will trigger the callback.
+ * @param[in] pos       Relative position of the callback
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] priority  The priority of the callback.
+ * @param[in] flags     The options of the callback (CallbackFlags).
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeAddrCBWithFlags(VMInstanceRef instance,
+                                                 rword address,
+                                                 InstPosition pos,
+                                                 InstCallback cbk, void *data,
+                                                 int priority,
+                                                 CallbackFlags flags);
+
 /*! Register a callback for when a specific address range is executed.
  *
  * @param[in] instance  VM instance.
@@ -488,6 +528,26 @@ QBDI_EXPORT uint32_t qbdi_addCodeRangeCB(VMInstanceRef instance, rword start,
                                          InstCallback cbk, void *data,
                                          int priority);
 
+/*! Register a callback with options for when a specific address range is
+ * executed.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] start  Start of the address range which will trigger the callback.
+ * @param[in] end    End of the address range which will trigger the callback.
+ * @param[in] pos    Relative position of the callback
+ *                   (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] priority  The priority of the callback.
+ * @param[in] flags     The options of the callback (CallbackFlags).
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeRangeCBWithFlags(
+    VMInstanceRef instance, rword start, rword end, InstPosition pos,
+    InstCallback cbk, void *data, int priority, CallbackFlags flags);
+
 /*! Register a callback event for a specific VM event.
  *
  * @param[in] instance  VM instance.
@@ -511,6 +571,17 @@ QBDI_EXPORT uint32_t qbdi_addVMEventCB(VMInstanceRef instance, VMEvent mask,
 QBDI_EXPORT bool qbdi_deleteInstrumentation(VMInstanceRef instance,
                                             uint32_t id);
 
+/*! Enable or disable an instrumentation without flushing the cache.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] id        The id of the instrumentation.
+ * @param[in] enabled   The new state of the instrumentation.
+ *
+ * @return  True if the id is valid.
+ */
+QBDI_EXPORT bool qbdi_setInstrumentationEnabled(VMInstanceRef instance,
+                                                uint32_t id, bool enabled);
+
 /*! Remove all the registered instrumentations.
  *
  * @param[in] instance  VM instance.
@@ -586,6 +657,26 @@ QBDI_EXPORT MemoryAccess *qbdi_getInstMemoryAccess(VMInstanceRef instance,
 QBDI_EXPORT MemoryAccess *qbdi_getBBMemoryAccess(VMInstanceRef instance,
                                                  size_t *size);
 
+/*! Record a compact binary trace of the execution in a file (see
+ *  QBDI/Trace.h for the format). A previous trace is closed.
+ *
+ *  @param[in]  instance     VM instance.
+ *  @param[in]  path         The path of the trace file. The file is truncated
+ *                           if it already exists.
+ *  @param[in]  flags        The content of the trace (TRACE_SEQUENCE and/or
+ *                           TRACE_MEMORY).
+ *
+ * @return True if the trace file has been created.
+ */
+QBDI_EXPORT bool qbdi_startTraceRecording(VMInstanceRef instance,
+                                          const char *path, TraceFlags flags);
+
+/*! Write the pending records and close the current trace file.
+ *
+ *  @param[in]  instance     VM instance.
+ */
+QBDI_EXPORT void qbdi_stopTraceRecording(VMInstanceRef instance);
+
 /*! Pre-cache a known basic block
  *  This method mustn't be called when the VM runs.
  *
@@ -39,6 +39,27 @@ typedef enum {
                                                 * optimisation when the target
                                                 * execblock doesn't used FPR
                                                 */
+  _QBDI_EI(OPT_ENABLE_REGISTER_LIVENESS) = 1 << 2, /*!< Use the registers
+                                                    * dead in the basic block
+                                                    * as temporary registers
+                                                    * of the instrumentation,
+                                                    * without saving them. The
+                                                    * value of these registers
+                                                    * in the GPRState isn't
+                                                    * reliable in the callbacks
+                                                    */
+  _QBDI_EI(OPT_DISABLE_MEMORYACCESS_VALUE) = 1 << 3, /*!< Only record the
+                                                      * address and the size
+                                                      * of the memory
+                                                      * accesses, not their
+                                                      * value
+                                                      */
+  _QBDI_EI(OPT_DETECT_SELF_MODIFYING_CODE) = 1 << 4, /*!< Write-protect the
+                                                       * pages of the
+                                                       * translated code and
+                                                       * invalidate the
+                                                       * modified sequences
+                                                       */
   // architecture specific option between 24 and 31
   _QBDI_EI(OPT_DISABLE_LOCAL_MONITOR) =
       1 << 24, /*!< Disable the local monitor for instruction like strex */
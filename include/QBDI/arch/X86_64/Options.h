@@ -39,6 +39,27 @@ typedef enum {
                                                 * optimisation when the target
                                                 * execblock doesn't used FPR
                                                 */
+  _QBDI_EI(OPT_ENABLE_REGISTER_LIVENESS) = 1 << 2, /*!< Use the registers
+                                                    * dead in the basic block
+                                                    * as temporary registers
+                                                    * of the instrumentation,
+                                                    * without saving them. The
+                                                    * value of these registers
+                                                    * in the GPRState isn't
+                                                    * reliable in the callbacks
+                                                    */
+  _QBDI_EI(OPT_DISABLE_MEMORYACCESS_VALUE) = 1 << 3, /*!< Only record the
+                                                      * address and the size
+                                                      * of the memory
+                                                      * accesses, not their
+                                                      * value
+                                                      */
+  _QBDI_EI(OPT_DETECT_SELF_MODIFYING_CODE) = 1 << 4, /*!< Write-protect the
+                                                       * pages of the
+                                                       * translated code and
+                                                       * invalidate the
+                                                       * modified sequences
+                                                       */
   // architecture specific option between 24 and 31
   _QBDI_EI(OPT_ATT_SYNTAX) = 1 << 24,   /*!< Used the AT&T syntax for
                                          * instruction disassembly
@@ -48,6 +69,11 @@ typedef enum {
                                          * instructions (RD|WR)(FS|GS)BASE that
                                          * must be supported by the operating
                                          * system */
+  _QBDI_EI(OPT_ENABLE_INLINE_CALL) = 1 << 26, /*!< Add the inline call stub
+                                               * in each ExecBlock. Needed by
+                                               * the callbacks registered with
+                                               * CB_FLAG_INLINE_CALL
+                                               */
 } Options;
 
 _QBDI_ENABLE_BITMASK_OPERATORS(Options)
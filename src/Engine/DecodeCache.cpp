@@ -0,0 +1,105 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include "Engine/DecodeCache.h"
+#include "Engine/LLVMCPU.h"
+#include "Utility/LogSys.h"
+
+#include "QBDI/Config.h"
+
+namespace QBDI {
+
+bool DecodeCache::getInstruction(const LLVMCPU &llvmcpu, llvm::MCInst &inst,
+                                 uint64_t &size, llvm::ArrayRef<uint8_t> bytes,
+                                 rword address) {
+#if defined(QBDI_ARCH_ARM)
+  // The Thumb disassembler keeps the state of the IT and VPT blocks between
+  // the instructions. The cache would skip the update of this state.
+  if (llvmcpu.getCPUMode() == CPUMode::Thumb) {
+    return llvmcpu.getInstruction(inst, size, bytes, address);
+  }
+#endif // QBDI_ARCH_ARM
+  std::unordered_map<rword, Entry> &modeEntries =
+      entries[llvmcpu.getCPUMode()];
+
+  auto it = modeEntries.find(address);
+  if (it != modeEntries.end()) {
+    const Entry &entry = it->second;
+    if (entry.size <= bytes.size() and
+        memcmp(entry.bytes, bytes.data(), entry.size) == 0) {
+      inst = entry.inst;
+      size = entry.size;
+      return true;
+    }
+    // the code has changed
+    modeEntries.erase(it);
+  }
+
+  if (not llvmcpu.getInstruction(inst, size, bytes, address)) {
+    return false;
+  }
+  if (size == 0 or size > MAX_INST_SIZE) {
+    return true;
+  }
+
+  if (modeEntries.size() >= MAX_ENTRIES) {
+    QBDI_DEBUG("DecodeCache full for CPUMode {}, clear it",
+               llvmcpu.getCPUMode());
+    modeEntries.clear();
+  }
+  Entry &entry = modeEntries[address];
+  entry.inst = inst;
+  entry.size = static_cast<uint8_t>(size);
+  memcpy(entry.bytes, bytes.data(), size);
+  return true;
+}
+
+void DecodeCache::clear(Range<rword> range) {
+  for (std::unordered_map<rword, Entry> &modeEntries : entries) {
+    if (range.size() < modeEntries.size()) {
+      for (rword address = range.start(); address < range.end(); address++) {
+        modeEntries.erase(address);
+      }
+    } else {
+      for (auto it = modeEntries.begin(); it != modeEntries.end();) {
+        if (range.contains(it->first)) {
+          it = modeEntries.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+}
+
+void DecodeCache::clear() {
+  for (std::unordered_map<rword, Entry> &modeEntries : entries) {
+    modeEntries.clear();
+  }
+}
+
+size_t DecodeCache::size() const {
+  size_t s = 0;
+  for (const std::unordered_map<rword, Entry> &modeEntries : entries) {
+    s += modeEntries.size();
+  }
+  return s;
+}
+
+} // namespace QBDI
@@ -0,0 +1,94 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DECODECACHE_H
+#define DECODECACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/MC/MCInst.h"
+
+#include "QBDI/Range.h"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+class LLVMCPU;
+
+/*! Cache of the instructions decoded by the LLVMCPU.
+ *
+ * The translation of a basic block that was flushed from the ExecBlock cache
+ * (by a change of the instrumentation or a clearCache) decodes the same bytes
+ * again. The cache keeps the MCInst and the size of each decoded instruction
+ * with a copy of its bytes. An entry is only used if the bytes in memory are
+ * still the same. The Thumb instructions aren't cached, as their decoding
+ * depends on the previous IT and VPT instructions.
+ */
+class DecodeCache {
+public:
+  static constexpr size_t MAX_INST_SIZE = 16;
+  static constexpr size_t MAX_ENTRIES = 1 << 18;
+
+private:
+  struct Entry {
+    llvm::MCInst inst;
+    uint8_t size;
+    uint8_t bytes[MAX_INST_SIZE];
+  };
+
+  std::unordered_map<rword, Entry> entries[CPUMode::COUNT];
+
+public:
+  DecodeCache() = default;
+
+  DecodeCache(const DecodeCache &) = delete;
+  DecodeCache &operator=(const DecodeCache &) = delete;
+
+  /*! Decode an instruction, or get it from the cache if the bytes at this
+   * address have already been decoded.
+   *
+   * @param[in]  llvmcpu  The LLVMCPU of the instruction
+   * @param[out] inst     The decoded instruction
+   * @param[out] size     The size of the instruction
+   * @param[in]  bytes    The code at the address of the instruction
+   * @param[in]  address  The address of the instruction
+   *
+   * @return False if the instruction cannot be decoded
+   */
+  bool getInstruction(const LLVMCPU &llvmcpu, llvm::MCInst &inst,
+                      uint64_t &size, llvm::ArrayRef<uint8_t> bytes,
+                      rword address);
+
+  /*! Remove the instructions that begin in a range.
+   *
+   * @param[in] range  The range to remove
+   */
+  void clear(Range<rword> range);
+
+  /*! Remove all the instructions.
+   */
+  void clear();
+
+  size_t size() const;
+};
+
+} // namespace QBDI
+
+#endif // DECODECACHE_H
@@ -17,13 +17,17 @@
  */
 #include <algorithm>
 #include <cstdint>
+#include <set>
 #include <string.h>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/MC/MCInst.h"
 
+#include "Engine/DecodeCache.h"
 #include "Engine/Engine.h"
 #include "Engine/LLVMCPU.h"
+#include "Engine/PatchCache.h"
+#include "Engine/TraceRecorder.h"
 
 #include "ExecBlock/Context.h"
 #include "ExecBlock/ExecBlock.h"
@@ -33,7 +37,10 @@
 #include "Patch/InstrRule.h"
 #include "Patch/Patch.h"
 #include "Patch/PatchRuleAssembly.h"
+#include "Patch/Register.h"
+#include "Utility/CodeWriteMonitor.h"
 #include "Utility/LogSys.h"
+#include "Utility/StackPool.h"
 
 #include "QBDI/Bitmask.h"
 #include "QBDI/Config.h"
@@ -45,6 +52,8 @@
 
 // Mask to identify VM events
 #define EVENTID_VM_MASK (1UL << 30)
+// codePages value of the pages that aren't writable
+#define CODEPAGE_READONLY (static_cast<uint32_t>(-1))
 
 namespace QBDI {
 
@@ -52,7 +61,7 @@ Engine::Engine(const std::string &_cpu, const std::vector<std::string> &_mattrs,
                Options opts, VMInstanceRef vminstance)
     : vminstance(vminstance), instrRulesCounter(0), vmCallbacksCounter(0),
       curCPUMode(CPUMode::DEFAULT), options(opts), eventMask(VMEvent::NO_EVENT),
-      running(false) {
+      running(false), codeWriteCounter(0) {
 
   llvmCPUs = std::make_unique<LLVMCPUs>(_cpu, _mattrs, opts);
   blockManager = std::make_unique<ExecBlockManager>(*llvmCPUs, vminstance);
@@ -60,6 +69,8 @@ Engine::Engine(const std::string &_cpu, const std::vector<std::string> &_mattrs,
 
   // Get Patch rules Assembly for this architecture
   patchRuleAssembly = std::make_unique<PatchRuleAssembly>(options);
+  decodeCache = std::make_unique<DecodeCache>();
+  patchCache = std::make_unique<PatchCache>();
 
   gprState = std::make_unique<GPRState>();
   fprState = std::make_unique<FPRState>();
@@ -72,7 +83,7 @@ Engine::Engine(const std::string &_cpu, const std::vector<std::string> &_mattrs,
   curExecBlock = nullptr;
 }
 
-Engine::~Engine() = default;
+Engine::~Engine() { unwatchCode(); }
 
 Engine::Engine(const Engine &other)
     : vminstance(nullptr), instrRules(),
@@ -80,7 +91,7 @@ Engine::Engine(const Engine &other)
       vmCallbacks(other.vmCallbacks),
       vmCallbacksCounter(other.vmCallbacksCounter),
       curCPUMode(CPUMode::DEFAULT), options(other.options),
-      eventMask(other.eventMask), running(false) {
+      eventMask(other.eventMask), running(false), codeWriteCounter(0) {
 
   llvmCPUs = std::make_unique<LLVMCPUs>(
       other.llvmCPUs->getCPU(), other.llvmCPUs->getMattrs(), other.options);
@@ -91,6 +102,8 @@ Engine::Engine(const Engine &other)
 
   // Get Patch rules Assembly for this architecture
   patchRuleAssembly = std::make_unique<PatchRuleAssembly>(options);
+  decodeCache = std::make_unique<DecodeCache>();
+  patchCache = std::make_unique<PatchCache>();
 
   // Copy unique_ptr of instrRules
   for (const auto &r : other.instrRules) {
@@ -125,6 +138,7 @@ Engine &Engine::operator=(const Engine &other) {
 
   // copy the configuration
   instrRules.clear();
+  instrRulesIndex.reset();
   for (const auto &r : other.instrRules) {
     instrRules.emplace_back(r.first, r.second->clone());
   }
@@ -215,6 +229,17 @@ bool Engine::isPreInst() const {
          QBDI_GPR_GET(getGPRState(), REG_PC);
 }
 
+void Engine::setTraceRecorder(std::unique_ptr<TraceRecorder> &&recorder) {
+  traceRecorder = std::move(recorder);
+}
+
+StackPool &Engine::getStackPool() {
+  if (not stackPool) {
+    stackPool = std::make_unique<StackPool>();
+  }
+  return *stackPool;
+}
+
 void Engine::addInstrumentedRange(rword start, rword end) {
   execBroker->addInstrumentedRange(Range<rword>(start, end));
 }
@@ -261,17 +286,48 @@ std::vector<Patch> Engine::patch(rword start) {
   }
 
   const llvm::ArrayRef<uint8_t> code((uint8_t *)start, sizeCode);
+
+  // The pages are watched before their code is read: a write between the
+  // read and the protection of the page would not be detected.
+  const bool detectWrites =
+      (options & Options::OPT_DETECT_SELF_MODIFYING_CODE) != 0;
+  if (detectWrites) {
+    watchCode(start, start + 1);
+  }
+
+  // The basic block may have been flushed by a change of the instrumentation
+  if (patchCache->getBasicBlock(curCPUMode, code, start, basicBlock)) {
+    // compare the code again if the basic block overlaps a new watched page
+    if (not detectWrites or
+        not watchCode(start, basicBlock.back().metadata.endAddress()) or
+        patchCache->getBasicBlock(curCPUMode, code, start, basicBlock)) {
+      QBDI_DEBUG("Reuse patched basic block at address 0x{:x}", start);
+      return basicBlock;
+    }
+    basicBlock.clear();
+  }
+
   rword address = start;
   QBDI_DEBUG("Patching basic block at address 0x{:x}", start);
 
   bool endLoop = false;
+  bool truncated = false;
   // Get Basic block
   do {
     llvm::MCInst inst;
     uint64_t instSize;
     // Disassemble
-    bool dstatus = llvmcpu.getInstruction(inst, instSize,
-                                          code.slice(address - start), address);
+    if (detectWrites) {
+      watchCode(address, address + 1);
+    }
+    bool dstatus = decodeCache->getInstruction(
+        llvmcpu, inst, instSize, code.slice(address - start), address);
+    // the instruction overlaps a new watched page, decode it again
+    if (dstatus and detectWrites and
+        watchCode(address + 1, address + instSize)) {
+      dstatus = decodeCache->getInstruction(
+          llvmcpu, inst, instSize, code.slice(address - start), address);
+    }
 
     // handle disassembly error
     if (not dstatus) {
@@ -294,6 +350,7 @@ std::vector<Patch> Engine::patch(rword start) {
                            reinterpret_cast<uint8_t *>(address + sizeDump)));
       } else {
         endLoop = true;
+        truncated = true;
         break;
       }
     }
@@ -318,6 +375,8 @@ std::vector<Patch> Engine::patch(rword start) {
   QBDI_DEBUG("Basic block starting at address 0x{:x} ended at address 0x{:x}",
              start, basicBlock.back().metadata.endAddress());
 
+  patchCache->addBasicBlock(basicBlock, code, truncated);
+
   return basicBlock;
 }
 
@@ -329,13 +388,31 @@ void Engine::instrument(std::vector<Patch> &basicBlock, size_t patchEnd) {
       basicBlock[patchEnd - 1].metadata.address,
       basicBlock.front().metadata.address, basicBlock.back().metadata.address);
 
+  std::vector<uint32_t> candidates;
+
+  // The liveness uses the whole basic block, including the cached patches
+  if ((options & Options::OPT_ENABLE_REGISTER_LIVENESS) != 0) {
+    computeDeadGPR(basicBlock);
+  }
+
   for (size_t i = 0; i < patchEnd; i++) {
     Patch &patch = basicBlock[i];
     QBDI_DUMP_PATCH_DEBUG(patch, "Instrumenting");
 
     // Instrument
-    for (const auto &item : instrRules) {
+    // The index is rebuilt if an InstrRuleCallback has changed the rules
+    if (not instrRulesIndex) {
+      instrRulesIndex = std::make_unique<InstrRuleIndex>(instrRules, llvmcpu);
+    }
+    instrRulesIndex->getRules(patch.metadata.address,
+                              patch.metadata.inst.getOpcode(), candidates);
+    for (uint32_t j : candidates) {
+      const auto &item = instrRules[j];
       const InstrRule *rule = item.second.get();
+      // a disabled rule is still applied, its callbacks are skipped until
+      // the rule is enabled
+      patch.ruleID = item.first;
+      patch.ruleEnabled = rule->isEnabled();
       if (rule->tryInstrument(patch, llvmcpu)) {
         QBDI_DEBUG("Instrumentation rule {:x} applied", item.first);
       }
@@ -344,6 +421,29 @@ void Engine::instrument(std::vector<Patch> &basicBlock, size_t patchEnd) {
   }
 }
 
+void Engine::clearRuleCache(const InstrRule &rule) {
+  // Only the regions with a translated instruction on which the rule may be
+  // applied are flushed. The patched basic blocks are kept in the patchCache,
+  // their translation only needs a new instrumentation.
+  const RangeSet<rword> range = rule.affectedRange();
+  std::set<unsigned> opcodes[CPUMode::COUNT];
+  bool anyOpcode[CPUMode::COUNT];
+  for (int mode = 0; mode < CPUMode::COUNT; mode++) {
+    anyOpcode[mode] = not rule.matchOpcodes(
+        opcodes[mode], llvmCPUs->getCPU(static_cast<CPUMode>(mode)));
+  }
+
+  blockManager->clearCache(range, [&](const InstMetadata &metadata) {
+    return range.overlaps(
+               Range<rword>(metadata.address, metadata.endAddress())) and
+           (anyOpcode[metadata.cpuMode] or
+            opcodes[metadata.cpuMode].count(metadata.inst.getOpcode()) != 0);
+  });
+  if (not running && blockManager->isFlushPending()) {
+    blockManager->flushCommit();
+  }
+}
+
 void Engine::handleNewBasicBlock(rword pc) {
   // disassemble and patch new basic block
   Patch::Vec basicBlock = patch(pc);
@@ -355,9 +455,75 @@ void Engine::handleNewBasicBlock(rword pc) {
   blockManager->writeBasicBlock(std::move(basicBlock), patchEnd);
 }
 
+bool Engine::watchCode(rword start, rword end) {
+  CodeWriteMonitor &monitor = CodeWriteMonitor::get();
+  const rword pageSize = monitor.getPageSize();
+  bool newPage = false;
+
+  for (rword page = start - (start % pageSize); page < end; page += pageSize) {
+    if (codePages.count(page) != 0 or unwatchedCodePages.contains(page)) {
+      continue;
+    }
+    newPage = true;
+    uint32_t writes = 0;
+    switch (monitor.watch(page, writes)) {
+      case CodeWriteMonitor::WATCH_OK:
+        codePages[page] = writes;
+        break;
+      case CodeWriteMonitor::WATCH_READONLY:
+        codePages[page] = CODEPAGE_READONLY;
+        break;
+      case CodeWriteMonitor::WATCH_FAILED:
+        // the sequences of this page are invalidated at each run
+        QBDI_DEBUG("Cannot watch the code page 0x{:x}", page);
+        unwatchedCodePages.add({page, page + pageSize});
+        break;
+    }
+  }
+  return newPage;
+}
+
+void Engine::checkCodeWrites() {
+  if (codePages.empty()) {
+    return;
+  }
+  CodeWriteMonitor &monitor = CodeWriteMonitor::get();
+  uint64_t counter = monitor.getWriteCounter();
+  if (counter == codeWriteCounter) {
+    return;
+  }
+  codeWriteCounter = counter;
+
+  const rword pageSize = monitor.getPageSize();
+  for (auto it = codePages.begin(); it != codePages.end();) {
+    if (it->second == CODEPAGE_READONLY or
+        monitor.getWrites(it->first) == it->second) {
+      ++it;
+      continue;
+    }
+    QBDI_DEBUG("Code page 0x{:x} has been modified", it->first);
+    // The page is watched again when its code is translated again
+    blockManager->invalidateRange({it->first, it->first + pageSize});
+    monitor.unwatch(it->first);
+    it = codePages.erase(it);
+  }
+}
+
+void Engine::unwatchCode() {
+  CodeWriteMonitor &monitor = CodeWriteMonitor::get();
+  for (const auto &it : codePages) {
+    if (it.second != CODEPAGE_READONLY) {
+      monitor.unwatch(it.first);
+    }
+  }
+  codePages.clear();
+  unwatchedCodePages.clear();
+}
+
 bool Engine::precacheBasicBlock(rword pc) {
   QBDI_REQUIRE_ABORT(not running,
                      "Cannot precacheBasicBlock on a running Engine");
+  checkCodeWrites();
   if (blockManager->isFlushPending()) {
     // Commit the flush
     blockManager->flushCommit();
@@ -394,6 +560,12 @@ bool Engine::run(rword start, rword stop) {
 
   running = true;
 
+  // The code of the pages that cannot be watched may have changed since the
+  // last run
+  for (const Range<rword> &r : unwatchedCodePages.getRanges()) {
+    blockManager->invalidateRange(r);
+  }
+
   // Execute basic block per basic block
   do {
     VMAction action = CONTINUE;
@@ -457,6 +629,18 @@ bool Engine::run(rword start, rword stop) {
       QBDI_DEBUG("Executing 0x{:x} through DBI in mode {}", currentPC,
                  curCPUMode);
 
+      // Invalidate the sequences of the modified code. A write from another
+      // thread after this check is handled before the next sequence: the
+      // current sequence may be executed once with the previous code.
+      checkCodeWrites();
+
+      // No InstAnalysis is used by a callback between two sequences. The
+      // ExecBlocks look up their analysis again in the new generation.
+      if (llvmCPUs->isAnalysisCacheFull()) {
+        QBDI_DEBUG("InstAnalysis cache full, start a new generation");
+        llvmCPUs->newAnalysisGeneration();
+      }
+
       // Is cache flush pending?
       if (blockManager->isFlushPending()) {
         // Backup fprState and gprState
@@ -506,7 +690,23 @@ bool Engine::run(rword start, rword stop) {
 
       if (action == CONTINUE) {
         hasRan = true;
+        if (traceRecorder != nullptr) {
+          traceRecorder->recordSequence(currentPC, currentSequence.seqEnd,
+                                        curCPUMode);
+        }
         action = curExecBlock->execute();
+        // the rules of the one-shot callbacks don't instrument the
+        // instruction again
+        for (const auto &fired : curExecBlock->takeFiredOneShot()) {
+          InstrRule *rule = getInstrRule(fired.first);
+          if (rule != nullptr) {
+            rule->setOneShotFired(fired.second);
+          }
+        }
+        // the recorder may have been removed by a callback
+        if (traceRecorder != nullptr) {
+          traceRecorder->recordMemoryAccess(*curExecBlock, isPreInst());
+        }
         // Signal events if normal exit
         if (action == CONTINUE) {
           if (basicBlockEndAddr == currentSequence.seqEnd) {
@@ -551,7 +751,7 @@ uint32_t Engine::addInstrRule(std::unique_ptr<InstrRule> &&rule) {
   uint32_t id = instrRulesCounter++;
   QBDI_REQUIRE_ACTION(id < EVENTID_VM_MASK, return VMError::INVALID_EVENTID);
 
-  this->clearCache(rule->affectedRange());
+  clearRuleCache(*rule);
 
   auto v = std::make_pair(id, std::move(rule));
 
@@ -563,6 +763,7 @@ uint32_t Engine::addInstrRule(std::unique_ptr<InstrRule> &&rule) {
                                       b.second->getPriority();
                              });
   instrRules.insert(it, std::move(v));
+  instrRulesIndex.reset();
 
   return id;
 }
@@ -583,7 +784,7 @@ InstrRule *Engine::getInstrRule(uint32_t id) {
 uint32_t Engine::addVMEventCB(VMEvent mask, VMCallback cbk, void *data) {
   uint32_t id = vmCallbacksCounter++;
   QBDI_REQUIRE_ACTION(id < EVENTID_VM_MASK, return VMError::INVALID_EVENTID);
-  vmCallbacks.emplace_back(id, CallbackRegistration{mask, cbk, data});
+  vmCallbacks.emplace_back(id, CallbackRegistration{mask, cbk, data, true});
   eventMask |= mask;
   return id | EVENTID_VM_MASK;
 }
@@ -621,7 +822,7 @@ VMAction Engine::signalEvent(VMEvent event, rword currentPC,
   VMAction action = CONTINUE;
   for (const auto &item : vmCallbacks) {
     const QBDI::CallbackRegistration &r = item.second;
-    if (event & r.mask) {
+    if ((event & r.mask) and r.enabled) {
       vmState.event = event;
       VMAction res = r.cbk(vminstance, &vmState, gprState, fprState, r.data);
       if (res > action) {
@@ -663,8 +864,32 @@ bool Engine::deleteInstrumentation(uint32_t id) {
   } else {
     for (size_t i = 0; i < instrRules.size(); i++) {
       if (instrRules[i].first == id) {
-        this->clearCache(instrRules[i].second->affectedRange());
+        clearRuleCache(*instrRules[i].second);
         instrRules.erase(instrRules.begin() + i);
+        instrRulesIndex.reset();
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Engine::setInstrumentationEnabled(uint32_t id, bool enabled) {
+  if (id & EVENTID_VM_MASK) {
+    id &= ~EVENTID_VM_MASK;
+    for (auto &item : vmCallbacks) {
+      if (item.first == id) {
+        item.second.enabled = enabled;
+        return true;
+      }
+    }
+  } else {
+    for (auto &item : instrRules) {
+      if (item.first == id) {
+        if (item.second->isEnabled() != enabled) {
+          item.second->setEnabled(enabled);
+          blockManager->setCallbacksEnabled(id, enabled);
+        }
         return true;
       }
     }
@@ -675,19 +900,27 @@ bool Engine::deleteInstrumentation(uint32_t id) {
 void Engine::deleteAllInstrumentations() {
   // clear cache
   for (const auto &r : instrRules) {
-    this->clearCache(r.second->affectedRange());
+    clearRuleCache(*r.second);
   }
   instrRules.clear();
+  instrRulesIndex.reset();
   vmCallbacks.clear();
   instrRulesCounter = 0;
   vmCallbacksCounter = 0;
   eventMask = VMEvent::NO_EVENT;
 }
 
-void Engine::clearAllCache() { blockManager->clearCache(not running); }
+void Engine::clearAllCache() {
+  unwatchCode();
+  blockManager->clearCache(not running);
+  decodeCache->clear();
+  patchCache->clear();
+}
 
 void Engine::clearCache(rword start, rword end) {
   blockManager->clearCache(Range<rword>(start, end));
+  decodeCache->clear(Range<rword>(start, end));
+  patchCache->clear(Range<rword>(start, end));
   if (not running && blockManager->isFlushPending()) {
     blockManager->flushCommit();
   }
@@ -22,6 +22,7 @@
 #include <memory>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -33,19 +34,25 @@
 
 namespace QBDI {
 
+class DecodeCache;
 class LLVMCPUs;
 class ExecBlock;
 class ExecBlockManager;
 class ExecBroker;
 class InstrRule;
+class InstrRuleIndex;
 class Patch;
+class PatchCache;
 class PatchRuleAssembly;
 struct SeqLoc;
+class StackPool;
+class TraceRecorder;
 
 struct CallbackRegistration {
   VMEvent mask;
   VMCallback cbk;
   void *data;
+  bool enabled;
 };
 
 class Engine {
@@ -56,8 +63,15 @@ private:
   std::unique_ptr<ExecBlockManager> blockManager;
   ExecBroker *execBroker;
   std::unique_ptr<PatchRuleAssembly> patchRuleAssembly;
+  std::unique_ptr<DecodeCache> decodeCache;
+  std::unique_ptr<PatchCache> patchCache;
+  std::unique_ptr<TraceRecorder> traceRecorder;
+  // stacks of switchStackAndCall, created on the first use
+  std::unique_ptr<StackPool> stackPool;
   std::vector<std::pair<uint32_t, std::unique_ptr<InstrRule>>> instrRules;
   uint32_t instrRulesCounter;
+  // index of instrRules, built on the next instrumentation when null
+  std::unique_ptr<InstrRuleIndex> instrRulesIndex;
   std::vector<std::pair<uint32_t, CallbackRegistration>> vmCallbacks;
   uint32_t vmCallbacksCounter;
   std::unique_ptr<GPRState> gprState;
@@ -69,6 +83,12 @@ private:
   Options options;
   VMEvent eventMask;
   bool running;
+  // pages of the translated code watched by the CodeWriteMonitor, with the
+  // number of writes of each page when it was watched
+  std::unordered_map<rword, uint32_t> codePages;
+  // pages of the translated code that cannot be watched
+  RangeSet<rword> unwatchedCodePages;
+  uint64_t codeWriteCounter;
 
   std::vector<Patch> patch(rword start);
 
@@ -76,8 +96,14 @@ private:
   void initFPRState();
 
   void instrument(std::vector<Patch> &basicBlock, size_t patchEnd);
+  void clearRuleCache(const InstrRule &rule);
   void handleNewBasicBlock(rword pc);
 
+  // return true if a page of the range wasn't known by the Engine
+  bool watchCode(rword start, rword end);
+  void checkCodeWrites();
+  void unwatchCode();
+
   VMAction signalEvent(VMEvent kind, rword currentPC, const SeqLoc *seqLoc,
                        rword basicBlockBegin, GPRState *gprState,
                        FPRState *fprState);
@@ -253,6 +279,14 @@ public:
    */
   bool deleteInstrumentation(uint32_t id);
 
+  /*! Enable or disable an instrumentation without flushing the cache.
+   *
+   * @param[in] id       The id of the instrumentation.
+   * @param[in] enabled  The new state of the instrumentation.
+   * @return  True if the id is valid.
+   */
+  bool setInstrumentationEnabled(uint32_t id, bool enabled);
+
   /*! Remove all the registered instrumentations.
    *
    */
@@ -270,6 +304,26 @@ public:
    */
   bool isPreInst() const;
 
+  /*! Set the recorder of the trace of the execution. The previous recorder
+   * is flushed and closed.
+   *
+   * @param[in] recorder The new recorder, or nullptr to stop the recording
+   */
+  void setTraceRecorder(std::unique_ptr<TraceRecorder> &&recorder);
+
+  /*! Get the current recorder of the trace
+   *
+   * @return The recorder, or nullptr if no trace is recorded
+   */
+  TraceRecorder *getTraceRecorder() const { return traceRecorder.get(); }
+
+  /*! Get the virtual stacks reused by switchStackAndCall. The pool isn't
+   * copied with the Engine.
+   *
+   * @return The stack pool of the engine
+   */
+  StackPool &getStackPool();
+
   /*! Pre-cache a known basic block
    *
    * @param[in] pc Start address of a basic block
@@ -289,7 +343,8 @@ public:
    */
   const InstAnalysis *getInstAnalysis(rword address, AnalysisType type) const;
 
-  /*! Clear a specific address range from the translation cache.
+  /*! Clear a specific address range from the translation cache. The decoded
+   * instructions of the range are also removed.
    *
    * @param[in] start Start of the address range to clear from the cache.
    * @param[in] end   End of the address range to clear from the cache.
@@ -15,6 +15,9 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <utility>
 
 #include "llvm/ADT/SmallVector.h"
@@ -45,8 +48,11 @@
 #include "llvm/TargetParser/Triple.h"
 
 #include "QBDI/Config.h"
+#include "devVariable.h"
 #include "Engine/LLVMCPU.h"
+#include "Patch/FastEncoder.h"
 #include "Patch/Types.h"
+#include "Utility/InstAnalysis_prive.h"
 #include "Utility/LogSys.h"
 #include "Utility/System.h"
 
@@ -78,30 +84,28 @@ void LLVMCPUs::setOptions(Options opts) {
   }
 }
 
-LLVMCPU::LLVMCPU(const std::string &_cpu, const std::string &_arch,
-                 const std::vector<std::string> &_mattrs, Options opts,
-                 CPUMode cpumode)
-    : cpu(_cpu), arch(_arch), mattrs(_mattrs), options(opts), cpumode(cpumode) {
+void LLVMCPUs::newAnalysisGeneration() const {
+  for (int i = 0; i < CPUMode::COUNT; i++) {
+    llvmcpu[i]->getAnalysisCache().newGeneration();
+  }
+}
+
+bool LLVMCPUs::isAnalysisCacheFull() const {
+  for (int i = 0; i < CPUMode::COUNT; i++) {
+    if (llvmcpu[i]->getAnalysisCache().isFull()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+LLVMTarget::LLVMTarget(const std::string &_cpu, const std::string &_arch,
+                       const std::vector<std::string> &_mattrs)
+    : cpu(_cpu), arch(_arch), mattrs(_mattrs) {
 
   std::string error;
   std::string featuresStr;
 
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmParsers();
-  llvm::InitializeAllDisassemblers();
-
-  // Build features string
-  if (cpu.empty()) {
-    cpu = QBDI::getHostCPUName();
-    // If API is broken on ARM, we are facing big problems...
-    if constexpr (is_arm) {
-      QBDI_REQUIRE(!cpu.empty() && cpu != "generic");
-    }
-  }
-  if (mattrs.empty()) {
-    mattrs = getHostCPUFeatures();
-  }
   if (!mattrs.empty()) {
     llvm::SubtargetFeatures features;
     for (unsigned i = 0; i != mattrs.size(); ++i) {
@@ -119,7 +123,7 @@ LLVMCPU::LLVMCPU(const std::string &_cpu, const std::string &_arch,
   tripleName = processTriple.getTriple();
   QBDI_DEBUG("Initialized LLVM for target {}", tripleName.c_str());
 
-  // Allocate all LLVM classes
+  // Allocate the immutable LLVM classes
   llvm::MCTargetOptions MCOptions;
   MRI = std::unique_ptr<llvm::MCRegisterInfo>(
       target->createMCRegInfo(tripleName));
@@ -128,43 +132,124 @@ LLVMCPU::LLVMCPU(const std::string &_cpu, const std::string &_arch,
   MCII = std::unique_ptr<llvm::MCInstrInfo>(target->createMCInstrInfo());
   MSTI = std::unique_ptr<llvm::MCSubtargetInfo>(
       target->createMCSubtargetInfo(tripleName, cpu, featuresStr));
-  MCTX = std::make_unique<llvm::MCContext>(processTriple, MAI.get(), MRI.get(),
-                                           MSTI.get(), nullptr, &MCOptions);
-  MOFI = std::unique_ptr<llvm::MCObjectFileInfo>(
-      target->createMCObjectFileInfo(*MCTX, false));
-  MCTX->setObjectFileInfo(MOFI.get());
   QBDI_DEBUG("Initialized LLVM subtarget with cpu {} and features {}",
              cpu.c_str(), featuresStr.c_str());
+}
 
-  auto MAB = std::unique_ptr<llvm::MCAsmBackend>(
-      target->createMCAsmBackend(*MSTI, *MRI, MCOptions));
+LLVMTarget::~LLVMTarget() = default;
 
-  // assembler, disassembler and printer
-  null_ostream = std::make_unique<llvm::raw_null_ostream>();
+std::shared_ptr<const LLVMTarget>
+LLVMTarget::get(const std::string &cpu, const std::string &arch,
+                const std::vector<std::string> &mattrs) {
+  using Key = std::tuple<std::string, std::string, std::vector<std::string>>;
+  static std::mutex registryLock;
+  static std::map<Key, std::shared_ptr<const LLVMTarget>> registry;
+
+  std::lock_guard<std::mutex> guard(registryLock);
+
+  if (registry.empty()) {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllDisassemblers();
+  }
+
+  // The host CPU is resolved before the lookup, so that a VM created with the
+  // CPU of another VM shares its target.
+  std::string targetCPU = cpu;
+  std::vector<std::string> targetMattrs = mattrs;
+  if (targetCPU.empty()) {
+    static const std::string hostCPU = QBDI::getHostCPUName();
+    targetCPU = hostCPU;
+    // If API is broken on ARM, we are facing big problems...
+    if constexpr (is_arm) {
+      QBDI_REQUIRE(!targetCPU.empty() && targetCPU != "generic");
+    }
+  }
+  if (targetMattrs.empty()) {
+    static const std::vector<std::string> hostMattrs = getHostCPUFeatures();
+    targetMattrs = hostMattrs;
+  }
+
+  Key key{targetCPU, arch, targetMattrs};
+  auto it = registry.find(key);
+  if (it != registry.end()) {
+    return it->second;
+  }
+  std::shared_ptr<const LLVMTarget> llvmTarget{
+      new LLVMTarget(targetCPU, arch, targetMattrs)};
+  registry.emplace(std::move(key), llvmTarget);
+  return llvmTarget;
+}
+
+LLVMCPU::LLVMCPU(const std::string &_cpu, const std::string &_arch,
+                 const std::vector<std::string> &_mattrs, Options opts,
+                 CPUMode cpumode)
+    : llvmTarget(LLVMTarget::get(_cpu, _arch, _mattrs)), options(opts),
+      cpumode(cpumode) {
+
+  const llvm::MCSubtargetInfo &MSTI = llvmTarget->getMSTI();
+
+  // Allocate the LLVM classes needed to decode the instructions. The others
+  // are created on their first use.
+  llvm::MCTargetOptions MCOptions;
+  MCTX = std::make_unique<llvm::MCContext>(
+      MSTI.getTargetTriple(), &llvmTarget->getMAI(), &llvmTarget->getMRI(),
+      &MSTI, nullptr, &MCOptions);
 
   disassembler = std::unique_ptr<llvm::MCDisassembler>(
-      target->createMCDisassembler(*MSTI, *MCTX));
+      llvmTarget->getTarget().createMCDisassembler(MSTI, *MCTX));
+
+  analysisCache = std::make_unique<InstAnalysisCache>();
+}
+
+llvm::MCAssembler &LLVMCPU::getAssembler() const {
+  if (assembler) {
+    return *assembler;
+  }
+  const llvm::Target &target = llvmTarget->getTarget();
+  llvm::MCTargetOptions MCOptions;
+
+  MOFI = std::unique_ptr<llvm::MCObjectFileInfo>(
+      target.createMCObjectFileInfo(*MCTX, false));
+  MCTX->setObjectFileInfo(MOFI.get());
+
+  auto MAB = std::unique_ptr<llvm::MCAsmBackend>(target.createMCAsmBackend(
+      llvmTarget->getMSTI(), llvmTarget->getMRI(), MCOptions));
+
+  null_ostream = std::make_unique<llvm::raw_null_ostream>();
 
   auto codeEmitter = std::unique_ptr<llvm::MCCodeEmitter>(
-      target->createMCCodeEmitter(*MCII, *MCTX));
+      target.createMCCodeEmitter(llvmTarget->getMCII(), *MCTX));
 
   auto objectWriter = std::unique_ptr<llvm::MCObjectWriter>(
       MAB->createObjectWriter(*null_ostream));
 
   assembler = std::make_unique<llvm::MCAssembler>(
       *MCTX, std::move(MAB), std::move(codeEmitter), std::move(objectWriter));
+  QBDI_DEBUG("Initialized LLVM assembler for CPUMode {}", cpumode);
+  return *assembler;
+}
 
+llvm::MCInstPrinter &LLVMCPU::getAsmPrinter() const {
+  if (asmPrinter) {
+    return *asmPrinter;
+  }
   unsigned int variant = 0;
 #if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
   variant = ((options & Options::OPT_ATT_SYNTAX) == 0) ? 1 : 0;
 #else
-  variant = MAI->getAssemblerDialect();
+  variant = llvmTarget->getMAI().getAssemblerDialect();
 #endif
 
-  asmPrinter = std::unique_ptr<llvm::MCInstPrinter>(target->createMCInstPrinter(
-      MSTI->getTargetTriple(), variant, *MAI, *MCII, *MRI));
+  asmPrinter = std::unique_ptr<llvm::MCInstPrinter>(
+      llvmTarget->getTarget().createMCInstPrinter(
+          llvmTarget->getMSTI().getTargetTriple(), variant,
+          llvmTarget->getMAI(), llvmTarget->getMCII(), llvmTarget->getMRI()));
   asmPrinter->setPrintImmHex(true);
   asmPrinter->setPrintImmHex(llvm::HexStyle::C);
+  QBDI_DEBUG("Initialized LLVM printer for CPUMode {}", cpumode);
+  return *asmPrinter;
 }
 
 LLVMCPU::~LLVMCPU() = default;
@@ -186,6 +271,31 @@ bool LLVMCPU::getInstruction(llvm::MCInst &instr, uint64_t &size,
 void LLVMCPU::writeInstruction(const llvm::MCInst inst,
                                llvm::SmallVectorImpl<char> &CB,
                                rword address) const {
+  uint64_t pos = CB.size();
+  if (fastEncodeInstruction(inst, CB, llvmTarget->getMRI())) {
+    auto buffRef = llvm::MutableArrayRef<char>(CB).drop_front(pos);
+    QBDI_DEBUG_BLOCK({
+      std::string disass = showInst(inst, address);
+      QBDI_DEBUG("Fast assembly of {} for 0x{:x} is: {:n}", disass.c_str(),
+                 address, spdlog::to_hex(buffRef));
+    });
+#if CHECK_FAST_ENCODER
+    llvm::SmallVector<char, 16> expected;
+    writeInstructionMC(inst, expected, address);
+    if (llvm::ArrayRef<char>(expected) != llvm::ArrayRef<char>(buffRef)) {
+      QBDI_ABORT("Fast encoder mismatch for {} (result: {:n}, expected: {:n})",
+                 showInst(inst, address), spdlog::to_hex(buffRef),
+                 spdlog::to_hex(expected));
+    }
+#endif
+    return;
+  }
+  writeInstructionMC(inst, CB, address);
+}
+
+void LLVMCPU::writeInstructionMC(const llvm::MCInst inst,
+                                 llvm::SmallVectorImpl<char> &CB,
+                                 rword address) const {
   // MCCodeEmitter needs a fixups array
   llvm::SmallVector<llvm::MCFixup, 4> fixups;
 
@@ -194,7 +304,9 @@ void LLVMCPU::writeInstruction(const llvm::MCInst inst,
     std::string disass = showInst(inst, address);
     QBDI_DEBUG("Assembling {} for 0x{:x}", disass.c_str(), address);
   });
-  assembler->getEmitter().encodeInstruction(inst, CB, fixups, *MSTI);
+  llvm::MCAssembler &mcAssembler = getAssembler();
+  mcAssembler.getEmitter().encodeInstruction(inst, CB, fixups,
+                                             llvmTarget->getMSTI());
   auto buffRef = llvm::MutableArrayRef<char>(CB).drop_front(pos);
 
   if (fixups.size() > 0) {
@@ -202,8 +314,9 @@ void LLVMCPU::writeInstruction(const llvm::MCInst inst,
     llvm::MCFixup fixup = fixups.pop_back_val();
     int64_t value;
     if (fixup.getValue()->evaluateAsAbsolute(value)) {
-      assembler->getBackend().applyFixup(*assembler, fixup, target, buffRef,
-                                         (uint64_t)value, true, MSTI.get());
+      mcAssembler.getBackend().applyFixup(mcAssembler, fixup, target, buffRef,
+                                        (uint64_t)value, true,
+                                        &llvmTarget->getMSTI());
     } else {
       QBDI_WARN("Could not evalutate fixup, might crash!");
     }
@@ -218,14 +331,15 @@ std::string LLVMCPU::showInst(const llvm::MCInst &inst, rword address) const {
   llvm::raw_string_ostream rso(out);
 
   llvm::StringRef unusedAnnotations;
-  asmPrinter->printInst(&inst, address, unusedAnnotations, *MSTI, rso);
+  getAsmPrinter().printInst(&inst, address, unusedAnnotations,
+                            llvmTarget->getMSTI(), rso);
 
   rso.flush();
   return out;
 }
 
 const char *LLVMCPU::getRegisterName(RegLLVM r) const {
-  return MRI->getName(r.getValue());
+  return llvmTarget->getMRI().getName(r.getValue());
 }
 
 const char *LLVMCPU::getInstOpcodeName(const llvm::MCInst &inst) const {
@@ -237,19 +351,17 @@ const char *LLVMCPU::getInstOpcodeName(unsigned opcode) const {
    * However, in the case of opcode name, that seems to be always the case
    * see <ARM|AArch64|X86>InstrNameData
    */
-  return MCII->getName(opcode).data();
+  return llvmTarget->getMCII().getName(opcode).data();
 }
 
 void LLVMCPU::setOptions(Options opts) {
 #if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
   if (((opts ^ options) & Options::OPT_ATT_SYNTAX) != 0) {
-    asmPrinter =
-        std::unique_ptr<llvm::MCInstPrinter>(target->createMCInstPrinter(
-            MSTI->getTargetTriple(),
-            ((opts & Options::OPT_ATT_SYNTAX) == 0) ? 1 : 0, *MAI, *MCII,
-            *MRI));
-    asmPrinter->setPrintImmHex(true);
-    asmPrinter->setPrintImmHex(llvm::HexStyle::C);
+    // the printer is created again with the new syntax on the next use
+    asmPrinter.reset();
+    // the disassembly of the cached analysis uses the previous syntax. The
+    // Engine has flushed all the ExecBlock before changing the options.
+    analysisCache->clear();
   }
 #endif
   options = opts;
@@ -47,30 +47,90 @@ class raw_pwrite_stream;
 } // namespace llvm
 
 namespace QBDI {
+class InstAnalysisCache;
 struct RegLLVM;
 
-class LLVMCPU {
-
+/*! LLVM target objects of a configuration (cpu, arch, mattrs). They are
+ * immutable once created and shared by all the LLVMCPU of the process with the
+ * same configuration, including from different threads.
+ */
+class LLVMTarget {
 private:
   std::string tripleName;
   std::string cpu;
   std::string arch;
   std::vector<std::string> mattrs;
   const llvm::Target *target;
-  Options options;
-  CPUMode cpumode;
 
   std::unique_ptr<llvm::MCAsmInfo> MAI;
-  std::unique_ptr<llvm::MCContext> MCTX;
   std::unique_ptr<llvm::MCInstrInfo> MCII;
-  std::unique_ptr<llvm::MCObjectFileInfo> MOFI;
   std::unique_ptr<llvm::MCRegisterInfo> MRI;
   std::unique_ptr<llvm::MCSubtargetInfo> MSTI;
 
-  std::unique_ptr<llvm::MCAssembler> assembler;
+  LLVMTarget(const std::string &cpu, const std::string &arch,
+             const std::vector<std::string> &mattrs);
+
+public:
+  ~LLVMTarget();
+
+  LLVMTarget(const LLVMTarget &) = delete;
+  LLVMTarget &operator=(const LLVMTarget &) = delete;
+
+  /*! Get the target of a configuration. The target is created on the first
+   * call and kept until the end of the process.
+   *
+   * @param[in] cpu     The name of the CPU, or an empty string for the host CPU
+   * @param[in] arch    The name of the LLVM architecture
+   * @param[in] mattrs  The features of the CPU, or an empty list for the
+   *                    features of the host CPU
+   */
+  static std::shared_ptr<const LLVMTarget>
+  get(const std::string &cpu, const std::string &arch,
+      const std::vector<std::string> &mattrs);
+
+  inline const std::string &getTripleName() const { return tripleName; }
+
+  inline const std::string &getCPU() const { return cpu; }
+
+  inline const std::vector<std::string> &getMattrs() const { return mattrs; }
+
+  inline const llvm::Target &getTarget() const { return *target; }
+
+  inline const llvm::MCAsmInfo &getMAI() const { return *MAI; }
+
+  inline const llvm::MCInstrInfo &getMCII() const { return *MCII; }
+
+  inline const llvm::MCRegisterInfo &getMRI() const { return *MRI; }
+
+  inline const llvm::MCSubtargetInfo &getMSTI() const { return *MSTI; }
+};
+
+/*! LLVM objects of a VM for a CPUMode. The mutable objects (context,
+ * assembler, disassembler and printer) belong to the LLVMCPU, the target
+ * objects are shared with the other VMs.
+ */
+class LLVMCPU {
+
+private:
+  std::shared_ptr<const LLVMTarget> llvmTarget;
+  Options options;
+  CPUMode cpumode;
+
+  std::unique_ptr<llvm::MCContext> MCTX;
   std::unique_ptr<llvm::MCDisassembler> disassembler;
-  std::unique_ptr<llvm::MCInstPrinter> asmPrinter;
-  std::unique_ptr<llvm::raw_pwrite_stream> null_ostream;
+
+  // Created on the first use: most instructions are written by the fast
+  // encoder, and the printer is only used for the disassembly.
+  mutable std::unique_ptr<llvm::MCObjectFileInfo> MOFI;
+  mutable std::unique_ptr<llvm::MCAssembler> assembler;
+  mutable std::unique_ptr<llvm::MCInstPrinter> asmPrinter;
+  mutable std::unique_ptr<llvm::raw_pwrite_stream> null_ostream;
+
+  std::unique_ptr<InstAnalysisCache> analysisCache;
+
+  llvm::MCAssembler &getAssembler() const;
+
+  llvm::MCInstPrinter &getAsmPrinter() const;
 
 public:
   LLVMCPU(const std::string &cpu = "", const std::string &arch = "",
@@ -88,6 +148,12 @@ public:
   void writeInstruction(llvm::MCInst inst, llvm::SmallVectorImpl<char> &CB,
                         rword address = 0) const;
 
+  /*! Encode an instruction with the LLVM MCCodeEmitter, without the fast
+   * encoder used by writeInstruction.
+   */
+  void writeInstructionMC(llvm::MCInst inst, llvm::SmallVectorImpl<char> &CB,
+                          rword address = 0) const;
+
   bool getInstruction(llvm::MCInst &inst, uint64_t &size,
                       llvm::ArrayRef<uint8_t> bytes, uint64_t address) const;
 
@@ -99,17 +165,25 @@ public:
 
   const char *getRegisterName(RegLLVM id) const;
 
-  inline const std::string &getCPU() const { return cpu; }
+  inline const std::string &getCPU() const { return llvmTarget->getCPU(); }
 
-  inline const std::vector<std::string> &getMattrs() const { return mattrs; }
+  inline const std::vector<std::string> &getMattrs() const {
+    return llvmTarget->getMattrs();
+  }
 
   inline const CPUMode getCPUMode() const { return cpumode; }
 
   inline operator CPUMode() const { return cpumode; }
 
-  inline const llvm::MCInstrInfo &getMCII() const { return *MCII; }
+  inline const llvm::MCInstrInfo &getMCII() const {
+    return llvmTarget->getMCII();
+  }
 
-  inline const llvm::MCRegisterInfo &getMRI() const { return *MRI; }
+  inline const llvm::MCRegisterInfo &getMRI() const {
+    return llvmTarget->getMRI();
+  }
+
+  inline InstAnalysisCache &getAnalysisCache() const { return *analysisCache; }
 
   Options getOptions() const { return options; }
   void setOptions(Options opts);
@@ -148,6 +222,15 @@ public:
   void setOptions(Options opts);
 
   const LLVMCPU &getCPU(CPUMode mode) const { return *llvmcpu[mode]; }
+
+  /*! Start a new generation of the analysis caches. The analysis not used
+   * since the previous generation are freed.
+   */
+  void newAnalysisGeneration() const;
+
+  /*! Return true if an analysis cache has reached its maximum size.
+   */
+  bool isAnalysisCacheFull() const;
 };
 
 } // namespace QBDI
@@ -0,0 +1,138 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include "Engine/PatchCache.h"
+#include "Utility/LogSys.h"
+
+namespace QBDI {
+
+void PatchCache::erase(ModeCache &cache, std::map<rword, Entry>::iterator it) {
+  cache.lru.erase(it->second.lru);
+  cache.entries.erase(it);
+}
+
+bool PatchCache::getBasicBlock(CPUMode cpuMode, llvm::ArrayRef<uint8_t> code,
+                               rword address, std::vector<Patch> &basicBlock) {
+  ModeCache &cache = caches[cpuMode];
+
+  auto it = cache.entries.find(address);
+  if (it == cache.entries.end()) {
+    return false;
+  }
+  const Entry &entry = it->second;
+  if (entry.bytes.size() > code.size() or
+      memcmp(entry.bytes.data(), code.data(), entry.bytes.size()) != 0) {
+    // the code has changed, or the basic block is now out of the
+    // instrumented range
+    erase(cache, it);
+    return false;
+  }
+  if (entry.truncatedSize != 0 and entry.truncatedSize != code.size()) {
+    // the instrumented range has changed around the end of the basic block,
+    // it may continue further
+    erase(cache, it);
+    return false;
+  }
+  cache.lru.splice(cache.lru.begin(), cache.lru, entry.lru);
+
+  basicBlock.clear();
+  basicBlock.reserve(entry.basicBlock.size());
+  for (const Patch &p : entry.basicBlock) {
+    basicBlock.push_back(p.clone());
+  }
+  return true;
+}
+
+void PatchCache::addBasicBlock(const std::vector<Patch> &basicBlock,
+                               llvm::ArrayRef<uint8_t> code, bool truncated) {
+  QBDI_REQUIRE_ACTION(not basicBlock.empty(), return );
+
+  const InstMetadata &first = basicBlock.front().metadata;
+  ModeCache &cache = caches[first.cpuMode];
+
+  auto it = cache.entries.find(first.address);
+  if (it == cache.entries.end()) {
+    if (cache.entries.size() >= MAX_ENTRIES) {
+      QBDI_DEBUG("PatchCache full for CPUMode {}, remove the entry 0x{:x}",
+                 first.cpuMode, cache.lru.back());
+      erase(cache, cache.entries.find(cache.lru.back()));
+    }
+    cache.lru.push_front(first.address);
+    it = cache.entries.emplace(first.address, Entry{}).first;
+    it->second.lru = cache.lru.begin();
+  } else {
+    cache.lru.splice(cache.lru.begin(), cache.lru, it->second.lru);
+  }
+
+  const rword bbEnd = basicBlock.back().metadata.endAddress();
+  const uint8_t *start = reinterpret_cast<const uint8_t *>(first.address);
+  const uint8_t *end = reinterpret_cast<const uint8_t *>(bbEnd);
+
+  Entry &entry = it->second;
+  entry.basicBlock.clear();
+  entry.basicBlock.reserve(basicBlock.size());
+  for (const Patch &p : basicBlock) {
+    entry.basicBlock.push_back(p.clone());
+  }
+  entry.bytes.assign(start, end);
+  entry.truncatedSize = truncated ? code.size() : 0;
+  if (cache.maxBytes < entry.bytes.size()) {
+    cache.maxBytes = entry.bytes.size();
+  }
+}
+
+void PatchCache::clear(Range<rword> range) {
+  for (ModeCache &cache : caches) {
+    // only the entries that begin less than maxBytes before the range can
+    // overlap it
+    rword first = 0;
+    if (range.start() > cache.maxBytes) {
+      first = range.start() - cache.maxBytes;
+    }
+    for (auto it = cache.entries.lower_bound(first);
+         it != cache.entries.end() and it->first < range.end();) {
+      const Range<rword> bbRange{
+          it->first, it->first + static_cast<rword>(it->second.bytes.size())};
+      if (range.overlaps(bbRange)) {
+        cache.lru.erase(it->second.lru);
+        it = cache.entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void PatchCache::clear() {
+  for (ModeCache &cache : caches) {
+    cache.entries.clear();
+    cache.lru.clear();
+    cache.maxBytes = 0;
+  }
+}
+
+size_t PatchCache::size() const {
+  size_t s = 0;
+  for (const ModeCache &cache : caches) {
+    s += cache.entries.size();
+  }
+  return s;
+}
+
+} // namespace QBDI
@@ -0,0 +1,119 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PATCHCACHE_H
+#define PATCHCACHE_H
+
+#include <stddef.h>
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include "Patch/Patch.h"
+
+#include "QBDI/Range.h"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Cache of the patched basic blocks, before their instrumentation.
+ *
+ * When the instrumentation rules change, the basic blocks flushed from the
+ * ExecBlock cache are translated again with the same PatchRules. The cache
+ * keeps a copy of each patched basic block with a copy of its bytes, so that
+ * only the instrumentation and the write in the ExecBlock are done again. An
+ * entry is only used if the bytes in memory are still the same.
+ *
+ * The entries are indexed by address. When the cache is full, the least
+ * recently used entry is removed.
+ */
+class PatchCache {
+public:
+  static constexpr size_t MAX_ENTRIES = 1 << 14;
+
+private:
+  struct Entry {
+    std::vector<Patch> basicBlock;
+    std::vector<uint8_t> bytes;
+    // size of the available code if the basic block has been truncated by
+    // the end of the code, 0 otherwise
+    size_t truncatedSize;
+    std::list<rword>::iterator lru;
+  };
+
+  struct ModeCache {
+    std::map<rword, Entry> entries;
+    // addresses of the entries, from the most recently used
+    std::list<rword> lru;
+    // size of the largest basic block, used to search the overlapping entries
+    size_t maxBytes = 0;
+  };
+
+  ModeCache caches[CPUMode::COUNT];
+
+  void erase(ModeCache &cache, std::map<rword, Entry>::iterator it);
+
+public:
+  PatchCache() = default;
+
+  PatchCache(const PatchCache &) = delete;
+  PatchCache &operator=(const PatchCache &) = delete;
+
+  /*! Get a copy of a cached basic block
+   *
+   * @param[in]  cpuMode     The CPUMode of the basic block
+   * @param[in]  code        The code from the address of the basic block
+   * @param[in]  address     The address of the basic block
+   * @param[out] basicBlock  The copy of the patched basic block
+   *
+   * @return False if the basic block isn't in the cache, if its code has
+   *         changed or if it was truncated by the end of a different code
+   */
+  bool getBasicBlock(CPUMode cpuMode, llvm::ArrayRef<uint8_t> code,
+                     rword address, std::vector<Patch> &basicBlock);
+
+  /*! Add a copy of a patched basic block. The basic block must not have been
+   * instrumented.
+   *
+   * @param[in] basicBlock  The patched basic block
+   * @param[in] code        The code available from the address of the basic
+   *                        block when it was patched
+   * @param[in] truncated   The basic block ended because its next
+   *                        instruction couldn't be decoded in the code
+   */
+  void addBasicBlock(const std::vector<Patch> &basicBlock,
+                     llvm::ArrayRef<uint8_t> code, bool truncated);
+
+  /*! Remove the basic blocks that overlap a range.
+   *
+   * @param[in] range  The range to remove
+   */
+  void clear(Range<rword> range);
+
+  /*! Remove all the basic blocks.
+   */
+  void clear();
+
+  size_t size() const;
+};
+
+} // namespace QBDI
+
+#endif // PATCHCACHE_H
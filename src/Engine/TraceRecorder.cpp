@@ -0,0 +1,277 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <string.h>
+#include <system_error>
+#include <type_traits>
+
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/Process.h"
+
+#include "Engine/TraceRecorder.h"
+#include "ExecBlock/ExecBlock.h"
+#include "Patch/MemoryAccess.h"
+#include "Utility/LogSys.h"
+
+#include "QBDI/Memory.hpp"
+
+namespace QBDI {
+
+namespace {
+
+inline void appendVarint(std::vector<uint8_t> &buffer, uint64_t value) {
+  uint8_t tmp[16];
+  unsigned size = llvm::encodeULEB128(value, tmp);
+  buffer.insert(buffer.end(), tmp, tmp + size);
+}
+
+// zigzag encoding of the difference between two rword
+inline void appendDelta(std::vector<uint8_t> &buffer, rword value,
+                        rword previous) {
+  int64_t delta = static_cast<std::make_signed_t<rword>>(value - previous);
+  appendVarint(buffer, (static_cast<uint64_t>(delta) << 1) ^
+                           static_cast<uint64_t>(delta >> 63));
+}
+
+} // anonymous namespace
+
+TraceRecorder::TraceRecorder(int fd, TraceFlags flags)
+    : flags(flags), fd(fd), mappingOffset(0), fileOffset(0), segmentNumber(0),
+      nextBlockID(0), lastBlockID(0), lastAddress(0) {
+  data.reserve(SEGMENT_SIZE + 64);
+}
+
+std::unique_ptr<TraceRecorder> TraceRecorder::create(const std::string &path,
+                                                     TraceFlags flags) {
+  static_assert(MAPPING_SIZE % SEGMENT_SIZE == 0);
+  if (MAPPING_SIZE % llvm::sys::fs::mapped_file_region::alignment() != 0) {
+    QBDI_ERROR("Unsupported mapping alignment {}",
+               llvm::sys::fs::mapped_file_region::alignment());
+    return nullptr;
+  }
+
+  int fd;
+  std::error_code ec = llvm::sys::fs::openFileForReadWrite(
+      path, fd, llvm::sys::fs::CD_CreateAlways, llvm::sys::fs::OF_None);
+  if (ec) {
+    QBDI_ERROR("Cannot create the trace file {}: {}", path, ec.message());
+    return nullptr;
+  }
+
+  std::unique_ptr<TraceRecorder> recorder{new TraceRecorder(fd, flags)};
+
+  TraceFileHeader header;
+  memset(&header, 0, sizeof(header));
+  strncpy(header.magic, QBDI_TRACE_MAGIC, sizeof(header.magic));
+  header.version = QBDI_TRACE_VERSION;
+  header.rwordSize = sizeof(rword);
+  if (not recorder->writeFile(&header, sizeof(header))) {
+    return nullptr;
+  }
+  QBDI_DEBUG("Record a trace in {}", path);
+  return recorder;
+}
+
+TraceRecorder::~TraceRecorder() {
+  flush();
+  mapping.reset();
+  // remove the unused part of the last mapping
+  std::error_code ec = llvm::sys::fs::resize_file(fd, fileOffset);
+  if (ec) {
+    QBDI_WARN("Cannot truncate the trace file: {}", ec.message());
+  }
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+bool TraceRecorder::writeFile(const void *buffer, size_t size) {
+  const uint8_t *src = static_cast<const uint8_t *>(buffer);
+
+  while (size > 0) {
+    if (mapping == nullptr or fileOffset >= mappingOffset + MAPPING_SIZE) {
+      mapping.reset();
+      mappingOffset = fileOffset - (fileOffset % MAPPING_SIZE);
+
+      std::error_code ec =
+          llvm::sys::fs::resize_file(fd, mappingOffset + MAPPING_SIZE);
+      if (not ec) {
+        mapping = std::make_unique<llvm::sys::fs::mapped_file_region>(
+            llvm::sys::fs::convertFDToNativeFile(fd),
+            llvm::sys::fs::mapped_file_region::readwrite, MAPPING_SIZE,
+            mappingOffset, ec);
+      }
+      if (ec) {
+        QBDI_ERROR("Cannot map the trace file: {}", ec.message());
+        mapping.reset();
+        return false;
+      }
+    }
+
+    size_t offset = fileOffset - mappingOffset;
+    size_t len = std::min(size, MAPPING_SIZE - offset);
+    memcpy(mapping->data() + offset, src, len);
+
+    src += len;
+    size -= len;
+    fileOffset += len;
+  }
+  return true;
+}
+
+void TraceRecorder::writeSegment(TraceSegmentKind kind,
+                                 std::vector<uint8_t> &buffer) {
+  TraceSegmentHeader header;
+  header.magic = QBDI_TRACE_SEGMENT_MAGIC;
+  header.kind = kind;
+  header.flags = 0;
+  header.size = buffer.size();
+  header.number = segmentNumber++;
+
+  if (not writeFile(&header, sizeof(header)) or
+      not writeFile(buffer.data(), buffer.size())) {
+    QBDI_ERROR("Fail to write a segment of the trace, {} bytes lost",
+               buffer.size());
+  }
+  buffer.clear();
+}
+
+void TraceRecorder::flush() {
+  // The definitions must be written before the first segment that uses them
+  if (not dictionary.empty()) {
+    writeSegment(TRACE_SEGMENT_DICTIONARY, dictionary);
+  }
+  if (not data.empty()) {
+    writeSegment(TRACE_SEGMENT_DATA, data);
+  }
+  lastBlockID = 0;
+  lastAddress = 0;
+}
+
+uint32_t TraceRecorder::getModule(rword address) {
+  for (const Module &m : modules) {
+    if (m.range.contains(address)) {
+      return m.id + 1;
+    }
+  }
+
+  // Search the module in the snapshot of the memory maps. A module is the
+  // union of the maps with the same name.
+  std::vector<MemoryMap> maps = getCachedProcessMaps(true);
+  auto it = std::find_if(maps.begin(), maps.end(), [&](const MemoryMap &m) {
+    return m.range.contains(address);
+  });
+  if (it == maps.end() or it->name.empty()) {
+    return 0;
+  }
+  std::string name = it->name;
+  Range<rword> range = it->range;
+  for (const MemoryMap &m : maps) {
+    if (m.name == name) {
+      range.setStart(std::min(range.start(), m.range.start()));
+      range.setEnd(std::max(range.end(), m.range.end()));
+    }
+  }
+
+  uint32_t id = modules.size();
+  modules.push_back({range, id});
+
+  dictionary.push_back(TRACE_RECORD_MODULE);
+  appendVarint(dictionary, id);
+  appendVarint(dictionary, range.start());
+  appendVarint(dictionary, range.end());
+  appendVarint(dictionary, name.size());
+  dictionary.insert(dictionary.end(), name.begin(), name.end());
+
+  return id + 1;
+}
+
+uint32_t TraceRecorder::getBlock(rword address, rword end, CPUMode cpuMode) {
+  auto it = blocks[cpuMode].find(address);
+  // A sequence can be translated again with another end after a flush of the
+  // cache, a new block is defined in this case.
+  if (it != blocks[cpuMode].end() and it->second.end == end) {
+    return it->second.id;
+  }
+
+  uint32_t id = nextBlockID++;
+  uint32_t module = getModule(address);
+  blocks[cpuMode][address] = Block{end, id};
+
+  dictionary.push_back(TRACE_RECORD_BLOCK);
+  appendVarint(dictionary, id);
+  appendVarint(dictionary, module);
+  appendVarint(dictionary, address);
+  appendVarint(dictionary, end - address);
+  appendVarint(dictionary, cpuMode);
+  // keep the code of the block to disassemble the trace offline
+  const uint8_t *code = reinterpret_cast<const uint8_t *>(address);
+  dictionary.insert(dictionary.end(), code, code + (end - address));
+
+  return id;
+}
+
+void TraceRecorder::recordSequence(rword address, rword end,
+                                   CPUMode cpuMode) {
+  if ((flags & TRACE_SEQUENCE) == 0) {
+    return;
+  }
+  uint32_t id = getBlock(address, end, cpuMode);
+
+  data.push_back(TRACE_RECORD_SEQUENCE);
+  appendDelta(data, id, lastBlockID);
+  lastBlockID = id;
+
+  if (data.size() >= SEGMENT_SIZE) {
+    flush();
+  }
+}
+
+void TraceRecorder::recordMemoryAccess(const ExecBlock &execBlock,
+                                       bool preInst) {
+  if ((flags & TRACE_MEMORY) == 0) {
+    return;
+  }
+  uint16_t seqID = execBlock.getCurrentSeqID();
+  uint16_t instID = execBlock.getCurrentInstID();
+
+  memAccesses.clear();
+  for (uint16_t id = execBlock.getSeqStart(seqID); id <= instID; id++) {
+    analyseMemoryAccess(execBlock, id, id != instID or not preInst,
+                        memAccesses);
+  }
+
+  for (const MemoryAccess &access : memAccesses) {
+    if (access.type == MEMORY_READ) {
+      data.push_back(TRACE_RECORD_MEMORY_READ);
+    } else {
+      data.push_back(TRACE_RECORD_MEMORY_WRITE);
+    }
+    appendDelta(data, access.accessAddress, lastAddress);
+    if ((access.flags & MEMORY_UNKNOWN_SIZE) != 0) {
+      appendVarint(data, 0);
+    } else {
+      appendVarint(data, access.size);
+    }
+    lastAddress = access.accessAddress;
+  }
+
+  if (data.size() >= SEGMENT_SIZE) {
+    flush();
+  }
+}
+
+} // namespace QBDI
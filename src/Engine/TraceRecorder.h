@@ -0,0 +1,134 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/Support/FileSystem.h"
+
+#include "QBDI/Callback.h"
+#include "QBDI/Range.h"
+#include "QBDI/State.h"
+#include "QBDI/Trace.h"
+
+namespace QBDI {
+
+class ExecBlock;
+
+/*! Writer of the binary trace of a VM (see QBDI/Trace.h for the format).
+ *
+ * The Engine feeds the recorder directly at each sequence entry, without
+ * going through a VMCallback. The records are encoded in a memory buffer and
+ * copied, one segment at a time, into a window of the file mapped in memory.
+ * The write back of the pages is left to the operating system.
+ *
+ * A recorder belongs to a single VM and isn't thread safe: each thread must
+ * use its own VM and its own trace file.
+ */
+class TraceRecorder {
+public:
+  static constexpr size_t SEGMENT_SIZE = 1 << 20;
+  static constexpr size_t MAPPING_SIZE = 1 << 22;
+
+private:
+  struct Module {
+    Range<rword> range;
+    uint32_t id;
+  };
+
+  struct Block {
+    rword end;
+    uint32_t id;
+  };
+
+  TraceFlags flags;
+  int fd;
+  std::unique_ptr<llvm::sys::fs::mapped_file_region> mapping;
+  uint64_t mappingOffset;
+  uint64_t fileOffset;
+  uint32_t segmentNumber;
+
+  std::vector<uint8_t> dictionary;
+  std::vector<uint8_t> data;
+
+  std::vector<Module> modules;
+  std::unordered_map<rword, Block> blocks[CPUMode::COUNT];
+  uint32_t nextBlockID;
+
+  // delta state of the current data segment
+  uint32_t lastBlockID;
+  rword lastAddress;
+
+  std::vector<MemoryAccess> memAccesses;
+
+  TraceRecorder(int fd, TraceFlags flags);
+
+  bool writeFile(const void *buffer, size_t size);
+  void writeSegment(TraceSegmentKind kind, std::vector<uint8_t> &buffer);
+
+  uint32_t getModule(rword address);
+  uint32_t getBlock(rword address, rword end, CPUMode cpuMode);
+
+public:
+  /*! Create a trace file
+   *
+   * @param[in] path   The path of the file, truncated if it already exists
+   * @param[in] flags  The content of the trace
+   *
+   * @return The recorder, or nullptr if the file cannot be created
+   */
+  static std::unique_ptr<TraceRecorder> create(const std::string &path,
+                                               TraceFlags flags);
+
+  ~TraceRecorder();
+
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  inline TraceFlags getFlags() const { return flags; }
+
+  /*! Record the entry in a sequence
+   *
+   * @param[in] address  The address of the first instruction of the sequence
+   * @param[in] end      The end address of the sequence (excluded)
+   * @param[in] cpuMode  The CPUMode of the sequence
+   */
+  void recordSequence(rword address, rword end, CPUMode cpuMode);
+
+  /*! Record the memory accesses of the last executed sequence
+   *
+   * @param[in] execBlock  The ExecBlock of the sequence
+   * @param[in] preInst    The last instruction of the sequence has not been
+   *                       executed
+   */
+  void recordMemoryAccess(const ExecBlock &execBlock, bool preInst);
+
+  /*! Write the pending records in the file
+   */
+  void flush();
+};
+
+} // namespace QBDI
+
+#endif // TRACERECORDER_H
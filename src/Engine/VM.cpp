@@ -32,9 +32,11 @@
 #include "QBDI/Options.h"
 #include "QBDI/Range.h"
 #include "QBDI/State.h"
+#include "QBDI/Trace.h"
 #include "QBDI/VM.h"
 
 #include "Engine/Engine.h"
+#include "Engine/TraceRecorder.h"
 #include "Engine/VM_internal.h"
 #include "ExecBlock/ExecBlock.h"
 #include "Patch/InstrRule.h"
@@ -44,6 +46,7 @@
 #include "Patch/PatchGenerator.h"
 #include "Patch/PatchUtils.h"
 #include "Utility/LogSys.h"
+#include "Utility/StackPool.h"
 #include "Utility/StackSwitch.h"
 
 // Mask to identify Virtual Callback events
@@ -68,7 +71,8 @@ VMAction memReadGate(VMInstanceRef vm, GPRState *gprState, FPRState *fprState,
   VMAction action = VMAction::CONTINUE;
   for (const auto &p : memCBInfos) {
     // Check access type and range
-    if (p.second.type == MEMORY_READ and readRange.overlaps(p.second.range)) {
+    if (p.second.enabled and p.second.type == MEMORY_READ and
+        readRange.overlaps(p.second.range)) {
       // Forward to virtual callback
       VMAction ret = p.second.cbk(vm, gprState, fprState, p.second.data);
       // Always keep the most extreme action as the return
@@ -104,10 +108,11 @@ VMAction memWriteGate(VMInstanceRef vm, GPRState *gprState, FPRState *fprState,
     // 1. has MEMORY_WRITE and write range overlaps
     // 2. is MEMORY_READ_WRITE and read range overlaps
     // note: the case with MEMORY_READ only is managed by memReadGate
-    if (((p.second.type & MEMORY_WRITE) and
-         writeRange.overlaps(p.second.range)) or
-        (p.second.type == MEMORY_READ_WRITE and
-         readRange.overlaps(p.second.range))) {
+    if (p.second.enabled and
+        (((p.second.type & MEMORY_WRITE) and
+          writeRange.overlaps(p.second.range)) or
+         (p.second.type == MEMORY_READ_WRITE and
+          readRange.overlaps(p.second.range)))) {
       // Forward to virtual callback
       VMAction ret = p.second.cbk(vm, gprState, fprState, p.second.data);
       // Always keep the most extreme action as the return
@@ -119,6 +124,23 @@ VMAction memWriteGate(VMInstanceRef vm, GPRState *gprState, FPRState *fprState,
   return action;
 }
 
+// Warn when a callback registered with CB_FLAG_INLINE_CALL will be called by
+// the VM after a break to the host.
+static void checkCallbackFlags(CallbackFlags flags, Options opts) {
+  if ((flags & CB_FLAG_INLINE_CALL) == 0) {
+    return;
+  }
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  if ((opts & Options::OPT_ENABLE_INLINE_CALL) == 0) {
+    QBDI_WARN("CB_FLAG_INLINE_CALL without OPT_ENABLE_INLINE_CALL, the "
+              "callback is called after a break to the host");
+  }
+#else
+  QBDI_WARN("CB_FLAG_INLINE_CALL isn't supported on this architecture, the "
+            "callback is called after a break to the host");
+#endif
+}
+
 std::vector<InstrRuleDataCBK>
 InstrCBGateC(VMInstanceRef vm, const InstAnalysis *inst, void *_data) {
   InstrCBInfo *data = static_cast<InstrCBInfo *>(_data);
@@ -177,6 +199,8 @@ VM::VM(VM &&vm)
       memCBInfos(std::move(vm.memCBInfos)), memCBID(vm.memCBID),
       memReadGateCBID(vm.memReadGateCBID),
       memWriteGateCBID(vm.memWriteGateCBID),
+      traceMemReadRuleIDs(std::move(vm.traceMemReadRuleIDs)),
+      traceMemWriteRuleIDs(std::move(vm.traceMemWriteRuleIDs)),
       instrCBInfos(std::move(vm.instrCBInfos)),
       vmCBData(std::move(vm.vmCBData)), instCBData(std::move(vm.instCBData)),
       instrRuleCBData(std::move(vm.instrRuleCBData)) {
@@ -193,6 +217,8 @@ VM &VM::operator=(VM &&vm) {
   memCBID = vm.memCBID;
   memReadGateCBID = vm.memReadGateCBID;
   memWriteGateCBID = vm.memWriteGateCBID;
+  traceMemReadRuleIDs = std::move(vm.traceMemReadRuleIDs);
+  traceMemWriteRuleIDs = std::move(vm.traceMemWriteRuleIDs);
   instrCBInfos = std::move(vm.instrCBInfos);
   vmCBData = std::move(vm.vmCBData);
   instCBData = std::move(vm.instCBData);
@@ -211,7 +237,9 @@ VM::VM(const VM &vm)
       memCBInfos(std::make_unique<std::vector<std::pair<uint32_t, MemCBInfo>>>(
           *vm.memCBInfos)),
       memCBID(vm.memCBID), memReadGateCBID(vm.memReadGateCBID),
-      memWriteGateCBID(vm.memWriteGateCBID), vmCBData(vm.vmCBData),
+      memWriteGateCBID(vm.memWriteGateCBID),
+      traceMemReadRuleIDs(vm.traceMemReadRuleIDs),
+      traceMemWriteRuleIDs(vm.traceMemWriteRuleIDs), vmCBData(vm.vmCBData),
       instCBData(vm.instCBData), instrRuleCBData(vm.instrRuleCBData) {
 
   engine->changeVMInstanceRef(this);
@@ -276,6 +304,8 @@ VM &VM::operator=(const VM &vm) {
   memCBID = vm.memCBID;
   memReadGateCBID = vm.memReadGateCBID;
   memWriteGateCBID = vm.memWriteGateCBID;
+  traceMemReadRuleIDs = vm.traceMemReadRuleIDs;
+  traceMemWriteRuleIDs = vm.traceMemWriteRuleIDs;
 
   instrCBInfos = std::make_unique<
       std::vector<std::pair<uint32_t, std::unique_ptr<InstrCBInfo>>>>();
@@ -480,7 +510,10 @@ bool VM::switchStackAndCallA(rword *retval, rword function, uint32_t argNum,
 
   QBDI_REQUIRE_ACTION(stackSize > 0x10000, return false);
 
-  uint8_t *fakestack = static_cast<uint8_t *>(alignedAlloc(stackSize, 16));
+  // The stacks are reused between the calls: the pages of a stack are
+  // already mapped and faulted in for the next call.
+  StackPool &stackPool = engine->getStackPool();
+  uint8_t *fakestack = stackPool.acquire(stackSize);
   if (fakestack == nullptr) {
     return false;
   }
@@ -495,7 +528,7 @@ bool VM::switchStackAndCallA(rword *retval, rword function, uint32_t argNum,
         return this->callA(retval, function, argNum, args);
       });
 
-  QBDI::alignedFree(fakestack);
+  stackPool.release(fakestack);
   return res;
 }
 
@@ -653,10 +686,17 @@ uint32_t VM::addMnemonicCB(const char *mnemonic, InstPosition pos,
 
 uint32_t VM::addCodeCB(InstPosition pos, InstCallback cbk, void *data,
                        int priority) {
+  return addCodeCB(pos, cbk, data, priority, CB_FLAG_NONE);
+}
+
+uint32_t VM::addCodeCB(InstPosition pos, InstCallback cbk, void *data,
+                       int priority, CallbackFlags flags) {
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
+  checkCallbackFlags(flags, getOptions());
   return engine->addInstrRule(InstrRuleBasicCBK::unique(
       True::unique(), cbk, data, pos, true, priority,
-      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK,
+      flags));
 }
 
 uint32_t VM::addCodeCB(InstPosition pos, const InstCbLambda &cbk,
@@ -674,14 +714,37 @@ uint32_t VM::addCodeCB(InstPosition pos, InstCbLambda &&cbk, int priority) {
   return id;
 }
 
+uint32_t VM::addCodeCB(InstPosition pos, const InstCbLambda &cbk, int priority,
+                       CallbackFlags flags) {
+  auto &el = instCBData.emplace_front(0xffffffff, cbk);
+  uint32_t id = addCodeCB(pos, InstCBLambdaProxy, &el.second, priority, flags);
+  el.first = id;
+  return id;
+}
+
+uint32_t VM::addCodeCB(InstPosition pos, InstCbLambda &&cbk, int priority,
+                       CallbackFlags flags) {
+  auto &el = instCBData.emplace_front(0xffffffff, std::move(cbk));
+  uint32_t id = addCodeCB(pos, InstCBLambdaProxy, &el.second, priority, flags);
+  el.first = id;
+  return id;
+}
+
 // addCodeAddrCB
 
 uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCallback cbk,
                            void *data, int priority) {
+  return addCodeAddrCB(address, pos, cbk, data, priority, CB_FLAG_NONE);
+}
+
+uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCallback cbk,
+                           void *data, int priority, CallbackFlags flags) {
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
+  checkCallbackFlags(flags, getOptions());
   return engine->addInstrRule(InstrRuleBasicCBK::unique(
       AddressIs::unique(address), cbk, data, pos, true, priority,
-      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK,
+      flags));
 }
 
 uint32_t VM::addCodeAddrCB(rword address, InstPosition pos,
@@ -702,15 +765,42 @@ uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCbLambda &&cbk,
   return id;
 }
 
+uint32_t VM::addCodeAddrCB(rword address, InstPosition pos,
+                           const InstCbLambda &cbk, int priority,
+                           CallbackFlags flags) {
+  auto &el = instCBData.emplace_front(0xffffffff, cbk);
+  uint32_t id = addCodeAddrCB(address, pos, InstCBLambdaProxy, &el.second,
+                              priority, flags);
+  el.first = id;
+  return id;
+}
+
+uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCbLambda &&cbk,
+                           int priority, CallbackFlags flags) {
+  auto &el = instCBData.emplace_front(0xffffffff, std::move(cbk));
+  uint32_t id = addCodeAddrCB(address, pos, InstCBLambdaProxy, &el.second,
+                              priority, flags);
+  el.first = id;
+  return id;
+}
+
 // addCodeRangeCB
 
 uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
                             InstCallback cbk, void *data, int priority) {
+  return addCodeRangeCB(start, end, pos, cbk, data, priority, CB_FLAG_NONE);
+}
+
+uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
+                            InstCallback cbk, void *data, int priority,
+                            CallbackFlags flags) {
   QBDI_REQUIRE_ACTION(start < end, return VMError::INVALID_EVENTID);
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
+  checkCallbackFlags(flags, getOptions());
   return engine->addInstrRule(InstrRuleBasicCBK::unique(
       InstructionInRange::unique(start, end), cbk, data, pos, true, priority,
-      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK,
+      flags));
 }
 
 uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
@@ -731,6 +821,26 @@ uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
   return id;
 }
 
+uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
+                            const InstCbLambda &cbk, int priority,
+                            CallbackFlags flags) {
+  auto &el = instCBData.emplace_front(0xffffffff, cbk);
+  uint32_t id = addCodeRangeCB(start, end, pos, InstCBLambdaProxy, &el.second,
+                               priority, flags);
+  el.first = id;
+  return id;
+}
+
+uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
+                            InstCbLambda &&cbk, int priority,
+                            CallbackFlags flags) {
+  auto &el = instCBData.emplace_front(0xffffffff, std::move(cbk));
+  uint32_t id = addCodeRangeCB(start, end, pos, InstCBLambdaProxy, &el.second,
+                               priority, flags);
+  el.first = id;
+  return id;
+}
+
 // addMemAccessCB
 
 uint32_t VM::addMemAccessCB(MemoryAccessType type, InstCallback cbk, void *data,
@@ -817,7 +927,7 @@ uint32_t VM::addMemRangeCB(rword start, rword end, MemoryAccessType type,
   QBDI_REQUIRE_ACTION(id < EVENTID_VIRTCB_MASK,
                       return VMError::INVALID_EVENTID);
   memCBInfos->emplace_back(id | EVENTID_VIRTCB_MASK,
-                           MemCBInfo{type, {start, end}, cbk, data});
+                           MemCBInfo{type, {start, end}, cbk, data, true});
   return id | EVENTID_VIRTCB_MASK;
 }
 
@@ -898,6 +1008,24 @@ bool VM::deleteInstrumentation(uint32_t id) {
   }
 }
 
+// setInstrumentationEnabled
+
+bool VM::setInstrumentationEnabled(uint32_t id, bool enabled) {
+  if (id & EVENTID_VIRTCB_MASK) {
+    auto it = std::find_if(memCBInfos->begin(), memCBInfos->end(),
+                           [id](const std::pair<uint32_t, MemCBInfo> &el) {
+                             return id == el.first;
+                           });
+    if (it == memCBInfos->end()) {
+      return false;
+    }
+    it->second.enabled = enabled;
+    return true;
+  } else {
+    return engine->setInstrumentationEnabled(id, enabled);
+  }
+}
+
 // deleteAllInstrumentations
 
 void VM::deleteAllInstrumentations() {
@@ -909,6 +1037,8 @@ void VM::deleteAllInstrumentations() {
   vmCBData.clear();
   instCBData.clear();
   instrRuleCBData.clear();
+  traceMemReadRuleIDs.clear();
+  traceMemWriteRuleIDs.clear();
   memoryLoggingLevel = 0;
 }
 
@@ -931,6 +1061,13 @@ const InstAnalysis *VM::getCachedInstAnalysis(rword address,
 // recordMemoryAccess
 
 bool VM::recordMemoryAccess(MemoryAccessType type) {
+  // The recording requested here is kept by stopTraceRecording
+  if (type & MEMORY_READ) {
+    traceMemReadRuleIDs.clear();
+  }
+  if (type & MEMORY_WRITE) {
+    traceMemWriteRuleIDs.clear();
+  }
   if (type & MEMORY_READ && !(memoryLoggingLevel & MEMORY_READ)) {
     memoryLoggingLevel |= MEMORY_READ;
     for (auto &r : getInstrRuleMemAccessRead()) {
@@ -946,6 +1083,61 @@ bool VM::recordMemoryAccess(MemoryAccessType type) {
   return true;
 }
 
+// startTraceRecording
+
+bool VM::startTraceRecording(const char *path, TraceFlags flags) {
+  QBDI_REQUIRE_ACTION(path != nullptr, return false);
+  QBDI_REQUIRE_ACTION((flags & (TRACE_SEQUENCE | TRACE_MEMORY)) != 0,
+                      return false);
+  stopTraceRecording();
+
+  std::unique_ptr<TraceRecorder> recorder =
+      TraceRecorder::create(path, flags);
+  if (recorder == nullptr) {
+    return false;
+  }
+  if (flags & TRACE_MEMORY) {
+    // Keep the rules added for the trace, they are removed by
+    // stopTraceRecording
+    if (!(memoryLoggingLevel & MEMORY_READ)) {
+      memoryLoggingLevel |= MEMORY_READ;
+      for (auto &r : getInstrRuleMemAccessRead()) {
+        traceMemReadRuleIDs.push_back(engine->addInstrRule(std::move(r)));
+      }
+    }
+    if (!(memoryLoggingLevel & MEMORY_WRITE)) {
+      memoryLoggingLevel |= MEMORY_WRITE;
+      for (auto &r : getInstrRuleMemAccessWrite()) {
+        traceMemWriteRuleIDs.push_back(engine->addInstrRule(std::move(r)));
+      }
+    }
+  }
+  engine->setTraceRecorder(std::move(recorder));
+  return true;
+}
+
+// stopTraceRecording
+
+void VM::stopTraceRecording() {
+  engine->setTraceRecorder(nullptr);
+
+  // Restore the recording of the memory accesses of before the trace
+  if (not traceMemReadRuleIDs.empty()) {
+    for (uint32_t id : traceMemReadRuleIDs) {
+      engine->deleteInstrumentation(id);
+    }
+    traceMemReadRuleIDs.clear();
+    memoryLoggingLevel &= ~MEMORY_READ;
+  }
+  if (not traceMemWriteRuleIDs.empty()) {
+    for (uint32_t id : traceMemWriteRuleIDs) {
+      engine->deleteInstrumentation(id);
+    }
+    traceMemWriteRuleIDs.clear();
+    memoryLoggingLevel &= ~MEMORY_WRITE;
+  }
+}
+
 // getInstMemoryAccess
 
 std::vector<MemoryAccess> VM::getInstMemoryAccess() const {
@@ -199,6 +199,14 @@ uint32_t qbdi_addCodeCB(VMInstanceRef instance, InstPosition pos,
   return static_cast<VM *>(instance)->addCodeCB(pos, cbk, data, priority);
 }
 
+uint32_t qbdi_addCodeCBWithFlags(VMInstanceRef instance, InstPosition pos,
+                                 InstCallback cbk, void *data, int priority,
+                                 CallbackFlags flags) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeCB(pos, cbk, data, priority,
+                                                flags);
+}
+
 uint32_t qbdi_addCodeAddrCB(VMInstanceRef instance, rword address,
                             InstPosition pos, InstCallback cbk, void *data,
                             int priority) {
@@ -207,6 +215,15 @@ uint32_t qbdi_addCodeAddrCB(VMInstanceRef instance, rword address,
                                                     priority);
 }
 
+uint32_t qbdi_addCodeAddrCBWithFlags(VMInstanceRef instance, rword address,
+                                     InstPosition pos, InstCallback cbk,
+                                     void *data, int priority,
+                                     CallbackFlags flags) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeAddrCB(address, pos, cbk, data,
+                                                    priority, flags);
+}
+
 uint32_t qbdi_addCodeRangeCB(VMInstanceRef instance, rword start, rword end,
                              InstPosition pos, InstCallback cbk, void *data,
                              int priority) {
@@ -215,6 +232,15 @@ uint32_t qbdi_addCodeRangeCB(VMInstanceRef instance, rword start, rword end,
                                                      priority);
 }
 
+uint32_t qbdi_addCodeRangeCBWithFlags(VMInstanceRef instance, rword start,
+                                      rword end, InstPosition pos,
+                                      InstCallback cbk, void *data,
+                                      int priority, CallbackFlags flags) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeRangeCB(start, end, pos, cbk, data,
+                                                     priority, flags);
+}
+
 uint32_t qbdi_addMemAccessCB(VMInstanceRef instance, MemoryAccessType type,
                              InstCallback cbk, void *data, int priority) {
   QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
@@ -247,6 +273,12 @@ bool qbdi_deleteInstrumentation(VMInstanceRef instance, uint32_t id) {
   return static_cast<VM *>(instance)->deleteInstrumentation(id);
 }
 
+bool qbdi_setInstrumentationEnabled(VMInstanceRef instance, uint32_t id,
+                                    bool enabled) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setInstrumentationEnabled(id, enabled);
+}
+
 void qbdi_deleteAllInstrumentations(VMInstanceRef instance) {
   QBDI_REQUIRE_ACTION(instance, return );
   static_cast<VM *>(instance)->deleteAllInstrumentations();
@@ -311,6 +343,17 @@ MemoryAccess *qbdi_getBBMemoryAccess(VMInstanceRef instance, size_t *size) {
   return ma_arr;
 }
 
+bool qbdi_startTraceRecording(VMInstanceRef instance, const char *path,
+                              TraceFlags flags) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->startTraceRecording(path, flags);
+}
+
+void qbdi_stopTraceRecording(VMInstanceRef instance) {
+  QBDI_REQUIRE_ACTION(instance, return );
+  static_cast<VM *>(instance)->stopTraceRecording();
+}
+
 bool qbdi_precacheBasicBlock(VMInstanceRef instance, rword pc) {
   QBDI_REQUIRE_ACTION(instance, return false);
   return static_cast<VM *>(instance)->precacheBasicBlock(pc);
@@ -27,6 +27,7 @@ struct MemCBInfo {
   Range<rword> range;
   InstCallback cbk;
   void *data;
+  bool enabled;
 };
 
 struct InstrCBInfo {
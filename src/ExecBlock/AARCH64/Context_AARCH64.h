@@ -38,8 +38,6 @@ struct QBDI_ALIGNED(8) HostState {
     rword callback;
     rword brokerAddr;
   };
-  rword data;
-  rword origin;
   rword tpidr;
   // unused
   rword executeFlags;
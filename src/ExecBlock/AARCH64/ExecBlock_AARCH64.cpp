@@ -28,6 +28,7 @@
 #include "ExecBlock/AARCH64/Context_AARCH64.h"
 #include "ExecBlock/ExecBlock.h"
 #include "Patch/AARCH64/ExecBlockPatch_AARCH64.h"
+#include "Patch/AARCH64/Layer2_AARCH64.h"
 #include "Patch/Patch.h"
 #include "Patch/RelocatableInst.h"
 #include "Utility/LogSys.h"
@@ -43,6 +44,13 @@ namespace QBDI {
 
 static const uint32_t MINIMAL_BLOCK_SIZE = 0xc;
 
+// Is the guest value of the register dead during the patch. Only computed
+// when OPT_ENABLE_REGISTER_LIVENESS is set.
+static inline bool isDeadSR(const Patch &p, RegLLVM reg) {
+  size_t pos = getGPRPosition(reg);
+  return pos != ((size_t)-1) and (p.deadGPR & (((rword)1) << pos)) != 0;
+}
+
 void ExecBlock::selectSeq(uint16_t seqID) {
   QBDI_REQUIRE(seqID < seqRegistry.size());
   currentSeq = seqID;
@@ -105,7 +113,9 @@ bool ExecBlock::writePatch(std::vector<Patch>::const_iterator seqCurrent,
     initScratchRegisterForPatch(seqCurrent, seqEnd);
     if (not applyRelocatedInst(
             changeScratchRegister(llvmcpu, backupSR.writeScratchRegister,
-                                  srInfo.writeScratchRegister),
+                                  srInfo.writeScratchRegister,
+                                  isDeadSR(p, backupSR.writeScratchRegister),
+                                  isDeadSR(p, srInfo.writeScratchRegister)),
             &tagRegistry, llvmcpu, MINIMAL_BLOCK_SIZE)) {
       QBDI_DEBUG("Not enough space left: rollback");
       srInfo = backupSR;
@@ -180,9 +190,18 @@ void ExecBlock::initScratchRegisterForPatch(
   }
 
   // get a free register
+  // Prefer a register whose guest value is dead at the beginning of the
+  // sequence: the change of ScratchRegister doesn't need to backup it.
   // In order to improve the debug, we select the higher free register
-  srInfo.writeScratchRegister =
-      *std::max_element(freeRegister.begin(), freeRegister.end());
+  auto deadIt = std::find_if(
+      freeRegister.rbegin(), freeRegister.rend(),
+      [&](RegLLVM r) { return isDeadSR(*seqStart, r); });
+  if (deadIt != freeRegister.rend()) {
+    srInfo.writeScratchRegister = *deadIt;
+  } else {
+    srInfo.writeScratchRegister =
+        *std::max_element(freeRegister.begin(), freeRegister.end());
+  }
 
   QBDI_DEBUG_BLOCK({
     const LLVMCPU &llvmcpu = llvmCPUs.getCPU(seqStart->metadata.cpuMode);
@@ -196,4 +215,9 @@ void ExecBlock::finalizeScratchRegisterForPatch() {
       getGPRPosition(srInfo.writeScratchRegister);
 }
 
+llvm::MCInst ExecBlock::getJump(uint16_t offset, uint16_t target,
+                                CPUMode cpuMode) const {
+  return branch(static_cast<rword>(target) - static_cast<rword>(offset));
+}
+
 } // namespace QBDI
@@ -28,8 +28,6 @@ struct QBDI_ALIGNED(4) HostState {
   rword sp;
   rword selector;
   rword callback;
-  rword data;
-  rword origin;
   rword exchange;
   rword executeFlags;
   // for thumb only
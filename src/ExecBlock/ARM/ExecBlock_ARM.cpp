@@ -16,6 +16,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <sstream>
 
 #include "QBDI/State.h"
@@ -23,6 +24,7 @@
 #include "ExecBlock/ARM/Context_ARM.h"
 #include "ExecBlock/ExecBlock.h"
 #include "Patch/ARM/ExecBlockPatch_ARM.h"
+#include "Patch/ARM/Layer2_ARM.h"
 #include "Patch/Patch.h"
 #include "Patch/RelocatableInst.h"
 #include "Utility/LogSys.h"
@@ -35,6 +37,13 @@ namespace QBDI {
 
 static const uint32_t MINIMAL_BLOCK_SIZE = 0x18;
 
+// Is the guest value of the register dead during the patch. Only computed
+// when OPT_ENABLE_REGISTER_LIVENESS is set.
+static inline bool isDeadSR(const Patch &p, RegLLVM reg) {
+  size_t pos = getGPRPosition(reg);
+  return pos != ((size_t)-1) and (p.deadGPR & (((rword)1) << pos)) != 0;
+}
+
 void ExecBlock::selectSeq(uint16_t seqID) {
   QBDI_REQUIRE(seqID < seqRegistry.size());
   currentSeq = seqID;
@@ -128,7 +137,9 @@ bool ExecBlock::writePatch(std::vector<Patch>::const_iterator seqCurrent,
     initScratchRegisterForPatch(seqCurrent, seqEnd);
     if (not applyRelocatedInst(
             changeScratchRegister(llvmcpu, backupSR.thumbScratchRegister,
-                                  srInfo.thumbScratchRegister),
+                                  srInfo.thumbScratchRegister,
+                                  isDeadSR(p, backupSR.thumbScratchRegister),
+                                  isDeadSR(p, srInfo.thumbScratchRegister)),
             &tagRegistry, llvmcpu, MINIMAL_BLOCK_SIZE)) {
       QBDI_DEBUG("Not enough space left: rollback");
       srInfo = backupSR;
@@ -207,9 +218,18 @@ void ExecBlock::initScratchRegisterForPatch(
   }
 
   // get a free register
+  // Prefer a register whose guest value is dead at the beginning of the
+  // sequence: the change of ScratchRegister doesn't need to backup it.
   // In order to improve the debug, we select the higher free register
-  srInfo.thumbScratchRegister =
-      *std::max_element(freeRegister.begin(), freeRegister.end());
+  auto deadIt = std::find_if(
+      freeRegister.rbegin(), freeRegister.rend(),
+      [&](RegLLVM r) { return isDeadSR(*seqStart, r); });
+  if (deadIt != freeRegister.rend()) {
+    srInfo.thumbScratchRegister = *deadIt;
+  } else {
+    srInfo.thumbScratchRegister =
+        *std::max_element(freeRegister.begin(), freeRegister.end());
+  }
 
   QBDI_DEBUG_BLOCK({
     const LLVMCPU &llvmcpu = llvmCPUs.getCPU(seqStart->metadata.cpuMode);
@@ -223,4 +243,15 @@ void ExecBlock::finalizeScratchRegisterForPatch() {
       getGPRPosition(srInfo.thumbScratchRegister);
 }
 
+llvm::MCInst ExecBlock::getJump(uint16_t offset, uint16_t target,
+                                CPUMode cpuMode) const {
+  // PC is 8 bytes ahead of the instruction in ARM and 4 bytes in Thumb
+  sword delta = static_cast<sword>(target) - static_cast<sword>(offset);
+  if (cpuMode == CPUMode::Thumb) {
+    return t2branch(delta - 4);
+  } else {
+    return branch(delta - 8);
+  }
+}
+
 } // namespace QBDI
@@ -52,7 +52,7 @@ ExecBlock::ExecBlock(
     const std::vector<std::unique_ptr<RelocatableInst>> *execBlockEpilogue,
     uint32_t epilogueSize_)
     : vminstance(vminstance), llvmCPUs(llvmCPUs), epilogueSize(epilogueSize_),
-      isFull(false) {
+      inlineCallOffset(0), callbackSiteOffset(0), isFull(false) {
 
   // Allocate memory blocks
   std::error_code ec;
@@ -118,6 +118,13 @@ ExecBlock::ExecBlock(
   QBDI_REQUIRE_ABORT(codeBlockPosition == codeBlock.allocatedSize(),
                      "Wrong Epilogue Size");
 
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  // parameters of the inline call stub
+  context->hostState.execBlock = reinterpret_cast<rword>(this);
+  context->hostState.inlineCallHandler =
+      reinterpret_cast<rword>(&ExecBlock::inlineCallHandler);
+#endif
+
   codeBlockPosition = 0;
   // forbid overwrite of the epilogue
   codeBlockMaxSize = codeBlock.allocatedSize() - epilogueSize;
@@ -190,30 +197,62 @@ VMAction ExecBlock::execute() {
 
   do {
     context->hostState.callback = static_cast<rword>(0);
-    context->hostState.data = static_cast<rword>(0);
 
     QBDI_DEBUG("Execution of ExecBlock 0x{:x} resumed at 0x{:x}",
                reinterpret_cast<uintptr_t>(this), context->hostState.selector);
     run();
 
     if (context->hostState.callback != 0) {
-      currentInst = context->hostState.origin;
+      uint16_t id = static_cast<uint16_t>(context->hostState.callback);
+      QBDI_REQUIRE(0 < id and id <= callbackRegistry.size());
+      // copy the CallbackInfo, the registry may grow during the callback
+      const CallbackInfo cbkInfo = callbackRegistry[id - 1];
+      currentInst = cbkInfo.instID;
       rword currentPC = QBDI_GPR_GET(&context->gprState, REG_PC);
 
-      QBDI_DEBUG("Callback request by ExecBlock 0x{:x} for callback 0x{:x}",
-                 reinterpret_cast<uintptr_t>(this),
-                 context->hostState.callback);
+      QBDI_DEBUG("Callback request by ExecBlock 0x{:x} for {} callback(s)",
+                 reinterpret_cast<uintptr_t>(this), cbkInfo.cbkSize);
       QBDI_REQUIRE(currentInst < instMetadata.size());
+      QBDI_REQUIRE(cbkInfo.cbkOffset + cbkInfo.cbkSize <=
+                   callbackDataRegistry.size());
+
+      if (cbkInfo.oneShot) {
+        fireOneShotSite(id);
+      }
+
+      // resume the execution after the callback
+      context->hostState.selector = reinterpret_cast<rword>(codeBlock.base()) +
+                                    static_cast<rword>(cbkInfo.resumeOffset);
+#if defined(QBDI_ARCH_ARM)
+      if (instMetadata[currentInst].cpuMode == CPUMode::Thumb) {
+        context->hostState.selector |= 1;
+      }
+#endif
 
-      VMAction r =
-          (reinterpret_cast<InstCallback>(context->hostState.callback))(
-              vminstance, &context->gprState, &context->fprState,
-              (void *)context->hostState.data);
+      // call the callbacks in order, until one doesn't return CONTINUE
+      VMAction r = CONTINUE;
+      InstCallback callback = nullptr;
+      for (uint16_t i = 0; i < cbkInfo.cbkSize and r == CONTINUE; i++) {
+        if (i != 0 and QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
+          QBDI_WARN(
+              "Callback returned CONTINUE but change PC: Ignore new value");
+          QBDI_GPR_SET(&context->gprState, REG_PC, currentPC);
+        }
+        // copy the CallbackData, the registry may grow during the callback
+        const CallbackData cbkData =
+            callbackDataRegistry[cbkInfo.cbkOffset + i];
+        if (not cbkData.enabled) {
+          continue;
+        }
+        callback = cbkData.cbk;
+        r = callback(vminstance, &context->gprState, &context->fprState,
+                     cbkData.data);
+      }
 
       switch (r) {
         case CONTINUE:
           QBDI_DEBUG("Callback 0x{:x} returned CONTINUE",
-                     context->hostState.callback);
+                     reinterpret_cast<rword>(callback));
           if (QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
             QBDI_WARN(
                 "Callback returned CONTINUE but change PC: Ignore new value");
@@ -221,7 +260,7 @@ VMAction ExecBlock::execute() {
           break;
         case SKIP_INST:
           QBDI_DEBUG("Callback 0x{:x} returned SKIP_INST",
-                     context->hostState.callback);
+                     reinterpret_cast<rword>(callback));
           if (not instMetadata[currentInst].modifyPC and
               QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
             QBDI_WARN(
@@ -238,7 +277,7 @@ VMAction ExecBlock::execute() {
           break;
         case SKIP_PATCH:
           QBDI_DEBUG("Callback 0x{:x} returned SKIP_PATCH",
-                     context->hostState.callback);
+                     reinterpret_cast<rword>(callback));
           if (not instMetadata[currentInst].modifyPC and
               QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
             QBDI_WARN(
@@ -269,11 +308,11 @@ VMAction ExecBlock::execute() {
           break;
         case BREAK_TO_VM:
           QBDI_DEBUG("Callback 0x{:x} returned BREAK_TO_VM",
-                     context->hostState.callback);
+                     reinterpret_cast<rword>(callback));
           return BREAK_TO_VM;
         case STOP:
           QBDI_DEBUG("Callback 0x{:x} returned STOP",
-                     context->hostState.callback);
+                     reinterpret_cast<rword>(callback));
           return STOP;
       }
     }
@@ -283,6 +322,154 @@ VMAction ExecBlock::execute() {
   return CONTINUE;
 }
 
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+void ExecBlock::inlineCallHandler(ExecBlock *execBlock) {
+  execBlock->executeInlineCallback();
+}
+
+void ExecBlock::executeInlineCallback() {
+  uint16_t id = static_cast<uint16_t>(context->hostState.callback);
+  QBDI_REQUIRE_ABORT(0 < id and id <= callbackRegistry.size(),
+                     "Invalid inline callback id {}", id);
+  const CallbackInfo cbkInfo = callbackRegistry[id - 1];
+  currentInst = cbkInfo.instID;
+  rword currentPC = QBDI_GPR_GET(&context->gprState, REG_PC);
+
+  QBDI_DEBUG("Inline callback request by ExecBlock 0x{:x} for {} callback(s)",
+             reinterpret_cast<uintptr_t>(this), cbkInfo.cbkSize);
+
+  if (cbkInfo.oneShot) {
+    fireOneShotSite(id);
+  }
+
+  // resume the execution after the callbacks
+  context->hostState.selector = reinterpret_cast<rword>(codeBlock.base()) +
+                                static_cast<rword>(cbkInfo.resumeOffset);
+
+  for (uint16_t i = 0; i < cbkInfo.cbkSize; i++) {
+    // copy the CallbackData, the registry may grow during the callback
+    const CallbackData cbkData = callbackDataRegistry[cbkInfo.cbkOffset + i];
+    if (not cbkData.enabled) {
+      continue;
+    }
+    VMAction r = cbkData.cbk(vminstance, &context->gprState,
+                             &context->fprState, cbkData.data);
+    if (r != CONTINUE) {
+      QBDI_WARN("Inline callback 0x{:x} returned {}: Use CONTINUE instead",
+                reinterpret_cast<rword>(cbkData.cbk), static_cast<int>(r));
+    }
+    if (QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
+      QBDI_WARN("Inline callback change PC: Ignore new value");
+      QBDI_GPR_SET(&context->gprState, REG_PC, currentPC);
+    }
+  }
+}
+#endif
+
+void ExecBlock::patchCode(uint16_t offset, llvm::ArrayRef<char> code) {
+  char *dst = static_cast<char *>(codeBlock.base()) + offset;
+  // Pages are RWX on iOS
+  if constexpr (is_ios) {
+    memcpy(dst, code.data(), code.size());
+    llvm::sys::Memory::InvalidateInstructionCache(dst, code.size());
+  } else {
+    // The code block may be executing when a callback is called inline, the
+    // page is restored before returning to the code block.
+    bool wasRX = isRX();
+    makeRW();
+    memcpy(dst, code.data(), code.size());
+    if (wasRX) {
+      makeRX();
+    }
+  }
+}
+
+void ExecBlock::skipCallbackSite(uint16_t id, bool remove) {
+  CallbackInfo &cbkInfo = callbackRegistry[id - 1];
+  if (cbkInfo.skipped) {
+    cbkInfo.removed |= remove;
+    return;
+  }
+  CPUMode cpuMode = instMetadata[cbkInfo.instID].cpuMode;
+  char *code = static_cast<char *>(codeBlock.base()) + cbkInfo.siteOffset;
+
+  QBDI_DEBUG("Skip the callback site {} of ExecBlock 0x{:x} (0x{:x} - 0x{:x})",
+             id, reinterpret_cast<uintptr_t>(this), cbkInfo.siteOffset,
+             cbkInfo.siteEndOffset);
+
+  llvm::SmallVector<char, 16> stream;
+  llvmCPUs.getCPU(cpuMode).writeInstruction(
+      getJump(cbkInfo.siteOffset, cbkInfo.siteEndOffset, cpuMode), stream,
+      reinterpret_cast<rword>(code));
+  QBDI_REQUIRE_ABORT(stream.size() <= sizeof(cbkInfo.savedCode) and
+                         stream.size() <=
+                             static_cast<size_t>(cbkInfo.siteEndOffset -
+                                                 cbkInfo.siteOffset),
+                     "The callback site is too small for a jump");
+
+  if (not remove) {
+    memcpy(cbkInfo.savedCode, code, stream.size());
+    cbkInfo.savedCodeSize = static_cast<uint8_t>(stream.size());
+  }
+  patchCode(cbkInfo.siteOffset, stream);
+  cbkInfo.skipped = true;
+  cbkInfo.removed = remove;
+}
+
+void ExecBlock::restoreCallbackSite(uint16_t id) {
+  CallbackInfo &cbkInfo = callbackRegistry[id - 1];
+  if (not cbkInfo.skipped or cbkInfo.removed) {
+    return;
+  }
+  QBDI_DEBUG("Restore the callback site {} of ExecBlock 0x{:x}", id,
+             reinterpret_cast<uintptr_t>(this));
+
+  patchCode(cbkInfo.siteOffset,
+            llvm::ArrayRef<char>(cbkInfo.savedCode, cbkInfo.savedCodeSize));
+  cbkInfo.skipped = false;
+}
+
+void ExecBlock::fireOneShotSite(uint16_t id) {
+  const CallbackInfo &cbkInfo = callbackRegistry[id - 1];
+  rword address = instMetadata[cbkInfo.instID].address;
+  for (uint16_t i = 0; i < cbkInfo.cbkSize; i++) {
+    firedOneShot.emplace_back(
+        callbackDataRegistry[cbkInfo.cbkOffset + i].ruleID, address);
+  }
+  skipCallbackSite(id, true);
+}
+
+bool ExecBlock::hasEnabledCallback(const CallbackInfo &cbkInfo) const {
+  for (uint16_t i = 0; i < cbkInfo.cbkSize; i++) {
+    if (callbackDataRegistry[cbkInfo.cbkOffset + i].enabled) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ExecBlock::setCallbacksEnabled(uint32_t ruleID, bool enabled) {
+  for (size_t id = 1; id <= callbackRegistry.size(); id++) {
+    const CallbackInfo &cbkInfo = callbackRegistry[id - 1];
+    bool found = false;
+    for (uint16_t i = 0; i < cbkInfo.cbkSize; i++) {
+      CallbackData &cbkData = callbackDataRegistry[cbkInfo.cbkOffset + i];
+      if (cbkData.ruleID == ruleID) {
+        cbkData.enabled = enabled;
+        found = true;
+      }
+    }
+    if (not found or cbkInfo.siteEndOffset == 0) {
+      continue;
+    }
+    if (not hasEnabledCallback(cbkInfo)) {
+      skipCallbackSite(id, false);
+    } else if (cbkInfo.skipped) {
+      restoreCallbackSite(id);
+    }
+  }
+}
+
 bool ExecBlock::writeCodeByte(const llvm::ArrayRef<char> &array) {
   QBDI_REQUIRE_ABORT(codeBlockPosition <= codeBlockMaxSize,
                      "Invalid position in codeBlock");
@@ -307,6 +494,23 @@ bool ExecBlock::applyRelocatedInst(
   for (const RelocatableInst::UniquePtr &inst : reloc) {
     if (inst->getTag() != RelocatableInstTag::RelocInst) {
       QBDI_DEBUG("RelocTag 0x{:x}", inst->getTag());
+      if (inst->getTag() == RelocTagCallbackResume) {
+        QBDI_REQUIRE_ABORT(not callbackRegistry.empty(),
+                           "No callback to resume");
+        callbackRegistry.back().resumeOffset =
+            static_cast<uint16_t>(codeBlockPosition);
+      } else if (inst->getTag() == RelocTagInlineCall) {
+        inlineCallOffset = codeBlockPosition;
+      } else if (inst->getTag() == RelocTagCallbackSite) {
+        callbackSiteOffset = codeBlockPosition;
+      } else if (inst->getTag() == RelocTagCallbackSiteEnd) {
+        // a site without callbacks has no id
+        if (not callbackRegistry.empty() and
+            callbackRegistry.back().siteEndOffset == 0) {
+          callbackRegistry.back().siteEndOffset =
+              static_cast<uint16_t>(codeBlockPosition);
+        }
+      }
       if (tags != nullptr) {
         tags->push_back(TagInfo{static_cast<uint16_t>(inst->getTag()),
                                 static_cast<uint16_t>(codeBlockPosition)});
@@ -378,6 +582,8 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
     uint32_t rollbackShadowIdx = shadowIdx;
     size_t rollbackShadowRegistry = shadowRegistry.size();
     size_t rollbackTagRegistry = tagRegistry.size();
+    size_t rollbackCallbackRegistry = callbackRegistry.size();
+    size_t rollbackCallbackDataRegistry = callbackDataRegistry.size();
 
     QBDI_DEBUG_BLOCK({
       std::string disass =
@@ -401,10 +607,12 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
       // Seek to the last complete patch written and terminate it with a
       // terminator
       codeBlockPosition = rollbackOffset;
-      // free shadows and tag allocated by the rollbacked code
+      // free shadows, tag and callbacks allocated by the rollbacked code
       shadowIdx = rollbackShadowIdx;
       shadowRegistry.resize(rollbackShadowRegistry);
       tagRegistry.resize(rollbackTagRegistry);
+      callbackRegistry.resize(rollbackCallbackRegistry);
+      callbackDataRegistry.resize(rollbackCallbackDataRegistry);
       // It's a NULL rollback, don't terminate it
       if (rollbackOffset == startOffset) {
         QBDI_DEBUG("NULL rollback, nothing written to ExecBlock 0x{:x}",
@@ -415,9 +623,11 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
       break;
     } else {
       // Complete instruction was written, we add the metadata
-      // Move the analysis of the instruction in the cached metadata
+      // Keep the analysis of the instruction in the cached metadata
       instMetadata.push_back(seqIt->metadata.lightCopy());
-      instMetadata.back().analysis.reset(seqIt->metadata.analysis.release());
+      instMetadata.back().analysis = seqIt->metadata.analysis;
+      instMetadata.back().analysisGeneration =
+          seqIt->metadata.analysisGeneration;
       // Register instruction
       instRegistry.push_back(InstInfo{
           seqID, 0, 0, static_cast<uint16_t>(rollbackShadowRegistry),
@@ -438,6 +648,14 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
       QBDI_REQUIRE_ABORT(endInstPatchTag.size() == 1,
                          "Internal Error: end tag not found");
       instRegistry.back().offsetSkip = endInstPatchTag[0].offset;
+      // skip the callback sites of the disabled InstrRule
+      for (size_t id = rollbackCallbackRegistry + 1;
+           id <= callbackRegistry.size(); id++) {
+        if (callbackRegistry[id - 1].siteEndOffset != 0 and
+            not hasEnabledCallback(callbackRegistry[id - 1])) {
+          skipCallbackSite(id, false);
+        }
+      }
       // set the scratch Register if needed
       finalizeScratchRegisterForPatch();
       // Update indexes
@@ -556,6 +774,24 @@ rword ExecBlock::getShadowOffset(uint16_t id) const {
   return offset;
 }
 
+uint16_t ExecBlock::newCallback(const std::vector<CallbackData> &callbacks,
+                                CallbackFlags flags) {
+  QBDI_REQUIRE_ABORT(callbackRegistry.size() < 0xFFFF,
+                     "Callback allocation fail");
+  QBDI_REQUIRE_ABORT(0 < callbacks.size() and callbacks.size() < 0xFFFF,
+                     "Invalid number of callbacks");
+  callbackRegistry.push_back(
+      {getNextInstID(), 0, static_cast<uint32_t>(callbackDataRegistry.size()),
+       static_cast<uint16_t>(callbacks.size()),
+       static_cast<uint16_t>(callbackSiteOffset), 0,
+       (flags & CB_FLAG_ONE_SHOT) != 0, false, false, 0, {}});
+  callbackDataRegistry.insert(callbackDataRegistry.end(), callbacks.begin(),
+                              callbacks.end());
+  QBDI_DEBUG("Registering new callback {} with {} function(s) for instID {}",
+             callbackRegistry.size(), callbacks.size(), getNextInstID());
+  return static_cast<uint16_t>(callbackRegistry.size());
+}
+
 uint16_t ExecBlock::getInstID(rword address, CPUMode cpuMode) const {
   for (size_t i = 0; i < instMetadata.size(); i++) {
     if (instMetadata[i].address == address and
@@ -20,6 +20,7 @@
 
 #include <memory>
 #include <stdint.h>
+#include <utility>
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -92,6 +93,25 @@ struct TagInfo {
   uint16_t offset;
 };
 
+struct CallbackInfo {
+  uint16_t instID;
+  uint16_t resumeOffset;
+  uint32_t cbkOffset;
+  uint16_t cbkSize;
+  // code of the callbacks, between RelocTagCallbackSite and
+  // RelocTagCallbackSiteEnd
+  uint16_t siteOffset;
+  uint16_t siteEndOffset;
+  // registered with CB_FLAG_ONE_SHOT
+  bool oneShot;
+  // the site is replaced by a jump to its end, the beginning of the code is
+  // kept in savedCode unless the site has been removed by a one-shot call
+  bool skipped;
+  bool removed;
+  uint8_t savedCodeSize;
+  char savedCode[8];
+};
+
 static const uint16_t EXEC_BLOCK_FULL = 0xFFFF;
 
 /*! Manages the concept of an exec block made of two contiguous memory blocks
@@ -114,6 +134,11 @@ private:
   rword *shadows;
   std::vector<ShadowInfo> shadowRegistry;
   std::vector<TagInfo> tagRegistry;
+  std::vector<CallbackInfo> callbackRegistry;
+  std::vector<CallbackData> callbackDataRegistry;
+  // (ruleID, address) of the one-shot callbacks called since the last
+  // takeFiredOneShot
+  std::vector<std::pair<uint32_t, rword>> firedOneShot;
   uint16_t shadowIdx;
   std::vector<InstMetadata> instMetadata;
   std::vector<InstInfo> instRegistry;
@@ -122,6 +147,8 @@ private:
   uint16_t currentSeq;
   uint16_t currentInst;
   uint32_t epilogueSize;
+  uint32_t inlineCallOffset;
+  uint32_t callbackSiteOffset;
   bool isFull;
   ScratchRegisterInfo srInfo;
 
@@ -161,6 +188,60 @@ private:
 
   void finalizeScratchRegisterForPatch();
 
+  /*! Get a jump between two offsets of the code block
+   *
+   * @param[in] offset   The offset of the jump
+   * @param[in] target   The offset of the target
+   * @param[in] cpuMode  The CPUMode of the code at the offset
+   */
+  llvm::MCInst getJump(uint16_t offset, uint16_t target, CPUMode cpuMode) const;
+
+  /*! Write in the code block outside of writeSequence. The permission of the
+   * page is restored after the write.
+   *
+   * @param[in] offset  The offset in the code block
+   * @param[in] code    The code to write
+   */
+  void patchCode(uint16_t offset, llvm::ArrayRef<char> code);
+
+  /*! Replace the code of a callback site with a jump to the end of the site.
+   *
+   * @param[in] id      The id of the callbacks
+   * @param[in] remove  Don't keep the original code (CB_FLAG_ONE_SHOT)
+   */
+  void skipCallbackSite(uint16_t id, bool remove);
+
+  /*! Restore the code of a callback site skipped by skipCallbackSite.
+   *
+   * @param[in] id  The id of the callbacks
+   */
+  void restoreCallbackSite(uint16_t id);
+
+  /*! Remove a one-shot callback site before its callbacks are called and
+   * record the rules of the callbacks in firedOneShot.
+   *
+   * @param[in] id  The id of the callbacks
+   */
+  void fireOneShotSite(uint16_t id);
+
+  /*! Check if a callback site has at least one enabled callback
+   *
+   * @param[in] cbkInfo  The callbacks of the site
+   */
+  bool hasEnabledCallback(const CallbackInfo &cbkInfo) const;
+
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  /*! Entry point of the inline call stub in the host. Call the callbacks
+   * registered with the id in the host state and set the selector to the
+   * address where the execution resumes.
+   *
+   * @param[in] execBlock  The ExecBlock of the stub
+   */
+  static void inlineCallHandler(ExecBlock *execBlock);
+
+  void executeInlineCallback();
+#endif
+
 public:
   /*! Construct a new ExecBlock
    *
@@ -255,6 +336,42 @@ public:
    */
   uint32_t getEpilogueSize() const { return epilogueSize; }
 
+  /*! Compute the offset between the current code stream position and the
+   * inline call stub, written with the epilogue. Used to jump to the stub in
+   * the callbacks registered with CB_FLAG_INLINE_CALL.
+   *
+   * @return The computed offset.
+   */
+  rword getInlineCallOffset() const {
+    return inlineCallOffset - codeBlockPosition;
+  }
+
+  /*! Check if the inline call stub was written with the epilogue
+   *
+   * @return True if the stub is available.
+   */
+  bool hasInlineCall() const { return inlineCallOffset != 0; }
+
+  /*! Enable or disable the callbacks registered by an InstrRule. A callback
+   * site without any enabled callback is replaced by a jump to its end, and
+   * restored when one of its callbacks is enabled again.
+   *
+   * @param[in] ruleID   The id of the InstrRule
+   * @param[in] enabled  The new state of the callbacks
+   */
+  void setCallbacksEnabled(uint32_t ruleID, bool enabled);
+
+  /*! Get and clear the one-shot callbacks called since the last call. The
+   * Engine records them in their InstrRule, the instruction isn't
+   * instrumented again by the rule when it is translated again.
+   *
+   * @return The id of the InstrRule and the address of the instruction of
+   *         each called one-shot callback.
+   */
+  std::vector<std::pair<uint32_t, rword>> takeFiredOneShot() {
+    return std::exchange(firedOneShot, {});
+  }
+
   /*! Obtain the value of the PC where the ExecBlock is currently writing
    * instructions.
    *
@@ -435,6 +552,20 @@ public:
    */
   rword getShadowOffset(uint16_t id) const;
 
+  /*! Register a list of callbacks for the current instruction. Used by
+   * relocation to identify the callbacks requested by the instrumented code.
+   * The callbacks are called in order until one of them returns another action
+   * than CONTINUE. The execution resumes at the next RelocTagCallbackResume
+   * tag when the callbacks return.
+   *
+   *  @param callbacks [in] The callbacks to call and their data.
+   *  @param flags     [in] The options of the callbacks.
+   *
+   *  @return The callback id, greater than 0.
+   */
+  uint16_t newCallback(const std::vector<CallbackData> &callbacks,
+                       CallbackFlags flags);
+
   /* Get all registered shadows for an instruction
    *
    * @param instID  The id of the instruction in the ExecBlock
@@ -78,6 +78,14 @@ void ExecBlockManager::changeVMInstanceRef(VMInstanceRef vminstance) {
   }
 }
 
+void ExecBlockManager::setCallbacksEnabled(uint32_t ruleID, bool enabled) {
+  for (auto &reg : regions) {
+    for (auto &block : reg.blocks) {
+      block->setCallbacksEnabled(ruleID, enabled);
+    }
+  }
+}
+
 float ExecBlockManager::getExpansionRatio() const {
   QBDI_DEBUG("{} / {}", total_translation_size, total_translated_size);
   return static_cast<float>(total_translation_size) /
@@ -528,6 +536,84 @@ void ExecBlockManager::clearCache(RangeSet<rword> rangeSet) {
   total_translation_size = 1;
 }
 
+void ExecBlockManager::clearCache(
+    RangeSet<rword> rangeSet,
+    const std::function<bool(const InstMetadata &)> &match) {
+  bool cleared = false;
+  for (ExecRegion &region : regions) {
+    if (region.toFlush or not rangeSet.overlaps(region.covered)) {
+      continue;
+    }
+    for (const auto &it : region.instCache) {
+      const ExecBlock &block = *region.blocks[it.second.blockIdx];
+      if (match(block.getInstMetadata(it.second.instID))) {
+        QBDI_DEBUG("Erasing region [0x{:x}, 0x{:x}]", region.covered.start(),
+                   region.covered.end());
+        region.toFlush = true;
+        needFlush = true;
+        cleared = true;
+        break;
+      }
+    }
+  }
+  if (cleared) {
+    // The instrumentation has changed, reset translation counters
+    total_translated_size = 1;
+    total_translation_size = 1;
+  }
+}
+
+bool ExecBlockManager::invalidateRange(Range<rword> range) {
+  bool invalidated = false;
+  QBDI_DEBUG("Invalidating range [0x{:x}, 0x{:x}]", range.start(),
+             range.end());
+  for (ExecRegion &region : regions) {
+    if (region.toFlush or not region.covered.overlaps(range)) {
+      continue;
+    }
+    // Erase the sequences that overlap the range. A sequence that overlaps an
+    // erased one shares its instructions and is erased too.
+    RangeSet<rword> stale;
+    stale.add(range);
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto it = region.sequenceCache.begin();
+           it != region.sequenceCache.end();) {
+        const Range<rword> seqRange{it->second.seqStart, it->second.seqEnd};
+        if (stale.overlaps(seqRange)) {
+          stale.add(seqRange);
+          it = region.sequenceCache.erase(it);
+          changed = true;
+        } else {
+          ++it;
+        }
+      }
+    }
+    // The instructions of the erased sequences must be translated again
+    for (auto it = region.instCache.begin(); it != region.instCache.end();) {
+      const ExecBlock &block = *region.blocks[it->second.blockIdx];
+      if (stale.contains(block.getInstMetadata(it->second.instID).address)) {
+        it = region.instCache.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    stale.intersect(region.covered);
+    region.invalidated += stale.size();
+    invalidated = true;
+    // The code of the erased sequences stays in the ExecBlocks until the
+    // region is flushed.
+    if (region.invalidated * 2 > region.translated) {
+      QBDI_DEBUG("Erasing region [0x{:x}, 0x{:x}]", region.covered.start(),
+                 region.covered.end());
+      region.toFlush = true;
+      needFlush = true;
+    }
+  }
+  return invalidated;
+}
+
 void ExecBlockManager::flushCommit() {
   // It needs to be erased from last to first to preserve index validity
   if (needFlush) {
@@ -19,6 +19,7 @@
 #define EXECBLOCKMANAGER_H
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <memory>
 #include <stddef.h>
@@ -33,6 +34,7 @@ namespace QBDI {
 
 class ExecBlock;
 class ExecBroker;
+class InstMetadata;
 class LLVMCPUs;
 class Patch;
 class RelocatableInst;
@@ -60,6 +62,8 @@ struct ExecRegion {
   std::map<rword, SeqLoc> sequenceCache;
   std::map<rword, InstLoc> instCache;
   bool toFlush = false;
+  // size of the code invalidated with invalidateRange
+  unsigned invalidated = 0;
 
   // lambda ptr for user callback set with addInstrRule
   // These pointers should be remove at the same time as the region
@@ -127,6 +131,32 @@ public:
   void clearCache(Range<rword> range);
 
   void clearCache(RangeSet<rword> rangeSet);
+
+  /*! Clear the regions that overlap a range set and have a translated
+   * instruction that matches a predicate. The other regions are kept.
+   *
+   * @param[in] rangeSet  The range set to clear
+   * @param[in] match     The predicate on the translated instructions
+   */
+  void clearCache(RangeSet<rword> rangeSet,
+                  const std::function<bool(const InstMetadata &)> &match);
+
+  /*! Invalidate the sequences that overlap a range of modified code. The
+   * other sequences of the regions are kept. A region is flushed when most of
+   * its translated code has been invalidated.
+   *
+   * @param[in] range  The range of modified code
+   *
+   * @return True if a sequence has been invalidated
+   */
+  bool invalidateRange(Range<rword> range);
+
+  /*! Enable or disable the callbacks of an InstrRule in all the ExecBlocks.
+   *
+   * @param[in] ruleID   The id of the InstrRule
+   * @param[in] enabled  The new state of the callbacks
+   */
+  void setCallbacksEnabled(uint32_t ruleID, bool enabled);
 };
 
 } // namespace QBDI
@@ -30,9 +30,10 @@ struct QBDI_ALIGNED(8) HostState {
   rword gs;
   rword selector;
   rword callback;
-  rword data;
-  rword origin;
   rword executeFlags;
+  // parameters of the inline call stub
+  rword execBlock;
+  rword inlineCallHandler;
 };
 
 /*! X86_64 Execution context.
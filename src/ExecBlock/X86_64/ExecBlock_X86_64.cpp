@@ -29,6 +29,7 @@
 #include "ExecBlock/X86_64/Context_X86_64.h"
 #include "Patch/Patch.h"
 #include "Patch/RelocatableInst.h"
+#include "Patch/X86_64/Layer2_X86_64.h"
 #include "Utility/LogSys.h"
 
 #if defined(QBDI_PLATFORM_WINDOWS)
@@ -91,4 +92,10 @@ void ExecBlock::initScratchRegisterForPatch(
 
 void ExecBlock::finalizeScratchRegisterForPatch() {}
 
+llvm::MCInst ExecBlock::getJump(uint16_t offset, uint16_t target,
+                                CPUMode cpuMode) const {
+  // jmp rel32 is relative to the end of the instruction
+  return jmp(static_cast<rword>(target) - static_cast<rword>(offset) - 1);
+}
+
 } // namespace QBDI
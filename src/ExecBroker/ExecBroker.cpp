@@ -23,14 +23,16 @@
 #include "QBDI/Memory.hpp"
 #include "ExecBroker/ExecBroker.h"
 #include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
 
 namespace QBDI {
 
 ExecBroker::ExecBroker(std::unique_ptr<ExecBlock> _transferBlock,
                        const LLVMCPUs &llvmCPUs, VMInstanceRef vminstance)
-    : transferBlock(std::move(_transferBlock)) {
-  pageSize = llvm::expectedToOptional(llvm::sys::Process::getPageSize())
-                 .value_or(4096);
+    : transferBlock(std::move(_transferBlock)),
+      pageSize(llvm::expectedToOptional(llvm::sys::Process::getPageSize())
+                   .value_or(4096)),
+      instrumentedPages(pageSize) {
   initExecBrokerSequences(llvmCPUs);
 }
 
@@ -41,15 +43,20 @@ void ExecBroker::changeVMInstanceRef(VMInstanceRef vminstance) {
 void ExecBroker::addInstrumentedRange(const Range<rword> &r) {
   QBDI_DEBUG("Adding instrumented range [0x{:x}, 0x{:x}]", r.start(), r.end());
   instrumented.add(r);
+  instrumentedPages.update(r, instrumented, true);
 }
 
 void ExecBroker::removeInstrumentedRange(const Range<rword> &r) {
   QBDI_DEBUG("Removing instrumented range [0x{:x}, 0x{:x}]", r.start(),
              r.end());
   instrumented.remove(r);
+  instrumentedPages.update(r, instrumented, false);
 }
 
-void ExecBroker::removeAllInstrumentedRanges() { instrumented.clear(); }
+void ExecBroker::removeAllInstrumentedRanges() {
+  instrumented.clear();
+  instrumentedPages.rebuild(instrumented);
+}
 
 bool ExecBroker::addInstrumentedModule(const std::string &name) {
   bool instrumented = false;
@@ -57,8 +64,20 @@ bool ExecBroker::addInstrumentedModule(const std::string &name) {
     return false;
   }
 
-  for (const MemoryMap &m : getCurrentProcessMaps()) {
-    if ((m.name == name) && (m.permission & QBDI::PF_EXEC)) {
+  ProcessMaps::Snapshot maps = ProcessMaps::get().snapshot();
+  const std::vector<size_t> *mapsIdx = maps->findByName(name);
+  if (mapsIdx == nullptr) {
+    // the module may have been mapped since the last snapshot
+    maps = ProcessMaps::get().refresh();
+    mapsIdx = maps->findByName(name);
+  }
+  if (mapsIdx == nullptr) {
+    return false;
+  }
+
+  for (size_t idx : *mapsIdx) {
+    const MemoryMap &m = maps->getMaps()[idx];
+    if (m.permission & QBDI::PF_EXEC) {
       addInstrumentedRange(m.range);
       instrumented = true;
     }
@@ -67,50 +86,67 @@ bool ExecBroker::addInstrumentedModule(const std::string &name) {
 }
 
 bool ExecBroker::addInstrumentedModuleFromAddr(rword addr) {
-  for (const MemoryMap &m : getCurrentProcessMaps()) {
-    if (m.range.contains(addr)) {
-      if (not m.name.empty()) {
-        return addInstrumentedModule(m.name);
-      } else if (m.permission & QBDI::PF_EXEC) {
-        addInstrumentedRange(m.range);
-        return true;
-      } else {
-        return false;
-      }
-    }
+  ProcessMaps::Snapshot maps = ProcessMaps::get().snapshot();
+  const MemoryMap *m = maps->findByAddress(addr);
+  if (m == nullptr) {
+    // the address may have been mapped since the last snapshot
+    maps = ProcessMaps::get().refresh();
+    m = maps->findByAddress(addr);
+  }
+  if (m == nullptr) {
+    return false;
+  }
+
+  if (not m->name.empty()) {
+    return addInstrumentedModule(m->name);
+  } else if (m->permission & QBDI::PF_EXEC) {
+    addInstrumentedRange(m->range);
+    return true;
+  } else {
+    return false;
   }
-  return false;
 }
 
 bool ExecBroker::removeInstrumentedModule(const std::string &name) {
   bool removed = false;
 
-  for (const MemoryMap &m : getCurrentProcessMaps()) {
-    if (m.name == name) {
-      removeInstrumentedRange(m.range);
-      removed = true;
-    }
+  ProcessMaps::Snapshot maps = ProcessMaps::get().snapshot();
+  const std::vector<size_t> *mapsIdx = maps->findByName(name);
+  if (mapsIdx == nullptr) {
+    return false;
+  }
+
+  for (size_t idx : *mapsIdx) {
+    removeInstrumentedRange(maps->getMaps()[idx].range);
+    removed = true;
   }
   return removed;
 }
 
 bool ExecBroker::removeInstrumentedModuleFromAddr(rword addr) {
-  for (const MemoryMap &m : getCurrentProcessMaps()) {
-    if (m.range.contains(addr)) {
-      removeInstrumentedRange(m.range);
-      if (not m.name.empty()) {
-        removeInstrumentedModule(m.name);
-      }
-      return true;
-    }
+  ProcessMaps::Snapshot maps = ProcessMaps::get().snapshot();
+  const MemoryMap *m = maps->findByAddress(addr);
+  if (m == nullptr) {
+    maps = ProcessMaps::get().refresh();
+    m = maps->findByAddress(addr);
+  }
+  if (m == nullptr) {
+    return false;
+  }
+
+  removeInstrumentedRange(m->range);
+  if (not m->name.empty()) {
+    removeInstrumentedModule(m->name);
   }
-  return false;
+  return true;
 }
 
 bool ExecBroker::instrumentAllExecutableMaps() {
   bool instrumented = false;
 
-  for (const MemoryMap &m : getCurrentProcessMaps()) {
+  // anonymous executable maps aren't tracked by the snapshot, read them again
+  ProcessMaps::Snapshot maps = ProcessMaps::get().refresh();
+  for (const MemoryMap &m : maps->getMaps()) {
     if (m.permission & QBDI::PF_EXEC) {
       addInstrumentedRange(m.range);
       instrumented = true;
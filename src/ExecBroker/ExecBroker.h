@@ -30,6 +30,7 @@
 #include "QBDI/Range.h"
 #include "QBDI/State.h"
 #include "ExecBlock/ExecBlock.h"
+#include "ExecBroker/PageIndex.h"
 
 #if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
 #include "ExecBroker/X86_64/ExecBroker_X86_64.h"
@@ -50,6 +51,8 @@ private:
   RangeSet<rword> instrumented;
   std::unique_ptr<ExecBlock> transferBlock;
   rword pageSize;
+  // page granular mirror of instrumented
+  PageIndex instrumentedPages;
 
   using PF = llvm::sys::Memory::ProtectionFlags;
 
@@ -65,9 +68,21 @@ public:
 
   void changeVMInstanceRef(VMInstanceRef vminstance);
 
-  bool isInstrumented(rword addr) const { return instrumented.contains(addr); }
-
-  void setInstrumentedRange(const RangeSet<rword> &r) { instrumented = r; }
+  bool isInstrumented(rword addr) const {
+    switch (instrumentedPages.lookup(addr)) {
+      case PageIndex::FULL:
+        return true;
+      case PageIndex::EMPTY:
+        return false;
+      default:
+        return instrumented.contains(addr);
+    }
+  }
+
+  void setInstrumentedRange(const RangeSet<rword> &r) {
+    instrumented = r;
+    instrumentedPages.rebuild(instrumented);
+  }
 
   const RangeSet<rword> &getInstrumentedRange() const { return instrumented; }
 
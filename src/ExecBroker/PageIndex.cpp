@@ -0,0 +1,155 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+
+#include "ExecBroker/PageIndex.h"
+#include "Utility/LogSys.h"
+
+namespace QBDI {
+
+PageIndex::PageIndex(rword pageSize)
+    : pageShift(0), enabled(true), lastLeafIdx(0), lastLeaf(nullptr) {
+  QBDI_REQUIRE_ABORT(pageSize != 0 and (pageSize & (pageSize - 1)) == 0,
+                     "Invalid page size 0x{:x}", pageSize);
+  while ((static_cast<rword>(1) << pageShift) != pageSize) {
+    pageShift++;
+  }
+  invalidateLookup();
+}
+
+void PageIndex::invalidateLookup() {
+  // no leaf can have this index
+  lastLeafIdx = ~static_cast<rword>(0);
+  lastLeaf = nullptr;
+}
+
+PageIndex::PageState
+PageIndex::computePage(rword page, const RangeSet<rword> &ranges) const {
+  rword start = page << pageShift;
+  rword end = start + (static_cast<rword>(1) << pageShift);
+  if (end <= start) {
+    // last page of the address space
+    return ranges.contains(start) ? PARTIAL : EMPTY;
+  }
+  Range<rword> pageRange{start, end};
+  if (ranges.contains(pageRange)) {
+    return FULL;
+  }
+  return ranges.overlaps(pageRange) ? PARTIAL : EMPTY;
+}
+
+void PageIndex::setPage(rword page, PageState state) {
+  rword leafIdx = page >> LEAF_BITS;
+  rword bit = page & (LEAF_PAGES - 1);
+
+  auto it = leaves.find(leafIdx);
+  if (it == leaves.end()) {
+    if (state == EMPTY) {
+      return;
+    }
+    if (leaves.size() >= MAX_LEAVES) {
+      QBDI_DEBUG("Too many instrumented pages, disable the page index");
+      enabled = false;
+      leaves.clear();
+      return;
+    }
+    it = leaves.emplace(leafIdx, std::make_unique<Leaf>()).first;
+  }
+  Leaf &leaf = *it->second;
+  leaf.any.set(bit, state != EMPTY);
+  leaf.full.set(bit, state == FULL);
+
+  if (state == EMPTY and leaf.any.none()) {
+    leaves.erase(it);
+  }
+}
+
+void PageIndex::update(const Range<rword> &r, const RangeSet<rword> &ranges,
+                       bool added) {
+  if (not enabled or r.size() == 0) {
+    return;
+  }
+  invalidateLookup();
+
+  rword firstPage = r.start() >> pageShift;
+  rword lastPage = (r.end() - 1) >> pageShift;
+
+  if (added and lastPage - firstPage >= MAX_LEAVES * LEAF_PAGES) {
+    QBDI_DEBUG("Too many instrumented pages, disable the page index");
+    enabled = false;
+    leaves.clear();
+    return;
+  }
+
+  if (not added) {
+    // only the existing leaves have pages to remove, the range may cover a
+    // large part of the address space
+    rword minLeaf = firstPage >> LEAF_BITS;
+    rword maxLeaf = lastPage >> LEAF_BITS;
+    for (auto it = leaves.begin(); it != leaves.end();) {
+      if (it->first < minLeaf or maxLeaf < it->first) {
+        ++it;
+        continue;
+      }
+      rword leafStart = it->first << LEAF_BITS;
+      rword begin = std::max(firstPage, leafStart) - leafStart;
+      rword end = std::min(lastPage, leafStart + (LEAF_PAGES - 1)) - leafStart;
+      Leaf &leaf = *it->second;
+      for (rword bit = begin; bit <= end; bit++) {
+        leaf.any.reset(bit);
+        leaf.full.reset(bit);
+      }
+      if (leaf.any.none()) {
+        it = leaves.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // the pages at the bounds may be shared with another range
+    setPage(firstPage, computePage(firstPage, ranges));
+    if (lastPage != firstPage and enabled) {
+      setPage(lastPage, computePage(lastPage, ranges));
+    }
+    return;
+  }
+
+  // the pages inside the range are fully added. The pages at the bounds may be
+  // shared with another range.
+  setPage(firstPage, computePage(firstPage, ranges));
+  for (rword page = firstPage + 1; page < lastPage and enabled; page++) {
+    setPage(page, FULL);
+  }
+  if (lastPage != firstPage and enabled) {
+    setPage(lastPage, computePage(lastPage, ranges));
+  }
+}
+
+void PageIndex::rebuild(const RangeSet<rword> &ranges) {
+  leaves.clear();
+  enabled = true;
+  invalidateLookup();
+
+  for (const Range<rword> &r : ranges.getRanges()) {
+    update(r, ranges, true);
+    if (not enabled) {
+      return;
+    }
+  }
+}
+
+} // namespace QBDI
@@ -0,0 +1,107 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QBDI_PAGEINDEX_H
+#define QBDI_PAGEINDEX_H
+
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+
+#include "QBDI/Range.h"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Two-level page bitmap that mirrors a RangeSet.
+ *
+ * Each page is either fully inside the RangeSet, outside of it, or partially
+ * covered. Only the last case needs a search in the RangeSet. The index is
+ * disabled when the RangeSet covers too many pages.
+ */
+class PageIndex {
+public:
+  enum PageState {
+    EMPTY,
+    FULL,
+    PARTIAL,
+  };
+
+private:
+  static constexpr unsigned LEAF_BITS = 12;
+  static constexpr rword LEAF_PAGES = static_cast<rword>(1) << LEAF_BITS;
+  // 1024 leaves cover 64GB with 4k pages and use 1MB
+  static constexpr size_t MAX_LEAVES = 1024;
+
+  struct Leaf {
+    std::bitset<LEAF_PAGES> any;
+    std::bitset<LEAF_PAGES> full;
+  };
+
+  unsigned pageShift;
+  bool enabled;
+  std::unordered_map<rword, std::unique_ptr<Leaf>> leaves;
+
+  // last leaf used by lookup. nullptr if the leaf doesn't exist.
+  mutable rword lastLeafIdx;
+  mutable const Leaf *lastLeaf;
+
+  void setPage(rword page, PageState state);
+  PageState computePage(rword page, const RangeSet<rword> &ranges) const;
+  void invalidateLookup();
+
+public:
+  PageIndex(rword pageSize);
+
+  /*! Rebuild the index from a RangeSet.
+   */
+  void rebuild(const RangeSet<rword> &ranges);
+
+  /*! Update the index after a range has been added or removed.
+   *
+   * @param[in] r       The range added or removed
+   * @param[in] ranges  The RangeSet after the modification
+   * @param[in] added   True if the range was added
+   */
+  void update(const Range<rword> &r, const RangeSet<rword> &ranges,
+              bool added);
+
+  inline PageState lookup(rword addr) const {
+    if (not enabled) {
+      return PARTIAL;
+    }
+    rword page = addr >> pageShift;
+    rword leafIdx = page >> LEAF_BITS;
+    if (leafIdx != lastLeafIdx) {
+      auto it = leaves.find(leafIdx);
+      lastLeafIdx = leafIdx;
+      lastLeaf = (it == leaves.end()) ? nullptr : it->second.get();
+    }
+    if (lastLeaf == nullptr) {
+      return EMPTY;
+    }
+    rword bit = page & (LEAF_PAGES - 1);
+    if (lastLeaf->full.test(bit)) {
+      return FULL;
+    }
+    return lastLeaf->any.test(bit) ? PARTIAL : EMPTY;
+  }
+};
+
+} // namespace QBDI
+
+#endif // QBDI_PAGEINDEX_H
@@ -224,7 +224,8 @@ RelocatableInst::UniquePtrVec getTerminator(const LLVMCPU &llvmcpu,
 
 // Change ScratchRegister
 RelocatableInst::UniquePtrVec
-changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_) {
+changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_,
+                      bool oldSRDead, bool nextSRDead) {
 
   QBDI_REQUIRE_ABORT(getGPRPosition(nextSR_) != ((size_t)-1),
                      "Unexpected next ScratchRegister {}",
@@ -243,16 +244,24 @@ changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_) {
 
   changeReloc.push_back(RelocTag::unique(RelocTagChangeScratchRegister));
 
-  // load the real value of the old SR
-  changeReloc.push_back(NoReloc::unique(
-      ldr(tmp, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
-  // backup the real value of the next SR
-  changeReloc.push_back(NoReloc::unique(
-      str(nextSR, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
+  // The value of a dead register doesn't need to be backup or restored
+  // (only with OPT_ENABLE_REGISTER_LIVENESS).
+  if (not oldSRDead) {
+    // load the real value of the old SR
+    changeReloc.push_back(NoReloc::unique(
+        ldr(tmp, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
+  }
+  if (not nextSRDead) {
+    // backup the real value of the next SR
+    changeReloc.push_back(NoReloc::unique(str(
+        nextSR, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
+  }
   // change the SR
   changeReloc.push_back(NoReloc::unique(movrr(nextSR, oldSR)));
-  // restore the value of the old SR
-  changeReloc.push_back(NoReloc::unique(movrr(oldSR, tmp)));
+  if (not oldSRDead) {
+    // restore the value of the old SR
+    changeReloc.push_back(NoReloc::unique(movrr(oldSR, tmp)));
+  }
   // change the index of the SRregister
   changeReloc.push_back(NoReloc::unique(movri(tmp, nextSR.getID())));
   changeReloc.push_back(NoReloc::unique(
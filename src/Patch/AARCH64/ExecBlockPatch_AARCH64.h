@@ -30,7 +30,8 @@ class RelocatableInst;
 class LLVMCPU;
 
 std::vector<std::unique_ptr<RelocatableInst>>
-changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR);
+changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR,
+                      bool oldSRDead = false, bool nextSRDead = false);
 
 } // namespace QBDI
 
@@ -0,0 +1,262 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+
+#include "AArch64InstrInfo.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCRegisterInfo.h"
+
+#include "Patch/FastEncoder.h"
+
+namespace QBDI {
+
+namespace {
+
+// Encoding of a X register (X0 to X30, XZR or SP), or -1 if the operand isn't
+// a 64 bits general purpose register.
+int getXReg(const llvm::MCOperand &op, const llvm::MCRegisterInfo &MRI) {
+  if (not op.isReg()) {
+    return -1;
+  }
+  unsigned reg = op.getReg();
+  if (not MRI.getRegClass(llvm::AArch64::GPR64RegClassID).contains(reg) and
+      not MRI.getRegClass(llvm::AArch64::GPR64spRegClassID).contains(reg)) {
+    return -1;
+  }
+  return MRI.getEncodingValue(reg);
+}
+
+inline bool getImm(const llvm::MCOperand &op, int64_t min, int64_t max,
+                   int64_t &value) {
+  if (not op.isImm() or op.getImm() < min or op.getImm() > max) {
+    return false;
+  }
+  value = op.getImm();
+  return true;
+}
+
+// [Rt, Rn, imm] with an unsigned or signed immediate at the given position
+bool encodeLoadStore(const llvm::MCInst &inst, const llvm::MCRegisterInfo &MRI,
+                     uint32_t base, int64_t min, int64_t max, unsigned shift,
+                     uint32_t mask, uint32_t &encoding) {
+  int64_t imm;
+  if (inst.getNumOperands() != 3) {
+    return false;
+  }
+  int rt = getXReg(inst.getOperand(0), MRI);
+  int rn = getXReg(inst.getOperand(1), MRI);
+  if (rt < 0 or rn < 0 or not getImm(inst.getOperand(2), min, max, imm)) {
+    return false;
+  }
+  encoding = base | ((static_cast<uint32_t>(imm) & mask) << shift) | (rn << 5) |
+             rt;
+  return true;
+}
+
+// [Rt, Rt2, Rn, imm7]
+bool encodePair(const llvm::MCInst &inst, const llvm::MCRegisterInfo &MRI,
+                uint32_t base, uint32_t &encoding) {
+  int64_t imm;
+  if (inst.getNumOperands() != 4) {
+    return false;
+  }
+  int rt = getXReg(inst.getOperand(0), MRI);
+  int rt2 = getXReg(inst.getOperand(1), MRI);
+  int rn = getXReg(inst.getOperand(2), MRI);
+  if (rt < 0 or rt2 < 0 or rn < 0 or
+      not getImm(inst.getOperand(3), -64, 63, imm)) {
+    return false;
+  }
+  encoding = base | ((static_cast<uint32_t>(imm) & 0x7f) << 15) | (rt2 << 10) |
+             (rn << 5) | rt;
+  return true;
+}
+
+// [Rd, Rn, imm12, shift]
+bool encodeAddSubImm(const llvm::MCInst &inst, const llvm::MCRegisterInfo &MRI,
+                     uint32_t base, uint32_t &encoding) {
+  int64_t imm;
+  if (inst.getNumOperands() != 4 or not inst.getOperand(3).isImm()) {
+    return false;
+  }
+  int rd = getXReg(inst.getOperand(0), MRI);
+  int rn = getXReg(inst.getOperand(1), MRI);
+  int64_t shift = inst.getOperand(3).getImm();
+  if (rd < 0 or rn < 0 or not getImm(inst.getOperand(2), 0, 0xfff, imm) or
+      (shift != 0 and shift != 12)) {
+    return false;
+  }
+  encoding = base | ((shift == 12) ? (1 << 22) : 0) | (imm << 10) | (rn << 5) |
+             rd;
+  return true;
+}
+
+// [Rd, Rn, Rm, shifter]
+bool encodeOrrRegShift(const llvm::MCInst &inst,
+                       const llvm::MCRegisterInfo &MRI, uint32_t &encoding) {
+  int64_t shifter;
+  if (inst.getNumOperands() != 4) {
+    return false;
+  }
+  int rd = getXReg(inst.getOperand(0), MRI);
+  int rn = getXReg(inst.getOperand(1), MRI);
+  int rm = getXReg(inst.getOperand(2), MRI);
+  // shifter = (type << 6) | amount, with type in LSL, LSR, ASR, ROR
+  if (rd < 0 or rn < 0 or rm < 0 or
+      not getImm(inst.getOperand(3), 0, 0xff, shifter)) {
+    return false;
+  }
+  encoding = 0xAA000000 | ((shifter >> 6) << 22) | (rm << 16) |
+             ((shifter & 0x3f) << 10) | (rn << 5) | rd;
+  return true;
+}
+
+// [Rd, imm16, shift] or [Rd, Rd, imm16, shift] for MOVK
+bool encodeMoveWide(const llvm::MCInst &inst, const llvm::MCRegisterInfo &MRI,
+                    uint32_t base, unsigned immIndex, uint32_t &encoding) {
+  int64_t imm, shift;
+  if (inst.getNumOperands() != immIndex + 2) {
+    return false;
+  }
+  int rd = getXReg(inst.getOperand(0), MRI);
+  if (rd < 0 or not getImm(inst.getOperand(immIndex), 0, 0xffff, imm) or
+      not getImm(inst.getOperand(immIndex + 1), 0, 48, shift) or
+      shift % 16 != 0) {
+    return false;
+  }
+  encoding = base | ((shift / 16) << 21) | (imm << 5) | rd;
+  return true;
+}
+
+// [Rn]
+bool encodeBranchReg(const llvm::MCInst &inst, const llvm::MCRegisterInfo &MRI,
+                     uint32_t base, uint32_t &encoding) {
+  if (inst.getNumOperands() != 1) {
+    return false;
+  }
+  int rn = getXReg(inst.getOperand(0), MRI);
+  if (rn < 0) {
+    return false;
+  }
+  encoding = base | (rn << 5);
+  return true;
+}
+
+// [Rd, imm21] for ADR (bytes) and ADRP (pages)
+bool encodeAdr(const llvm::MCInst &inst, const llvm::MCRegisterInfo &MRI,
+               uint32_t base, uint32_t &encoding) {
+  int64_t imm;
+  if (inst.getNumOperands() != 2) {
+    return false;
+  }
+  int rd = getXReg(inst.getOperand(0), MRI);
+  if (rd < 0 or
+      not getImm(inst.getOperand(1), -(1 << 20), (1 << 20) - 1, imm)) {
+    return false;
+  }
+  uint32_t uimm = static_cast<uint32_t>(imm);
+  encoding = base | ((uimm & 3) << 29) | (((uimm >> 2) & 0x7ffff) << 5) | rd;
+  return true;
+}
+
+} // anonymous namespace
+
+bool fastEncodeInstruction(const llvm::MCInst &inst,
+                           llvm::SmallVectorImpl<char> &CB,
+                           const llvm::MCRegisterInfo &MRI) {
+  uint32_t encoding = 0;
+  int64_t imm = 0;
+  bool res;
+
+  switch (inst.getOpcode()) {
+    case llvm::AArch64::LDRXui:
+      res = encodeLoadStore(inst, MRI, 0xF9400000, 0, 0xfff, 10, 0xfff,
+                            encoding);
+      break;
+    case llvm::AArch64::STRXui:
+      res = encodeLoadStore(inst, MRI, 0xF9000000, 0, 0xfff, 10, 0xfff,
+                            encoding);
+      break;
+    case llvm::AArch64::LDURXi:
+      res = encodeLoadStore(inst, MRI, 0xF8400000, -256, 255, 12, 0x1ff,
+                            encoding);
+      break;
+    case llvm::AArch64::STURXi:
+      res = encodeLoadStore(inst, MRI, 0xF8000000, -256, 255, 12, 0x1ff,
+                            encoding);
+      break;
+    case llvm::AArch64::LDPXi:
+      res = encodePair(inst, MRI, 0xA9400000, encoding);
+      break;
+    case llvm::AArch64::STPXi:
+      res = encodePair(inst, MRI, 0xA9000000, encoding);
+      break;
+    case llvm::AArch64::ADDXri:
+      res = encodeAddSubImm(inst, MRI, 0x91000000, encoding);
+      break;
+    case llvm::AArch64::SUBXri:
+      res = encodeAddSubImm(inst, MRI, 0xD1000000, encoding);
+      break;
+    case llvm::AArch64::ORRXrs:
+      res = encodeOrrRegShift(inst, MRI, encoding);
+      break;
+    case llvm::AArch64::MOVZXi:
+      res = encodeMoveWide(inst, MRI, 0xD2800000, 1, encoding);
+      break;
+    case llvm::AArch64::MOVKXi:
+      res = encodeMoveWide(inst, MRI, 0xF2800000, 2, encoding);
+      break;
+    case llvm::AArch64::BR:
+      res = encodeBranchReg(inst, MRI, 0xD61F0000, encoding);
+      break;
+    case llvm::AArch64::BLR:
+      res = encodeBranchReg(inst, MRI, 0xD63F0000, encoding);
+      break;
+    case llvm::AArch64::RET:
+      res = encodeBranchReg(inst, MRI, 0xD65F0000, encoding);
+      break;
+    case llvm::AArch64::ADR:
+      res = encodeAdr(inst, MRI, 0x10000000, encoding);
+      break;
+    case llvm::AArch64::ADRP:
+      res = encodeAdr(inst, MRI, 0x90000000, encoding);
+      break;
+    case llvm::AArch64::B:
+      res = inst.getNumOperands() == 1 and
+            getImm(inst.getOperand(0), -(1 << 25), (1 << 25) - 1, imm);
+      encoding = 0x14000000 | (static_cast<uint32_t>(imm) & 0x3ffffff);
+      break;
+    case llvm::AArch64::HINT:
+      res = inst.getNumOperands() == 1 and
+            getImm(inst.getOperand(0), 0, 0x7f, imm);
+      encoding = 0xD503201F | (static_cast<uint32_t>(imm) << 5);
+      break;
+    default:
+      return false;
+  }
+  if (not res) {
+    return false;
+  }
+
+  for (unsigned i = 0; i < 4; i++) {
+    CB.push_back(static_cast<char>((encoding >> (i * 8)) & 0xff));
+  }
+  return true;
+}
+
+} // namespace QBDI
@@ -33,23 +33,17 @@ namespace QBDI {
 
 /* Genreate a series of RelocatableInst which when appended to an
  * instrumentation code trigger a break to host. It receive in argument a
- * temporary reg which will be used for computations then finally restored.
+ * temporary reg which will be restored. The address where the execution is
+ * resumed is registered in the ExecBlock with the RelocTagCallbackResume tag.
  */
 RelocatableInst::UniquePtrVec getBreakToHost(Reg temp, const Patch &patch,
-                                             bool restore) {
-  RelocatableInst::UniquePtrVec breakToHost;
+                                             bool restore,
+                                             CallbackFlags flags) {
+  // The inline call isn't supported on this architecture. The callbacks with
+  // CB_FLAG_INLINE_CALL are called by the VM after a break to the host.
 
-  size_t patchSize = 12;
-  if (restore) {
-    patchSize += 4;
-  }
+  RelocatableInst::UniquePtrVec breakToHost;
 
-  // compute address after JmpEpilogue
-  breakToHost.push_back(Adr(temp, patchSize));
-  // set address in hostState.selector
-  append(breakToHost,
-         SaveReg(temp, Offset(offsetof(Context, hostState.selector)))
-             .genReloc(*patch.llvmcpu));
   if (restore) {
     // Restore the temporary register
     append(breakToHost, LoadReg(temp, Offset(temp)).genReloc(*patch.llvmcpu));
@@ -58,6 +52,7 @@ RelocatableInst::UniquePtrVec getBreakToHost(Reg temp, const Patch &patch,
   append(breakToHost, JmpEpilogue().genReloc(*patch.llvmcpu));
 
   // add target when callback return CONTINUE
+  breakToHost.push_back(RelocTag::unique(RelocTagCallbackResume));
   append(breakToHost, TargetPrologue().genReloc(patch));
 
   return breakToHost;
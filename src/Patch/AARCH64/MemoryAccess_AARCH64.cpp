@@ -51,6 +51,7 @@
 
 #include "QBDI/Bitmask.h"
 #include "QBDI/Callback.h"
+#include "QBDI/Options.h"
 #include "QBDI/State.h"
 
 namespace QBDI {
@@ -1635,8 +1636,20 @@ enum MemoryTag : uint16_t {
   MEM_MOPS_SIZE_TAG = MEMORY_TAG_BEGIN + 5,
 };
 
+// With OPT_DISABLE_MEMORYACCESS_VALUE, only the address of the accesses is
+// recorded.
+inline bool recordValue(const LLVMCPU &llvmcpu) {
+  return (llvmcpu.getOptions() & Options::OPT_DISABLE_MEMORYACCESS_VALUE) == 0;
+}
+
 const PatchGenerator::UniquePtrVec &
 generateReadInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
+  if (not recordValue(llvmcpu)) {
+    static const PatchGenerator::UniquePtrVec r = conv_unique<PatchGenerator>(
+        GetReadAddress::unique(Temp(0)),
+        WriteTemp::unique(Temp(0), Shadow(MEM_READ_ADDRESS_TAG)));
+    return r;
+  }
   switch (getReadSize(patch.metadata.inst, llvmcpu)) {
     case 1:
     case 2:
@@ -1743,6 +1756,11 @@ generatePreWriteInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
 
 const PatchGenerator::UniquePtrVec &
 generatePostWriteInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
+  if (not recordValue(llvmcpu)) {
+    // the address is already recorded before the instruction
+    static const PatchGenerator::UniquePtrVec r;
+    return r;
+  }
   switch (getWriteSize(patch.metadata.inst, llvmcpu)) {
     case 1:
     case 2:
@@ -1968,6 +1986,18 @@ void analyseMemoryAccessAddrValue(const ExecBlock &curExecBlock,
   access.accessAddress = curExecBlock.getShadow(shadows[0].shadowID);
   access.instAddress = curExecBlock.getInstAddress(shadows[0].instID);
 
+  // without the value, only the MOPS instructions have another shadow
+  bool noValue =
+      not recordValue(llvmcpu) and
+      (shadows.size() < 2 or shadows[0].instID != shadows[1].instID or
+       shadows[1].tag != MEM_MOPS_SIZE_TAG);
+  if (noValue) {
+    access.value = 0;
+    access.flags |= MEMORY_UNKNOWN_VALUE;
+    dest.push_back(access);
+    return;
+  }
+
   size_t index = 0;
   // search the index of MEM_x_VALUE_TAG. For most instruction, it's the next
   // shadow.
@@ -455,7 +455,8 @@ std::vector<PatchRule> getDefaultPatchRules(Options opts) {
 } // namespace
 
 PatchRuleAssembly::PatchRuleAssembly(Options opts)
-    : patchRules(getDefaultPatchRules(opts)), options(opts) {}
+    : patchRules(getDefaultPatchRules(opts)), patchRulesIndex(patchRules),
+      options(opts) {}
 
 PatchRuleAssembly::~PatchRuleAssembly() = default;
 
@@ -465,6 +466,7 @@ bool PatchRuleAssembly::changeOptions(Options opts) {
       Options::OPT_DISABLE_LOCAL_MONITOR | Options::OPT_BYPASS_PAUTH;
   if ((opts & needRecreate) != (options & needRecreate)) {
     patchRules = getDefaultPatchRules(opts);
+    patchRulesIndex = PatchRuleIndex(patchRules);
     options = opts;
     return true;
   }
@@ -478,7 +480,8 @@ bool PatchRuleAssembly::generate(const llvm::MCInst &inst, rword address,
 
   Patch instPatch{inst, address, instSize, llvmcpu};
 
-  for (uint32_t j = 0; j < patchRules.size(); j++) {
+  unsigned opcode = instPatch.metadata.inst.getOpcode();
+  for (uint32_t j : patchRulesIndex.getRules(opcode)) {
     if (patchRules[j].canBeApplied(instPatch, llvmcpu)) {
       QBDI_DEBUG("Patch rule {} applied", j);
 
@@ -124,6 +124,15 @@ llvm::MCInst InstId::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
 
 int InstId::getSize(const LLVMCPU &llvmcpu) const { return 4; }
 
+// CallbackId
+// ==========
+
+llvm::MCInst CallbackId::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
+  return movri(reg, execBlock->newCallback(callbacks, flags));
+}
+
+int CallbackId::getSize(const LLVMCPU &llvmcpu) const { return 4; }
+
 // Target Specific RelocatableInst
 
 // SetScratchRegister
@@ -49,10 +49,16 @@ void TempManager::generateSaveRestoreInstructions(
 
   for (unsigned i = 0; i < usedRegisters.size(); i++) {
     Reg r = usedRegisters[i];
-    if (shouldRestore(r)) {
+    if (shouldRestore(r) and isDeadRegister(r)) {
+      // the value of the register is dead, it is neither saved nor restored
+      if (unrestoredReg.size() < unrestoredRegNum) {
+        unrestoredReg.push_back(r);
+      }
+    } else if (shouldRestore(r)) {
       // found a pair register that we may optimised with LDP/STP
       if (i + 1 < usedRegisters.size() and
           shouldRestore(usedRegisters[i + 1]) and
+          not isDeadRegister(usedRegisters[i + 1]) and
           r.getID() + 1 == usedRegisters[i + 1].getID()) {
         saveInst.push_back(
             StoreDataBlockX2::unique(r, usedRegisters[i + 1], Offset(r)));
@@ -181,7 +181,8 @@ RelocatableInst::UniquePtrVec getTerminator(const LLVMCPU &llvmcpu,
 
 // Change ScratchRegister
 RelocatableInst::UniquePtrVec
-changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_) {
+changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_,
+                      bool oldSRDead, bool nextSRDead) {
 
   QBDI_REQUIRE_ABORT(llvmcpu == CPUMode::Thumb,
                      "No scratch Register in ARM mode");
@@ -204,16 +205,24 @@ changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_) {
 
   // save the temporary register
   changeReloc.push_back(NoReloc::unique(t2stri12(tmp, oldSR, tmp.offset())));
-  // load the real value of the old SR
-  changeReloc.push_back(NoReloc::unique(
-      t2ldri12(tmp, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
-  // backup the real value of the next SR
-  changeReloc.push_back(NoReloc::unique(t2stri12(
-      nextSR, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
+  // The value of a dead register doesn't need to be backup or restored
+  // (only with OPT_ENABLE_REGISTER_LIVENESS).
+  if (not oldSRDead) {
+    // load the real value of the old SR
+    changeReloc.push_back(NoReloc::unique(t2ldri12(
+        tmp, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
+  }
+  if (not nextSRDead) {
+    // backup the real value of the next SR
+    changeReloc.push_back(NoReloc::unique(t2stri12(
+        nextSR, oldSR, offsetof(Context, hostState.scratchRegisterValue))));
+  }
   // change the SR
   changeReloc.push_back(NoReloc::unique(tmovr(nextSR, oldSR)));
-  // restore the value of the old SR
-  changeReloc.push_back(NoReloc::unique(tmovr(oldSR, tmp)));
+  if (not oldSRDead) {
+    // restore the value of the old SR
+    changeReloc.push_back(NoReloc::unique(tmovr(oldSR, tmp)));
+  }
   // change the index of the SRregister
   changeReloc.push_back(NoReloc::unique(t2movi(tmp, nextSR.getID())));
   changeReloc.push_back(NoReloc::unique(
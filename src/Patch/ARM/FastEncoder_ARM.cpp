@@ -0,0 +1,32 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "llvm/MC/MCInst.h"
+
+#include "Patch/FastEncoder.h"
+
+namespace QBDI {
+
+// The ARM and Thumb instructions use many encoding forms (conditions, IT
+// blocks, Thumb1 and Thumb2 variants). All of them are encoded by LLVM.
+bool fastEncodeInstruction(const llvm::MCInst &inst,
+                           llvm::SmallVectorImpl<char> &CB,
+                           const llvm::MCRegisterInfo &MRI) {
+  return false;
+}
+
+} // namespace QBDI
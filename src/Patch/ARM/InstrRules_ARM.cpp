@@ -33,39 +33,27 @@ namespace QBDI {
 
 /* Genreate a series of RelocatableInst which when appended to an
  * instrumentation code trigger a break to host. It receive in argument a
- * temporary reg which will be used for computations then finally restored.
+ * temporary reg which will be restored. The address where the execution is
+ * resumed is registered in the ExecBlock with the RelocTagCallbackResume tag.
  */
 RelocatableInst::UniquePtrVec getBreakToHost(Reg temp, const Patch &patch,
-                                             bool restore) {
+                                             bool restore,
+                                             CallbackFlags flags) {
+  // The inline call isn't supported on this architecture. The callbacks with
+  // CB_FLAG_INLINE_CALL are called by the VM after a break to the host.
 
   QBDI_REQUIRE_ABORT_PATCH(restore, patch,
                            "ARM don't have a temporary register");
 
-  // compute offset address
-  unsigned int patchSize = RelativeAddress(temp, 0xff).getSize(*patch.llvmcpu);
-
-  RelocatableInst::UniquePtrVec tmpVec;
-  append(tmpVec, SaveReg(temp, Offset(offsetof(Context, hostState.selector)))
-                     .genReloc(*patch.llvmcpu));
-  append(tmpVec, LoadReg(temp, Offset(temp)).genReloc(*patch.llvmcpu));
-  append(tmpVec, JmpEpilogue().genReloc(*patch.llvmcpu));
-
-  patchSize += getUniquePtrVecSize(tmpVec, *patch.llvmcpu);
-  if (patch.metadata.cpuMode == CPUMode::Thumb) {
-    patchSize += 1;
-  }
-
   RelocatableInst::UniquePtrVec breakToHost;
 
-  // set temp to the address after JmpEpilogue
-  breakToHost.push_back(RelativeAddress::unique(temp, patchSize));
-
-  // set address in hostState.selector
   // Restore the temporary register
+  append(breakToHost, LoadReg(temp, Offset(temp)).genReloc(*patch.llvmcpu));
   // JumpEpilogue
-  append(breakToHost, std::move(tmpVec));
+  append(breakToHost, JmpEpilogue().genReloc(*patch.llvmcpu));
 
   // add target when callback return CONTINUE
+  breakToHost.push_back(RelocTag::unique(RelocTagCallbackResume));
   append(breakToHost, TargetPrologue().genReloc(patch));
 
   return breakToHost;
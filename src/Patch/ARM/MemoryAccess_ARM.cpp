@@ -41,6 +41,7 @@
 
 #include "QBDI/Bitmask.h"
 #include "QBDI/Callback.h"
+#include "QBDI/Options.h"
 #include "QBDI/State.h"
 
 namespace QBDI {
@@ -1733,8 +1734,22 @@ enum MemoryTag : uint16_t {
   MEM_VALUE_EXTENDED_TAG = MEMORY_TAG_BEGIN + 5,
 };
 
+// With OPT_DISABLE_MEMORYACCESS_VALUE, only the address of the accesses is
+// recorded.
+inline bool recordValue(const LLVMCPU &llvmcpu) {
+  return (llvmcpu.getOptions() & Options::OPT_DISABLE_MEMORYACCESS_VALUE) == 0;
+}
+
 const PatchGenerator::UniquePtrVec &
 generateReadInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
+  if (not recordValue(llvmcpu)) {
+    static const PatchGenerator::UniquePtrVec r = conv_unique<PatchGenerator>(
+        GetReadAddress::unique(Temp(0)),
+        WriteTemp::unique(Temp(0), Shadow(MEM_READ_ADDRESS_TAG)),
+        SetCondReachAndJump::unique(Temp(0), Shadow(MEN_COND_REACH_TAG),
+                                    PatchGenerator::UniquePtrVec()));
+    return r;
+  }
   switch (getReadSize(patch.metadata.inst, llvmcpu)) {
     case 1:
     case 2:
@@ -2144,6 +2159,13 @@ generatePreWriteInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
 
 const PatchGenerator::UniquePtrVec &
 generatePostWriteInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
+  if (not recordValue(llvmcpu)) {
+    // the address is already recorded before the instruction
+    static const PatchGenerator::UniquePtrVec r = conv_unique<PatchGenerator>(
+        SetCondReachAndJump::unique(Temp(0), Shadow(MEN_COND_REACH_TAG),
+                                    PatchGenerator::UniquePtrVec()));
+    return r;
+  }
   switch (getWriteSize(patch.metadata.inst, llvmcpu)) {
     case 1:
     case 2:
@@ -2578,7 +2600,7 @@ void analyseMemoryAccessAddrValue(const ExecBlock &curExecBlock,
   access.accessAddress = curExecBlock.getShadow(shadows[0].shadowID);
   access.instAddress = curExecBlock.getInstAddress(shadows[0].instID);
 
-  if (access.size > 64) {
+  if (access.size > 64 or not recordValue(llvmcpu)) {
     access.value = 0;
     access.flags |= MEMORY_UNKNOWN_VALUE;
     // search if the shadow MEN_COND_REACH_TAG is present
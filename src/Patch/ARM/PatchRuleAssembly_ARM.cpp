@@ -1262,8 +1262,9 @@ std::vector<PatchRule> getThumbPatchRules(Options opts) {
 
 PatchRuleAssembly::PatchRuleAssembly(Options opts)
     : patchRulesARM(getARMPatchRules(opts)),
-      patchRulesThumb(getThumbPatchRules(opts)), options(opts),
-      itRemainingInst(0), itCond({0}) {}
+      patchRulesThumb(getThumbPatchRules(opts)),
+      patchRulesARMIndex(patchRulesARM), patchRulesThumbIndex(patchRulesThumb),
+      options(opts), itRemainingInst(0), itCond({0}) {}
 
 PatchRuleAssembly::~PatchRuleAssembly() = default;
 
@@ -1281,6 +1282,8 @@ bool PatchRuleAssembly::changeOptions(Options opts) {
     reset();
     patchRulesARM = getARMPatchRules(opts);
     patchRulesThumb = getThumbPatchRules(opts);
+    patchRulesARMIndex = PatchRuleIndex(patchRulesARM);
+    patchRulesThumbIndex = PatchRuleIndex(patchRulesThumb);
     options = opts;
     return true;
   }
@@ -1385,7 +1388,8 @@ bool PatchRuleAssembly::generateARM(const llvm::MCInst &inst, rword address,
       break;
   }
 
-  for (uint32_t j = 0; j < patchRulesARM.size(); j++) {
+  unsigned opcode = instPatch.metadata.inst.getOpcode();
+  for (uint32_t j : patchRulesARMIndex.getRules(opcode)) {
     if (patchRulesARM[j].canBeApplied(instPatch, llvmcpu)) {
       QBDI_DEBUG("Patch ARM rule {} applied", j);
 
@@ -1484,7 +1488,8 @@ bool PatchRuleAssembly::generateThumb(const llvm::MCInst &inst, rword address,
     itCond = {itCond[1], itCond[2], itCond[3], 0};
   }
 
-  for (uint32_t j = 0; j < patchRulesThumb.size(); j++) {
+  unsigned opcode = instPatch.metadata.inst.getOpcode();
+  for (uint32_t j : patchRulesThumbIndex.getRules(opcode)) {
     if (patchRulesThumb[j].canBeApplied(instPatch, llvmcpu)) {
       QBDI_DEBUG("Patch Thumb rule {} applied", j);
 
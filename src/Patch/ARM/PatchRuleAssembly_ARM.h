@@ -19,14 +19,16 @@
 #define PATCHRULEASSEMBLY_ARM_H
 
 #include <array>
+#include "Patch/PatchRule.h"
 #include "Patch/PatchRuleAssemblyBase.h"
 
 namespace QBDI {
-class PatchRule;
 
 class PatchRuleAssembly final : public PatchRuleAssemblyBase {
   std::vector<PatchRule> patchRulesARM;
   std::vector<PatchRule> patchRulesThumb;
+  PatchRuleIndex patchRulesARMIndex;
+  PatchRuleIndex patchRulesThumbIndex;
   Options options;
   unsigned itRemainingInst;
   std::array<uint8_t, 4> itCond;
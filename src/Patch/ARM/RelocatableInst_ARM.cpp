@@ -135,6 +135,18 @@ int InstId::getSize(const LLVMCPU &llvmcpu) const {
   return LoadImm(reg, 0xffff).getSize(llvmcpu);
 }
 
+// CallbackId
+// ==========
+
+llvm::MCInst CallbackId::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
+  uint16_t v = execBlock->newCallback(callbacks, flags);
+  return LoadImm(reg, v).reloc(execBlock, cpumode);
+}
+
+int CallbackId::getSize(const LLVMCPU &llvmcpu) const {
+  return LoadImm(reg, 0xffff).getSize(llvmcpu);
+}
+
 // Target Specific RelocatableInst
 
 // LoadShadowCC
@@ -0,0 +1,46 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FASTENCODER_H
+#define FASTENCODER_H
+
+#include "llvm/ADT/SmallVector.h"
+
+namespace llvm {
+class MCInst;
+class MCRegisterInfo;
+} // namespace llvm
+
+namespace QBDI {
+
+/*! Encode the most common instructions generated by the PatchGenerator and
+ * the RelocatableInst without the LLVM MCCodeEmitter.
+ *
+ * @param[in]  inst  The instruction to encode
+ * @param[out] CB    The buffer where the instruction is appended
+ * @param[in]  MRI   The register info of the target
+ *
+ * @return False if the instruction isn't supported. In this case, CB is left
+ *         unchanged and the instruction must be encoded by LLVM.
+ */
+bool fastEncodeInstruction(const llvm::MCInst &inst,
+                           llvm::SmallVectorImpl<char> &CB,
+                           const llvm::MCRegisterInfo &MRI);
+
+} // namespace QBDI
+
+#endif // FASTENCODER_H
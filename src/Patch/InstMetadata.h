@@ -43,21 +43,22 @@ public:
   CPUMode cpuMode;
   bool modifyPC;
   uint8_t execblockFlags;
-  mutable InstAnalysisPtr analysis;
+  mutable InstAnalysis *analysis;
+  mutable uint32_t analysisGeneration;
   InstMetadataArch archMetadata;
 
   InstMetadata(const llvm::MCInst &inst, rword address, uint32_t instSize,
                uint32_t patchSize, CPUMode cpuMode, bool modifyPC,
-               uint8_t execblockFlags, InstAnalysisPtr analysis)
+               uint8_t execblockFlags, InstAnalysis *analysis)
       : inst(inst), address(address), instSize(instSize), patchSize(patchSize),
         cpuMode(cpuMode), modifyPC(modifyPC), execblockFlags(execblockFlags),
-        analysis(std::move(analysis)) {}
+        analysis(analysis), analysisGeneration(0) {}
 
   InstMetadata(const llvm::MCInst &inst, rword address, uint32_t instSize,
                CPUMode cpuMode, uint8_t execblockFlags)
       : inst(inst), address(address), instSize(instSize), patchSize(0),
         cpuMode(cpuMode), modifyPC(false), execblockFlags(execblockFlags),
-        analysis(nullptr) {}
+        analysis(nullptr), analysisGeneration(0) {}
 
   inline rword endAddress() const { return address + instSize; }
 
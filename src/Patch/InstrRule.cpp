@@ -15,6 +15,9 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <iterator>
+#include <set>
 #include <stdint.h>
 #include <stdlib.h>
 #include <utility>
@@ -34,20 +37,16 @@
 
 namespace QBDI {
 
-// InstrRule
-// =========
+// generateInstrumentation
+// =======================
 
-void InstrRule::instrument(Patch &patch,
-                           const PatchGenerator::UniquePtrVec &patchGen,
-                           bool breakToHost, InstPosition position,
-                           int priority, RelocatableInstTag tag) const {
-
-  if (patchGen.size() == 0 && breakToHost == false) {
-    QBDI_DEBUG("Empty patch Generator");
-    return;
-  }
+RelocatableInst::UniquePtrVec
+generateInstrumentation(Patch &patch,
+                        const PatchGenerator::UniquePtrVec &patchGen,
+                        bool breakToHost, InstPosition position,
+                        RelocatableInstTag tag, CallbackFlags flags) {
 
-  /* The instrument function needs to handle several different cases. An
+  /* This function needs to handle several different cases. An
    * instrumentation can be either prepended or appended to the patch and, in
    * each case, can trigger a break to host.
    */
@@ -111,7 +110,8 @@ void InstrRule::instrument(Patch &patch,
     prepend(instru, std::move(saveReg));
     append(instru, std::move(restoreReg));
     append(instru, getBreakToHost(unrestoredReg[0], patch,
-                                  tempManager.shouldRestore(unrestoredReg[0])));
+                                  tempManager.shouldRestore(unrestoredReg[0]),
+                                  flags));
   }
   // Normal case where we append the temporary register restoration code to the
   // instrumentation
@@ -122,9 +122,36 @@ void InstrRule::instrument(Patch &patch,
     append(instru, std::move(restoreReg));
   }
 
+  // Delimit the code of the callbacks. The ExecBlock replaces it with a jump
+  // to the end of the site when the callbacks are disabled or when a one-shot
+  // callback is called.
+  if (breakToHost) {
+    instru.insert(instru.begin(), RelocTag::unique(RelocTagCallbackSite));
+    instru.push_back(RelocTag::unique(RelocTagCallbackSiteEnd));
+  }
+
   // add Tag
   instru.insert(instru.begin(), RelocTag::unique(tag));
 
+  return instru;
+}
+
+// InstrRule
+// =========
+
+void InstrRule::instrument(Patch &patch,
+                           const PatchGenerator::UniquePtrVec &patchGen,
+                           bool breakToHost, InstPosition position,
+                           int priority, RelocatableInstTag tag) const {
+
+  if (patchGen.size() == 0 && breakToHost == false) {
+    QBDI_DEBUG("Empty patch Generator");
+    return;
+  }
+
+  RelocatableInst::UniquePtrVec instru =
+      generateInstrumentation(patch, patchGen, breakToHost, position, tag);
+
   QBDI_DEBUG(
       "Insert {} PatchGen with priority {}, position {} ({}) and tag 0x{:x}",
       instru.size(), priority,
@@ -138,22 +165,44 @@ void InstrRule::instrument(Patch &patch,
   patch.addInstsPatch(position, priority, std::move(instru));
 }
 
+void InstrRule::instrumentCallback(Patch &patch, InstCallback cbk, void *data,
+                                   InstPosition position, int priority,
+                                   RelocatableInstTag tag,
+                                   CallbackFlags flags) const {
+
+  QBDI_DEBUG("Insert callback 0x{:x} with priority {}, position {} ({}), "
+             "tag 0x{:x} and flags 0x{:x}",
+             reinterpret_cast<rword>(cbk), priority,
+             (position == PREINST) ? "PREINST"
+                                   : ((position == POSTINST) ? "POSTINST" : ""),
+             position, tag, flags);
+
+  // The callbacks are added in a pending list. The consecutive callbacks with
+  // the same position are merged in a single break to host when the pending
+  // list is flush in the Patch
+  patch.addInstsCallback(position, priority, tag, cbk, data, flags);
+}
+
 // InstrRuleBasicCBK
 // =================
 
 InstrRuleBasicCBK::InstrRuleBasicCBK(PatchConditionUniquePtr &&condition,
                                      InstCallback cbk, void *data,
                                      InstPosition position, bool breakToHost,
-                                     int priority, RelocatableInstTag tag)
+                                     int priority, RelocatableInstTag tag,
+                                     CallbackFlags flags)
     : AutoUnique<InstrRule, InstrRuleBasicCBK>(priority),
       condition(std::forward<PatchConditionUniquePtr>(condition)),
       patchGen(getCallbackGenerator(cbk, data)), position(position),
-      breakToHost(breakToHost), tag(tag), cbk(cbk), data(data) {}
+      breakToHost(breakToHost), tag(tag), cbk(cbk), data(data), flags(flags) {}
 
 InstrRuleBasicCBK::~InstrRuleBasicCBK() = default;
 
 bool InstrRuleBasicCBK::canBeApplied(const Patch &patch,
                                      const LLVMCPU &llvmcpu) const {
+  if (oneShotFired.count(patch.metadata.address) != 0) {
+    return false;
+  }
   return condition->test(patch, llvmcpu);
 }
 
@@ -163,9 +212,23 @@ bool InstrRuleBasicCBK::changeDataPtr(void *new_data) {
   return true;
 }
 
+bool InstrRuleBasicCBK::matchOpcodes(std::set<unsigned> &opcodes,
+                                     const LLVMCPU &llvmcpu) const {
+  return condition->matchOpcodes(opcodes, &llvmcpu);
+}
+
+void InstrRuleBasicCBK::setOneShotFired(rword address) {
+  if ((flags & CB_FLAG_ONE_SHOT) != 0) {
+    oneShotFired.insert(address);
+  }
+}
+
 std::unique_ptr<InstrRule> InstrRuleBasicCBK::clone() const {
-  return InstrRuleBasicCBK::unique(condition->clone(), cbk, data, position,
-                                   breakToHost, priority);
+  auto rule = std::make_unique<InstrRuleBasicCBK>(
+      condition->clone(), cbk, data, position, breakToHost, priority, tag,
+      flags);
+  rule->oneShotFired = oneShotFired;
+  return copyState(std::move(rule));
 };
 
 RangeSet<rword> InstrRuleBasicCBK::affectedRange() const {
@@ -191,9 +254,15 @@ bool InstrRuleDynamic::canBeApplied(const Patch &patch,
   return condition->test(patch, llvmcpu);
 }
 
+bool InstrRuleDynamic::matchOpcodes(std::set<unsigned> &opcodes,
+                                    const LLVMCPU &llvmcpu) const {
+  return condition->matchOpcodes(opcodes, &llvmcpu);
+}
+
 std::unique_ptr<InstrRule> InstrRuleDynamic::clone() const {
-  return InstrRuleDynamic::unique(condition->clone(), patchGenMethod, position,
-                                  breakToHost, priority);
+  return copyState(InstrRuleDynamic::unique(condition->clone(), patchGenMethod,
+                                            position, breakToHost, priority,
+                                            tag));
 };
 
 RangeSet<rword> InstrRuleDynamic::affectedRange() const {
@@ -235,23 +304,104 @@ bool InstrRuleUser::tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const {
 
   for (const InstrRuleDataCBK &cbkToAdd : vec) {
     if (cbkToAdd.lambdaCbk == nullptr) {
-      instrument(patch, getCallbackGenerator(cbkToAdd.cbk, cbkToAdd.data), true,
-                 cbkToAdd.position, cbkToAdd.priority,
-                 (cbkToAdd.position == PREINST) ? RelocTagPreInstStdCBK
-                                                : RelocTagPostInstStdCBK);
+      instrumentCallback(patch, cbkToAdd.cbk, cbkToAdd.data, cbkToAdd.position,
+                         cbkToAdd.priority,
+                         (cbkToAdd.position == PREINST)
+                             ? RelocTagPreInstStdCBK
+                             : RelocTagPostInstStdCBK);
     } else {
       patch.userInstCB.emplace_back(
           std::make_unique<InstCbLambda>(cbkToAdd.lambdaCbk));
-      instrument(patch,
-                 getCallbackGenerator(InstCBLambdaProxy,
-                                      patch.userInstCB.back().get()),
-                 true, cbkToAdd.position, cbkToAdd.priority,
-                 (cbkToAdd.position == PREINST) ? RelocTagPreInstStdCBK
-                                                : RelocTagPostInstStdCBK);
+      instrumentCallback(patch, InstCBLambdaProxy,
+                         patch.userInstCB.back().get(), cbkToAdd.position,
+                         cbkToAdd.priority,
+                         (cbkToAdd.position == PREINST)
+                             ? RelocTagPreInstStdCBK
+                             : RelocTagPostInstStdCBK);
     }
   }
 
   return true;
 }
 
+// InstrRuleIndex
+// ==============
+
+InstrRuleIndex::InstrRuleIndex(
+    const std::vector<std::pair<uint32_t, std::unique_ptr<InstrRule>>> &rules,
+    const LLVMCPU &llvmcpu) {
+
+  const Range<rword> fullRange(0, (rword)-1);
+  std::vector<std::pair<uint32_t, RangeSet<rword>>> restrictedRules;
+
+  for (uint32_t i = 0; i < rules.size(); i++) {
+    const InstrRule &rule = *rules[i].second;
+
+    RangeSet<rword> range = rule.affectedRange();
+    if (not range.contains(fullRange)) {
+      // the rule is only applied in some addresses
+      restrictedRules.emplace_back(i, std::move(range));
+      continue;
+    }
+
+    std::set<unsigned> opcodes;
+    if (rule.matchOpcodes(opcodes, llvmcpu)) {
+      for (unsigned opcode : opcodes) {
+        auto it = opcodeRules.find(opcode);
+        if (it == opcodeRules.end()) {
+          // the rules before this one that can match any opcode
+          it = opcodeRules.emplace(opcode, genericRules).first;
+        }
+        it->second.push_back(i);
+      }
+    } else {
+      genericRules.push_back(i);
+      for (auto &r : opcodeRules) {
+        r.second.push_back(i);
+      }
+    }
+  }
+
+  // split the address space in segments where the same rules apply
+  for (const auto &r : restrictedRules) {
+    for (const Range<rword> &range : r.second.getRanges()) {
+      addressRules.emplace(range.start(), std::vector<uint32_t>());
+      addressRules.emplace(range.end(), std::vector<uint32_t>());
+    }
+  }
+  for (const auto &r : restrictedRules) {
+    for (const Range<rword> &range : r.second.getRanges()) {
+      for (auto it = addressRules.find(range.start());
+           it != addressRules.end() and it->first < range.end(); ++it) {
+        it->second.push_back(r.first);
+      }
+    }
+  }
+
+  QBDI_DEBUG("Index {} InstrRules ({} generic, {} opcodes, {} segments)",
+             rules.size(), genericRules.size(), opcodeRules.size(),
+             addressRules.size());
+}
+
+void InstrRuleIndex::getRules(rword address, unsigned opcode,
+                              std::vector<uint32_t> &rules) const {
+  rules.clear();
+
+  auto opcodeIt = opcodeRules.find(opcode);
+  const std::vector<uint32_t> &opRules =
+      (opcodeIt == opcodeRules.end()) ? genericRules : opcodeIt->second;
+
+  auto addressIt = addressRules.upper_bound(address);
+  if (addressIt == addressRules.begin() or
+      std::prev(addressIt)->second.empty()) {
+    rules.insert(rules.end(), opRules.begin(), opRules.end());
+    return;
+  }
+  const std::vector<uint32_t> &addrRules = std::prev(addressIt)->second;
+
+  // both lists are sorted and disjoint
+  std::merge(opRules.begin(), opRules.end(), addrRules.begin(),
+             addrRules.end(), std::back_inserter(rules));
+}
+
 } // namespace QBDI
@@ -19,7 +19,11 @@
 #define INSTRRULE_H
 
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Patch/PatchUtils.h"
@@ -49,8 +53,19 @@ protected:
   // The rule with the lesser priority will be applied first
   int priority;
 
+  // the callbacks of a disabled rule are skipped by the ExecBlock
+  bool enabled;
+
+  // copy the state of this rule in a clone
+  inline std::unique_ptr<InstrRule>
+  copyState(std::unique_ptr<InstrRule> &&rule) const {
+    rule->enabled = enabled;
+    return std::move(rule);
+  }
+
 public:
-  InstrRule(int priority = PRIORITY_DEFAULT) : priority(priority) {}
+  InstrRule(int priority = PRIORITY_DEFAULT)
+      : priority(priority), enabled(true) {}
 
   virtual ~InstrRule() = default;
 
@@ -63,10 +78,33 @@ public:
 
   inline void setPriority(int priority) { this->priority = priority; };
 
+  inline bool isEnabled() const { return enabled; };
+
+  inline void setEnabled(bool enabled) { this->enabled = enabled; };
+
   inline virtual void changeVMInstanceRef(VMInstanceRef vminstance){};
 
   inline virtual bool changeDataPtr(void *data) { return false; };
 
+  /*! Record that the one-shot callbacks of this rule have been called on an
+   * instruction. The rule isn't applied on this instruction anymore.
+   *
+   * @param[in] address  The address of the instruction
+   */
+  inline virtual void setOneShotFired(rword address){};
+
+  /*! Get the opcodes that this rule can be applied on.
+   *
+   * @param[out] opcodes  Set where the opcodes are added
+   * @param[in]  llvmcpu  LLVMCPU object
+   *
+   * @return False if the rule may be applied on any opcode
+   */
+  inline virtual bool matchOpcodes(std::set<unsigned> &opcodes,
+                                   const LLVMCPU &llvmcpu) const {
+    return false;
+  };
+
   /*! Determine wheter this rule have to be apply on this Path and instrument if
    * needed.
    *
@@ -88,6 +126,22 @@ public:
   void instrument(Patch &patch, const PatchGeneratorUniquePtrVec &patchGen,
                   bool breakToHost, InstPosition position, int priority,
                   RelocatableInstTag tag) const;
+
+  /*! Instrument a patch with a callback. The consecutive callbacks with the
+   * same position are called with a single break to host.
+   *
+   * @param[in] patch       The current patch to instrument.
+   * @param[in] cbk         The callback to call
+   * @param[in] data        The data pointer to give to the callback
+   * @param[in] position    Add the callback before or after the instruction
+   * @param[in] priority    The priority of this callback
+   * @param[in] tag         The tag for this callback
+   * @param[in] flags       The options of this callback
+   */
+  void instrumentCallback(Patch &patch, InstCallback cbk, void *data,
+                          InstPosition position, int priority,
+                          RelocatableInstTag tag,
+                          CallbackFlags flags = CB_FLAG_NONE) const;
 };
 
 class InstrRuleBasicCBK : public AutoUnique<InstrRule, InstrRuleBasicCBK> {
@@ -99,6 +153,9 @@ class InstrRuleBasicCBK : public AutoUnique<InstrRule, InstrRuleBasicCBK> {
   RelocatableInstTag tag;
   InstCallback cbk;
   void *data;
+  CallbackFlags flags;
+  // instructions where the callback has been called, with CB_FLAG_ONE_SHOT
+  std::set<rword> oneShotFired;
 
 public:
   /*! Allocate a new instrumentation rule with a condition, a list of
@@ -116,11 +173,13 @@ public:
    *                         callback for example).
    * @param[in] priority     Priority of the callback
    * @param[in] tag          A tag for the callback
+   * @param[in] flags        The options of the callback
    */
   InstrRuleBasicCBK(PatchConditionUniquePtr &&condition, InstCallback cbk,
                     void *data, InstPosition position, bool breakToHost,
                     int priority = PRIORITY_DEFAULT,
-                    RelocatableInstTag tag = RelocTagInvalid);
+                    RelocatableInstTag tag = RelocTagInvalid,
+                    CallbackFlags flags = CB_FLAG_NONE);
 
   ~InstrRuleBasicCBK() override;
 
@@ -143,10 +202,19 @@ public:
 
   bool changeDataPtr(void *data) override;
 
+  bool matchOpcodes(std::set<unsigned> &opcodes,
+                    const LLVMCPU &llvmcpu) const override;
+
+  void setOneShotFired(rword address) override;
+
   inline bool tryInstrument(Patch &patch,
                             const LLVMCPU &llvmcpu) const override {
     if (canBeApplied(patch, llvmcpu)) {
-      instrument(patch, patchGen, breakToHost, position, priority, tag);
+      if (breakToHost) {
+        instrumentCallback(patch, cbk, data, position, priority, tag, flags);
+      } else {
+        instrument(patch, patchGen, breakToHost, position, priority, tag);
+      }
       return true;
     }
     return false;
@@ -205,6 +273,9 @@ public:
    */
   bool canBeApplied(const Patch &patch, const LLVMCPU &llvmcpu) const;
 
+  bool matchOpcodes(std::set<unsigned> &opcodes,
+                    const LLVMCPU &llvmcpu) const override;
+
   inline bool tryInstrument(Patch &patch,
                             const LLVMCPU &llvmcpu) const override {
     if (canBeApplied(patch, llvmcpu)) {
@@ -245,6 +316,43 @@ public:
   bool tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const override;
 };
 
+/*! Index of the instrumentation rules of an Engine. The rules restricted to
+ * some addresses are stored in an interval map, the rules restricted to some
+ * opcodes in a map by opcode. Only the rules that may be applied on an
+ * instruction are returned, in the order of the original list.
+ */
+class InstrRuleIndex {
+  // rules that can be applied on any instruction
+  std::vector<uint32_t> genericRules;
+  // for each opcode, the rules restricted to this opcode and the generic rules
+  std::unordered_map<unsigned, std::vector<uint32_t>> opcodeRules;
+  // Begin of each segment of the address space and the address-restricted
+  // rules that can be applied in the segment. A segment ends at the begin of
+  // the next one.
+  std::map<rword, std::vector<uint32_t>> addressRules;
+
+public:
+  InstrRuleIndex() = default;
+
+  /*! Build the index of a list of rules
+   *
+   * @param[in] rules    The rules to index
+   * @param[in] llvmcpu  LLVMCPU object used to resolve the mnemonics
+   */
+  InstrRuleIndex(
+      const std::vector<std::pair<uint32_t, std::unique_ptr<InstrRule>>> &rules,
+      const LLVMCPU &llvmcpu);
+
+  /*! Get the index of the rules that may be applied on an instruction.
+   *
+   * @param[in]  address  The address of the instruction
+   * @param[in]  opcode   The opcode of the instruction
+   * @param[out] rules    The index of the rules, in ascending order
+   */
+  void getRules(rword address, unsigned opcode,
+                std::vector<uint32_t> &rules) const;
+};
+
 } // namespace QBDI
 
 #endif
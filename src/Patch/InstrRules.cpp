@@ -16,6 +16,8 @@
  * limitations under the License.
  */
 #include <stddef.h>
+#include <utility>
+#include <vector>
 
 #include "QBDI/State.h"
 #include "ExecBlock/Context.h"
@@ -25,7 +27,9 @@
 namespace QBDI {
 
 /*! Output a list of PatchGenerator which would set up the host state part of
- * the context for a callback.
+ * the context for a callback. The callback, its data and the instruction are
+ * registered in the ExecBlock, only the id of the callback is written in the
+ * host state by the instrumented code.
  *
  * @param[in] cbk   The callback function to call.
  * @param[in] data  The data to pass as an argument to the callback function.
@@ -35,22 +39,28 @@ namespace QBDI {
  */
 PatchGenerator::UniquePtrVec getCallbackGenerator(InstCallback cbk,
                                                   void *data) {
+  return getCallbackListGenerator({{cbk, data}});
+}
+
+/*! Output a list of PatchGenerator which would set up the host state part of
+ * the context for a list of callbacks called with a single break to host.
+ *
+ * @param[in] callbacks  The callbacks functions to call with their data.
+ * @param[in] flags      The options of the callbacks.
+ *
+ * @return A list of PatchGenerator to set up this callbacks call.
+ *
+ */
+PatchGenerator::UniquePtrVec
+getCallbackListGenerator(std::vector<CallbackData> callbacks,
+                         CallbackFlags flags) {
   PatchGenerator::UniquePtrVec callbackGenerator;
 
-  // Write callback address in host state
+  // Write the id of the callbacks in host state
   callbackGenerator.push_back(
-      GetConstant::unique(Temp(0), Constant((rword)cbk)));
+      GetCallbackId::unique(Temp(0), std::move(callbacks), flags));
   callbackGenerator.push_back(WriteTemp::unique(
       Temp(0), Offset(offsetof(Context, hostState.callback))));
-  // Write callback data pointer in host state
-  callbackGenerator.push_back(
-      GetConstant::unique(Temp(0), Constant((rword)data)));
-  callbackGenerator.push_back(
-      WriteTemp::unique(Temp(0), Offset(offsetof(Context, hostState.data))));
-  // Write internal instruction id of a callback
-  callbackGenerator.push_back(GetInstId::unique(Temp(0)));
-  callbackGenerator.push_back(
-      WriteTemp::unique(Temp(0), Offset(offsetof(Context, hostState.origin))));
 
   return callbackGenerator;
 }
@@ -41,8 +41,45 @@ class RelocatableInst;
 std::vector<std::unique_ptr<PatchGenerator>>
 getCallbackGenerator(InstCallback cbk, void *data);
 
+/*
+ * Setup a list of user callbacks in the host state. The callbacks are called
+ * in the order of the list with a single break to host.
+ *
+ * @param[in] callbacks  The callbacks and their data
+ * @param[in] flags      The options of the callbacks
+ */
+std::vector<std::unique_ptr<PatchGenerator>>
+getCallbackListGenerator(std::vector<CallbackData> callbacks,
+                         CallbackFlags flags = CB_FLAG_NONE);
+
+/*
+ * Break to the host. With CB_FLAG_INLINE_CALL, the callbacks are called by the
+ * inline call stub of the ExecBlock when the architecture supports it.
+ *
+ * @param[in] temp     The temporary register used by the callback setup
+ * @param[in] patch    The current patch
+ * @param[in] restore  Restore the temporary register before the break
+ * @param[in] flags    The options of the callbacks
+ */
 std::vector<std::unique_ptr<RelocatableInst>>
-getBreakToHost(Reg temp, const Patch &patch, bool restore);
+getBreakToHost(Reg temp, const Patch &patch, bool restore,
+               CallbackFlags flags = CB_FLAG_NONE);
+
+/*
+ * Generate the instrumentation of a patch from a list of PatchGenerator.
+ * Handles the temporary registers management and the break to host.
+ *
+ * @param[in] patch        The current patch to instrument
+ * @param[in] patchGen     The list of PatchGenerator to apply
+ * @param[in] breakToHost  Add a break to host after the instrumentation
+ * @param[in] position     The position of the instrumentation
+ * @param[in] tag          The tag of the instrumentation
+ * @param[in] flags        The options of the callbacks of the break to host
+ */
+std::vector<std::unique_ptr<RelocatableInst>> generateInstrumentation(
+    Patch &patch, const std::vector<std::unique_ptr<PatchGenerator>> &patchGen,
+    bool breakToHost, InstPosition position, RelocatableInstTag tag,
+    CallbackFlags flags = CB_FLAG_NONE);
 } // namespace QBDI
 
 #endif
@@ -21,6 +21,7 @@
 
 #include "Engine/LLVMCPU.h"
 #include "Patch/ExecBlockFlags.h"
+#include "Patch/InstrRules.h"
 #include "Patch/Patch.h"
 #include "Patch/PatchGenerator.h"
 #include "Patch/Register.h"
@@ -36,7 +37,8 @@ Patch::Patch(const llvm::MCInst &inst, rword address, uint32_t instSize,
              const LLVMCPU &llvmcpu)
     : metadata(inst, address, instSize, llvmcpu.getCPUMode(),
                getExecBlockFlags(inst, llvmcpu)),
-      regUsage({RegisterUnused}), llvmcpu(&llvmcpu), finalize(false) {
+      regUsage({RegisterUnused}), deadGPR(0), llvmcpu(&llvmcpu),
+      finalize(false) {
   metadata.patchSize = 0;
 
   getUsedGPR(metadata.inst, llvmcpu, regUsage, regUsageExtra);
@@ -48,6 +50,21 @@ Patch::Patch(Patch &&) = default;
 
 Patch &Patch::operator=(Patch &&) = default;
 
+Patch::Patch(const Patch &other)
+    : metadata(other.metadata.lightCopy()), insts(cloneVec(other.insts)),
+      patchGenFlags(other.patchGenFlags),
+      patchGenFlagsOffset(other.patchGenFlagsOffset),
+      regUsage(other.regUsage), regUsageExtra(other.regUsageExtra),
+      deadGPR(other.deadGPR), tempReg(other.tempReg), llvmcpu(other.llvmcpu),
+      finalize(other.finalize), ruleID(other.ruleID),
+      ruleEnabled(other.ruleEnabled) {}
+
+Patch Patch::clone() const {
+  QBDI_REQUIRE_ABORT(instsPatchs.empty() and userInstCB.empty(),
+                     "Cannot clone an instrumented Patch");
+  return Patch(*this);
+}
+
 void Patch::setModifyPC(bool modifyPC) { metadata.modifyPC = modifyPC; }
 
 void Patch::append(RelocatableInst::UniquePtr &&r) {
@@ -95,12 +112,9 @@ void Patch::insertAt(unsigned position, RelocatableInst::UniquePtrVec v) {
   }
 }
 
-void Patch::addInstsPatch(InstPosition position, int priority,
-                          std::vector<std::unique_ptr<RelocatableInst>> v) {
+void Patch::insertInstrPatch(InstrPatch &&el) {
   QBDI_REQUIRE(not finalize);
 
-  InstrPatch el{position, priority, std::move(v)};
-
   auto it = std::upper_bound(instsPatchs.begin(), instsPatchs.end(), el,
                              [](const InstrPatch &a, const InstrPatch &b) {
                                return a.priority > b.priority;
@@ -108,8 +122,55 @@ void Patch::addInstsPatch(InstPosition position, int priority,
   instsPatchs.insert(it, std::move(el));
 }
 
+void Patch::addInstsPatch(InstPosition position, int priority,
+                          std::vector<std::unique_ptr<RelocatableInst>> v) {
+  insertInstrPatch(InstrPatch{position, priority, std::move(v)});
+}
+
+void Patch::addInstsCallback(InstPosition position, int priority,
+                             RelocatableInstTag tag, InstCallback cbk,
+                             void *data, CallbackFlags flags) {
+  insertInstrPatch(
+      InstrPatch{position, priority, {}, tag, flags,
+                 {{cbk, data, ruleID, ruleEnabled}}});
+}
+
+void Patch::mergeInstsCallback() {
+  // Merge the consecutive callbacks with the same position, tag and flags in
+  // the first one.
+  for (InstPosition position : {PREINST, POSTINST}) {
+    InstrPatch *first = nullptr;
+    for (InstrPatch &el : instsPatchs) {
+      if (el.position != position) {
+        continue;
+      } else if (el.callbacks.empty()) {
+        first = nullptr;
+      } else if (first == nullptr or first->tag != el.tag or
+                 first->flags != el.flags) {
+        first = &el;
+      } else {
+        std::move(el.callbacks.begin(), el.callbacks.end(),
+                  std::back_inserter(first->callbacks));
+        el.callbacks.clear();
+      }
+    }
+  }
+  // Generate a single break to host for each list of callbacks
+  for (InstrPatch &el : instsPatchs) {
+    if (not el.callbacks.empty()) {
+      QBDI_DEBUG("Generate a break to host for {} callback(s)",
+                 el.callbacks.size());
+      el.insts = generateInstrumentation(
+          *this, getCallbackListGenerator(std::move(el.callbacks), el.flags),
+          true, el.position, el.tag, el.flags);
+      el.callbacks.clear();
+    }
+  }
+}
+
 void Patch::finalizeInstsPatch() {
   QBDI_REQUIRE(not finalize);
+  mergeInstsCallback();
   // avoid to used prepend
   RelocatableInst::UniquePtrVec prePatch;
   // add the tag RelocTagPatchInstBegin
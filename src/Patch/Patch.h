@@ -43,12 +43,22 @@ struct InstrPatch {
   InstPosition position;
   int priority;
   std::vector<std::unique_ptr<RelocatableInst>> insts;
+  // callbacks generated when the Patch is finalized
+  RelocatableInstTag tag = RelocTagInvalid;
+  CallbackFlags flags = CB_FLAG_NONE;
+  std::vector<CallbackData> callbacks = {};
 };
 
 class Patch {
 private:
   std::vector<InstrPatch> instsPatchs;
 
+  Patch(const Patch &);
+
+  void insertInstrPatch(InstrPatch &&el);
+
+  void mergeInstsCallback();
+
 public:
   InstMetadata metadata;
   std::vector<std::unique_ptr<RelocatableInst>> insts;
@@ -60,10 +70,17 @@ public:
   // Registers Used and Defs by the instruction
   std::array<RegisterUsage, NUM_GPR> regUsage;
   std::map<RegLLVM, RegisterUsage> regUsageExtra;
+  // Registers dead during the patch (bitfield of the GPR index), computed for
+  // the instrumentation with OPT_ENABLE_REGISTER_LIVENESS
+  rword deadGPR;
   // Registers used by the TempRegister for this patch
   std::set<RegLLVM> tempReg;
   const LLVMCPU *llvmcpu;
   bool finalize = false;
+  // id and state of the InstrRule being applied, set by the Engine and
+  // registered with the callbacks
+  uint32_t ruleID = 0;
+  bool ruleEnabled = true;
 
   using Vec = std::vector<Patch>;
 
@@ -75,6 +92,9 @@ public:
 
   ~Patch();
 
+  // Copy a Patch that has not been instrumented yet
+  Patch clone() const;
+
   void setModifyPC(bool modifyPC);
 
   void append(std::unique_ptr<RelocatableInst> &&r);
@@ -89,6 +109,10 @@ public:
   void addInstsPatch(InstPosition position, int priority,
                      std::vector<std::unique_ptr<RelocatableInst>> v);
 
+  void addInstsCallback(InstPosition position, int priority,
+                        RelocatableInstTag tag, InstCallback cbk, void *data,
+                        CallbackFlags flags);
+
   void finalizeInstsPatch();
 };
 
@@ -31,6 +31,21 @@ bool MnemonicIs::test(const Patch &patch, const LLVMCPU &llvmcpu) const {
       mnemonic.c_str(), llvmcpu.getInstOpcodeName(patch.metadata.inst));
 }
 
+bool MnemonicIs::matchOpcodes(std::set<unsigned> &opcodes,
+                              const LLVMCPU *llvmcpu) const {
+  if (llvmcpu == nullptr) {
+    return false;
+  }
+  unsigned numOpcodes = llvmcpu->getMCII().getNumOpcodes();
+  for (unsigned opcode = 0; opcode < numOpcodes; opcode++) {
+    if (QBDI::String::startsWith(mnemonic.c_str(),
+                                 llvmcpu->getInstOpcodeName(opcode))) {
+      opcodes.insert(opcode);
+    }
+  }
+  return true;
+}
+
 bool OpIs::test(const Patch &patch, const LLVMCPU &llvmcpu) const {
   return patch.metadata.inst.getOpcode() == op;
 }
@@ -45,6 +60,48 @@ bool UseReg::test(const Patch &patch, const LLVMCPU &llvmcpu) const {
   return false;
 }
 
+bool And::matchOpcodes(std::set<unsigned> &opcodes,
+                       const LLVMCPU *llvmcpu) const {
+  // intersection of the conditions restricted to some opcodes
+  bool restricted = false;
+  std::set<unsigned> result;
+  for (const PatchCondition::UniquePtr &cond : conditions) {
+    std::set<unsigned> condOpcodes;
+    if (not cond->matchOpcodes(condOpcodes, llvmcpu)) {
+      continue;
+    }
+    if (not restricted) {
+      result = std::move(condOpcodes);
+      restricted = true;
+    } else {
+      for (auto it = result.begin(); it != result.end();) {
+        if (condOpcodes.count(*it) == 0) {
+          it = result.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  if (restricted) {
+    opcodes.insert(result.begin(), result.end());
+  }
+  return restricted;
+}
+
+bool Or::matchOpcodes(std::set<unsigned> &opcodes,
+                      const LLVMCPU *llvmcpu) const {
+  // union of the conditions, if all of them are restricted
+  std::set<unsigned> result;
+  for (const PatchCondition::UniquePtr &cond : conditions) {
+    if (not cond->matchOpcodes(result, llvmcpu)) {
+      return false;
+    }
+  }
+  opcodes.insert(result.begin(), result.end());
+  return true;
+}
+
 bool DoesReadAccess::test(const Patch &patch, const LLVMCPU &llvmcpu) const {
   return getReadSize(patch.metadata.inst, llvmcpu) > 0;
 }
@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -49,6 +50,20 @@ public:
     return r;
   }
 
+  /*! Get the opcodes that this condition can match.
+   *
+   * @param[out] opcodes  Set where the opcodes are added
+   * @param[in]  llvmcpu  LLVMCPU object used to resolve the opcodes names, may
+   *                      be null
+   *
+   * @return False if the condition may match any opcode (opcodes is left
+   *         unchanged)
+   */
+  virtual bool matchOpcodes(std::set<unsigned> &opcodes,
+                            const LLVMCPU *llvmcpu) const {
+    return false;
+  }
+
   virtual ~PatchCondition() = default;
 };
 
@@ -65,6 +80,9 @@ public:
   MnemonicIs(const char *mnemonic) : mnemonic(mnemonic){};
 
   bool test(const Patch &patch, const LLVMCPU &llvmcpu) const override;
+
+  bool matchOpcodes(std::set<unsigned> &opcodes,
+                    const LLVMCPU *llvmcpu) const override;
 };
 
 class OpIs : public AutoClone<PatchCondition, OpIs> {
@@ -78,6 +96,12 @@ public:
   OpIs(unsigned int op) : op(op){};
 
   bool test(const Patch &patch, const LLVMCPU &llvmcpu) const override;
+
+  bool matchOpcodes(std::set<unsigned> &opcodes,
+                    const LLVMCPU *llvmcpu) const override {
+    opcodes.insert(op);
+    return true;
+  }
 };
 
 class UseReg : public AutoClone<PatchCondition, UseReg> {
@@ -175,6 +199,9 @@ public:
     return r;
   }
 
+  bool matchOpcodes(std::set<unsigned> &opcodes,
+                    const LLVMCPU *llvmcpu) const override;
+
   inline std::unique_ptr<PatchCondition> clone() const override {
     return And::unique(cloneVec(conditions));
   };
@@ -207,6 +234,9 @@ public:
     return r;
   }
 
+  bool matchOpcodes(std::set<unsigned> &opcodes,
+                    const LLVMCPU *llvmcpu) const override;
+
   inline std::unique_ptr<PatchCondition> clone() const override {
     return Or::unique(cloneVec(conditions));
   };
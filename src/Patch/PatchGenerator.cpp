@@ -259,6 +259,16 @@ GetInstId::generate(const Patch &patch, TempManager &temp_manager) const {
       InstId::unique(temp_manager.getRegForTemp(temp)));
 }
 
+// GetCallbackId
+// =============
+
+RelocatableInst::UniquePtrVec
+GetCallbackId::generate(const Patch &patch, TempManager &temp_manager) const {
+
+  return conv_unique<RelocatableInst>(
+      CallbackId::unique(temp_manager.getRegForTemp(temp), callbacks, flags));
+}
+
 // TargetPrologue
 // ==============
 
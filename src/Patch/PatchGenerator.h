@@ -472,6 +472,35 @@ public:
   generate(const Patch &patch, TempManager &temp_manager) const override;
 };
 
+class GetCallbackId : public AutoClone<PatchGenerator, GetCallbackId> {
+
+  Temp temp;
+  std::vector<CallbackData> callbacks;
+  CallbackFlags flags;
+
+public:
+  /*! Register a list of callbacks for the current instruction in the ExecBlock
+   * and copy its id in a temporary. The ExecBlock keeps the callbacks, their
+   * data, the instruction and the address where the execution resumes for
+   * each id, so that the instrumented code only needs to give this id to the
+   * host. The callbacks are called in the order of the list.
+   *
+   * @param[in] temp       A temporary where the id will be copied.
+   * @param[in] callbacks  The callbacks to call and their data.
+   * @param[in] flags      The options of the callbacks.
+   */
+  GetCallbackId(Temp temp, std::vector<CallbackData> callbacks,
+                CallbackFlags flags = CB_FLAG_NONE)
+      : temp(temp), callbacks(std::move(callbacks)), flags(flags) {}
+
+  /*! Output:
+   *
+   * MOV REG64 temp, IMM64 callbackID
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
 // Generic PatchGenerator that must be implemented by each target
 
 class TargetPrologue : public AutoClone<PatchGenerator, TargetPrologue> {
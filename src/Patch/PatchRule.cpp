@@ -42,6 +42,10 @@ bool PatchRule::canBeApplied(const Patch &patch, const LLVMCPU &llvmcpu) const {
   return condition->test(patch, llvmcpu);
 }
 
+bool PatchRule::matchOpcodes(std::set<unsigned> &opcodes) const {
+  return condition->matchOpcodes(opcodes, nullptr);
+}
+
 void PatchRule::apply(Patch &patch, const LLVMCPU &llvmcpu) const {
 
   TempManager temp_manager(patch);
@@ -72,4 +76,25 @@ void PatchRule::apply(Patch &patch, const LLVMCPU &llvmcpu) const {
   patch.append(std::move(restoreReg));
 }
 
+PatchRuleIndex::PatchRuleIndex(const std::vector<PatchRule> &rules) {
+  for (uint32_t i = 0; i < rules.size(); i++) {
+    std::set<unsigned> opcodes;
+    if (rules[i].matchOpcodes(opcodes)) {
+      for (unsigned opcode : opcodes) {
+        auto it = opcodeRules.find(opcode);
+        if (it == opcodeRules.end()) {
+          // the rules before this one that can match any opcode
+          it = opcodeRules.emplace(opcode, genericRules).first;
+        }
+        it->second.push_back(i);
+      }
+    } else {
+      genericRules.push_back(i);
+      for (auto &r : opcodeRules) {
+        r.second.push_back(i);
+      }
+    }
+  }
+}
+
 } // namespace QBDI
@@ -19,6 +19,9 @@
 #define PATCHRULE_H
 
 #include <memory>
+#include <set>
+#include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 #include "QBDI/State.h"
@@ -73,6 +76,43 @@ public:
    * @param[in] llvmcpu   LLVMCPU object
    */
   void apply(Patch &patch, const LLVMCPU &llvmcpu) const;
+
+  /*! Get the opcodes that this rule can be applied on.
+   *
+   * @param[out] opcodes  Set where the opcodes are added
+   *
+   * @return False if the rule may be applied on any opcode
+   */
+  bool matchOpcodes(std::set<unsigned> &opcodes) const;
+};
+
+/*! Index of a list of PatchRule by opcode. For each opcode, the list of the
+ * rules that can be applied, in the same order as the original list.
+ */
+class PatchRuleIndex {
+  std::unordered_map<unsigned, std::vector<uint32_t>> opcodeRules;
+  std::vector<uint32_t> genericRules;
+
+public:
+  PatchRuleIndex() = default;
+
+  /*! Build the index of a list of rules
+   *
+   * @param[in] rules  The rules to index
+   */
+  PatchRuleIndex(const std::vector<PatchRule> &rules);
+
+  /*! Get the index of the rules that may be applied on an opcode.
+   *
+   * @param[in] opcode  The opcode of the instruction
+   */
+  inline const std::vector<uint32_t> &getRules(unsigned opcode) const {
+    auto it = opcodeRules.find(opcode);
+    if (it == opcodeRules.end()) {
+      return genericRules;
+    }
+    return it->second;
+  }
 };
 
 } // namespace QBDI
@@ -22,9 +22,14 @@
 #include "llvm/MC/MCInstrDesc.h"
 #include "llvm/MC/MCInstrInfo.h"
 
+#if defined(QBDI_ARCH_ARM)
+#include "Target/ARM/Utils/ARMBaseInfo.h"
+#endif
+
 #include "devVariable.h"
 #include "Engine/LLVMCPU.h"
 #include "Patch/InstInfo.h"
+#include "Patch/Patch.h"
 #include "Patch/Register.h"
 #include "Patch/Types.h"
 
@@ -167,4 +172,90 @@ void getUsedGPR(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
   });
 }
 
+static void addKilledRegister(rword &killed, RegLLVM reg_) {
+  // A write on 32 bits clears the upper bits on X86_64 and AArch64. A smaller
+  // write keeps the upper bits of the register.
+  if (getRegisterSize(reg_) < 4 and getRegisterSize(reg_) < sizeof(rword)) {
+    return;
+  }
+  for (int i = 0; i < getRegisterPacked(reg_); i++) {
+    int id = getGPRPosition(getUpperRegister(reg_, i));
+    if (id >= 0 and ((unsigned)id) < NUM_GPR) {
+      killed |= ((rword)1) << id;
+    }
+  }
+}
+
+rword getKilledGPR(const llvm::MCInst &inst, const LLVMCPU &llvmcpu) {
+  const llvm::MCInstrInfo &MCII = llvmcpu.getMCII();
+  const llvm::MCInstrDesc &desc = MCII.get(inst.getOpcode());
+  unsigned opIsUsedBegin = desc.getNumDefs();
+  unsigned opIsUsedEnd = inst.getNumOperands();
+  rword killed = 0;
+
+  if (desc.isVariadic() and variadicOpsIsWrite(inst)) {
+    if (desc.getNumOperands() < 1) {
+      opIsUsedEnd = 0;
+    } else {
+      opIsUsedEnd = desc.getNumOperands() - 1;
+    }
+  }
+
+  for (unsigned int i = 0; i < inst.getNumOperands(); i++) {
+    const llvm::MCOperand &op = inst.getOperand(i);
+    if (op.isReg() and op.getReg() != 0 and
+        (i < opIsUsedBegin or opIsUsedEnd <= i)) {
+      addKilledRegister(killed, op.getReg());
+    }
+  }
+  for (const unsigned implicitRegs : desc.implicit_defs()) {
+    if (implicitRegs) {
+      addKilledRegister(killed, implicitRegs);
+    }
+  }
+  return killed;
+}
+
+void computeDeadGPR(std::vector<Patch> &basicBlock) {
+  static constexpr rword allGPR = (((rword)1) << (NUM_GPR - 1) << 1) - 1;
+
+  // registers alive after the current instruction
+  rword alive = allGPR;
+
+  for (auto it = basicBlock.rbegin(); it != basicBlock.rend(); ++it) {
+    Patch &patch = *it;
+    const llvm::MCInst &inst = patch.metadata.inst;
+    const llvm::MCInstrDesc &desc =
+        patch.llvmcpu->getMCII().get(inst.getOpcode());
+
+    rword used = 0;
+    rword usedOrSet = 0;
+    for (unsigned i = 0; i < NUM_GPR; i++) {
+      if ((patch.regUsage[i] & RegisterUsed) != 0) {
+        used |= ((rword)1) << i;
+      }
+      if ((patch.regUsage[i] & RegisterBoth) != 0) {
+        usedOrSet |= ((rword)1) << i;
+      }
+    }
+
+    patch.deadGPR = allGPR & ~alive & ~usedOrSet;
+
+    if (patch.metadata.modifyPC or desc.isCall() or desc.isReturn() or
+        desc.isBranch() or desc.hasUnmodeledSideEffects()) {
+      alive = allGPR;
+      continue;
+    }
+
+    rword killed = getKilledGPR(inst, *patch.llvmcpu);
+#if defined(QBDI_ARCH_ARM)
+    // a conditional instruction may not overwrite the registers
+    if (patch.metadata.archMetadata.cond != llvm::ARMCC::AL) {
+      killed = 0;
+    }
+#endif
+    alive = (alive & ~killed) | used;
+  }
+}
+
 } // namespace QBDI
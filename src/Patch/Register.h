@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <map>
 #include <stdint.h>
+#include <vector>
 
 #include "QBDI/Bitmask.h"
 #include "QBDI/State.h"
@@ -91,6 +92,26 @@ void getUsedGPR(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
                 std::array<RegisterUsage, NUM_GPR> &regUsage,
                 std::map<RegLLVM, RegisterUsage> &regUsageExtra);
 
+/* Get General Register fully overwritten by an instruction (needed for the
+ * liveness of the registers)
+ *
+ * A partial write of a register (like AL on X86_64) or a write under a
+ * condition doesn't overwrite the register. The result is a bitfield of the
+ * index of the registers in the GPRState.
+ */
+rword getKilledGPR(const llvm::MCInst &inst, const LLVMCPU &llvmcpu);
+
+/* Compute the General Register dead during each Patch of a basic block (needed
+ * for TempManager)
+ *
+ * A register is dead during a Patch if the instruction doesn't use or set it
+ * and if the next instructions of the basic block overwrite it before reading
+ * it. All the registers are alive at the end of the basic block and before an
+ * instruction that may read registers not declared by LLVM (call, syscall,
+ * ...).
+ */
+void computeDeadGPR(std::vector<Patch> &basicBlock);
+
 }; // namespace QBDI
 
 #endif // REGISTER_H
@@ -19,6 +19,7 @@
 #define RELOCATABLEINST_H
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "llvm/MC/MCInst.h"
@@ -192,6 +193,24 @@ public:
   int getSize(const LLVMCPU &llvmcpu) const override;
 };
 
+class CallbackId : public AutoClone<RelocatableInst, CallbackId> {
+  RegLLVM reg;
+  std::vector<CallbackData> callbacks;
+  CallbackFlags flags;
+
+public:
+  CallbackId(RegLLVM reg, std::vector<CallbackData> callbacks,
+             CallbackFlags flags = CB_FLAG_NONE)
+      : AutoClone<RelocatableInst, CallbackId>(), reg(reg),
+        callbacks(std::move(callbacks)), flags(flags) {}
+
+  // Register the callbacks for the current instruction in the ExecBlock and
+  // store the ID of the callbacks in the register
+  llvm::MCInst reloc(ExecBlock *execBlock, CPUMode cpumode) const override;
+
+  int getSize(const LLVMCPU &llvmcpu) const override;
+};
+
 } // namespace QBDI
 
 #endif
@@ -105,6 +105,16 @@ Reg TempManager::getRegForTemp(unsigned int id) {
     }
   }
 
+  // Find a dead register, that doesn't need to be saved
+  for (unsigned i = _QBDI_FIRST_FREE_REGISTER; i < AVAILABLE_GPR; i++) {
+    Reg r = Reg(i);
+    if ((not usedRegister(r)) and patch.regUsage[i] == 0 and
+        isDeadRegister(r)) {
+      associatedReg(id, r);
+      return r;
+    }
+  }
+
   // Find a free register
   for (unsigned i = _QBDI_FIRST_FREE_REGISTER; i < AVAILABLE_GPR; i++) {
     Reg r = Reg(i);
@@ -149,6 +159,10 @@ bool TempManager::shouldRestore(Reg r) const {
   return TempManagerUnrestoreGPR.count(r) == 0;
 }
 
+bool TempManager::isDeadRegister(Reg r) const {
+  return (patch.deadGPR & (((rword)1) << r.getID())) != 0;
+}
+
 RegLLVM TempManager::getSizedSubReg(RegLLVM reg, unsigned size) const {
   if (getRegisterSize(reg) == size) {
     return reg;
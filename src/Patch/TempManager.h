@@ -64,6 +64,9 @@ public:
 
   bool shouldRestore(Reg r) const;
 
+  // the value of the register is dead, it doesn't need to be saved
+  bool isDeadRegister(Reg r) const;
+
   bool usedRegister(Reg reg) const;
 
   bool isAllocatedId(unsigned int id) const;
@@ -23,6 +23,7 @@
 #include "ExecBlock/Context.h"
 #include "Patch/Register.h"
 
+#include "QBDI/Callback.h"
 #include "QBDI/State.h"
 
 namespace QBDI {
@@ -247,11 +248,24 @@ public:
   inline operator unsigned int() const { return idx; }
 };
 
+/* A callback, its data parameter and the instrumentation rule that added it
+ */
+struct CallbackData {
+  InstCallback cbk;
+  void *data;
+  uint32_t ruleID;
+  bool enabled;
+};
+
 /* Tag value for RelocatableInst
  */
 enum RelocatableInstTag {
   RelocInst = 0,
   RelocTagChangeScratchRegister = 0x1,
+  RelocTagCallbackResume = 0x2,
+  RelocTagInlineCall = 0x3,
+  RelocTagCallbackSite = 0x4,
+  RelocTagCallbackSiteEnd = 0x5,
   RelocTagPatchBegin = 0x10,
   RelocTagPreInstMemAccess = 0x20,
   RelocTagPreInstStdCBK = 0x21,
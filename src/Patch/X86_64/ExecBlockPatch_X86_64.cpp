@@ -38,112 +38,288 @@
 
 namespace QBDI {
 
-RelocatableInst::UniquePtrVec getExecBlockPrologue(const LLVMCPU &llvmcpu) {
+namespace {
+
+void appendRestoreFPR(RelocatableInst::UniquePtrVec &v,
+                      const LLVMCPU &llvmcpu) {
   Options opts = llvmcpu.getOptions();
-  RelocatableInst::UniquePtrVec prologue;
 
-  // Save host SP
-  append(prologue, SaveReg(Reg(REG_SP), Offset(offsetof(Context, hostState.sp)))
-                       .genReloc(llvmcpu));
-  // Restore FPR
-  if ((opts & Options::OPT_DISABLE_FPR) == 0) {
+  if ((opts & Options::OPT_DISABLE_FPR) != 0) {
+    return;
+  }
+  if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
+    append(v, LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
+                  .genReloc(llvmcpu));
+    v.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
+    v.push_back(Je(7 + 4));
+  }
+  v.push_back(Fxrstor(Offset(offsetof(Context, fprState))));
+  // target je needFPU
+  if (isHostCPUFeaturePresent("avx")) {
+    QBDI_DEBUG("AVX support enabled in guest context switches");
+    // don't restore if not needed
     if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
-      append(prologue,
-             LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
-                 .genReloc(llvmcpu));
-      prologue.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
-      prologue.push_back(Je(7 + 4));
+      v.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
+      if constexpr (is_x86_64)
+        v.push_back(Je(16 * 10 + 4));
+      else
+        v.push_back(Je(8 * 10 + 4));
     }
-    prologue.push_back(Fxrstor(Offset(offsetof(Context, fprState))));
-    // target je needFPU
-    if (isHostCPUFeaturePresent("avx")) {
-      QBDI_DEBUG("AVX support enabled in guest context switches");
-      // don't restore if not needed
-      if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
-        prologue.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
-        if constexpr (is_x86_64)
-          prologue.push_back(Je(16 * 10 + 4));
-        else
-          prologue.push_back(Je(8 * 10 + 4));
-      }
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM0,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM1,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm1)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM2,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm2)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM3,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm3)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM4,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm4)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM5,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm5)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM6,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm6)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM7,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm7)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM0,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM1,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm1)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM2,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm2)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM3,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm3)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM4,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm4)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM5,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm5)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM6,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm6)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM7,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm7)), 1));
 #if defined(QBDI_ARCH_X86_64)
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM8,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm8)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM9,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm9)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM10,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm10)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM11,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm11)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM12,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm12)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM13,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm13)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM14,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm14)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM15,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm15)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM8,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm8)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM9,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm9)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM10,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm10)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM11,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm11)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM12,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm12)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM13,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm13)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM14,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm14)), 1));
+    v.push_back(Vinsertf128(
+        llvm::X86::YMM15,
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm15)), 1));
 #endif // QBDI_ARCH_X86_64
        // target je needAVX
+  }
+}
+
+void appendSaveFPR(RelocatableInst::UniquePtrVec &v, const LLVMCPU &llvmcpu) {
+  Options opts = llvmcpu.getOptions();
+
+  if ((opts & Options::OPT_DISABLE_FPR) != 0) {
+    return;
+  }
+  if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
+    append(v, LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
+                  .genReloc(llvmcpu));
+    v.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
+    v.push_back(Je(7 + 4));
+  }
+  v.push_back(Fxsave(Offset(offsetof(Context, fprState))));
+  // target je needFPU
+  if (isHostCPUFeaturePresent("avx")) {
+    QBDI_DEBUG("AVX support enabled in guest context switches");
+    // don't save if not needed
+    if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
+      v.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
+      if constexpr (is_x86_64)
+        v.push_back(Je(16 * 10 + 4));
+      else
+        v.push_back(Je(8 * 10 + 4));
     }
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0)),
+        llvm::X86::YMM0, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm1)),
+        llvm::X86::YMM1, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm2)),
+        llvm::X86::YMM2, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm3)),
+        llvm::X86::YMM3, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm4)),
+        llvm::X86::YMM4, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm5)),
+        llvm::X86::YMM5, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm6)),
+        llvm::X86::YMM6, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm7)),
+        llvm::X86::YMM7, 1));
+#if defined(QBDI_ARCH_X86_64)
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm8)),
+        llvm::X86::YMM8, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm9)),
+        llvm::X86::YMM9, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm10)),
+        llvm::X86::YMM10, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm11)),
+        llvm::X86::YMM11, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm12)),
+        llvm::X86::YMM12, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm13)),
+        llvm::X86::YMM13, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm14)),
+        llvm::X86::YMM14, 1));
+    v.push_back(Vextractf128(
+        Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm15)),
+        llvm::X86::YMM15, 1));
+#endif // QBDI_ARCH_X86_64
+       // target je needAVX
   }
+}
+
 #if defined(QBDI_ARCH_X86_64)
-  // if enable FS GS
-  if ((opts & Options::OPT_ENABLE_FS_GS) == Options::OPT_ENABLE_FS_GS) {
-    QBDI_REQUIRE_ABORT(isHostCPUFeaturePresent("fsgsbase"),
-                       "Need CPU feature fsgsbase");
+// Exchange the FS and GS bases: the current bases are saved at saveFS and
+// saveGS and the bases stored at loadFS and loadGS are loaded
+void appendSwitchFSGS(RelocatableInst::UniquePtrVec &v, const LLVMCPU &llvmcpu,
+                      size_t loadFS, size_t loadGS, size_t saveFS,
+                      size_t saveGS) {
+  Options opts = llvmcpu.getOptions();
 
-    append(prologue,
-           LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
-               .genReloc(llvmcpu));
-    prologue.push_back(Test(Reg(0), ExecBlockFlags::needFSGS));
-    prologue.push_back(Je(5 * 4 + 7 * 4 + 4));
+  if ((opts & Options::OPT_ENABLE_FS_GS) != Options::OPT_ENABLE_FS_GS) {
+    return;
+  }
+  QBDI_REQUIRE_ABORT(isHostCPUFeaturePresent("fsgsbase"),
+                     "Need CPU feature fsgsbase");
+
+  append(v, LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
+                .genReloc(llvmcpu));
+  v.push_back(Test(Reg(0), ExecBlockFlags::needFSGS));
+  v.push_back(Je(5 * 4 + 7 * 4 + 4));
+
+  append(v, LoadReg(Reg(3), Offset(loadFS)).genReloc(llvmcpu));
+  append(v, LoadReg(Reg(4), Offset(loadGS)).genReloc(llvmcpu));
+  v.push_back(Rdfsbase(Reg(1)));
+  v.push_back(Rdgsbase(Reg(2)));
+  v.push_back(Wrfsbase(Reg(3)));
+  v.push_back(Wrgsbase(Reg(4)));
+  append(v, SaveReg(Reg(1), Offset(saveFS)).genReloc(llvmcpu));
+  append(v, SaveReg(Reg(2), Offset(saveGS)).genReloc(llvmcpu));
+}
+#endif // QBDI_ARCH_X86_64
 
-    append(prologue, LoadReg(Reg(3), Offset(offsetof(Context, gprState.fs)))
-                         .genReloc(llvmcpu));
-    append(prologue, LoadReg(Reg(4), Offset(offsetof(Context, gprState.gs)))
-                         .genReloc(llvmcpu));
-    prologue.push_back(Rdfsbase(Reg(1)));
-    prologue.push_back(Rdgsbase(Reg(2)));
-    prologue.push_back(Wrfsbase(Reg(3)));
-    prologue.push_back(Wrgsbase(Reg(4)));
-    append(prologue, SaveReg(Reg(1), Offset(offsetof(Context, hostState.fs)))
-                         .genReloc(llvmcpu));
-    append(prologue, SaveReg(Reg(2), Offset(offsetof(Context, hostState.gs)))
-                         .genReloc(llvmcpu));
+// Stub used by the callbacks registered with CB_FLAG_INLINE_CALL. The guest
+// state is saved, ExecBlock::inlineCallHandler is called on the host stack and
+// the guest state is restored before jumping to the selector set by the
+// handler. The stub doesn't return to the VM. The FPR are always saved, as
+// the host code doesn't preserve the XMM, YMM and x87 registers of the guest.
+RelocatableInst::UniquePtrVec getInlineCallStub(const LLVMCPU &llvmcpu) {
+  RelocatableInst::UniquePtrVec stub;
+
+  stub.push_back(RelocTag::unique(RelocTagInlineCall));
+
+  // Save GPR
+  for (unsigned int i = 0; i < NUM_GPR - 1; i++)
+    append(stub, SaveReg(Reg(i), Offset(Reg(i))).genReloc(llvmcpu));
+  // Restore host SP
+  append(stub, LoadReg(Reg(REG_SP), Offset(offsetof(Context, hostState.sp)))
+                   .genReloc(llvmcpu));
+  // Save EFLAGS
+  stub.push_back(Pushf());
+  stub.push_back(Popr(Reg(0)));
+  append(stub, SaveReg(Reg(0), Offset(offsetof(Context, gprState.eflags)))
+                   .genReloc(llvmcpu));
+#if defined(QBDI_ARCH_X86_64)
+  appendSwitchFSGS(stub, llvmcpu, offsetof(Context, hostState.fs),
+                   offsetof(Context, hostState.gs),
+                   offsetof(Context, gprState.fs),
+                   offsetof(Context, gprState.gs));
+#endif // QBDI_ARCH_X86_64
+  // Save FPR
+  appendSaveFPR(stub, llvmcpu);
+
+  // Call the handler with the ExecBlock on an aligned stack
+  stub.push_back(Cld());
+  stub.push_back(Andri(Reg(REG_SP), -16));
+  if constexpr (is_x86_64) {
+    // first argument in RCX on Windows, in RDI otherwise
+    Reg arg = is_windows ? Reg(2) : Reg(5);
+    append(stub,
+           LoadReg(arg, Offset(offsetof(Context, hostState.execBlock)))
+               .genReloc(llvmcpu));
+    // shadow space of the Windows calling convention
+    stub.push_back(Add(Reg(REG_SP), Reg(REG_SP), Constant(-32)));
+  } else {
+    stub.push_back(Add(Reg(REG_SP), Reg(REG_SP), Constant(-12)));
+    append(stub,
+           LoadReg(Reg(0), Offset(offsetof(Context, hostState.execBlock)))
+               .genReloc(llvmcpu));
+    stub.push_back(Pushr(Reg(0)));
   }
+  stub.push_back(CallM(Offset(offsetof(Context, hostState.inlineCallHandler))));
+
+  // Restore FPR
+  appendRestoreFPR(stub, llvmcpu);
+
+  // Clear the callback id
+  stub.push_back(Xorrr(Reg(0), Reg(0)));
+  append(stub, SaveReg(Reg(0), Offset(offsetof(Context, hostState.callback)))
+                   .genReloc(llvmcpu));
+#if defined(QBDI_ARCH_X86_64)
+  appendSwitchFSGS(stub, llvmcpu, offsetof(Context, gprState.fs),
+                   offsetof(Context, gprState.gs),
+                   offsetof(Context, hostState.fs),
+                   offsetof(Context, hostState.gs));
+#endif // QBDI_ARCH_X86_64
+  // Restore EFLAGS
+  append(stub, LoadReg(Reg(0), Offset(offsetof(Context, gprState.eflags)))
+                   .genReloc(llvmcpu));
+  stub.push_back(Pushr(Reg(0)));
+  stub.push_back(Popf());
+  // Restore GPR
+  for (unsigned int i = 0; i < NUM_GPR - 1; i++)
+    append(stub, LoadReg(Reg(i), Offset(Reg(i))).genReloc(llvmcpu));
+  // Jump selector
+  stub.push_back(JmpM(Offset(offsetof(Context, hostState.selector))));
+
+  return stub;
+}
+
+} // anonymous namespace
+
+RelocatableInst::UniquePtrVec getExecBlockPrologue(const LLVMCPU &llvmcpu) {
+  RelocatableInst::UniquePtrVec prologue;
+
+  // Save host SP
+  append(prologue, SaveReg(Reg(REG_SP), Offset(offsetof(Context, hostState.sp)))
+                       .genReloc(llvmcpu));
+  // Restore FPR
+  appendRestoreFPR(prologue, llvmcpu);
+#if defined(QBDI_ARCH_X86_64)
+  // if enable FS GS
+  appendSwitchFSGS(prologue, llvmcpu, offsetof(Context, gprState.fs),
+                   offsetof(Context, gprState.gs),
+                   offsetof(Context, hostState.fs),
+                   offsetof(Context, hostState.gs));
 #endif // QBDI_ARCH_X86_64
   // Restore EFLAGS
   append(prologue, LoadReg(Reg(0), Offset(offsetof(Context, gprState.eflags)))
@@ -176,107 +352,21 @@ RelocatableInst::UniquePtrVec getExecBlockEpilogue(const LLVMCPU &llvmcpu) {
                        .genReloc(llvmcpu));
 #if defined(QBDI_ARCH_X86_64)
   // if enable FS GS
-  if ((opts & Options::OPT_ENABLE_FS_GS) == Options::OPT_ENABLE_FS_GS) {
-    QBDI_REQUIRE_ABORT(isHostCPUFeaturePresent("fsgsbase"),
-                       "Need CPU feature fsgsbase");
-
-    append(epilogue,
-           LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
-               .genReloc(llvmcpu));
-    epilogue.push_back(Test(Reg(0), ExecBlockFlags::needFSGS));
-    epilogue.push_back(Je(5 * 4 + 7 * 4 + 4));
-
-    append(epilogue, LoadReg(Reg(3), Offset(offsetof(Context, hostState.fs)))
-                         .genReloc(llvmcpu));
-    append(epilogue, LoadReg(Reg(4), Offset(offsetof(Context, hostState.gs)))
-                         .genReloc(llvmcpu));
-    epilogue.push_back(Rdfsbase(Reg(1)));
-    epilogue.push_back(Rdgsbase(Reg(2)));
-    epilogue.push_back(Wrfsbase(Reg(3)));
-    epilogue.push_back(Wrgsbase(Reg(4)));
-    append(epilogue, SaveReg(Reg(1), Offset(offsetof(Context, gprState.fs)))
-                         .genReloc(llvmcpu));
-    append(epilogue, SaveReg(Reg(2), Offset(offsetof(Context, gprState.gs)))
-                         .genReloc(llvmcpu));
-  }
+  appendSwitchFSGS(epilogue, llvmcpu, offsetof(Context, hostState.fs),
+                   offsetof(Context, hostState.gs),
+                   offsetof(Context, gprState.fs),
+                   offsetof(Context, gprState.gs));
 #endif // QBDI_ARCH_X86_64
   // Save FPR
-  if ((opts & Options::OPT_DISABLE_FPR) == 0) {
-    if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
-      append(epilogue,
-             LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
-                 .genReloc(llvmcpu));
-      epilogue.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
-      epilogue.push_back(Je(7 + 4));
-    }
-    epilogue.push_back(Fxsave(Offset(offsetof(Context, fprState))));
-    // target je needFPU
-    if (isHostCPUFeaturePresent("avx")) {
-      QBDI_DEBUG("AVX support enabled in guest context switches");
-      // don't save if not needed
-      if ((opts & Options::OPT_DISABLE_OPTIONAL_FPR) == 0) {
-        epilogue.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
-        if constexpr (is_x86_64)
-          epilogue.push_back(Je(16 * 10 + 4));
-        else
-          epilogue.push_back(Je(8 * 10 + 4));
-      }
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0)),
-          llvm::X86::YMM0, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm1)),
-          llvm::X86::YMM1, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm2)),
-          llvm::X86::YMM2, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm3)),
-          llvm::X86::YMM3, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm4)),
-          llvm::X86::YMM4, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm5)),
-          llvm::X86::YMM5, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm6)),
-          llvm::X86::YMM6, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm7)),
-          llvm::X86::YMM7, 1));
-#if defined(QBDI_ARCH_X86_64)
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm8)),
-          llvm::X86::YMM8, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm9)),
-          llvm::X86::YMM9, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm10)),
-          llvm::X86::YMM10, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm11)),
-          llvm::X86::YMM11, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm12)),
-          llvm::X86::YMM12, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm13)),
-          llvm::X86::YMM13, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm14)),
-          llvm::X86::YMM14, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm15)),
-          llvm::X86::YMM15, 1));
-#endif // QBDI_ARCH_X86_64
-       // target je needAVX
-    }
-  }
+  appendSaveFPR(epilogue, llvmcpu);
   // return to host
   epilogue.push_back(Ret());
 
+  // The inline call stub is written after the epilogue
+  if ((opts & Options::OPT_ENABLE_INLINE_CALL) != 0) {
+    append(epilogue, getInlineCallStub(llvmcpu));
+  }
+
   return epilogue;
 }
 
@@ -0,0 +1,352 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+
+#include "X86InstrInfo.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCRegisterInfo.h"
+
+#include "Patch/FastEncoder.h"
+
+#include "QBDI/Config.h"
+
+namespace QBDI {
+
+namespace {
+
+constexpr uint8_t REX_W = 0x48;
+constexpr uint8_t REX_R = 0x44;
+constexpr uint8_t REX_B = 0x41;
+
+// Encoding of a general purpose register (0 to 15), or -1 if the operand
+// isn't a 64 bits general purpose register.
+int getGPR64(const llvm::MCOperand &op, const llvm::MCRegisterInfo &MRI) {
+  if (not op.isReg()) {
+    return -1;
+  }
+  unsigned reg = op.getReg();
+  if (not MRI.getRegClass(llvm::X86::GR64RegClassID).contains(reg)) {
+    return -1;
+  }
+  return MRI.getEncodingValue(reg);
+}
+
+inline void emitByte(llvm::SmallVectorImpl<char> &CB, uint8_t b) {
+  CB.push_back(static_cast<char>(b));
+}
+
+inline void emitImm32(llvm::SmallVectorImpl<char> &CB, uint32_t v) {
+  for (unsigned i = 0; i < 4; i++) {
+    emitByte(CB, (v >> (i * 8)) & 0xff);
+  }
+}
+
+inline void emitImm64(llvm::SmallVectorImpl<char> &CB, uint64_t v) {
+  for (unsigned i = 0; i < 8; i++) {
+    emitByte(CB, (v >> (i * 8)) & 0xff);
+  }
+}
+
+inline bool isInt8(int64_t v) { return -0x80 <= v and v < 0x80; }
+
+inline bool isInt32(int64_t v) {
+  return -0x80000000ll <= v and v < 0x80000000ll;
+}
+
+// A memory operand [base + disp] (no index, no segment)
+struct MemOperand {
+  bool ripRelative;
+  int base;
+  int64_t disp;
+};
+
+// Decode the 5 MCOperand of a memory reference starting at index
+bool getMemOperand(const llvm::MCInst &inst, unsigned index,
+                   const llvm::MCRegisterInfo &MRI, MemOperand &mem) {
+  if (inst.getNumOperands() < index + 5) {
+    return false;
+  }
+  const llvm::MCOperand &base = inst.getOperand(index);
+  const llvm::MCOperand &scale = inst.getOperand(index + 1);
+  const llvm::MCOperand &indexReg = inst.getOperand(index + 2);
+  const llvm::MCOperand &disp = inst.getOperand(index + 3);
+  const llvm::MCOperand &seg = inst.getOperand(index + 4);
+
+  if (not base.isReg() or not scale.isImm() or scale.getImm() != 1 or
+      not indexReg.isReg() or indexReg.getReg() != 0 or not disp.isImm() or
+      not seg.isReg() or seg.getReg() != 0) {
+    return false;
+  }
+  mem.disp = disp.getImm();
+  if (not isInt32(mem.disp)) {
+    return false;
+  }
+  if (base.getReg() == llvm::X86::RIP) {
+    mem.ripRelative = true;
+    mem.base = 0;
+    return true;
+  }
+  mem.ripRelative = false;
+  mem.base = getGPR64(base, MRI);
+  return mem.base >= 0;
+}
+
+// Emit the ModRM, the SIB and the displacement of a memory operand
+void emitMemOperand(llvm::SmallVectorImpl<char> &CB, unsigned regField,
+                    const MemOperand &mem) {
+  uint8_t reg = (regField & 7) << 3;
+  if (mem.ripRelative) {
+    emitByte(CB, 0x05 | reg);
+    emitImm32(CB, static_cast<uint32_t>(mem.disp));
+    return;
+  }
+  uint8_t rm = mem.base & 7;
+  uint8_t mod;
+  if (mem.disp == 0 and rm != 5) {
+    mod = 0x00;
+  } else if (isInt8(mem.disp)) {
+    mod = 0x40;
+  } else {
+    mod = 0x80;
+  }
+  emitByte(CB, mod | reg | rm);
+  if (rm == 4) {
+    // RSP and R12 need a SIB without index
+    emitByte(CB, 0x24);
+  }
+  if (mod == 0x40) {
+    emitByte(CB, static_cast<uint8_t>(mem.disp));
+  } else if (mod == 0x80) {
+    emitImm32(CB, static_cast<uint32_t>(mem.disp));
+  }
+}
+
+inline uint8_t rexMem(uint8_t rex, int reg, const MemOperand &mem) {
+  if (reg >= 8) {
+    rex |= REX_R;
+  }
+  if (not mem.ripRelative and mem.base >= 8) {
+    rex |= REX_B;
+  }
+  return rex;
+}
+
+bool encodeMovRM(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                 const llvm::MCRegisterInfo &MRI) {
+  // MOV64rm dst, [base + disp]
+  MemOperand mem;
+  if (inst.getNumOperands() != 6) {
+    return false;
+  }
+  int dst = getGPR64(inst.getOperand(0), MRI);
+  if (dst < 0 or not getMemOperand(inst, 1, MRI, mem)) {
+    return false;
+  }
+  emitByte(CB, rexMem(REX_W, dst, mem));
+  emitByte(CB, 0x8B);
+  emitMemOperand(CB, dst, mem);
+  return true;
+}
+
+bool encodeMovMR(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                 const llvm::MCRegisterInfo &MRI) {
+  // MOV64mr [base + disp], src
+  MemOperand mem;
+  if (inst.getNumOperands() != 6) {
+    return false;
+  }
+  int src = getGPR64(inst.getOperand(5), MRI);
+  if (src < 0 or not getMemOperand(inst, 0, MRI, mem)) {
+    return false;
+  }
+  emitByte(CB, rexMem(REX_W, src, mem));
+  emitByte(CB, 0x89);
+  emitMemOperand(CB, src, mem);
+  return true;
+}
+
+bool encodeJmpM(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                const llvm::MCRegisterInfo &MRI) {
+  // JMP64m [base + disp]
+  MemOperand mem;
+  if (inst.getNumOperands() != 5 or not getMemOperand(inst, 0, MRI, mem)) {
+    return false;
+  }
+  if (not mem.ripRelative and mem.base >= 8) {
+    emitByte(CB, REX_B);
+  }
+  emitByte(CB, 0xFF);
+  emitMemOperand(CB, 4, mem);
+  return true;
+}
+
+bool encodeMovRR(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                 const llvm::MCRegisterInfo &MRI) {
+  // MOV64rr dst, src (89 /r)
+  if (inst.getNumOperands() != 2) {
+    return false;
+  }
+  int dst = getGPR64(inst.getOperand(0), MRI);
+  int src = getGPR64(inst.getOperand(1), MRI);
+  if (dst < 0 or src < 0) {
+    return false;
+  }
+  emitByte(CB, REX_W | ((src >= 8) ? REX_R : 0) | ((dst >= 8) ? REX_B : 0));
+  emitByte(CB, 0x89);
+  emitByte(CB, 0xC0 | ((src & 7) << 3) | (dst & 7));
+  return true;
+}
+
+bool encodeMovRI(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                 const llvm::MCRegisterInfo &MRI) {
+  // MOV64ri reg, imm64 (REX.W B8+r io)
+  if (inst.getNumOperands() != 2 or not inst.getOperand(1).isImm()) {
+    return false;
+  }
+  int reg = getGPR64(inst.getOperand(0), MRI);
+  if (reg < 0) {
+    return false;
+  }
+  emitByte(CB, REX_W | ((reg >= 8) ? REX_B : 0));
+  emitByte(CB, 0xB8 | (reg & 7));
+  emitImm64(CB, static_cast<uint64_t>(inst.getOperand(1).getImm()));
+  return true;
+}
+
+bool encodeMovRI32(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                   const llvm::MCRegisterInfo &MRI) {
+  // MOV64ri32 reg, simm32 (REX.W C7 /0 id)
+  if (inst.getNumOperands() != 2 or not inst.getOperand(1).isImm()) {
+    return false;
+  }
+  int reg = getGPR64(inst.getOperand(0), MRI);
+  if (reg < 0) {
+    return false;
+  }
+  emitByte(CB, REX_W | ((reg >= 8) ? REX_B : 0));
+  emitByte(CB, 0xC7);
+  emitByte(CB, 0xC0 | (reg & 7));
+  emitImm32(CB, static_cast<uint32_t>(inst.getOperand(1).getImm()));
+  return true;
+}
+
+bool encodePushPop(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB,
+                   const llvm::MCRegisterInfo &MRI, uint8_t opcode) {
+  // PUSH64r (50+r) and POP64r (58+r)
+  if (inst.getNumOperands() != 1) {
+    return false;
+  }
+  int reg = getGPR64(inst.getOperand(0), MRI);
+  if (reg < 0) {
+    return false;
+  }
+  if (reg >= 8) {
+    emitByte(CB, REX_B);
+  }
+  emitByte(CB, opcode | (reg & 7));
+  return true;
+}
+
+// The immediate of a JMP_4 or a JCC_4 is a PC-relative fixup. LLVM resolves
+// it relatively to the beginning of the rel32 field, i.e. the value written
+// is (imm - 4).
+inline bool getRel32(const llvm::MCOperand &op, uint32_t &rel) {
+  if (not op.isImm() or not isInt32(op.getImm() - 4)) {
+    return false;
+  }
+  rel = static_cast<uint32_t>(op.getImm() - 4);
+  return true;
+}
+
+bool encodeJmp(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB) {
+  // JMP_4 rel32
+  uint32_t rel;
+  if (inst.getNumOperands() != 1 or not getRel32(inst.getOperand(0), rel)) {
+    return false;
+  }
+  emitByte(CB, 0xE9);
+  emitImm32(CB, rel);
+  return true;
+}
+
+bool encodeJcc(const llvm::MCInst &inst, llvm::SmallVectorImpl<char> &CB) {
+  // JCC_4 rel32, cond
+  uint32_t rel;
+  if (inst.getNumOperands() != 2 or not getRel32(inst.getOperand(0), rel) or
+      not inst.getOperand(1).isImm() or inst.getOperand(1).getImm() < 0 or
+      inst.getOperand(1).getImm() > 0xF) {
+    return false;
+  }
+  emitByte(CB, 0x0F);
+  emitByte(CB, 0x80 | inst.getOperand(1).getImm());
+  emitImm32(CB, rel);
+  return true;
+}
+
+} // anonymous namespace
+
+bool fastEncodeInstruction(const llvm::MCInst &inst,
+                           llvm::SmallVectorImpl<char> &CB,
+                           const llvm::MCRegisterInfo &MRI) {
+  if constexpr (not is_x86_64) {
+    return false;
+  }
+
+  size_t pos = CB.size();
+  bool res;
+  switch (inst.getOpcode()) {
+    case llvm::X86::MOV64rm:
+      res = encodeMovRM(inst, CB, MRI);
+      break;
+    case llvm::X86::MOV64mr:
+      res = encodeMovMR(inst, CB, MRI);
+      break;
+    case llvm::X86::MOV64rr:
+      res = encodeMovRR(inst, CB, MRI);
+      break;
+    case llvm::X86::MOV64ri:
+      res = encodeMovRI(inst, CB, MRI);
+      break;
+    case llvm::X86::MOV64ri32:
+      res = encodeMovRI32(inst, CB, MRI);
+      break;
+    case llvm::X86::PUSH64r:
+      res = encodePushPop(inst, CB, MRI, 0x50);
+      break;
+    case llvm::X86::POP64r:
+      res = encodePushPop(inst, CB, MRI, 0x58);
+      break;
+    case llvm::X86::JMP64m:
+      res = encodeJmpM(inst, CB, MRI);
+      break;
+    case llvm::X86::JMP_4:
+      res = encodeJmp(inst, CB);
+      break;
+    case llvm::X86::JCC_4:
+      res = encodeJcc(inst, CB);
+      break;
+    default:
+      return false;
+  }
+  if (not res) {
+    CB.truncate(pos);
+  }
+  return res;
+}
+
+} // namespace QBDI
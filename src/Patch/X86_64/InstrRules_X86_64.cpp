@@ -35,31 +35,29 @@ class Patch;
 
 /* Generate a series of RelocatableInst which when appended to an
  * instrumentation code trigger a break to host. It receive in argument a
- * temporary reg which will be used for computations then finally restored.
+ * temporary reg which will be restored. The address where the execution is
+ * resumed is registered in the ExecBlock with the RelocTagCallbackResume tag.
  */
 RelocatableInst::UniquePtrVec getBreakToHost(Reg temp, const Patch &patch,
-                                             bool restore) {
+                                             bool restore,
+                                             CallbackFlags flags) {
   RelocatableInst::UniquePtrVec breakToHost;
 
   QBDI_REQUIRE_ABORT(restore, "X86 don't have a temporary register");
 
-  // Use the temporary register to compute RIP + offset which is the address
-  // which will follow this patch and where the execution needs to be resumed
-  if constexpr (is_x86)
-    breakToHost.push_back(SetRegtoPCRel::unique(temp, 22));
-  else
-    breakToHost.push_back(Add(temp, Reg(REG_PC), 19));
-  // Set the selector to this address so the execution can be resumed when the
-  // exec block will be reexecuted
-  append(breakToHost,
-         SaveReg(temp, Offset(offsetof(Context, hostState.selector)))
-             .genReloc(*patch.llvmcpu));
   // Restore the temporary register
   append(breakToHost, LoadReg(temp, Offset(temp)).genReloc(*patch.llvmcpu));
-  // Jump to the epilogue to break to the host
-  append(breakToHost, JmpEpilogue().genReloc(*patch.llvmcpu));
+  if ((flags & CB_FLAG_INLINE_CALL) != 0) {
+    // Jump to the inline call stub. The stub calls the callbacks and resumes
+    // the execution without returning to the VM.
+    breakToHost.push_back(InlineCallJump::unique());
+  } else {
+    // Jump to the epilogue to break to the host
+    append(breakToHost, JmpEpilogue().genReloc(*patch.llvmcpu));
+  }
 
   // add target when callback return CONTINUE
+  breakToHost.push_back(RelocTag::unique(RelocTagCallbackResume));
   append(breakToHost, TargetPrologue().genReloc(patch));
 
   return breakToHost;
@@ -266,6 +266,32 @@ llvm::MCInst jmp(rword offset) {
   return inst;
 }
 
+llvm::MCInst call32m(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CALL32m);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst call64m(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CALL64m);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
 llvm::MCInst fxsave(RegLLVM base, rword offset) {
   llvm::MCInst inst;
 
@@ -509,6 +535,36 @@ llvm::MCInst xor64rr(RegLLVM dst, RegLLVM src) {
   return inst;
 }
 
+llvm::MCInst and32ri8(RegLLVM reg, int8_t imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::AND32ri8);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst and64ri8(RegLLVM reg, int8_t imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::AND64ri8);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst cld() {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CLD);
+
+  return inst;
+}
+
 // high level layer 2
 
 [[maybe_unused]] static bool isr8_15Reg(RegLLVM r) {
@@ -582,6 +638,13 @@ RelocatableInst::UniquePtr JmpM(Offset offset) {
     return DataBlockAbsRel::unique(jmp32m(0, 0), 3, offset, 6);
 }
 
+RelocatableInst::UniquePtr CallM(Offset offset) {
+  if constexpr (is_x86_64)
+    return DataBlockRel::unique(call64m(Reg(REG_PC), 0), 3, offset - 6, 6);
+  else
+    return DataBlockAbsRel::unique(call32m(0, 0), 3, offset, 6);
+}
+
 RelocatableInst::UniquePtr Fxsave(Offset offset) {
   return DataBlockRelx86(fxsave(0, 0), 0, offset, 7, 7);
 }
@@ -677,6 +740,15 @@ RelocatableInst::UniquePtr Xorrr(RegLLVM dst, RegLLVM src) {
     return NoRelocSized::unique(xor32rr(dst, src), 2);
 }
 
+RelocatableInst::UniquePtr Andri(Reg reg, int8_t imm) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(and64ri8(reg, imm), 4);
+  else
+    return NoRelocSized::unique(and32ri8(reg, imm), 3);
+}
+
+RelocatableInst::UniquePtr Cld() { return NoRelocSized::unique(cld(), 1); }
+
 RelocatableInst::UniquePtr Lea(RegLLVM dst, RegLLVM base, rword scale,
                                RegLLVM offset, rword disp, RegLLVM seg) {
   if (base == 0 and scale == 1 and offset != 0) {
@@ -78,6 +78,10 @@ llvm::MCInst jmp64m(RegLLVM base, rword offset);
 
 llvm::MCInst jmp(rword offset);
 
+llvm::MCInst call32m(RegLLVM base, rword offset);
+
+llvm::MCInst call64m(RegLLVM base, rword offset);
+
 llvm::MCInst fxsave(RegLLVM base, rword offset);
 
 llvm::MCInst fxrstor(RegLLVM base, rword offset);
@@ -130,10 +134,18 @@ llvm::MCInst xor32rr(RegLLVM dst, RegLLVM src);
 
 llvm::MCInst xor64rr(RegLLVM dst, RegLLVM src);
 
+llvm::MCInst and32ri8(RegLLVM reg, int8_t imm);
+
+llvm::MCInst and64ri8(RegLLVM reg, int8_t imm);
+
+llvm::MCInst cld();
+
 // high level layer 2
 
 std::unique_ptr<RelocatableInst> JmpM(Offset offset);
 
+std::unique_ptr<RelocatableInst> CallM(Offset offset);
+
 std::unique_ptr<RelocatableInst> Fxsave(Offset offset);
 
 std::unique_ptr<RelocatableInst> Fxrstor(Offset offset);
@@ -172,6 +184,10 @@ std::unique_ptr<RelocatableInst> Wrgsbase(Reg reg);
 
 std::unique_ptr<RelocatableInst> Xorrr(RegLLVM dst, RegLLVM src);
 
+std::unique_ptr<RelocatableInst> Andri(Reg reg, int8_t imm);
+
+std::unique_ptr<RelocatableInst> Cld();
+
 std::unique_ptr<RelocatableInst> Lea(RegLLVM dst, RegLLVM base, rword scale,
                                      RegLLVM offset, rword disp, RegLLVM seg);
 
@@ -43,6 +43,7 @@
 
 #include "QBDI/Bitmask.h"
 #include "QBDI/Callback.h"
+#include "QBDI/Options.h"
 #include "QBDI/State.h"
 
 namespace llvm {
@@ -67,6 +68,12 @@ enum MemoryTag : uint16_t {
   MEM_WRITE_END_ADDRESS_TAG = MEMORY_TAG_BEGIN + 9,
 };
 
+// With OPT_DISABLE_MEMORYACCESS_VALUE, only the address of the accesses is
+// recorded.
+static inline bool recordValue(const LLVMCPU &llvmcpu) {
+  return (llvmcpu.getOptions() & Options::OPT_DISABLE_MEMORYACCESS_VALUE) == 0;
+}
+
 void analyseMemoryAccessAddrValue(const ExecBlock &curExecBlock,
                                   llvm::ArrayRef<ShadowInfo> &shadows,
                                   std::vector<MemoryAccess> &dest,
@@ -104,7 +111,7 @@ void analyseMemoryAccessAddrValue(const ExecBlock &curExecBlock,
   access.accessAddress = curExecBlock.getShadow(shadows[0].shadowID);
   access.instAddress = curExecBlock.getInstAddress(shadows[0].instID);
 
-  if (access.size > sizeof(rword)) {
+  if (access.size > sizeof(rword) or not recordValue(llvmcpu)) {
     access.flags |= MEMORY_UNKNOWN_VALUE;
     access.value = 0;
     dest.push_back(std::move(access));
@@ -266,7 +273,8 @@ generatePreReadInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
   }
   // instruction with double read
   else if (isDoubleRead(patch.metadata.inst)) {
-    if (getReadSize(patch.metadata.inst, llvmcpu) > sizeof(rword)) {
+    if (getReadSize(patch.metadata.inst, llvmcpu) > sizeof(rword) or
+        not recordValue(llvmcpu)) {
       static const PatchGenerator::UniquePtrVec r = conv_unique<PatchGenerator>(
           GetReadAddress::unique(Temp(0), 0),
           WriteTemp::unique(Temp(0), Shadow(MEM_READ_ADDRESS_TAG)),
@@ -286,7 +294,8 @@ generatePreReadInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
       return r;
     }
   } else {
-    if (getReadSize(patch.metadata.inst, llvmcpu) > sizeof(rword)) {
+    if (getReadSize(patch.metadata.inst, llvmcpu) > sizeof(rword) or
+        not recordValue(llvmcpu)) {
       static const PatchGenerator::UniquePtrVec r = conv_unique<PatchGenerator>(
           GetReadAddress::unique(Temp(0)),
           WriteTemp::unique(Temp(0), Shadow(MEM_READ_ADDRESS_TAG)));
@@ -366,7 +375,8 @@ generatePostWriteInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
   // Some instruction need to have the address get before the instruction
   else if (mayChangeWriteAddr(patch.metadata.inst, desc) and
            not isStackWrite(patch.metadata.inst)) {
-    if (getWriteSize(patch.metadata.inst, llvmcpu) > sizeof(rword)) {
+    if (getWriteSize(patch.metadata.inst, llvmcpu) > sizeof(rword) or
+        not recordValue(llvmcpu)) {
       static const PatchGenerator::UniquePtrVec r;
       return r;
     } else {
@@ -377,7 +387,8 @@ generatePostWriteInstrumentPatch(Patch &patch, const LLVMCPU &llvmcpu) {
       return r;
     }
   } else {
-    if (getWriteSize(patch.metadata.inst, llvmcpu) > sizeof(rword)) {
+    if (getWriteSize(patch.metadata.inst, llvmcpu) > sizeof(rword) or
+        not recordValue(llvmcpu)) {
       static const PatchGenerator::UniquePtrVec r = conv_unique<PatchGenerator>(
           GetWriteAddress::unique(Temp(0)),
           WriteTemp::unique(Temp(0), Shadow(MEM_WRITE_ADDRESS_TAG)));
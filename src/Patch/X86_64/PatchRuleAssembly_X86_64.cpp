@@ -278,8 +278,8 @@ std::vector<PatchRule> getDefaultPatchRules(Options opts) {
 } // namespace
 
 PatchRuleAssembly::PatchRuleAssembly(Options opts)
-    : patchRules(getDefaultPatchRules(opts)), options(opts),
-      mergePending(false) {}
+    : patchRules(getDefaultPatchRules(opts)), patchRulesIndex(patchRules),
+      options(opts), mergePending(false) {}
 
 PatchRuleAssembly::~PatchRuleAssembly() = default;
 
@@ -294,9 +294,11 @@ bool PatchRuleAssembly::changeOptions(Options opts) {
 #if defined(QBDI_ARCH_X86_64)
                                Options::OPT_ENABLE_FS_GS |
 #endif
+                               Options::OPT_ENABLE_INLINE_CALL |
                                Options::OPT_DISABLE_OPTIONAL_FPR;
   if ((opts & needRecreate) != (options & needRecreate)) {
     patchRules = getDefaultPatchRules(opts);
+    patchRulesIndex = PatchRuleIndex(patchRules);
     options = opts;
     return true;
   }
@@ -332,7 +334,8 @@ bool PatchRuleAssembly::generate(const llvm::MCInst &inst, rword address,
   Patch instPatch{inst, address, instSize, llvmcpu};
   setRegisterSaved(instPatch);
 
-  for (uint32_t j = 0; j < patchRules.size(); j++) {
+  unsigned opcode = instPatch.metadata.inst.getOpcode();
+  for (uint32_t j : patchRulesIndex.getRules(opcode)) {
     if (patchRules[j].canBeApplied(instPatch, llvmcpu)) {
       QBDI_DEBUG("Patch rule {} applied", j);
       if (mergePending) {
@@ -20,13 +20,14 @@
 
 #include <stdbool.h>
 
+#include "Patch/PatchRule.h"
 #include "Patch/PatchRuleAssemblyBase.h"
 
 namespace QBDI {
-class PatchRule;
 
 class PatchRuleAssembly final : public PatchRuleAssemblyBase {
   std::vector<PatchRule> patchRules;
+  PatchRuleIndex patchRulesIndex;
   Options options;
   bool mergePending;
 
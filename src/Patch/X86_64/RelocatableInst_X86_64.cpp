@@ -195,6 +195,26 @@ int InstId::getSize(const LLVMCPU &llvmcpu) const {
   }
 }
 
+// CallbackId
+// ==========
+
+llvm::MCInst CallbackId::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
+  uint16_t v = execBlock->newCallback(callbacks, flags);
+  if constexpr (is_x86_64) {
+    return mov64ri32(reg, v);
+  } else {
+    return mov32ri(reg, v);
+  }
+}
+
+int CallbackId::getSize(const LLVMCPU &llvmcpu) const {
+  if constexpr (is_x86_64) {
+    return 7;
+  } else {
+    return 5;
+  }
+}
+
 // Target Specific RelocatableInst
 
 // EpilogueJump
@@ -206,6 +226,21 @@ llvm::MCInst EpilogueJump::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
 
 int EpilogueJump::getSize(const LLVMCPU &llvmcpu) const { return 5; }
 
+// InlineCallJump
+// ==============
+
+llvm::MCInst InlineCallJump::reloc(ExecBlock *execBlock,
+                                   CPUMode cpumode) const {
+  // without OPT_ENABLE_INLINE_CALL, the stub isn't available and the callback
+  // is handled by the VM as any other callback
+  if (not execBlock->hasInlineCall()) {
+    return jmp(execBlock->getEpilogueOffset() - 1);
+  }
+  return jmp(execBlock->getInlineCallOffset() - 1);
+}
+
+int InlineCallJump::getSize(const LLVMCPU &llvmcpu) const { return 5; }
+
 // SetRegtoPCRel
 // =============
 
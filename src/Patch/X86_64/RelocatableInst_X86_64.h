@@ -58,6 +58,17 @@ public:
   int getSize(const LLVMCPU &llvmcpu) const override;
 };
 
+class InlineCallJump : public AutoClone<RelocatableInst, InlineCallJump> {
+
+public:
+  InlineCallJump() : AutoClone<RelocatableInst, InlineCallJump>() {}
+
+  // Jump to the inline call stub of the ExecBlock
+  llvm::MCInst reloc(ExecBlock *execBlock, CPUMode cpumode) const override;
+
+  int getSize(const LLVMCPU &llvmcpu) const override;
+};
+
 class SetRegtoPCRel : public AutoClone<RelocatableInst, SetRegtoPCRel> {
   Reg reg;
   rword offset;
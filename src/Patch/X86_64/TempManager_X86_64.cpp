@@ -36,7 +36,12 @@ void TempManager::generateSaveRestoreInstructions(
   Reg::Vec usedRegisters = getUsedRegisters();
 
   for (Reg r : usedRegisters) {
-    if (shouldRestore(r)) {
+    if (shouldRestore(r) and isDeadRegister(r)) {
+      // the value of the register is dead, it is neither saved nor restored
+      if (unrestoredReg.size() < unrestoredRegNum) {
+        unrestoredReg.push_back(r);
+      }
+    } else if (shouldRestore(r)) {
       append(saveInst, SaveReg(r, Offset(r)).genReloc(*patch.llvmcpu));
       if (unrestoredReg.size() < unrestoredRegNum) {
         unrestoredReg.push_back(r);
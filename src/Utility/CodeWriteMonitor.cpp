@@ -0,0 +1,321 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <functional>
+
+#include "llvm/Support/Process.h"
+
+#include "QBDI/Config.h"
+#include "QBDI/Memory.h"
+#include "QBDI/Memory.hpp"
+#include "Utility/CodeWriteMonitor.h"
+#include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
+
+#if defined(QBDI_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#endif
+
+namespace QBDI {
+
+namespace {
+
+// The handler must be async-signal-safe: no log, no allocation and no lock.
+
+bool protectPage(rword page, rword size, unsigned int permission) {
+#if defined(QBDI_PLATFORM_WINDOWS)
+  DWORD prot;
+  DWORD oldProt;
+  switch (permission & (PF_READ | PF_WRITE | PF_EXEC)) {
+    case PF_NONE:
+      prot = PAGE_NOACCESS;
+      break;
+    case PF_READ:
+      prot = PAGE_READONLY;
+      break;
+    case PF_EXEC:
+      prot = PAGE_EXECUTE;
+      break;
+    case PF_READ | PF_EXEC:
+      prot = PAGE_EXECUTE_READ;
+      break;
+    case PF_READ | PF_WRITE:
+    case PF_WRITE:
+      prot = PAGE_READWRITE;
+      break;
+    default:
+      prot = PAGE_EXECUTE_READWRITE;
+      break;
+  }
+  return VirtualProtect(reinterpret_cast<void *>(page), size, prot,
+                        &oldProt) != 0;
+#else
+  int prot = PROT_NONE;
+  if (permission & PF_READ) {
+    prot |= PROT_READ;
+  }
+  if (permission & PF_WRITE) {
+    prot |= PROT_WRITE;
+  }
+  if (permission & PF_EXEC) {
+    prot |= PROT_EXEC;
+  }
+  return mprotect(reinterpret_cast<void *>(page), size, prot) == 0;
+#endif
+}
+
+#if defined(QBDI_PLATFORM_WINDOWS)
+
+PVOID faultHandlerHandle = nullptr;
+
+LONG CALLBACK faultHandler(PEXCEPTION_POINTERS info) {
+  PEXCEPTION_RECORD record = info->ExceptionRecord;
+  // ExceptionInformation[0] is 1 for a write access
+  if (record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION and
+      record->NumberParameters >= 2 and
+      record->ExceptionInformation[0] == 1 and
+      CodeWriteMonitor::get().handleFault(
+          static_cast<rword>(record->ExceptionInformation[1]))) {
+    return EXCEPTION_CONTINUE_EXECUTION;
+  }
+  return EXCEPTION_CONTINUE_SEARCH;
+}
+
+void installFaultHandler() {
+  if (faultHandlerHandle == nullptr) {
+    faultHandlerHandle = AddVectoredExceptionHandler(1, faultHandler);
+    QBDI_REQUIRE_ABORT(faultHandlerHandle != nullptr,
+                       "Fail to install the exception handler");
+  }
+}
+
+#else
+
+#if defined(QBDI_PLATFORM_OSX)
+constexpr int faultSignals[] = {SIGSEGV, SIGBUS};
+#else
+constexpr int faultSignals[] = {SIGSEGV};
+#endif
+constexpr size_t nbFaultSignals = sizeof(faultSignals) / sizeof(int);
+
+struct sigaction previousHandlers[nbFaultSignals];
+
+void faultHandler(int sig, siginfo_t *info, void *ucontext) {
+  if (CodeWriteMonitor::get().handleFault(
+          reinterpret_cast<rword>(info->si_addr))) {
+    return;
+  }
+  // The fault isn't caused by the monitor, forward it to the previous handler
+  for (size_t i = 0; i < nbFaultSignals; i++) {
+    if (faultSignals[i] != sig) {
+      continue;
+    }
+    const struct sigaction &previous = previousHandlers[i];
+    if (previous.sa_flags & SA_SIGINFO) {
+      previous.sa_sigaction(sig, info, ucontext);
+    } else if (previous.sa_handler == SIG_DFL or
+               previous.sa_handler == SIG_IGN) {
+      // the faulting instruction is executed again with the default action
+      signal(sig, SIG_DFL);
+    } else {
+      previous.sa_handler(sig);
+    }
+    return;
+  }
+}
+
+void installFaultHandler() {
+  for (size_t i = 0; i < nbFaultSignals; i++) {
+    struct sigaction current;
+    QBDI_REQUIRE_ABORT(sigaction(faultSignals[i], nullptr, &current) == 0,
+                       "Fail to get the handler of signal {}",
+                       faultSignals[i]);
+    if ((current.sa_flags & SA_SIGINFO) and
+        current.sa_sigaction == faultHandler) {
+      continue;
+    }
+    // The handler isn't installed, or has been replaced by the target
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = faultHandler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    QBDI_REQUIRE_ABORT(
+        sigaction(faultSignals[i], &action, &previousHandlers[i]) == 0,
+        "Fail to install the handler of signal {}", faultSignals[i]);
+  }
+}
+
+#endif
+
+} // anonymous namespace
+
+CodeWriteMonitor::CodeWriteMonitor()
+    : pageSize(llvm::expectedToOptional(llvm::sys::Process::getPageSize())
+                   .value_or(4096)),
+      usedPages(0), pages(new Page[MAX_PAGES]()), writeCounter(0) {}
+
+CodeWriteMonitor &CodeWriteMonitor::get() {
+  static CodeWriteMonitor monitor;
+  return monitor;
+}
+
+CodeWriteMonitor::Page *CodeWriteMonitor::findPage(rword page) const {
+  size_t index = std::hash<rword>{}(page / pageSize) % MAX_PAGES;
+  for (size_t i = 0; i < MAX_PAGES; i++) {
+    Page &p = pages[(index + i) % MAX_PAGES];
+    rword address = p.address.load(std::memory_order_acquire);
+    if (address == page) {
+      return &p;
+    } else if (address == 0) {
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+CodeWriteMonitor::Page *CodeWriteMonitor::insertPage(rword page) {
+  // keep short probe sequences for the fault handler
+  if (usedPages >= MAX_PAGES / 4 * 3) {
+    return nullptr;
+  }
+  size_t index = std::hash<rword>{}(page / pageSize) % MAX_PAGES;
+  for (size_t i = 0; i < MAX_PAGES; i++) {
+    Page &p = pages[(index + i) % MAX_PAGES];
+    if (p.address.load(std::memory_order_relaxed) == 0) {
+      p.state.store(PAGE_WRITABLE, std::memory_order_relaxed);
+      p.users = 0;
+      // the slot is visible to the handler once the address is set
+      p.address.store(page, std::memory_order_release);
+      usedPages++;
+      return &p;
+    }
+  }
+  return nullptr;
+}
+
+CodeWriteMonitor::WatchResult CodeWriteMonitor::watch(rword page,
+                                                      uint32_t &writes) {
+  QBDI_REQUIRE_ACTION(page != 0 and page % pageSize == 0, return WATCH_FAILED);
+  std::lock_guard<std::mutex> guard(lock);
+
+  Page *p = findPage(page);
+  if (p == nullptr or p->state.load() == PAGE_WRITABLE) {
+    // Get the current protection of the page. The page may have been mapped
+    // after the snapshot.
+    const MemoryMap *map = ProcessMaps::get().snapshot()->findByAddress(page);
+    if (map == nullptr or not map->range.contains({page, page + pageSize})) {
+      map = ProcessMaps::get().refresh()->findByAddress(page);
+    }
+    if (map == nullptr or not map->range.contains({page, page + pageSize})) {
+      QBDI_DEBUG("No map for the code page 0x{:x}", page);
+      return WATCH_FAILED;
+    }
+    if ((map->permission & PF_WRITE) == 0) {
+      return WATCH_READONLY;
+    }
+    if (p == nullptr) {
+      p = insertPage(page);
+      if (p == nullptr) {
+        QBDI_DEBUG("Too many code pages watched");
+        return WATCH_FAILED;
+      }
+    }
+    p->permission = map->permission;
+  }
+
+  if (p->state.load() == PAGE_HOT) {
+    return WATCH_FAILED;
+  }
+
+  if (p->state.load() == PAGE_WRITABLE) {
+    installFaultHandler();
+    p->retries.store(0);
+    // the state is set before the protection: a concurrent write on the page
+    // must be seen by the handler
+    p->state.store(PAGE_PROTECTED);
+    if (not protectPage(page, pageSize, p->permission & ~PF_WRITE)) {
+      QBDI_DEBUG("Fail to write-protect the code page 0x{:x}", page);
+      uint8_t expected = PAGE_PROTECTED;
+      p->state.compare_exchange_strong(expected, PAGE_WRITABLE);
+      return WATCH_FAILED;
+    }
+  }
+
+  p->users++;
+  writes = p->writes.load(std::memory_order_acquire);
+  return WATCH_OK;
+}
+
+void CodeWriteMonitor::unwatch(rword page) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  Page *p = findPage(page);
+  QBDI_REQUIRE_ACTION(p != nullptr and p->users > 0, return);
+
+  p->users--;
+  if (p->users == 0 and p->state.load() == PAGE_PROTECTED) {
+    protectPage(page, pageSize, p->permission);
+    uint8_t expected = PAGE_PROTECTED;
+    p->state.compare_exchange_strong(expected, PAGE_WRITABLE);
+  }
+}
+
+uint32_t CodeWriteMonitor::getWrites(rword page) const {
+  Page *p = findPage(page);
+  if (p == nullptr) {
+    return 0;
+  }
+  return p->writes.load(std::memory_order_acquire);
+}
+
+bool CodeWriteMonitor::handleFault(rword address) {
+  Page *p = findPage(address - (address % pageSize));
+  if (p == nullptr) {
+    return false;
+  }
+  uint8_t state = p->state.load();
+  if (state == PAGE_PROTECTED) {
+    // restore the protection before changing the state: the page must stay
+    // protected while the state is PAGE_PROTECTED
+    if (not protectPage(p->address.load(std::memory_order_relaxed), pageSize,
+                        p->permission)) {
+      return false;
+    }
+    uint8_t expected = PAGE_PROTECTED;
+    if (p->state.compare_exchange_strong(expected, PAGE_WRITABLE)) {
+      p->retries.store(0);
+      if (p->writes.fetch_add(1, std::memory_order_acq_rel) + 1 >=
+          HOT_THRESHOLD) {
+        expected = PAGE_WRITABLE;
+        p->state.compare_exchange_strong(expected, PAGE_HOT);
+      }
+      writeCounter.fetch_add(1, std::memory_order_release);
+    }
+    return true;
+  }
+  // Another thread has restored the protection between the fault and the
+  // handler. The protection of the page has already been restored, unless
+  // the fault is not a write on the page.
+  return p->retries.fetch_add(1) < MAX_RETRIES;
+}
+
+} // namespace QBDI
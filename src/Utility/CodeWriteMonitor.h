@@ -0,0 +1,136 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CODEWRITEMONITOR_H
+#define CODEWRITEMONITOR_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Process-wide detection of the writes in the pages of translated code, used
+ * by OPT_DETECT_SELF_MODIFYING_CODE.
+ *
+ * A watched page is write-protected. The first write in the page raises a
+ * fault: the handler restores the protection of the page, counts the write
+ * and the faulting instruction is executed again. The Engines poll the
+ * counters, invalidate the sequences of the written pages and watch them
+ * again when their code is translated again. A page written HOT_THRESHOLD
+ * times isn't protected anymore.
+ *
+ * The fault handler doesn't allocate nor lock: the pages are stored in a
+ * fixed size open addressing table, where a slot is never released.
+ */
+class CodeWriteMonitor {
+public:
+  static constexpr size_t MAX_PAGES = 1 << 14;
+  static constexpr uint32_t HOT_THRESHOLD = 16;
+  // faults accepted on a page unprotected by another thread, before the
+  // handler considers that the fault isn't caused by the monitor
+  static constexpr uint32_t MAX_RETRIES = 64;
+
+  enum WatchResult {
+    WATCH_OK,       // the page is write-protected
+    WATCH_READONLY, // the page isn't writable, no need to watch it
+    WATCH_FAILED,   // the page is written too often or the table is full
+  };
+
+private:
+  enum PageState : uint8_t {
+    PAGE_WRITABLE,
+    PAGE_PROTECTED,
+    PAGE_HOT,
+  };
+
+  struct Page {
+    std::atomic<rword> address; // 0 for a free slot
+    std::atomic<uint8_t> state;
+    std::atomic<uint32_t> writes;
+    std::atomic<uint32_t> retries;
+    uint32_t users;          // number of Engines watching the page
+    unsigned int permission; // original Permission of the page
+  };
+
+  std::mutex lock;
+  rword pageSize;
+  size_t usedPages;
+  std::unique_ptr<Page[]> pages;
+  std::atomic<uint64_t> writeCounter;
+
+  CodeWriteMonitor();
+
+  Page *findPage(rword page) const;
+
+  Page *insertPage(rword page);
+
+public:
+  CodeWriteMonitor(const CodeWriteMonitor &) = delete;
+  CodeWriteMonitor &operator=(const CodeWriteMonitor &) = delete;
+
+  static CodeWriteMonitor &get();
+
+  inline rword getPageSize() const { return pageSize; }
+
+  /*! Write-protect a page of translated code for an Engine. Each successful
+   * watch must be followed by an unwatch.
+   *
+   * @param[in]  page    The address of the page
+   * @param[out] writes  The number of writes already caught in the page
+   *
+   * @return WATCH_OK if the page is watched
+   */
+  WatchResult watch(rword page, uint32_t &writes);
+
+  /*! Release a page watched by an Engine. The original protection of the page
+   * is restored when no Engine watches it anymore.
+   *
+   * @param[in] page  The address of the page
+   */
+  void unwatch(rword page);
+
+  /*! Get the number of writes caught in all the pages. It changes each time a
+   * watched page is written.
+   */
+  inline uint64_t getWriteCounter() const {
+    return writeCounter.load(std::memory_order_acquire);
+  }
+
+  /*! Get the number of writes caught in a page.
+   *
+   * @param[in] page  The address of the page
+   */
+  uint32_t getWrites(rword page) const;
+
+  /*! Handle a memory fault. Called by the fault handler.
+   *
+   * @param[in] address  The address of the fault
+   *
+   * @return True if the fault is caused by a watched page and the faulting
+   *         instruction can be executed again
+   */
+  bool handleFault(rword address);
+};
+
+} // namespace QBDI
+
+#endif // CODEWRITEMONITOR_H
@@ -21,8 +21,10 @@
 #include <map>
 #include <string.h>
 #include <string>
+#include <tuple>
 #include <utility>
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCInstrDesc.h"
@@ -43,10 +45,9 @@
 #include "QBDI/InstAnalysis.h"
 #include "QBDI/State.h"
 
-#ifndef QBDI_PLATFORM_WINDOWS
-#if defined(QBDI_PLATFORM_LINUX) && !defined(__USE_GNU)
-#define __USE_GNU
-#endif
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+#include "Utility/SymbolIndex.h"
+#elif !defined(QBDI_PLATFORM_WINDOWS)
 #include <dlfcn.h>
 #endif
 
@@ -264,7 +265,7 @@ void analyseImplicitRegisters(InstAnalysis *instAnalysis,
 }
 
 void analyseOperands(InstAnalysis *instAnalysis, const llvm::MCInst &inst,
-                     const LLVMCPU &llvmcpu) {
+                     const LLVMCPU &llvmcpu, InstAnalysisCache &cache) {
   if (!instAnalysis) {
     // no instruction analysis
     return;
@@ -293,7 +294,9 @@ void analyseOperands(InstAnalysis *instAnalysis, const llvm::MCInst &inst,
     // no operand to analyse
     return;
   }
-  instAnalysis->operands = new OperandAnalysis[numOperandsMax]();
+  // work in a temporary buffer, only the used operands are kept in the cache
+  llvm::SmallVector<OperandAnalysis, 16> operandsBuffer(numOperandsMax);
+  instAnalysis->operands = operandsBuffer.data();
   // limit operandDescription
   unsigned maxOperandDesc = desc.getNumOperands();
   if (desc.isVariadic()) {
@@ -440,45 +443,162 @@ void analyseOperands(InstAnalysis *instAnalysis, const llvm::MCInst &inst,
   // (R|E)SP are missing for RET and CALL in x86
   getAdditionnalOperand(instAnalysis, inst, desc, MRI);
 
-  // reduce operands buffer if possible
-  if (instAnalysis->numOperands < numOperandsMax) {
-    OperandAnalysis *oldbuff = instAnalysis->operands;
-    if (instAnalysis->numOperands == 0) {
-      instAnalysis->operands = nullptr;
+  // move the used operands in the cache arena
+  if (instAnalysis->numOperands == 0) {
+    instAnalysis->operands = nullptr;
+  } else {
+    instAnalysis->operands = cache.allocateOperands(instAnalysis->numOperands);
+    memcpy(instAnalysis->operands, operandsBuffer.data(),
+           sizeof(OperandAnalysis) * instAnalysis->numOperands);
+  }
+}
+
+} // namespace InstructionAnalysis
+
+bool InstAnalysisCache::Key::operator<(const Key &other) const {
+  return std::tie(address, instSize, cpuMode, modifyPC, encodedInst) <
+         std::tie(other.address, other.instSize, other.cpuMode, other.modifyPC,
+                  other.encodedInst);
+}
+
+bool InstAnalysisCache::buildKey(Key &key, const InstMetadata &instMetadata) {
+  const llvm::MCInst &inst = instMetadata.inst;
+
+  key.address = instMetadata.address;
+  key.instSize = instMetadata.instSize;
+  key.cpuMode = instMetadata.cpuMode;
+  key.modifyPC = instMetadata.modifyPC;
+  // The MCInst is fully determined by the bytes of the instruction. Using it
+  // avoids reading the original code again, which may have been unmapped.
+  key.encodedInst.push_back(inst.getOpcode());
+  for (const llvm::MCOperand &op : inst) {
+    if (op.isReg()) {
+      key.encodedInst.push_back(1);
+      key.encodedInst.push_back(op.getReg());
+    } else if (op.isImm()) {
+      key.encodedInst.push_back(2);
+      key.encodedInst.push_back(static_cast<uint64_t>(op.getImm()));
+    } else if (op.isSFPImm()) {
+      key.encodedInst.push_back(3);
+      key.encodedInst.push_back(op.getSFPImm());
+    } else if (op.isDFPImm()) {
+      key.encodedInst.push_back(4);
+      key.encodedInst.push_back(op.getDFPImm());
+    } else if (op.isValid()) {
+      // expression or sub-instruction: not produced by the disassembler
+      return false;
     } else {
-      instAnalysis->operands = new OperandAnalysis[instAnalysis->numOperands]();
-      memcpy(instAnalysis->operands, oldbuff,
-             sizeof(OperandAnalysis) * instAnalysis->numOperands);
+      key.encodedInst.push_back(0);
     }
-    delete[] oldbuff;
   }
+  return true;
 }
 
-} // namespace InstructionAnalysis
+void InstAnalysisCache::Arena::reset() {
+  strings.clear();
+  allocator.Reset();
+  allocated = 0;
+}
 
-void InstAnalysisDestructor::operator()(InstAnalysis *ptr) const {
-  if (ptr == nullptr) {
-    return;
+InstAnalysis *InstAnalysisCache::promote(const InstAnalysis *previous) {
+  Arena &arena = currentArena();
+  InstAnalysis *instAnalysis = arena.allocator.Allocate<InstAnalysis>();
+  arena.allocated++;
+  memcpy(instAnalysis, previous, sizeof(InstAnalysis));
+
+  // the strings and the operands are in the arena of the previous generation
+  if (previous->disassembly != nullptr) {
+    instAnalysis->disassembly = internString(previous->disassembly);
   }
-  if (ptr->operands != nullptr) {
-    delete[] ptr->operands;
+  if (previous->operands != nullptr) {
+    instAnalysis->operands = allocateOperands(previous->numOperands);
+    memcpy(instAnalysis->operands, previous->operands,
+           sizeof(OperandAnalysis) * previous->numOperands);
   }
-  if (ptr->disassembly != nullptr) {
-    delete[] ptr->disassembly;
+  return instAnalysis;
+}
+
+InstAnalysis *InstAnalysisCache::get(const InstMetadata &instMetadata) {
+  Key key;
+  bool cacheable = buildKey(key, instMetadata);
+  if (cacheable) {
+    auto it = analysis.find(key);
+    if (it != analysis.end()) {
+      if (it->second.generation != generation) {
+        it->second.analysis = promote(it->second.analysis);
+        it->second.generation = generation;
+      }
+      return it->second.analysis;
+    }
+  }
+
+  Arena &arena = currentArena();
+  InstAnalysis *instAnalysis = arena.allocator.Allocate<InstAnalysis>();
+  arena.allocated++;
+  // set all values to NULL/0/false
+  memset(instAnalysis, 0, sizeof(InstAnalysis));
+
+  if (cacheable) {
+    analysis.emplace(std::move(key), Entry{instAnalysis, generation});
   }
-  delete ptr;
+  return instAnalysis;
+}
+
+OperandAnalysis *InstAnalysisCache::allocateOperands(size_t count) {
+  OperandAnalysis *operands =
+      currentArena().allocator.Allocate<OperandAnalysis>(count);
+  memset(operands, 0, sizeof(OperandAnalysis) * count);
+  return operands;
+}
+
+char *InstAnalysisCache::internString(llvm::StringRef str) {
+  Arena &arena = currentArena();
+  auto it = arena.strings.find(std::string_view(str.data(), str.size()));
+  if (it != arena.strings.end()) {
+    return const_cast<char *>(it->data());
+  }
+  char *buffer = arena.allocator.Allocate<char>(str.size() + 1);
+  memcpy(buffer, str.data(), str.size());
+  buffer[str.size()] = '\0';
+  arena.strings.emplace(buffer, str.size());
+  return buffer;
+}
+
+void InstAnalysisCache::newGeneration() {
+  // the analysis of the previous generation weren't used during the current
+  // one. Their arena becomes the arena of the new generation.
+  auto it = analysis.begin();
+  while (it != analysis.end()) {
+    if (it->second.generation != generation) {
+      it = analysis.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  generation++;
+  currentArena().reset();
+}
+
+void InstAnalysisCache::clear() {
+  analysis.clear();
+  arenas[0].reset();
+  arenas[1].reset();
+  // the InstMetadata of both generations must look up their analysis again
+  generation += 2;
 }
 
 const InstAnalysis *analyzeInstMetadata(const InstMetadata &instMetadata,
                                         AnalysisType type,
                                         const LLVMCPU &llvmcpu) {
 
-  InstAnalysis *instAnalysis = instMetadata.analysis.get();
-  if (instAnalysis == nullptr) {
-    instAnalysis = new InstAnalysis;
-    // set all values to NULL/0/false
-    memset(instAnalysis, 0, sizeof(InstAnalysis));
-    instMetadata.analysis.reset(instAnalysis);
+  InstAnalysisCache &cache = llvmcpu.getAnalysisCache();
+
+  InstAnalysis *instAnalysis = instMetadata.analysis;
+  if (instAnalysis == nullptr or
+      instMetadata.analysisGeneration != cache.getGeneration()) {
+    instAnalysis = cache.get(instMetadata);
+    instMetadata.analysis = instAnalysis;
+    instMetadata.analysisGeneration = cache.getGeneration();
   }
 
   uint32_t oldType = instAnalysis->analysisType;
@@ -497,10 +617,7 @@ const InstAnalysis *analyzeInstMetadata(const InstMetadata &instMetadata,
 
   if (missingType & ANALYSIS_DISASSEMBLY) {
     std::string buffer = llvmcpu.showInst(inst, instMetadata.address);
-    int len = buffer.size() + 1;
-    instAnalysis->disassembly = new char[len];
-    strncpy(instAnalysis->disassembly, buffer.c_str(), len);
-    buffer.clear();
+    instAnalysis->disassembly = cache.internString(buffer);
   }
 
   if (missingType & ANALYSIS_INSTRUCTION) {
@@ -536,21 +653,28 @@ const InstAnalysis *analyzeInstMetadata(const InstMetadata &instMetadata,
       }
     }
     // analyse operands (immediates / registers)
-    InstructionAnalysis::analyseOperands(instAnalysis, inst, llvmcpu);
+    InstructionAnalysis::analyseOperands(instAnalysis, inst, llvmcpu, cache);
   }
 
   if (missingType & ANALYSIS_SYMBOL) {
     // find nearest symbol (if any)
-#ifndef QBDI_PLATFORM_WINDOWS
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+    SymbolInfo info;
+    if (SymbolIndex::get().lookup(instMetadata.address, info)) {
+      instAnalysis->symbolName = info.symbolName;
+      instAnalysis->symbolOffset = info.symbolOffset;
+      instAnalysis->moduleName = info.moduleName;
+    }
+#elif !defined(QBDI_PLATFORM_WINDOWS)
     Dl_info info;
     const char *ptr;
 
-    int ret = dladdr((void *)instAnalysis->address, &info);
+    int ret = dladdr((void *)instMetadata.address, &info);
     if (ret != 0) {
       if (info.dli_sname) {
         instAnalysis->symbolName = info.dli_sname;
         instAnalysis->symbolOffset =
-            instAnalysis->address - (rword)info.dli_saddr;
+            instMetadata.address - (rword)info.dli_saddr;
       }
       if (info.dli_fname) {
         // dirty basename, but thead safe
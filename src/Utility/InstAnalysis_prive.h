@@ -18,7 +18,14 @@
 #ifndef INSTANALYSISPRIVE_H
 #define INSTANALYSISPRIVE_H
 
+#include <map>
 #include <memory>
+#include <string_view>
+#include <unordered_set>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 
 #include "QBDI/InstAnalysis.h"
 
@@ -36,12 +43,109 @@ namespace QBDI {
 class InstMetadata;
 class LLVMCPU;
 
-struct InstAnalysisDestructor {
-  void operator()(InstAnalysis *ptr) const;
+/*! Store of the InstAnalysis of a VM.
+ *
+ * The analysis are deduplicated on the decoded instruction (address, CPU mode,
+ * size and MCInst) and are allocated in an arena with their operands. They
+ * are not owned by the ExecBlock anymore and therefore survive the flush of
+ * the cache: a retranslated instruction reuses the previous analysis. The
+ * disassembly strings are interned in the same arena.
+ *
+ * The memory is reclaimed by generations. Each generation allocates in its own
+ * arena. When the arena of the current generation is full, the Engine starts
+ * a new generation between two sequences: the analysis used in the previous
+ * generation are moved to the new arena on their next use, and the arena of
+ * the generation before is freed with the analysis that weren't used since.
+ * An InstMetadata keeps the generation of its analysis pointer and looks up
+ * the analysis again when the generation has changed.
+ */
+class InstAnalysisCache {
+public:
+  static constexpr size_t GENERATION_SIZE = 1 << 16;
+
+private:
+  struct Key {
+    rword address;
+    uint32_t instSize;
+    CPUMode cpuMode;
+    bool modifyPC;
+    llvm::SmallVector<uint64_t, 12> encodedInst;
+
+    bool operator<(const Key &other) const;
+  };
+
+  struct Entry {
+    InstAnalysis *analysis;
+    uint32_t generation;
+  };
+
+  struct Arena {
+    llvm::BumpPtrAllocator allocator;
+    std::unordered_set<std::string_view> strings;
+    size_t allocated = 0;
+
+    void reset();
+  };
+
+  std::map<Key, Entry> analysis;
+  // the arenas of the current and the previous generation
+  Arena arenas[2];
+  uint32_t generation = 1;
+
+  inline Arena &currentArena() { return arenas[generation % 2]; }
+
+  static bool buildKey(Key &key, const InstMetadata &instMetadata);
+
+  InstAnalysis *promote(const InstAnalysis *previous);
+
+public:
+  InstAnalysisCache() = default;
+
+  InstAnalysisCache(const InstAnalysisCache &) = delete;
+  InstAnalysisCache &operator=(const InstAnalysisCache &) = delete;
+
+  /*! Get the analysis of an instruction. A new empty analysis is created if
+   * the instruction isn't in the cache.
+   *
+   * @param[in] instMetadata  The metadata of the instruction
+   *
+   * @return a pointer to the analysis, valid until the end of the next
+   *         generation
+   */
+  InstAnalysis *get(const InstMetadata &instMetadata);
+
+  /*! Allocate a zeroed array of OperandAnalysis in the arena.
+   *
+   * @param[in] count  The number of operands
+   */
+  OperandAnalysis *allocateOperands(size_t count);
+
+  /*! Intern a string in the arena.
+   *
+   * @param[in] str  The string to intern
+   *
+   * @return a null terminated copy of the string
+   */
+  char *internString(llvm::StringRef str);
+
+  /*! Start a new generation. The analysis not used during the current
+   * generation are freed. No analysis pointer must be in use by a callback.
+   */
+  void newGeneration();
+
+  /*! Drop all the analysis.
+   */
+  void clear();
+
+  inline uint32_t getGeneration() const { return generation; }
+
+  inline size_t size() const { return analysis.size(); }
+
+  inline bool isFull() const {
+    return arenas[generation % 2].allocated >= GENERATION_SIZE;
+  }
 };
 
-using InstAnalysisPtr = std::unique_ptr<InstAnalysis, InstAnalysisDestructor>;
-
 const InstAnalysis *analyzeInstMetadata(const InstMetadata &instMetadata,
                                         AnalysisType type,
                                         const LLVMCPU &llvmcpu);
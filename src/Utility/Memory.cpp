@@ -31,6 +31,7 @@
 #include "QBDI/Range.h"
 #include "QBDI/State.h"
 #include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
 
 #define FRAME_LENGTH 16
 
@@ -47,6 +48,12 @@ std::vector<std::string> getModuleNames() {
   return {std::begin(modules), std::end(modules)};
 }
 
+std::vector<MemoryMap> getCachedProcessMaps(bool full_path) {
+  return ProcessMaps::get().snapshot()->getMaps(full_path);
+}
+
+void invalidateProcessMapsCache() { ProcessMaps::get().invalidate(); }
+
 void *alignedAlloc(size_t size, size_t align) {
   void *allocated = nullptr;
   // Alignment needs to be a power of 2
@@ -203,6 +210,14 @@ qbdi_MemoryMap *qbdi_getCurrentProcessMaps(bool full_path, size_t *size) {
   return convert_MemoryMap_to_C(getCurrentProcessMaps(full_path), size);
 }
 
+qbdi_MemoryMap *qbdi_getCachedProcessMaps(bool full_path, size_t *size) {
+  if (size == NULL)
+    return NULL;
+  return convert_MemoryMap_to_C(getCachedProcessMaps(full_path), size);
+}
+
+void qbdi_invalidateProcessMapsCache() { invalidateProcessMapsCache(); }
+
 void qbdi_freeMemoryMapArray(qbdi_MemoryMap *arr, size_t size) {
   for (size_t i = 0; i < size; i++) {
     if (arr[i].name) {
@@ -17,6 +17,10 @@
  */
 #include <algorithm>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,33 +33,89 @@
 #include "QBDI/Range.h"
 #include "QBDI/State.h"
 #include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
 
 namespace QBDI {
 
+namespace {
+
+int getGeneration(struct dl_phdr_info *info, size_t size, void *data) {
+  uint64_t &generation = *static_cast<uint64_t *>(data);
+#if defined(__GLIBC__)
+  if (size >=
+      offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs)) {
+    generation = (info->dlpi_adds << 32) + info->dlpi_subs;
+    // the counters are the same for all the modules
+    return 1;
+  }
+#endif
+  // without the counters, hash the address and the name of the modules
+  generation = generation * 31 + info->dlpi_addr + 1;
+  if (info->dlpi_name != nullptr) {
+    for (const char *c = info->dlpi_name; *c != '\0'; c++) {
+      generation = generation * 31 + static_cast<uint8_t>(*c);
+    }
+  }
+  return 0;
+}
+
+} // anonymous namespace
+
+uint64_t getLoadedModulesGeneration() {
+  uint64_t generation = 0;
+  dl_iterate_phdr(getGeneration, &generation);
+  return generation;
+}
+
 std::vector<MemoryMap> getCurrentProcessMaps(bool full_path) {
   return getRemoteProcessMaps(getpid(), full_path);
 }
 
 std::vector<MemoryMap> getRemoteProcessMaps(QBDI::rword pid, bool full_path) {
-  static const int BUFFER_SIZE = 256;
-  char line[BUFFER_SIZE] = {0};
-  FILE *mapfile = nullptr;
+  static const int BUFFER_SIZE = 4096;
+  char path[64] = {0};
   std::vector<MemoryMap> maps;
-
-  snprintf(line, BUFFER_SIZE, "/proc/%llu/maps", (unsigned long long)pid);
-  mapfile = fopen(line, "r");
-  QBDI_DEBUG("Querying memory maps from {}", line);
-  QBDI_REQUIRE_ACTION(mapfile != nullptr, return maps);
+  std::string content;
+
+  snprintf(path, sizeof(path), "/proc/%llu/maps", (unsigned long long)pid);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  QBDI_DEBUG("Querying memory maps from {}", path);
+  QBDI_REQUIRE_ACTION(fd >= 0, return maps);
+
+  // Read the whole file at once: the file is generated by the kernel at each
+  // read, reading it in large chunks is much faster than line by line.
+  while (true) {
+    size_t pos = content.size();
+    content.resize(pos + BUFFER_SIZE);
+    ssize_t len = read(fd, &content[pos], BUFFER_SIZE);
+    if (len < 0 and errno == EINTR) {
+      content.resize(pos);
+      continue;
+    }
+    content.resize(pos + std::max<ssize_t>(len, 0));
+    if (len <= 0) {
+      break;
+    }
+  }
+  close(fd);
 
   // Process a memory map line in the form of
   // 00400000-0063c000 r-xp 00000000 fe:01 675628    /usr/bin/vim
-  while (fgets(line, BUFFER_SIZE, mapfile) != nullptr) {
+  char *next = &content[0];
+  char *contentEnd = next + content.size();
+  while (next < contentEnd) {
+    char *line = next;
     char *ptr = nullptr;
     MemoryMap m;
 
-    // Remove \n
-    if ((ptr = strchr(line, '\n')) != nullptr) {
+    // Split the line on \n
+    if ((ptr = static_cast<char *>(memchr(line, '\n', contentEnd - line))) !=
+        nullptr) {
       *ptr = '\0';
+      next = ptr + 1;
+    } else {
+      // the content is null terminated by std::string
+      next = contentEnd;
     }
     ptr = line;
     QBDI_DEBUG("Parsing line: {}", line);
@@ -125,9 +185,8 @@ std::vector<MemoryMap> getRemoteProcessMaps(QBDI::rword pid, bool full_path) {
                (m.permission & QBDI::PF_READ) ? "r" : "-",
                (m.permission & QBDI::PF_WRITE) ? "w" : "-",
                (m.permission & QBDI::PF_EXEC) ? "x" : "-");
-    maps.push_back(m);
+    maps.push_back(std::move(m));
   }
-  fclose(mapfile);
   return maps;
 }
 
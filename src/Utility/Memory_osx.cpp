@@ -15,11 +15,14 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <atomic>
+
 #include "llvm/Support/Process.h"
 
 #include "QBDI/Memory.h"
 #include "QBDI/Memory.hpp"
 #include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
 
 #include <set>
 
@@ -163,6 +166,12 @@ uintptr_t getImageSlideWithHeader(const struct dyld_image_info *image_info,
   return 0;
 }
 
+uint64_t getLoadedModulesGeneration() {
+  // No cheap way to detect a module change, the maps are always read again
+  static std::atomic<uint64_t> generation{0};
+  return ++generation;
+}
+
 std::vector<MemoryMap> getCurrentProcessMaps(bool full_path) {
   return getRemoteProcessMaps(getpid(), full_path);
 }
@@ -15,11 +15,14 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <atomic>
+
 #include "llvm/Support/Process.h"
 
 #include "QBDI/Memory.h"
 #include "QBDI/Memory.hpp"
 #include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
 
 // clang-format off
 #include <Windows.h>
@@ -36,6 +39,12 @@ namespace QBDI {
 #define PROT_ISWRITE(PROT) ((PROT)&0xCC)
 #define PROT_ISEXEC(PROT) ((PROT)&0xF0)
 
+uint64_t getLoadedModulesGeneration() {
+  // No cheap way to detect a module change, the maps are always read again
+  static std::atomic<uint64_t> generation{0};
+  return ++generation;
+}
+
 std::vector<MemoryMap> getCurrentProcessMaps(bool full_path) {
   return getRemoteProcessMaps(GetCurrentProcessId(), full_path);
 }
@@ -0,0 +1,112 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <utility>
+
+#include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
+
+namespace QBDI {
+
+ProcessMapsSnapshot::ProcessMapsSnapshot(std::vector<MemoryMap> &&fullMaps)
+    : fullPathMaps(std::move(fullMaps)) {
+
+  std::sort(fullPathMaps.begin(), fullPathMaps.end(),
+            [](const MemoryMap &a, const MemoryMap &b) {
+              return a.range.start() < b.range.start();
+            });
+
+  maps.reserve(fullPathMaps.size());
+  for (const MemoryMap &m : fullPathMaps) {
+    // same basename as getCurrentProcessMaps(false): the pseudo paths
+    // ([stack], [heap], ...) have no name
+    size_t pos = m.name.find_last_of("/\\");
+    if (pos == std::string::npos) {
+      maps.emplace_back(m.range, m.permission, "");
+    } else {
+      maps.emplace_back(m.range, m.permission, m.name.substr(pos + 1));
+    }
+  }
+
+  for (size_t i = 0; i < maps.size(); i++) {
+    if (not maps[i].name.empty()) {
+      nameIndex[maps[i].name].push_back(i);
+    }
+  }
+}
+
+const MemoryMap *ProcessMapsSnapshot::findByAddress(rword address) const {
+  auto it = std::upper_bound(maps.begin(), maps.end(), address,
+                             [](rword addr, const MemoryMap &m) {
+                               return addr < m.range.start();
+                             });
+  if (it == maps.begin()) {
+    return nullptr;
+  }
+  --it;
+  if (it->range.contains(address)) {
+    return &*it;
+  }
+  return nullptr;
+}
+
+const std::vector<size_t> *
+ProcessMapsSnapshot::findByName(const std::string &name) const {
+  auto it = nameIndex.find(name);
+  if (it == nameIndex.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+ProcessMaps::ProcessMaps() : current(), generation(0) {}
+
+ProcessMaps &ProcessMaps::get() {
+  static ProcessMaps processMaps;
+  return processMaps;
+}
+
+ProcessMaps::Snapshot ProcessMaps::snapshot() {
+  std::lock_guard<std::mutex> guard(lock);
+
+  uint64_t currentGeneration = getLoadedModulesGeneration();
+  if (current and generation == currentGeneration) {
+    return current;
+  }
+  QBDI_DEBUG("Memory maps outdated, read them again");
+  current = std::make_shared<const ProcessMapsSnapshot>(
+      getCurrentProcessMaps(true));
+  generation = currentGeneration;
+  return current;
+}
+
+ProcessMaps::Snapshot ProcessMaps::refresh() {
+  std::lock_guard<std::mutex> guard(lock);
+
+  current = std::make_shared<const ProcessMapsSnapshot>(
+      getCurrentProcessMaps(true));
+  generation = getLoadedModulesGeneration();
+  return current;
+}
+
+void ProcessMaps::invalidate() {
+  std::lock_guard<std::mutex> guard(lock);
+  current.reset();
+}
+
+} // namespace QBDI
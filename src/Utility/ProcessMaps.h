@@ -0,0 +1,113 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PROCESSMAPS_H
+#define PROCESSMAPS_H
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "QBDI/Memory.hpp"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Get a counter that changes each time a module is loaded or unloaded in the
+ * current process. On platforms where the loader doesn't provide this
+ * information, the counter changes at each call.
+ */
+uint64_t getLoadedModulesGeneration();
+
+/*! Immutable view of the memory maps of the current process.
+ */
+class ProcessMapsSnapshot {
+private:
+  // sorted by start address
+  std::vector<MemoryMap> maps;
+  std::vector<MemoryMap> fullPathMaps;
+  std::unordered_map<std::string, std::vector<size_t>> nameIndex;
+
+public:
+  ProcessMapsSnapshot(std::vector<MemoryMap> &&fullPathMaps);
+
+  /*! Get all the maps, sorted by address.
+   *
+   * @param[in] full_path  Use the full path of the module in name field
+   */
+  inline const std::vector<MemoryMap> &getMaps(bool full_path = false) const {
+    return full_path ? fullPathMaps : maps;
+  }
+
+  /*! Find the map that contains an address.
+   *
+   * @return the map (with the basename of the module), or nullptr
+   */
+  const MemoryMap *findByAddress(rword address) const;
+
+  /*! Find the maps of a module
+   *
+   * @param[in] name  The basename of the module
+   *
+   * @return the index of the maps in getMaps(), or nullptr
+   */
+  const std::vector<size_t> *findByName(const std::string &name) const;
+};
+
+/*! Process-wide cache of the memory maps of the current process.
+ *
+ * The maps are read again when the snapshot has been invalidated or when the
+ * loader reports that a module has been loaded or unloaded. A snapshot doesn't
+ * see the anonymous mappings created after it, the users must call refresh()
+ * when a lookup misses.
+ */
+class ProcessMaps {
+private:
+  std::mutex lock;
+  std::shared_ptr<const ProcessMapsSnapshot> current;
+  uint64_t generation;
+
+  ProcessMaps();
+
+public:
+  using Snapshot = std::shared_ptr<const ProcessMapsSnapshot>;
+
+  ProcessMaps(const ProcessMaps &) = delete;
+  ProcessMaps &operator=(const ProcessMaps &) = delete;
+
+  static ProcessMaps &get();
+
+  /*! Get the current snapshot. It is read again if it is outdated.
+   */
+  Snapshot snapshot();
+
+  /*! Read the memory maps again and get the new snapshot.
+   */
+  Snapshot refresh();
+
+  /*! Mark the current snapshot as outdated. Should be called when the memory
+   * layout changes (mmap, munmap, dlopen, ...).
+   */
+  void invalidate();
+};
+
+} // namespace QBDI
+
+#endif // PROCESSMAPS_H
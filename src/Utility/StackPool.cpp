@@ -0,0 +1,114 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+
+#include "llvm/Support/Process.h"
+
+#include "QBDI/Config.h"
+#include "Utility/LogSys.h"
+#include "Utility/StackPool.h"
+
+#if defined(QBDI_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace QBDI {
+
+StackPool::StackPool()
+    : pageSize(llvm::expectedToOptional(llvm::sys::Process::getPageSize())
+                   .value_or(4096)) {}
+
+StackPool::~StackPool() {
+  for (const Stack &stack : stacks) {
+    QBDI_REQUIRE(not stack.used);
+    unmap(stack);
+  }
+}
+
+void StackPool::unmap(const Stack &stack) {
+#if defined(QBDI_PLATFORM_WINDOWS)
+  VirtualFree(stack.mapping, 0, MEM_RELEASE);
+#else
+  munmap(stack.mapping, stack.mappingSize);
+#endif
+}
+
+uint8_t *StackPool::acquire(size_t stackSize) {
+  // Reuse the smallest released stack that is large enough
+  Stack *best = nullptr;
+  for (Stack &stack : stacks) {
+    if (not stack.used and stack.stackSize >= stackSize and
+        (best == nullptr or stack.stackSize < best->stackSize)) {
+      best = &stack;
+    }
+  }
+  if (best != nullptr) {
+    best->used = true;
+    return best->mapping + best->mappingSize - best->stackSize;
+  }
+
+  size_t alignedSize = (stackSize + pageSize - 1) & ~(pageSize - 1);
+  size_t mappingSize = alignedSize + pageSize;
+#if defined(QBDI_PLATFORM_WINDOWS)
+  uint8_t *mapping = static_cast<uint8_t *>(VirtualAlloc(
+      nullptr, mappingSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+  if (mapping == nullptr) {
+    return nullptr;
+  }
+  DWORD oldProt;
+  bool guarded =
+      VirtualProtect(mapping, pageSize, PAGE_NOACCESS, &oldProt) != 0;
+#else
+  void *addr = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  uint8_t *mapping = static_cast<uint8_t *>(addr);
+  bool guarded = mprotect(mapping, pageSize, PROT_NONE) == 0;
+#endif
+  if (not guarded) {
+    QBDI_WARN("Fail to protect the guard page of the stack 0x{:x}",
+              reinterpret_cast<rword>(mapping));
+  }
+  QBDI_DEBUG("Allocated stack 0x{:x} of {} bytes",
+             reinterpret_cast<rword>(mapping + pageSize), alignedSize);
+
+  stacks.push_back({mapping, mappingSize, alignedSize, true});
+  return mapping + pageSize;
+}
+
+void StackPool::release(uint8_t *stack) {
+  auto it = std::find_if(stacks.begin(), stacks.end(), [&](const Stack &s) {
+    return s.used and s.mapping + s.mappingSize - s.stackSize == stack;
+  });
+  QBDI_REQUIRE_ACTION(it != stacks.end(), return);
+  it->used = false;
+
+  // Keep a bounded number of released stacks
+  size_t nbFree = std::count_if(stacks.begin(), stacks.end(),
+                                [](const Stack &s) { return not s.used; });
+  if (nbFree > MAX_FREE_STACKS) {
+    unmap(*it);
+    stacks.erase(it);
+  }
+}
+
+} // namespace QBDI
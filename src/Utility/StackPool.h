@@ -0,0 +1,79 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef STACKPOOL_H
+#define STACKPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Virtual stacks reused between the calls of a VM. Each stack is mapped with
+ * a guard page below it, so that an overflow faults instead of corrupting the
+ * surrounding memory. A released stack keeps its pages: the next call uses
+ * memory that has already been faulted in.
+ */
+class StackPool {
+private:
+  struct Stack {
+    uint8_t *mapping; // begins with the guard page
+    size_t mappingSize;
+    size_t stackSize;
+    bool used;
+  };
+
+  std::vector<Stack> stacks;
+  size_t pageSize;
+
+  void unmap(const Stack &stack);
+
+public:
+  // number of released stacks kept for the next calls
+  static constexpr size_t MAX_FREE_STACKS = 2;
+
+  StackPool();
+
+  ~StackPool();
+
+  StackPool(const StackPool &) = delete;
+  StackPool &operator=(const StackPool &) = delete;
+
+  /*! Get a stack of at least stackSize bytes.
+   *
+   * @param[in] stackSize  The size of the stack
+   *
+   * @return The lowest address of the stack, or nullptr if the allocation
+   *         failed. The stack must be released with release().
+   */
+  uint8_t *acquire(size_t stackSize);
+
+  /*! Release a stack returned by acquire.
+   *
+   * @param[in] stack  The address returned by acquire
+   */
+  void release(uint8_t *stack);
+
+  inline size_t getPageSize() const { return pageSize; }
+};
+
+} // namespace QBDI
+
+#endif // STACKPOOL_H
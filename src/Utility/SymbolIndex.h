@@ -0,0 +1,107 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+struct SymbolInfo {
+  const char *symbolName; // nullptr if no symbol covers the address
+  rword symbolOffset;
+  const char *moduleName; // basename of the module
+};
+
+/*! Process-wide index of the symbols of the loaded modules.
+ *
+ * The symbol tables (.symtab and .dynsym) of each module are read once from
+ * the mapped ELF file and kept in a sorted array. A lookup is a binary search
+ * on the modules and on the symbols of the module. Each lookup checks the
+ * generation of the loaded modules (the dlpi_adds and dlpi_subs counters of
+ * dl_iterate_phdr) and refreshes the list of the modules when it has changed.
+ *
+ * The returned strings stay valid until the end of the process, even if the
+ * module is unloaded.
+ */
+class SymbolIndex {
+public:
+  struct Symbol {
+    rword address;
+    rword size;
+    const char *name;
+  };
+
+  struct Module {
+    rword start;
+    rword end;
+    std::string path;
+    const char *name;
+    std::vector<Symbol> symbols;
+    const void *mapping;
+    size_t mappingSize;
+
+    ~Module();
+  };
+
+private:
+  std::mutex lock;
+  // sorted by start address, only the currently loaded modules
+  std::vector<Module *> modules;
+  // all the modules ever indexed. Never freed, as the InstAnalysis may keep a
+  // pointer on the names.
+  std::vector<std::unique_ptr<Module>> storage;
+  uint64_t loadGeneration;
+
+  SymbolIndex();
+
+  bool refresh();
+  const Module *findModule(rword address) const;
+
+public:
+  SymbolIndex(const SymbolIndex &) = delete;
+  SymbolIndex &operator=(const SymbolIndex &) = delete;
+
+  /*! Get the process-wide index
+   */
+  static SymbolIndex &get();
+
+  /*! Search the symbol and the module of an address.
+   *
+   * @param[in]  address  The address to resolve
+   * @param[out] info     The symbol and the module found
+   *
+   * @return true if a module covers the address
+   */
+  bool lookup(rword address, SymbolInfo &info);
+
+  /*! Force the reload of the list of the modules on the next lookup.
+   */
+  void invalidate();
+};
+
+} // namespace QBDI
+
+#endif // SYMBOLINDEX_H
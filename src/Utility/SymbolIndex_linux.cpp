@@ -0,0 +1,291 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Utility/LogSys.h"
+#include "Utility/ProcessMaps.h"
+#include "Utility/SymbolIndex.h"
+
+#include "QBDI/Config.h"
+
+namespace QBDI {
+
+namespace {
+
+struct LoadedModule {
+  rword base;
+  rword start;
+  rword end;
+  std::string path;
+};
+
+int collectModule(struct dl_phdr_info *info, size_t size, void *data) {
+  std::vector<LoadedModule> &loaded =
+      *static_cast<std::vector<LoadedModule> *>(data);
+
+  LoadedModule m{info->dlpi_addr, ~static_cast<rword>(0), 0, ""};
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_LOAD) {
+      continue;
+    }
+    m.start = std::min<rword>(m.start, info->dlpi_addr + phdr.p_vaddr);
+    m.end =
+        std::max<rword>(m.end, info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz);
+  }
+  if (m.start >= m.end) {
+    return 0;
+  }
+  if (info->dlpi_name != nullptr and info->dlpi_name[0] != '\0') {
+    m.path = info->dlpi_name;
+  } else if (loaded.empty()) {
+    // the first entry is the main executable
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0) {
+      m.path = std::string(path, len);
+    }
+  }
+  loaded.push_back(std::move(m));
+  return 0;
+}
+
+void readSymbolTable(SymbolIndex::Module &module, rword base,
+                     const uint8_t *file, size_t fileSize,
+                     const ElfW(Shdr) & symtab, const ElfW(Shdr) & strtab) {
+  if (symtab.sh_entsize != sizeof(ElfW(Sym)) or
+      symtab.sh_offset + symtab.sh_size > fileSize or
+      strtab.sh_offset + strtab.sh_size > fileSize or strtab.sh_size == 0) {
+    return;
+  }
+  const ElfW(Sym) *syms =
+      reinterpret_cast<const ElfW(Sym) *>(file + symtab.sh_offset);
+  const char *strings = reinterpret_cast<const char *>(file + strtab.sh_offset);
+  size_t count = symtab.sh_size / sizeof(ElfW(Sym));
+
+  for (size_t i = 0; i < count; i++) {
+    const ElfW(Sym) &sym = syms[i];
+    // ELF32_ST_TYPE and ELF64_ST_TYPE are the same
+    unsigned type = ELF64_ST_TYPE(sym.st_info);
+    if (sym.st_shndx == SHN_UNDEF or sym.st_value == 0 or
+        sym.st_name >= strtab.sh_size) {
+      continue;
+    }
+    if (type != STT_FUNC and type != STT_GNU_IFUNC and type != STT_OBJECT and
+        type != STT_NOTYPE) {
+      continue;
+    }
+    // the last character of the string table must be a '\0'
+    if (strings[strtab.sh_size - 1] != '\0' or strings[sym.st_name] == '\0') {
+      continue;
+    }
+    rword address = base + sym.st_value;
+    if constexpr (is_arm) {
+      // thumb bit
+      address &= ~static_cast<rword>(1);
+    }
+    module.symbols.push_back({address, static_cast<rword>(sym.st_size),
+                              strings + sym.st_name});
+  }
+}
+
+void indexModule(SymbolIndex::Module &module, rword base) {
+  int fd = open(module.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    QBDI_DEBUG("Cannot open {} to read the symbols", module.path);
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 or
+      static_cast<size_t>(st.st_size) < sizeof(ElfW(Ehdr))) {
+    close(fd);
+    return;
+  }
+  void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return;
+  }
+  module.mapping = mapping;
+  module.mappingSize = st.st_size;
+
+  const uint8_t *file = static_cast<const uint8_t *>(mapping);
+  size_t fileSize = module.mappingSize;
+  const ElfW(Ehdr) &ehdr = *reinterpret_cast<const ElfW(Ehdr) *>(file);
+  if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 or
+      ehdr.e_ident[EI_CLASS] !=
+          (sizeof(rword) == 8 ? ELFCLASS64 : ELFCLASS32) or
+      ehdr.e_shentsize != sizeof(ElfW(Shdr)) or
+      ehdr.e_shoff + ehdr.e_shnum * sizeof(ElfW(Shdr)) > fileSize) {
+    QBDI_DEBUG("{} is not a valid ELF for the symbol index", module.path);
+    return;
+  }
+  const ElfW(Shdr) *shdrs =
+      reinterpret_cast<const ElfW(Shdr) *>(file + ehdr.e_shoff);
+  // the symbols of an executable are absolute
+  if (ehdr.e_type == ET_EXEC) {
+    base = 0;
+  }
+
+  for (ElfW(Half) i = 0; i < ehdr.e_shnum; i++) {
+    const ElfW(Shdr) &shdr = shdrs[i];
+    if ((shdr.sh_type != SHT_SYMTAB and shdr.sh_type != SHT_DYNSYM) or
+        shdr.sh_link >= ehdr.e_shnum) {
+      continue;
+    }
+    readSymbolTable(module, base, file, fileSize, shdr, shdrs[shdr.sh_link]);
+  }
+
+  // sort by address. For the same address, keep the symbol with a size.
+  std::sort(module.symbols.begin(), module.symbols.end(),
+            [](const SymbolIndex::Symbol &a, const SymbolIndex::Symbol &b) {
+              if (a.address != b.address) {
+                return a.address < b.address;
+              }
+              return a.size > b.size;
+            });
+  module.symbols.erase(
+      std::unique(module.symbols.begin(), module.symbols.end(),
+                  [](const SymbolIndex::Symbol &a,
+                     const SymbolIndex::Symbol &b) {
+                    return a.address == b.address;
+                  }),
+      module.symbols.end());
+  module.symbols.shrink_to_fit();
+
+  QBDI_DEBUG("Index {} symbols for {}", module.symbols.size(), module.path);
+}
+
+} // anonymous namespace
+
+SymbolIndex::Module::~Module() {
+  if (mapping != nullptr) {
+    munmap(const_cast<void *>(mapping), mappingSize);
+  }
+}
+
+SymbolIndex::SymbolIndex() : loadGeneration(0) {}
+
+SymbolIndex &SymbolIndex::get() {
+  static SymbolIndex index;
+  return index;
+}
+
+void SymbolIndex::invalidate() {
+  std::lock_guard<std::mutex> guard(lock);
+  loadGeneration = 0;
+}
+
+bool SymbolIndex::refresh() {
+  uint64_t generation = getLoadedModulesGeneration();
+  if (generation == loadGeneration) {
+    return false;
+  }
+  loadGeneration = generation;
+
+  std::vector<LoadedModule> loaded;
+  dl_iterate_phdr(collectModule, &loaded);
+
+  modules.clear();
+  for (const LoadedModule &m : loaded) {
+    auto it = std::find_if(storage.begin(), storage.end(),
+                           [&m](const std::unique_ptr<Module> &s) {
+                             return s->start == m.start and s->end == m.end and
+                                    s->path == m.path;
+                           });
+    if (it != storage.end()) {
+      modules.push_back(it->get());
+      continue;
+    }
+    std::unique_ptr<Module> module = std::make_unique<Module>();
+    module->start = m.start;
+    module->end = m.end;
+    module->path = m.path;
+    module->mapping = nullptr;
+    module->mappingSize = 0;
+    module->name = nullptr;
+    if (not module->path.empty()) {
+      size_t pos = module->path.rfind('/');
+      module->name = module->path.c_str() +
+                     ((pos == std::string::npos) ? 0 : (pos + 1));
+      indexModule(*module, m.base);
+    }
+    modules.push_back(module.get());
+    storage.push_back(std::move(module));
+  }
+
+  std::sort(
+      modules.begin(), modules.end(),
+      [](const Module *a, const Module *b) { return a->start < b->start; });
+  return true;
+}
+
+const SymbolIndex::Module *SymbolIndex::findModule(rword address) const {
+  auto it = std::upper_bound(
+      modules.begin(), modules.end(), address,
+      [](rword addr, const Module *m) { return addr < m->start; });
+  if (it == modules.begin()) {
+    return nullptr;
+  }
+  --it;
+  if (address < (*it)->end) {
+    return *it;
+  }
+  return nullptr;
+}
+
+bool SymbolIndex::lookup(rword address, SymbolInfo &info) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  // a module may have been unloaded and another one loaded at the same
+  // address. The generation changes with each dlopen and dlclose.
+  refresh();
+  const Module *module = findModule(address);
+  if (module == nullptr) {
+    return false;
+  }
+
+  info.symbolName = nullptr;
+  info.symbolOffset = 0;
+  info.moduleName = module->name;
+
+  auto it = std::upper_bound(
+      module->symbols.begin(), module->symbols.end(), address,
+      [](rword addr, const Symbol &s) { return addr < s.address; });
+  if (it != module->symbols.begin()) {
+    --it;
+    if (address < it->address + it->size or
+        (it->size == 0 and address == it->address)) {
+      info.symbolName = it->name;
+      info.symbolOffset = address - it->address;
+    }
+  }
+  return true;
+}
+
+} // namespace QBDI
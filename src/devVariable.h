@@ -22,5 +22,6 @@
 #define CHECK_INSTRUCTION_SIZE 1
 #define CHECK_MEMORYACCESS_TABLE 1
 #define CHECK_INSTINFO_TABLE 1
+#define CHECK_FAST_ENCODER 0
 
 #endif // DEVVARIABLE_H
@@ -83,10 +83,16 @@ std::vector<uint8_t> VMTest_AARCH64_SelfModifyingCode2 = {
   0x41, 0x80, 0x00, 0xb8,     // stur w1, [x2, #8]
   0xe0, 0x03, 0x1f, 0xd6      // br xzr  replaced by 'ret'
 };
+
+std::vector<uint8_t> VMTest_AARCH64_SelfModifyingCode3 = {
+  0x40, 0x05, 0x80, 0xd2,     // mov	x0, #0x2a
+  0xc0, 0x03, 0x5f, 0xd6      // ret
+};
 // clang-format on
 
 std::unordered_map<std::string, SizedTestCode> TestCode = {
     {"VMTest-InvalidInstruction", {VMTest_AARCH64_InvalidInstruction, 0x10}},
     {"VMTest-BreakingInstruction", {VMTest_AARCH64_BreakingInstruction, 0x10}},
     {"VMTest-SelfModifyingCode1", {VMTest_AARCH64_SelfModifyingCode1}},
-    {"VMTest-SelfModifyingCode2", {VMTest_AARCH64_SelfModifyingCode2}}};
+    {"VMTest-SelfModifyingCode2", {VMTest_AARCH64_SelfModifyingCode2}},
+    {"VMTest-SelfModifyingCode3", {VMTest_AARCH64_SelfModifyingCode3, 0x1}}};
@@ -75,10 +75,16 @@ std::vector<uint8_t> VMTest_ARM_SelfModifyingCode2 = {
   0x01, 0x0c, 0x80, 0xe2,     // add  r0, r0, #256, replaced by 'andeq r0, r0, r0'
   0x1e, 0xff, 0x2f, 0xe1      // bx   lr
 };
+
+std::vector<uint8_t> VMTest_ARM_SelfModifyingCode3 = {
+  0x2a, 0x00, 0xa0, 0xe3,     // mov  r0, #0x2a
+  0x1e, 0xff, 0x2f, 0xe1      // bx   lr
+};
 // clang-format on
 
 std::unordered_map<std::string, SizedTestCode> TestCode = {
     {"VMTest-InvalidInstruction", {VMTest_ARM_InvalidInstruction, 0x10}},
     {"VMTest-BreakingInstruction", {VMTest_ARM_BreakingInstruction, 0x10}},
     {"VMTest-SelfModifyingCode1", {VMTest_ARM_SelfModifyingCode1}},
-    {"VMTest-SelfModifyingCode2", {VMTest_ARM_SelfModifyingCode2}}};
+    {"VMTest-SelfModifyingCode2", {VMTest_ARM_SelfModifyingCode2}},
+    {"VMTest-SelfModifyingCode3", {VMTest_ARM_SelfModifyingCode3, 0x0}}};
@@ -974,3 +974,45 @@ TEST_CASE_METHOD(APITest, "MemoryAccessTest-InstCbLambda-addMemRangeCB") {
 
   SUCCEED();
 }
+
+TEST_CASE_METHOD(APITest, "MemoryAccessTest-AddressOnly") {
+  QBDI::rword retval;
+  const size_t buffer_size = 10;
+  uint32_t buffer[buffer_size];
+  size_t nbRead = 0;
+  size_t nbWrite = 0;
+  bool withValue = false;
+
+  vm.setOptions(vm.getOptions() | QBDI::OPT_DISABLE_MEMORYACCESS_VALUE);
+
+  vm.addMemAccessCB(
+      QBDI::MEMORY_READ_WRITE,
+      [&](QBDI::VMInstanceRef vm, QBDI::GPRState *gpr, QBDI::FPRState *fpr) {
+        for (const QBDI::MemoryAccess &memaccess : vm->getInstMemoryAccess()) {
+          if (memaccess.accessAddress < (QBDI::rword)buffer or
+              memaccess.accessAddress >= (QBDI::rword)(buffer + buffer_size)) {
+            continue;
+          }
+          CHECK(memaccess.size == sizeof(uint32_t));
+          if ((memaccess.flags & QBDI::MEMORY_UNKNOWN_VALUE) == 0) {
+            withValue = true;
+          }
+          if (memaccess.type == QBDI::MEMORY_READ) {
+            nbRead++;
+          } else if (memaccess.type == QBDI::MEMORY_WRITE) {
+            nbWrite++;
+          }
+        }
+        return QBDI::VMAction::CONTINUE;
+      });
+
+  vm.call(&retval, (QBDI::rword)arrayWrite32,
+          {(QBDI::rword)buffer, (QBDI::rword)buffer_size});
+
+  REQUIRE(retval == (QBDI::rword)arrayWrite32(buffer, buffer_size));
+  REQUIRE(nbWrite == buffer_size);
+  REQUIRE(nbRead >= buffer_size - 1);
+  REQUIRE_FALSE(withValue);
+
+  SUCCEED();
+}
@@ -16,13 +16,21 @@
  * limitations under the License.
  */
 #include <algorithm>
+#include <set>
+#include <string.h>
 #include <catch2/catch.hpp>
 #include "APITest.h"
 
 #include "inttypes.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MemoryBuffer.h"
+
 #include "QBDI/Memory.hpp"
 #include "QBDI/Platform.h"
+#include "QBDI/Trace.h"
 #include "Utility/LogSys.h"
 #include "Utility/String.h"
 
@@ -523,6 +531,39 @@ TEST_CASE_METHOD(APITest, "VMTest-CacheInvalidation") {
   REQUIRE((uint32_t)0 == count2);
 }
 
+TEST_CASE_METHOD(APITest, "VMTest-IncrementalInstrumentation") {
+  uint32_t countRef = 0;
+  uint32_t count = 0;
+
+  bool instrumented =
+      vm.addInstrumentedModuleFromAddr((QBDI::rword)&dummyFunCall);
+  REQUIRE(instrumented);
+  uint32_t instr =
+      vm.addCodeCB(QBDI::InstPosition::POSTINST, countInstruction, &countRef);
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {1, 2, 3, 4});
+  bool ran = vm.run((QBDI::rword)dummyFun4, (QBDI::rword)FAKE_RET_ADDR);
+  REQUIRE(ran);
+  REQUIRE(QBDI_GPR_GET(state, QBDI::REG_RETURN) == (QBDI::rword)10);
+  REQUIRE((uint32_t)0 != countRef);
+
+  // the basic blocks are instrumented again from their cached patches
+  REQUIRE(vm.deleteInstrumentation(instr));
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {1, 2, 3, 4});
+  ran = vm.run((QBDI::rword)dummyFun4, (QBDI::rword)FAKE_RET_ADDR);
+  REQUIRE(ran);
+  REQUIRE(QBDI_GPR_GET(state, QBDI::REG_RETURN) == (QBDI::rword)10);
+
+  vm.addCodeCB(QBDI::InstPosition::POSTINST, countInstruction, &count);
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {1, 2, 3, 4});
+  ran = vm.run((QBDI::rword)dummyFun4, (QBDI::rword)FAKE_RET_ADDR);
+  REQUIRE(ran);
+  REQUIRE(QBDI_GPR_GET(state, QBDI::REG_RETURN) == (QBDI::rword)10);
+  CHECK(count == countRef);
+}
+
 struct FunkyInfo {
   uint32_t instID;
   uint32_t count;
@@ -846,6 +887,219 @@ TEST_CASE_METHOD(APITest, "VMTest-SKIP_INST") {
   REQUIRE(data.cbnumpost == 3);
 }
 
+TEST_CASE_METHOD(APITest, "VMTest-ChainedCallbacks") {
+  // the callbacks of an instruction are called in a single break to host, each
+  // one with its own data
+  std::vector<int> order;
+  std::vector<std::pair<std::vector<int> *, int>> data;
+  for (int i = 0; i < 5; i++) {
+    data.emplace_back(&order, i);
+  }
+  QBDI::rword addr = (QBDI::rword)dummyFun0;
+
+  for (auto &d : data) {
+    vm.addCodeAddrCB(
+        addr, QBDI::InstPosition::PREINST,
+        [](QBDI::VMInstanceRef vm, QBDI::GPRState *gprState,
+           QBDI::FPRState *fprState, void *data) -> QBDI::VMAction {
+          auto *d = static_cast<std::pair<std::vector<int> *, int> *>(data);
+          d->first->push_back(d->second);
+          return QBDI::VMAction::CONTINUE;
+        },
+        &d);
+  }
+
+  QBDI::rword retval = 0;
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(order == std::vector<int>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-InlineCallCallbacks") {
+  // the inline callbacks are called on the same instructions as the others
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  vm.setOptions(vm.getOptions() | QBDI::Options::OPT_ENABLE_INLINE_CALL);
+#endif
+  QBDI::InstCallback count = [](QBDI::VMInstanceRef vm,
+                                QBDI::GPRState *gprState,
+                                QBDI::FPRState *fprState,
+                                void *data) -> QBDI::VMAction {
+    (*static_cast<uint64_t *>(data))++;
+    return QBDI::VMAction::CONTINUE;
+  };
+  uint64_t countStd = 0;
+  uint64_t countInline = 0;
+  uint64_t countInlinePost = 0;
+  QBDI::rword addr = (QBDI::rword)dummyFun0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, count, &countStd);
+  vm.addCodeCB(QBDI::InstPosition::PREINST, count, &countInline,
+               QBDI::PRIORITY_DEFAULT, QBDI::CB_FLAG_INLINE_CALL);
+  vm.addCodeCB(QBDI::InstPosition::POSTINST, count, &countInlinePost,
+               QBDI::PRIORITY_DEFAULT, QBDI::CB_FLAG_INLINE_CALL);
+  uint64_t countLambda = 0;
+  vm.addCodeAddrCB(
+      addr, QBDI::InstPosition::PREINST,
+      [&countLambda](QBDI::VMInstanceRef, QBDI::GPRState *, QBDI::FPRState *) {
+        countLambda++;
+        return QBDI::VMAction::CONTINUE;
+      },
+      QBDI::PRIORITY_DEFAULT, QBDI::CB_FLAG_INLINE_CALL);
+
+  QBDI::rword retval = 0;
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countStd != 0);
+  REQUIRE(countInline == countStd);
+  REQUIRE(countInlinePost == countStd);
+  REQUIRE(countLambda == 1);
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-OneShotCallbacks") {
+  // the one-shot callbacks are removed from the cache after their first call
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  vm.setOptions(vm.getOptions() | QBDI::Options::OPT_ENABLE_INLINE_CALL);
+#endif
+  QBDI::InstCallback count = [](QBDI::VMInstanceRef vm,
+                                QBDI::GPRState *gprState,
+                                QBDI::FPRState *fprState,
+                                void *data) -> QBDI::VMAction {
+    (*static_cast<uint64_t *>(data))++;
+    return QBDI::VMAction::CONTINUE;
+  };
+  uint64_t countStd = 0;
+  uint64_t countOneShot = 0;
+  uint64_t countInlineOneShot = 0;
+  uint64_t countLambdaOneShot = 0;
+  QBDI::rword addr = (QBDI::rword)dummyFun0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, count, &countStd);
+  vm.addCodeCB(QBDI::InstPosition::PREINST, count, &countOneShot,
+               QBDI::PRIORITY_DEFAULT, QBDI::CB_FLAG_ONE_SHOT);
+  vm.addCodeCB(QBDI::InstPosition::POSTINST, count, &countInlineOneShot,
+               QBDI::PRIORITY_DEFAULT,
+               QBDI::CB_FLAG_ONE_SHOT | QBDI::CB_FLAG_INLINE_CALL);
+  vm.addCodeCB(
+      QBDI::InstPosition::PREINST,
+      [&countLambdaOneShot](QBDI::VMInstanceRef, QBDI::GPRState *,
+                            QBDI::FPRState *) {
+        countLambdaOneShot++;
+        return QBDI::VMAction::CONTINUE;
+      },
+      QBDI::PRIORITY_DEFAULT, QBDI::CB_FLAG_ONE_SHOT);
+
+  QBDI::rword retval = 0;
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countStd != 0);
+  REQUIRE(countOneShot == countStd);
+  REQUIRE(countInlineOneShot == countStd);
+  REQUIRE(countLambdaOneShot == countStd);
+
+  // the second execution uses the same ExecBlock without the callbacks
+  uint64_t firstCount = countStd;
+  retval = 0;
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countStd == 2 * firstCount);
+  REQUIRE(countOneShot == firstCount);
+  REQUIRE(countInlineOneShot == firstCount);
+  REQUIRE(countLambdaOneShot == firstCount);
+
+  // the rules don't instrument the instructions again after a retranslation
+  vm.clearAllCache();
+  retval = 0;
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countStd == 3 * firstCount);
+  REQUIRE(countOneShot == firstCount);
+  REQUIRE(countInlineOneShot == firstCount);
+  REQUIRE(countLambdaOneShot == firstCount);
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-InstrumentationEnabled") {
+  // the callbacks are disabled and enabled without a flush of the cache
+  QBDI::InstCallback count = [](QBDI::VMInstanceRef vm,
+                                QBDI::GPRState *gprState,
+                                QBDI::FPRState *fprState,
+                                void *data) -> QBDI::VMAction {
+    (*static_cast<uint64_t *>(data))++;
+    return QBDI::VMAction::CONTINUE;
+  };
+  uint64_t countRef = 0;
+  uint64_t countToggle = 0;
+  uint64_t countEvent = 0;
+  QBDI::rword addr = (QBDI::rword)dummyFun0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, count, &countRef);
+  uint32_t id = vm.addCodeCB(QBDI::InstPosition::PREINST, count, &countToggle);
+  uint32_t eventID = vm.addVMEventCB(
+      QBDI::SEQUENCE_ENTRY,
+      [](QBDI::VMInstanceRef vm, const QBDI::VMState *state,
+         QBDI::GPRState *gprState, QBDI::FPRState *fprState,
+         void *data) -> QBDI::VMAction {
+        (*static_cast<uint64_t *>(data))++;
+        return QBDI::VMAction::CONTINUE;
+      },
+      &countEvent);
+  REQUIRE(id != QBDI::VMError::INVALID_EVENTID);
+  REQUIRE(eventID != QBDI::VMError::INVALID_EVENTID);
+  REQUIRE_FALSE(vm.setInstrumentationEnabled(0xabcdef, false));
+
+  QBDI::rword retval = 0;
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  uint64_t nbInst = countRef;
+  uint64_t nbSeq = countEvent;
+  REQUIRE(nbInst != 0);
+  REQUIRE(countToggle == nbInst);
+
+  REQUIRE(vm.setInstrumentationEnabled(id, false));
+  REQUIRE(vm.setInstrumentationEnabled(eventID, false));
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countRef == 2 * nbInst);
+  REQUIRE(countToggle == nbInst);
+  REQUIRE(countEvent == nbSeq);
+
+  // the code translated while the callback is disabled can enable it
+  vm.clearAllCache();
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countRef == 3 * nbInst);
+  REQUIRE(countToggle == nbInst);
+
+  REQUIRE(vm.setInstrumentationEnabled(id, true));
+  REQUIRE(vm.setInstrumentationEnabled(eventID, true));
+  vm.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countRef == 4 * nbInst);
+  REQUIRE(countToggle == 2 * nbInst);
+  REQUIRE(countEvent == 2 * nbSeq);
+
+  // the copies of the VM keep the disabled callbacks
+  REQUIRE(vm.setInstrumentationEnabled(id, false));
+  REQUIRE(vm.setInstrumentationEnabled(eventID, false));
+  QBDI::VM vm2 = vm;
+  QBDI::VM vm3;
+  vm3.precacheBasicBlock(addr);
+  vm3 = vm;
+
+  vm2.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  vm3.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countRef == 6 * nbInst);
+  REQUIRE(countToggle == 2 * nbInst);
+  REQUIRE(countEvent == 2 * nbSeq);
+
+  REQUIRE(vm2.setInstrumentationEnabled(id, true));
+  vm2.call(&retval, addr);
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(countRef == 7 * nbInst);
+  REQUIRE(countToggle == 3 * nbInst);
+}
+
 TEST_CASE_METHOD(APITest, "VMTest-SKIP_PATCH") {
 
   SkipTestData data = {0};
@@ -1803,3 +2057,219 @@ TEST_CASE_METHOD(APITest, "VMTest-SelfModifyingCode2") {
 
   SUCCEED();
 }
+
+TEST_CASE_METHOD(APITest, "VMTest-SelfModifyingCode3") {
+  /**
+   * The code is modified between two runs, without clearing the cache. The
+   * modified sequence is invalidated by OPT_DETECT_SELF_MODIFYING_CODE.
+   * */
+  auto tc = TestCode["VMTest-SelfModifyingCode3"];
+  if (tc.code.empty()) {
+    return;
+  }
+  // the code must be alone in its pages
+  uint8_t *code = (uint8_t *)QBDI::alignedAlloc(0x4000, 0x4000);
+  REQUIRE(code != nullptr);
+  memcpy(code, tc.code.data(), tc.code.size());
+  auto start = (QBDI::rword)code;
+  auto stop = (QBDI::rword)(code + tc.code.size());
+
+  vm.setOptions(vm.getOptions() |
+                QBDI::Options::OPT_DETECT_SELF_MODIFYING_CODE);
+  vm.addInstrumentedRange(start, stop);
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR);
+  bool ran = vm.run(start, FAKE_RET_ADDR);
+  REQUIRE(ran);
+  REQUIRE(QBDI_GPR_GET(state, QBDI::REG_RETURN) == (QBDI::rword)42);
+
+  // change the immediate of the first instruction
+  code[tc.size] ^= 1;
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR);
+  ran = vm.run(start, FAKE_RET_ADDR);
+  REQUIRE(ran);
+  QBDI::rword ret = QBDI_GPR_GET(state, QBDI::REG_RETURN);
+  CHECK(ret != (QBDI::rword)42);
+
+  // same result with a new translation
+  vm.clearAllCache();
+  QBDI::simulateCall(state, FAKE_RET_ADDR);
+  ran = vm.run(start, FAKE_RET_ADDR);
+  REQUIRE(ran);
+  CHECK(QBDI_GPR_GET(state, QBDI::REG_RETURN) == ret);
+
+  // restore the protection of the pages before the free
+  vm.clearAllCache();
+  QBDI::alignedFree(code);
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-InstAnalysisSurviveFlush") {
+  std::vector<const QBDI::InstAnalysis *> analysis;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST,
+               [&analysis](QBDI::VMInstanceRef vm, QBDI::GPRState *,
+                           QBDI::FPRState *) {
+                 analysis.push_back(vm->getInstAnalysis(
+                     QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_DISASSEMBLY));
+                 return QBDI::VMAction::CONTINUE;
+               });
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR);
+  bool ran = vm.run((QBDI::rword)dummyFun0, (QBDI::rword)FAKE_RET_ADDR);
+  REQUIRE(ran);
+  REQUIRE(analysis.size() != 0);
+  std::vector<const QBDI::InstAnalysis *> firstRun = analysis;
+
+  // the analysis are kept by the VM after the flush of the ExecBlocks
+  vm.clearAllCache();
+  analysis.clear();
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR);
+  ran = vm.run((QBDI::rword)dummyFun0, (QBDI::rword)FAKE_RET_ADDR);
+  REQUIRE(ran);
+  REQUIRE(analysis == firstRun);
+  for (const QBDI::InstAnalysis *ana : analysis) {
+    CHECK(ana->disassembly != nullptr);
+  }
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-TraceRecording") {
+  llvm::SmallString<128> path;
+  REQUIRE_FALSE(llvm::sys::fs::createTemporaryFile("qbdi", "trace", path));
+
+  size_t nbSequence = 0;
+  vm.addVMEventCB(QBDI::SEQUENCE_ENTRY,
+                  [&nbSequence](QBDI::VMInstanceRef, const QBDI::VMState *,
+                                QBDI::GPRState *, QBDI::FPRState *) {
+                    nbSequence++;
+                    return QBDI::VMAction::CONTINUE;
+                  });
+
+  REQUIRE(vm.startTraceRecording(path.c_str()));
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {1, 2, 3, 4});
+  REQUIRE(vm.run((QBDI::rword)dummyFun4, (QBDI::rword)FAKE_RET_ADDR));
+  vm.stopTraceRecording();
+  REQUIRE(nbSequence != 0);
+
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  REQUIRE(buffer);
+  const uint8_t *p =
+      reinterpret_cast<const uint8_t *>((*buffer)->getBufferStart());
+  const uint8_t *end =
+      reinterpret_cast<const uint8_t *>((*buffer)->getBufferEnd());
+
+  QBDI::TraceFileHeader header;
+  REQUIRE(static_cast<size_t>(end - p) >= sizeof(header));
+  memcpy(&header, p, sizeof(header));
+  CHECK(strcmp(header.magic, QBDI_TRACE_MAGIC) == 0);
+  CHECK(header.version == QBDI_TRACE_VERSION);
+  CHECK(header.rwordSize == sizeof(QBDI::rword));
+  p += sizeof(header);
+
+  auto readVarint = [&p, &end]() {
+    unsigned n;
+    const char *error = nullptr;
+    uint64_t v = llvm::decodeULEB128(p, &n, end, &error);
+    REQUIRE(error == nullptr);
+    p += n;
+    return v;
+  };
+
+  std::set<uint64_t> definedBlocks;
+  size_t nbRecord = 0;
+  while (p < end) {
+    QBDI::TraceSegmentHeader segment;
+    REQUIRE(static_cast<size_t>(end - p) >= sizeof(segment));
+    memcpy(&segment, p, sizeof(segment));
+    REQUIRE(segment.magic == QBDI_TRACE_SEGMENT_MAGIC);
+    p += sizeof(segment);
+    const uint8_t *segmentEnd = p + segment.size;
+    REQUIRE(segmentEnd <= end);
+
+    uint64_t blockID = 0;
+    while (p < segmentEnd) {
+      uint8_t tag = *p++;
+      switch (tag) {
+        case QBDI::TRACE_RECORD_MODULE: {
+          readVarint();
+          readVarint();
+          readVarint();
+          p += readVarint();
+          break;
+        }
+        case QBDI::TRACE_RECORD_BLOCK: {
+          definedBlocks.insert(readVarint());
+          readVarint();
+          QBDI::rword address = readVarint();
+          uint64_t size = readVarint();
+          readVarint();
+          CHECK(address != 0);
+          REQUIRE(size != 0);
+          CHECK(memcmp(p, reinterpret_cast<const void *>(address), size) == 0);
+          p += size;
+          break;
+        }
+        case QBDI::TRACE_RECORD_SEQUENCE: {
+          uint64_t v = readVarint();
+          blockID += (v >> 1) ^ (~(v & 1) + 1);
+          CHECK(definedBlocks.count(blockID) == 1);
+          nbRecord++;
+          break;
+        }
+        default:
+          FAIL("Unexpected record " << (int)tag);
+      }
+    }
+    REQUIRE(p == segmentEnd);
+  }
+  CHECK(nbRecord == nbSequence);
+
+  llvm::sys::fs::remove(path);
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-TraceRecordingRestoreMemory") {
+  llvm::SmallString<128> path;
+  REQUIRE_FALSE(llvm::sys::fs::createTemporaryFile("qbdi", "trace", path));
+
+  size_t nbAccess = 0;
+  vm.addCodeCB(QBDI::InstPosition::POSTINST,
+               [&nbAccess](QBDI::VMInstanceRef vm, QBDI::GPRState *,
+                           QBDI::FPRState *) {
+                 nbAccess += vm->getInstMemoryAccess().size();
+                 return QBDI::VMAction::CONTINUE;
+               });
+
+  auto runWithTrace = [&]() {
+    REQUIRE(vm.startTraceRecording(path.c_str(),
+                                   QBDI::TRACE_SEQUENCE | QBDI::TRACE_MEMORY));
+    QBDI::simulateCall(state, FAKE_RET_ADDR, {42});
+    REQUIRE(vm.run((QBDI::rword)dummyFunCall, (QBDI::rword)FAKE_RET_ADDR));
+    vm.stopTraceRecording();
+  };
+  auto runWithoutTrace = [&]() {
+    nbAccess = 0;
+    QBDI::simulateCall(state, FAKE_RET_ADDR, {42});
+    REQUIRE(vm.run((QBDI::rword)dummyFunCall, (QBDI::rword)FAKE_RET_ADDR));
+    return nbAccess;
+  };
+
+  // the recording enabled by the trace is disabled with the trace
+  nbAccess = 0;
+  runWithTrace();
+  CHECK(nbAccess != 0);
+  CHECK(runWithoutTrace() == 0);
+
+  // the recording requested by the user is kept
+  vm.recordMemoryAccess(QBDI::MEMORY_READ_WRITE);
+  runWithTrace();
+  CHECK(runWithoutTrace() != 0);
+
+  llvm::sys::fs::remove(path);
+  SUCCEED();
+}
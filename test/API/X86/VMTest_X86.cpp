@@ -149,10 +149,16 @@ std::vector<uint8_t> VMTest_X86_SelfModifyingCode2 = {
   0x31, 0xc0,                             // 15: xor    eax,eax   , 15: replaced by 'mov    eax,ecx'
   0xff, 0xe0,                             // 17: jmp    eax       , 17: replaced by 'ret'
 };
+
+std::vector<uint8_t> VMTest_X86_SelfModifyingCode3 = {
+  0xb8, 0x2a, 0x00, 0x00, 0x00,           // 00: mov    eax,0x2a
+  0xc3,                                   // 05: ret
+};
 // clang-format on
 
 std::unordered_map<std::string, SizedTestCode> TestCode = {
     {"VMTest-InvalidInstruction", {VMTest_X86_InvalidInstruction, 0x11}},
     {"VMTest-BreakingInstruction", {VMTest_X86_BreakingInstruction, 0x0b}},
     {"VMTest-SelfModifyingCode1", {VMTest_X86_SelfModifyingCode1}},
-    {"VMTest-SelfModifyingCode2", {VMTest_X86_SelfModifyingCode2}}};
+    {"VMTest-SelfModifyingCode2", {VMTest_X86_SelfModifyingCode2}},
+    {"VMTest-SelfModifyingCode3", {VMTest_X86_SelfModifyingCode3, 0x01}}};
@@ -145,10 +145,16 @@ std::vector<uint8_t> VMTest_X86_64_SelfModifyingCode2 = {
   0x48, 0x31, 0xc9,                           // 16: xor    rcx,rcx   , 18: replaced by 'ret'
   0xcc,                                       // 19: int3
 };
+
+std::vector<uint8_t> VMTest_X86_64_SelfModifyingCode3 = {
+  0x48, 0xc7, 0xc0, 0x2a, 0x00, 0x00, 0x00,   // 00: mov    rax,0x2a
+  0xc3,                                       // 07: ret
+};
 // clang-format on
 
 std::unordered_map<std::string, SizedTestCode> TestCode = {
     {"VMTest-InvalidInstruction", {VMTest_X86_64_InvalidInstruction, 0x11}},
     {"VMTest-BreakingInstruction", {VMTest_X86_64_BreakingInstruction, 0x0d}},
     {"VMTest-SelfModifyingCode1", {VMTest_X86_64_SelfModifyingCode1}},
-    {"VMTest-SelfModifyingCode2", {VMTest_X86_64_SelfModifyingCode2}}};
+    {"VMTest-SelfModifyingCode2", {VMTest_X86_64_SelfModifyingCode2}},
+    {"VMTest-SelfModifyingCode3", {VMTest_X86_64_SelfModifyingCode3, 0x03}}};
@@ -0,0 +1,96 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include <QBDI.h>
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+QBDI_NOINLINE QBDI::rword StartupTarget(QBDI::rword number) {
+  return number * 3 + 1;
+}
+
+static QBDI::VMAction firstInstCB(QBDI::VMInstanceRef vm,
+                                  QBDI::GPRState *gprState,
+                                  QBDI::FPRState *fprState, void *data) {
+  *static_cast<bool *>(data) = true;
+  return QBDI::VMAction::STOP;
+}
+
+static QBDI::VMAction firstInstAnalysisCB(QBDI::VMInstanceRef vm,
+                                          QBDI::GPRState *gprState,
+                                          QBDI::FPRState *fprState,
+                                          void *data) {
+  const QBDI::InstAnalysis *instAnalysis = vm->getInstAnalysis(
+      QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_DISASSEMBLY);
+  *static_cast<size_t *>(data) = strlen(instAnalysis->disassembly);
+  return QBDI::VMAction::STOP;
+}
+
+// Time between the construction of a VM and the first instrumented
+// instruction, as for a short program run under QBDIPreload
+TEST_CASE("Benchmark_Startup") {
+
+  BENCHMARK_ADVANCED("VM construction")
+  (Catch::Benchmark::Chronometer meter) {
+    std::vector<Catch::Benchmark::storage_for<QBDI::VM>> storage(meter.runs());
+    meter.measure([&](int i) { storage[i].construct(); });
+  };
+
+  BENCHMARK_ADVANCED("VM copy")
+  (Catch::Benchmark::Chronometer meter) {
+    QBDI::VM vm;
+    std::vector<Catch::Benchmark::storage_for<QBDI::VM>> storage(meter.runs());
+    meter.measure([&](int i) { storage[i].construct(vm); });
+  };
+
+  BENCHMARK("Time to first instrumented instruction") {
+    QBDI::VM vm;
+    uint8_t *fakestack = nullptr;
+    bool reached = false;
+
+    QBDI::allocateVirtualStack(vm.getGPRState(), 1 << 20, &fakestack);
+    vm.addInstrumentedModuleFromAddr(
+        reinterpret_cast<QBDI::rword>(StartupTarget));
+    vm.addCodeCB(QBDI::PREINST, firstInstCB, &reached);
+
+    QBDI::rword ret_value = 0;
+    vm.call(&ret_value, reinterpret_cast<QBDI::rword>(StartupTarget),
+            {static_cast<QBDI::rword>(2)});
+    QBDI::alignedFree(fakestack);
+    return reached;
+  };
+
+  BENCHMARK("Time to first instrumented instruction with InstAnalysis") {
+    QBDI::VM vm;
+    uint8_t *fakestack = nullptr;
+    size_t length = 0;
+
+    QBDI::allocateVirtualStack(vm.getGPRState(), 1 << 20, &fakestack);
+    vm.addInstrumentedModuleFromAddr(
+        reinterpret_cast<QBDI::rword>(StartupTarget));
+    vm.addCodeCB(QBDI::PREINST, firstInstAnalysisCB, &length);
+
+    QBDI::rword ret_value = 0;
+    vm.call(&ret_value, reinterpret_cast<QBDI::rword>(StartupTarget),
+            {static_cast<QBDI::rword>(2)});
+    QBDI::alignedFree(fakestack);
+    return length;
+  };
+}
@@ -0,0 +1,130 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <stdlib.h>
+
+#include "ExecBroker/PageIndex.h"
+
+#include "QBDI/Range.h"
+
+static bool indexContains(const QBDI::PageIndex &index,
+                          const QBDI::RangeSet<QBDI::rword> &ranges,
+                          QBDI::rword addr) {
+  switch (index.lookup(addr)) {
+    case QBDI::PageIndex::FULL:
+      return true;
+    case QBDI::PageIndex::EMPTY:
+      return false;
+    default:
+      return ranges.contains(addr);
+  }
+}
+
+static void checkIndex(const QBDI::PageIndex &index,
+                       const QBDI::RangeSet<QBDI::rword> &ranges,
+                       QBDI::rword start, QBDI::rword end) {
+  for (QBDI::rword addr = start; addr < end; addr += 0x100) {
+    INFO("Address 0x" << std::hex << addr);
+    REQUIRE(indexContains(index, ranges, addr) == ranges.contains(addr));
+  }
+}
+
+TEST_CASE("PageIndex-AddRemove") {
+  QBDI::PageIndex index(0x1000);
+  QBDI::RangeSet<QBDI::rword> ranges;
+
+  ranges.add({0x10000, 0x15800});
+  index.update({0x10000, 0x15800}, ranges, true);
+  CHECK(index.lookup(0x10000) == QBDI::PageIndex::FULL);
+  CHECK(index.lookup(0x15000) == QBDI::PageIndex::PARTIAL);
+  CHECK(index.lookup(0x16000) == QBDI::PageIndex::EMPTY);
+  CHECK(index.lookup(0xf000) == QBDI::PageIndex::EMPTY);
+
+  ranges.add({0x15800, 0x16000});
+  index.update({0x15800, 0x16000}, ranges, true);
+  CHECK(index.lookup(0x15000) == QBDI::PageIndex::FULL);
+
+  ranges.remove({0x11100, 0x13200});
+  index.update({0x11100, 0x13200}, ranges, false);
+  CHECK(index.lookup(0x11000) == QBDI::PageIndex::PARTIAL);
+  CHECK(index.lookup(0x12000) == QBDI::PageIndex::EMPTY);
+  CHECK(index.lookup(0x13000) == QBDI::PageIndex::PARTIAL);
+
+  checkIndex(index, ranges, 0xe000, 0x18000);
+}
+
+TEST_CASE("PageIndex-Random") {
+  QBDI::PageIndex index(0x1000);
+  QBDI::RangeSet<QBDI::rword> ranges;
+  const QBDI::rword base = 0x70000000;
+
+  srand(0x5eed);
+  for (int i = 0; i < 200; i++) {
+    QBDI::rword start = base + (rand() % 0x40000);
+    QBDI::rword end = start + 1 + (rand() % 0x8000);
+    QBDI::Range<QBDI::rword> r{start, end};
+    bool add = (rand() % 3) != 0;
+    if (add) {
+      ranges.add(r);
+    } else {
+      ranges.remove(r);
+    }
+    index.update(r, ranges, add);
+  }
+  checkIndex(index, ranges, base - 0x1000, base + 0x50000);
+
+  QBDI::PageIndex rebuilt(0x1000);
+  rebuilt.rebuild(ranges);
+  checkIndex(rebuilt, ranges, base - 0x1000, base + 0x50000);
+}
+
+TEST_CASE("PageIndex-HugeRange") {
+  QBDI::PageIndex index(0x1000);
+  QBDI::RangeSet<QBDI::rword> ranges;
+  QBDI::Range<QBDI::rword> r{0x1000, ~static_cast<QBDI::rword>(0) >> 1};
+
+  // on 64 bits, the index gives up and the lookups fall back on the RangeSet
+  ranges.add(r);
+  index.update(r, ranges, true);
+  CHECK(indexContains(index, ranges, 0x2000));
+  CHECK_FALSE(indexContains(index, ranges, 0x10));
+
+  ranges.clear();
+  index.rebuild(ranges);
+  CHECK(index.lookup(0x2000) == QBDI::PageIndex::EMPTY);
+}
+
+TEST_CASE("PageIndex-RemoveHugeRange") {
+  QBDI::PageIndex index(0x1000);
+  QBDI::RangeSet<QBDI::rword> ranges;
+  QBDI::Range<QBDI::rword> small{0x10000, 0x12800};
+  QBDI::Range<QBDI::rword> r{0x11000, ~static_cast<QBDI::rword>(0) >> 1};
+
+  ranges.add(small);
+  index.update(small, ranges, true);
+  ranges.add({0x40000000, 0x40002000});
+  index.update({0x40000000, 0x40002000}, ranges, true);
+
+  // only the leaves of the index are visited, not every page of the range
+  ranges.remove(r);
+  index.update(r, ranges, false);
+  CHECK(index.lookup(0x10000) == QBDI::PageIndex::FULL);
+  CHECK(index.lookup(0x11000) == QBDI::PageIndex::EMPTY);
+  CHECK(index.lookup(0x40000000) == QBDI::PageIndex::EMPTY);
+  checkIndex(index, ranges, 0xf000, 0x14000);
+}
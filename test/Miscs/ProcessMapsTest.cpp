@@ -0,0 +1,63 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <catch2/catch.hpp>
+
+#include "QBDI/Memory.hpp"
+#include "QBDI/Platform.h"
+#include "Utility/ProcessMaps.h"
+
+QBDI_NOINLINE int processMapsTestFunction(int a) { return a + 1; }
+
+TEST_CASE("ProcessMaps-SameAsCurrentProcessMaps") {
+  QBDI::rword addr = reinterpret_cast<QBDI::rword>(processMapsTestFunction);
+
+  QBDI::ProcessMaps::Snapshot snapshot = QBDI::ProcessMaps::get().refresh();
+  std::vector<QBDI::MemoryMap> maps = QBDI::getCurrentProcessMaps(false);
+
+  const QBDI::MemoryMap *cached = snapshot->findByAddress(addr);
+  REQUIRE(cached != nullptr);
+  CHECK((cached->permission & QBDI::PF_EXEC) != 0);
+
+  auto it = std::find_if(
+      maps.begin(), maps.end(),
+      [addr](const QBDI::MemoryMap &m) { return m.range.contains(addr); });
+  REQUIRE(it != maps.end());
+  CHECK(it->name == cached->name);
+  CHECK(it->range == cached->range);
+
+  if (not cached->name.empty()) {
+    const std::vector<size_t> *idx = snapshot->findByName(cached->name);
+    REQUIRE(idx != nullptr);
+    CHECK(std::find_if(idx->begin(), idx->end(), [&](size_t i) {
+            return &snapshot->getMaps()[i] == cached;
+          }) != idx->end());
+  }
+}
+
+TEST_CASE("ProcessMaps-SnapshotReuse") {
+  QBDI::ProcessMaps::Snapshot first = QBDI::ProcessMaps::get().snapshot();
+
+  QBDI::invalidateProcessMapsCache();
+  QBDI::ProcessMaps::Snapshot second = QBDI::ProcessMaps::get().snapshot();
+  CHECK(first != second);
+  // the previous snapshot is still usable
+  CHECK(first->getMaps().size() != 0);
+
+  CHECK(second->findByName("not a module name") == nullptr);
+}
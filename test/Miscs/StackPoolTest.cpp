@@ -0,0 +1,65 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <string.h>
+
+#include "QBDI/Memory.hpp"
+#include "Utility/ProcessMaps.h"
+#include "Utility/StackPool.h"
+
+TEST_CASE("StackPool-Reuse") {
+  QBDI::StackPool pool;
+
+  uint8_t *stack1 = pool.acquire(0x20000);
+  REQUIRE(stack1 != nullptr);
+  memset(stack1, 0x41, 0x20000);
+
+  // a stack in use isn't given twice
+  uint8_t *stack2 = pool.acquire(0x20000);
+  REQUIRE(stack2 != nullptr);
+  CHECK(stack1 != stack2);
+
+  pool.release(stack1);
+  CHECK(pool.acquire(0x10000) == stack1);
+  // the memory of a released stack is kept
+  CHECK(stack1[0x1000] == 0x41);
+
+  pool.release(stack1);
+  pool.release(stack2);
+}
+
+TEST_CASE("StackPool-GuardPage") {
+  QBDI::StackPool pool;
+
+  uint8_t *stack = pool.acquire(0x20000);
+  REQUIRE(stack != nullptr);
+
+  QBDI::rword guard = reinterpret_cast<QBDI::rword>(stack) - pool.getPageSize();
+  QBDI::ProcessMaps::Snapshot snapshot = QBDI::ProcessMaps::get().refresh();
+
+  const QBDI::MemoryMap *guardMap = snapshot->findByAddress(guard);
+  REQUIRE(guardMap != nullptr);
+  CHECK(guardMap->permission == QBDI::PF_NONE);
+
+  const QBDI::MemoryMap *stackMap =
+      snapshot->findByAddress(reinterpret_cast<QBDI::rword>(stack));
+  REQUIRE(stackMap != nullptr);
+  CHECK((stackMap->permission & QBDI::PF_WRITE) != 0);
+
+  pool.release(stack);
+}
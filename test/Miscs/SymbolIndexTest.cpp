@@ -0,0 +1,61 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "QBDI/Platform.h"
+#include "Utility/SymbolIndex.h"
+
+extern "C" QBDI_NOINLINE int qbdiSymbolIndexTestFunction(int a) {
+  return a * 3 + 1;
+}
+
+TEST_CASE("SymbolIndex-LocalFunction") {
+  QBDI::rword addr = reinterpret_cast<QBDI::rword>(qbdiSymbolIndexTestFunction);
+  QBDI::SymbolInfo info;
+
+  REQUIRE(QBDI::SymbolIndex::get().lookup(addr, info));
+  REQUIRE(info.moduleName != nullptr);
+  // the test binary is not stripped
+  REQUIRE(info.symbolName != nullptr);
+  CHECK(strcmp(info.symbolName, "qbdiSymbolIndexTestFunction") == 0);
+  CHECK(info.symbolOffset <= 1);
+}
+
+TEST_CASE("SymbolIndex-SharedLibrary") {
+  QBDI::rword addr = reinterpret_cast<QBDI::rword>(fopen);
+  QBDI::SymbolInfo info;
+  Dl_info dlinfo;
+
+  REQUIRE(dladdr(reinterpret_cast<void *>(addr), &dlinfo) != 0);
+  REQUIRE(QBDI::SymbolIndex::get().lookup(addr, info));
+  REQUIRE(info.moduleName != nullptr);
+  CHECK(strstr(dlinfo.dli_fname, info.moduleName) != nullptr);
+  if (dlinfo.dli_saddr != nullptr) {
+    REQUIRE(info.symbolName != nullptr);
+    CHECK(addr - info.symbolOffset ==
+          reinterpret_cast<QBDI::rword>(dlinfo.dli_saddr));
+  }
+}
+
+TEST_CASE("SymbolIndex-UnknownAddress") {
+  QBDI::SymbolInfo info;
+  CHECK_FALSE(QBDI::SymbolIndex::get().lookup(0x10, info));
+}
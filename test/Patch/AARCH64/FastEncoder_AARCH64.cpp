@@ -0,0 +1,131 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+
+#include "AArch64InstrInfo.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCRegisterInfo.h"
+
+#include "TestSetup/LLVMTestEnv.h"
+#include "Patch/AARCH64/Layer2_AARCH64.h"
+#include "Patch/FastEncoder.h"
+#include "Patch/Utils.h"
+
+namespace {
+
+// Compare the fast encoder with the LLVM MCCodeEmitter. Returns false if the
+// instruction isn't supported by the fast encoder.
+bool checkFastEncoder(const QBDI::LLVMCPU &llvmcpu, const llvm::MCInst &inst) {
+  llvm::SmallVector<char, 16> fast;
+  llvm::SmallVector<char, 16> expected;
+
+  if (not QBDI::fastEncodeInstruction(inst, fast, llvmcpu.getMRI())) {
+    CHECK(fast.empty());
+    return false;
+  }
+  llvmcpu.writeInstructionMC(inst, expected);
+  INFO("Instruction " << llvmcpu.showInst(inst, 0));
+  CHECK(llvm::ArrayRef<char>(fast) == llvm::ArrayRef<char>(expected));
+  return true;
+}
+
+QBDI::RegLLVM randomReg(const llvm::MCRegisterInfo &MRI, unsigned regClass) {
+  const llvm::MCRegisterClass &RC = MRI.getRegClass(regClass);
+  return RC.getRegister(get_random() % RC.getNumRegs());
+}
+
+QBDI::sword randomRange(QBDI::sword min, QBDI::sword max) {
+  return min + static_cast<QBDI::sword>(get_random() % (max - min + 1));
+}
+
+} // namespace
+
+TEST_CASE_METHOD(LLVMTestEnv, "FastEncoder_AARCH64-CompareWithLLVM") {
+  INFO("TEST_SEED=" << seed_random());
+  const QBDI::LLVMCPU &llvmcpu = getCPU(QBDI::CPUMode::DEFAULT);
+  const llvm::MCRegisterInfo &MRI = llvmcpu.getMRI();
+
+  for (unsigned i = 0; i < 5000; i++) {
+    QBDI::RegLLVM reg = randomReg(MRI, llvm::AArch64::GPR64RegClassID);
+    QBDI::RegLLVM reg2 = randomReg(MRI, llvm::AArch64::GPR64RegClassID);
+    QBDI::RegLLVM base = randomReg(MRI, llvm::AArch64::GPR64spRegClassID);
+    QBDI::sword offset = (get_random() % 2) ? randomRange(0, 4095) * 8
+                                            : randomRange(-256, 255);
+    llvm::MCInst inst;
+
+    switch (get_random() % 14) {
+      case 0:
+        inst = QBDI::ldr(reg, base, offset);
+        break;
+      case 1:
+        inst = QBDI::str(reg, base, offset);
+        break;
+      case 2:
+        inst = QBDI::ldp(reg, reg2, base, randomRange(-64, 63) * 8);
+        break;
+      case 3:
+        inst = QBDI::stp(reg, reg2, base, randomRange(-64, 63) * 8);
+        break;
+      case 4:
+        inst = QBDI::addri(base, base, randomRange(0, 4095));
+        break;
+      case 5:
+        inst = QBDI::subri(base, base, randomRange(1, 4095) << 12);
+        break;
+      case 6:
+        inst = QBDI::movrr(reg, reg2);
+        break;
+      case 7:
+        inst = QBDI::movri(reg, get_random());
+        break;
+      case 8:
+        inst = QBDI::orrrs(reg, reg2, reg, randomRange(0, 63));
+        break;
+      case 9:
+        inst = (get_random() % 2) ? QBDI::br(reg) : QBDI::blr(reg);
+        break;
+      case 10:
+        inst = QBDI::ret(reg);
+        break;
+      case 11:
+        inst = QBDI::adr(reg, randomRange(-(1 << 20), (1 << 20) - 1));
+        break;
+      case 12:
+        inst = QBDI::adrp(reg, randomRange(-(1 << 20), (1 << 20) - 1) * 0x1000);
+        break;
+      default:
+        inst = (get_random() % 2)
+                   ? QBDI::branch(randomRange(0, (1 << 25) - 1) * 4)
+                   : QBDI::hint(randomRange(0, 127));
+        break;
+    }
+    CHECK(checkFastEncoder(llvmcpu, inst));
+  }
+}
+
+TEST_CASE_METHOD(LLVMTestEnv, "FastEncoder_AARCH64-Unsupported") {
+  const QBDI::LLVMCPU &llvmcpu = getCPU(QBDI::CPUMode::DEFAULT);
+
+  // 32 bits registers and exclusive access are left to LLVM
+  CHECK_FALSE(checkFastEncoder(
+      llvmcpu, QBDI::ldrw(llvm::AArch64::W0, llvm::AArch64::X1, 4)));
+  CHECK_FALSE(checkFastEncoder(
+      llvmcpu, QBDI::ldxrb(llvm::AArch64::W0, llvm::AArch64::X1)));
+  CHECK_FALSE(checkFastEncoder(llvmcpu, QBDI::brk(0)));
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <stdint.h>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/MC/MCInst.h"
+
+#include "Engine/DecodeCache.h"
+#include "Engine/LLVMCPU.h"
+
+#include "QBDI/Config.h"
+
+using namespace QBDI;
+
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+// nop ; int3
+static const uint8_t codeA[] = {0x90};
+static const uint8_t codeB[] = {0xcc};
+#elif defined(QBDI_ARCH_ARM)
+// nop ; bkpt #0
+static const uint8_t codeA[] = {0x00, 0xf0, 0x20, 0xe3};
+static const uint8_t codeB[] = {0x70, 0x00, 0x20, 0xe1};
+#elif defined(QBDI_ARCH_AARCH64)
+// nop ; brk #0
+static const uint8_t codeA[] = {0x1f, 0x20, 0x03, 0xd5};
+static const uint8_t codeB[] = {0x00, 0x00, 0x20, 0xd4};
+#endif
+
+TEST_CASE("DecodeCache-SameBytes") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  DecodeCache cache;
+
+  llvm::MCInst inst1, inst2;
+  uint64_t size1 = 0, size2 = 0;
+
+  REQUIRE(cache.getInstruction(llvmcpu, inst1, size1,
+                               llvm::ArrayRef<uint8_t>(codeA), 0x1000));
+  CHECK(size1 == sizeof(codeA));
+  CHECK(cache.size() == 1);
+
+  REQUIRE(cache.getInstruction(llvmcpu, inst2, size2,
+                               llvm::ArrayRef<uint8_t>(codeA), 0x1000));
+  CHECK(size2 == size1);
+  CHECK(inst2.getOpcode() == inst1.getOpcode());
+  CHECK(cache.size() == 1);
+
+  REQUIRE(cache.getInstruction(llvmcpu, inst2, size2,
+                               llvm::ArrayRef<uint8_t>(codeA), 0x2000));
+  CHECK(cache.size() == 2);
+}
+
+TEST_CASE("DecodeCache-ModifiedBytes") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  DecodeCache cache;
+
+  llvm::MCInst instA, instB, inst;
+  uint64_t size = 0;
+
+  REQUIRE(llvmcpu.getInstruction(instA, size, llvm::ArrayRef<uint8_t>(codeA),
+                                 0x1000));
+  REQUIRE(llvmcpu.getInstruction(instB, size, llvm::ArrayRef<uint8_t>(codeB),
+                                 0x1000));
+  REQUIRE(instA.getOpcode() != instB.getOpcode());
+
+  REQUIRE(cache.getInstruction(llvmcpu, inst, size,
+                               llvm::ArrayRef<uint8_t>(codeA), 0x1000));
+  CHECK(inst.getOpcode() == instA.getOpcode());
+
+  // the bytes at the address have changed
+  REQUIRE(cache.getInstruction(llvmcpu, inst, size,
+                               llvm::ArrayRef<uint8_t>(codeB), 0x1000));
+  CHECK(inst.getOpcode() == instB.getOpcode());
+  CHECK(cache.size() == 1);
+
+  cache.clear(Range<rword>(0x1000, 0x1001));
+  CHECK(cache.size() == 0);
+
+  REQUIRE(cache.getInstruction(llvmcpu, inst, size,
+                               llvm::ArrayRef<uint8_t>(codeA), 0x1000));
+  cache.clear();
+  CHECK(cache.size() == 0);
+}
+
+#if defined(QBDI_ARCH_ARM)
+TEST_CASE("DecodeCache-Thumb") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::Thumb);
+  DecodeCache cache;
+
+  // it eq ; nop
+  static const uint8_t thumbIT[] = {0x08, 0xbf};
+  static const uint8_t thumbNop[] = {0x00, 0xbf};
+
+  llvm::MCInst inst;
+  uint64_t size = 0;
+
+  // the decoding of the instructions in the IT block depends on the IT
+  // instruction, the Thumb instructions are never cached
+  REQUIRE(cache.getInstruction(llvmcpu, inst, size,
+                               llvm::ArrayRef<uint8_t>(thumbIT), 0x1000));
+  CHECK(size == sizeof(thumbIT));
+  REQUIRE(cache.getInstruction(llvmcpu, inst, size,
+                               llvm::ArrayRef<uint8_t>(thumbNop), 0x1002));
+  CHECK(size == sizeof(thumbNop));
+  CHECK(cache.size() == 0);
+}
+#endif
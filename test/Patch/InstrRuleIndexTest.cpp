@@ -0,0 +1,99 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Engine/LLVMCPU.h"
+#include "Patch/InstrRule.h"
+#include "Patch/PatchCondition.h"
+#include "Patch/PatchGenerator.h"
+
+using namespace QBDI;
+
+namespace {
+
+using RuleVec = std::vector<std::pair<uint32_t, std::unique_ptr<InstrRule>>>;
+
+VMAction emptyCB(VMInstanceRef vm, GPRState *gprState, FPRState *fprState,
+                 void *data) {
+  return VMAction::CONTINUE;
+}
+
+void addRule(RuleVec &rules, PatchCondition::UniquePtr &&condition) {
+  uint32_t id = rules.size();
+  rules.emplace_back(id, InstrRuleBasicCBK::unique(std::move(condition),
+                                                   emptyCB, nullptr,
+                                                   InstPosition::PREINST,
+                                                   true));
+}
+
+std::vector<uint32_t> getRules(const InstrRuleIndex &index, rword address,
+                               unsigned opcode) {
+  std::vector<uint32_t> rules;
+  index.getRules(address, opcode, rules);
+  return rules;
+}
+
+} // namespace
+
+TEST_CASE("InstrRuleIndex-Address") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  RuleVec rules;
+
+  // 0
+  addRule(rules, AddressIs::unique(0x1000));
+  // 1
+  addRule(rules, True::unique());
+  // 2
+  addRule(rules, InstructionInRange::unique(Constant(0x800), Constant(0x1800)));
+  // 3
+  addRule(rules, AddressIs::unique(0x1400));
+  // 4
+  addRule(rules, OpIs::unique(10));
+
+  InstrRuleIndex index(rules, llvmcpu);
+
+  CHECK(getRules(index, 0x1000, 11) == std::vector<uint32_t>({0, 1, 2}));
+  CHECK(getRules(index, 0x1000, 10) == std::vector<uint32_t>({0, 1, 2, 4}));
+  CHECK(getRules(index, 0x1004, 11) == std::vector<uint32_t>({1, 2}));
+  CHECK(getRules(index, 0x1400, 11) == std::vector<uint32_t>({1, 2, 3}));
+  CHECK(getRules(index, 0x1800, 11) == std::vector<uint32_t>({1}));
+  CHECK(getRules(index, 0x100, 10) == std::vector<uint32_t>({1, 4}));
+}
+
+TEST_CASE("InstrRuleIndex-Mnemonic") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  unsigned numOpcodes = llvmcpu.getMCII().getNumOpcodes();
+  REQUIRE(numOpcodes > 100);
+
+  // a mnemonic that doesn't match the first opcodes (PHI, INLINEASM, ...)
+  const char *mnemonic = llvmcpu.getInstOpcodeName(numOpcodes - 1);
+  RuleVec rules;
+  addRule(rules, MnemonicIs::unique(mnemonic));
+  addRule(rules, Not::unique(MnemonicIs::unique(mnemonic)));
+
+  InstrRuleIndex index(rules, llvmcpu);
+
+  CHECK(getRules(index, 0x1000, numOpcodes - 1) ==
+        std::vector<uint32_t>({0, 1}));
+  CHECK(getRules(index, 0x1000, 0) == std::vector<uint32_t>({1}));
+}
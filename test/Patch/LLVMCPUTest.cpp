@@ -0,0 +1,134 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <stdint.h>
+#include <thread>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/MC/MCInst.h"
+
+#include "Engine/LLVMCPU.h"
+#include "Patch/InstMetadata.h"
+#include "Utility/InstAnalysis_prive.h"
+
+#include "QBDI/Config.h"
+
+using namespace QBDI;
+
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+// nop
+static const uint8_t code[] = {0x90};
+#elif defined(QBDI_ARCH_ARM)
+// nop
+static const uint8_t code[] = {0x00, 0xf0, 0x20, 0xe3};
+#elif defined(QBDI_ARCH_AARCH64)
+// nop
+static const uint8_t code[] = {0x1f, 0x20, 0x03, 0xd5};
+#endif
+
+TEST_CASE("LLVMCPU-SharedTarget") {
+  LLVMCPUs llvmcpus1("", {});
+  LLVMCPUs llvmcpus2("", {});
+  // same configuration as a copy of a VM
+  LLVMCPUs llvmcpus3(llvmcpus1.getCPU(), llvmcpus1.getMattrs());
+
+  for (int i = 0; i < CPUMode::COUNT; i++) {
+    const LLVMCPU &cpu1 = llvmcpus1.getCPU(static_cast<CPUMode>(i));
+    const LLVMCPU &cpu2 = llvmcpus2.getCPU(static_cast<CPUMode>(i));
+    const LLVMCPU &cpu3 = llvmcpus3.getCPU(static_cast<CPUMode>(i));
+
+    CHECK(&cpu1.getMCII() == &cpu2.getMCII());
+    CHECK(&cpu1.getMRI() == &cpu2.getMRI());
+    CHECK(&cpu1.getMCII() == &cpu3.getMCII());
+    CHECK(&cpu1.getMRI() == &cpu3.getMRI());
+    // the mutable objects aren't shared
+    CHECK(&cpu1.getAnalysisCache() != &cpu2.getAnalysisCache());
+  }
+  CHECK(llvmcpus1.isSameCPU(llvmcpus2));
+  CHECK(llvmcpus1.isSameCPU(llvmcpus3));
+}
+
+TEST_CASE("LLVMCPU-Threads") {
+  // one LLVMCPUs per thread, sharing the same target
+  auto worker = [](bool *success) {
+    LLVMCPUs llvmcpus("", {});
+    const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+    *success = true;
+    for (int i = 0; i < 1000; i++) {
+      llvm::MCInst inst;
+      uint64_t size = 0;
+      if (not llvmcpu.getInstruction(inst, size,
+                                     llvm::ArrayRef<uint8_t>(code), 0x1000) or
+          size != sizeof(code) or
+          llvmcpu.showInst(inst, 0x1000).find("nop") == std::string::npos) {
+        *success = false;
+      }
+    }
+  };
+  bool success[4] = {false, false, false, false};
+  std::thread threads[4];
+  for (int i = 0; i < 4; i++) {
+    threads[i] = std::thread(worker, &success[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    threads[i].join();
+    CHECK(success[i]);
+  }
+}
+
+TEST_CASE("LLVMCPU-AnalysisCacheGeneration") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  InstAnalysisCache &cache = llvmcpu.getAnalysisCache();
+
+  llvm::MCInst inst;
+  uint64_t size = 0;
+  REQUIRE(llvmcpu.getInstruction(inst, size, llvm::ArrayRef<uint8_t>(code),
+                                 0x1000));
+  InstMetadata metadata(inst, 0x1000, size, CPUMode::DEFAULT, 0);
+
+  const InstAnalysis *ana = analyzeInstMetadata(
+      metadata, ANALYSIS_INSTRUCTION | ANALYSIS_DISASSEMBLY, llvmcpu);
+  REQUIRE(ana != nullptr);
+  CHECK(ana->address == 0x1000);
+  std::string disassembly = ana->disassembly;
+
+  // another metadata of the same instruction shares the analysis
+  InstMetadata metadata2(inst, 0x1000, size, CPUMode::DEFAULT, 0);
+  CHECK(analyzeInstMetadata(metadata2, ANALYSIS_INSTRUCTION, llvmcpu) == ana);
+  CHECK(cache.size() == 1);
+
+  // the analysis used in the previous generation is kept
+  cache.newGeneration();
+  ana = analyzeInstMetadata(metadata, ANALYSIS_INSTRUCTION, llvmcpu);
+  CHECK(metadata.analysisGeneration == cache.getGeneration());
+  CHECK(ana->address == 0x1000);
+  CHECK(ana->disassembly == disassembly);
+  CHECK(analyzeInstMetadata(metadata2, ANALYSIS_INSTRUCTION, llvmcpu) == ana);
+  CHECK(cache.size() == 1);
+
+  // the analysis unused for a full generation is freed
+  cache.newGeneration();
+  CHECK(cache.size() == 1);
+  cache.newGeneration();
+  CHECK(cache.size() == 0);
+  ana = analyzeInstMetadata(metadata, ANALYSIS_INSTRUCTION, llvmcpu);
+  CHECK(ana->address == 0x1000);
+  CHECK(ana->disassembly == nullptr);
+  CHECK(cache.size() == 1);
+}
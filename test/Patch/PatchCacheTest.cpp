@@ -0,0 +1,214 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/MC/MCInst.h"
+
+#include "Engine/LLVMCPU.h"
+#include "Engine/PatchCache.h"
+#include "Patch/Patch.h"
+
+#include "QBDI/Config.h"
+
+using namespace QBDI;
+
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+// nop ; int3
+static const uint8_t codeA[] = {0x90};
+static const uint8_t codeB[] = {0xcc};
+#elif defined(QBDI_ARCH_ARM)
+// nop ; bkpt #0
+static const uint8_t codeA[] = {0x00, 0xf0, 0x20, 0xe3};
+static const uint8_t codeB[] = {0x70, 0x00, 0x20, 0xe1};
+#elif defined(QBDI_ARCH_AARCH64)
+// nop ; brk #0
+static const uint8_t codeA[] = {0x1f, 0x20, 0x03, 0xd5};
+static const uint8_t codeB[] = {0x00, 0x00, 0x20, 0xd4};
+#endif
+
+TEST_CASE("PatchCache-SameBytes") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  PatchCache cache;
+
+  uint8_t code[sizeof(codeA)];
+  memcpy(code, codeA, sizeof(codeA));
+  rword address = reinterpret_cast<rword>(code);
+
+  llvm::MCInst inst;
+  uint64_t size = 0;
+  REQUIRE(llvmcpu.getInstruction(inst, size, llvm::ArrayRef<uint8_t>(code),
+                                 address));
+
+  std::vector<Patch> basicBlock;
+  basicBlock.emplace_back(inst, address, size, llvmcpu);
+  cache.addBasicBlock(basicBlock, llvm::ArrayRef<uint8_t>(code), false);
+  CHECK(cache.size() == 1);
+
+  std::vector<Patch> copy;
+  REQUIRE(cache.getBasicBlock(CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code),
+                              address, copy));
+  REQUIRE(copy.size() == 1);
+  CHECK(copy[0].metadata.address == address);
+  CHECK(copy[0].metadata.instSize == size);
+  CHECK(copy[0].metadata.inst.getOpcode() == inst.getOpcode());
+  CHECK(cache.size() == 1);
+
+  // another address isn't in the cache
+  CHECK_FALSE(cache.getBasicBlock(
+      CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code), address + 1, copy));
+}
+
+TEST_CASE("PatchCache-ModifiedBytes") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  PatchCache cache;
+
+  uint8_t code[sizeof(codeA)];
+  memcpy(code, codeA, sizeof(codeA));
+  rword address = reinterpret_cast<rword>(code);
+
+  llvm::MCInst inst;
+  uint64_t size = 0;
+  REQUIRE(llvmcpu.getInstruction(inst, size, llvm::ArrayRef<uint8_t>(code),
+                                 address));
+
+  std::vector<Patch> basicBlock;
+  basicBlock.emplace_back(inst, address, size, llvmcpu);
+  cache.addBasicBlock(basicBlock, llvm::ArrayRef<uint8_t>(code), false);
+  CHECK(cache.size() == 1);
+
+  // the code of the basic block has changed
+  std::vector<Patch> copy;
+  memcpy(code, codeB, sizeof(codeB));
+  CHECK_FALSE(cache.getBasicBlock(
+      CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code), address, copy));
+  CHECK(cache.size() == 0);
+
+  memcpy(code, codeA, sizeof(codeA));
+  cache.addBasicBlock(basicBlock, llvm::ArrayRef<uint8_t>(code), false);
+  CHECK(cache.size() == 1);
+
+  // the basic block is out of the available code
+  CHECK_FALSE(cache.getBasicBlock(
+      CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code, size - 1), address,
+      copy));
+  CHECK(cache.size() == 0);
+
+  cache.addBasicBlock(basicBlock, llvm::ArrayRef<uint8_t>(code), false);
+  cache.clear(Range<rword>(address + size - 1, address + size));
+  CHECK(cache.size() == 0);
+
+  cache.addBasicBlock(basicBlock, llvm::ArrayRef<uint8_t>(code), false);
+  cache.clear();
+  CHECK(cache.size() == 0);
+}
+
+TEST_CASE("PatchCache-TruncatedBlock") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  PatchCache cache;
+
+  uint8_t code[2 * sizeof(codeA)];
+  memcpy(code, codeA, sizeof(codeA));
+  memcpy(code + sizeof(codeA), codeA, sizeof(codeA));
+  rword address = reinterpret_cast<rword>(code);
+
+  llvm::MCInst inst;
+  uint64_t size = 0;
+  REQUIRE(llvmcpu.getInstruction(inst, size, llvm::ArrayRef<uint8_t>(code),
+                                 address));
+
+  // the basic block ended at the end of the instrumented range
+  std::vector<Patch> basicBlock;
+  basicBlock.emplace_back(inst, address, size, llvmcpu);
+  cache.addBasicBlock(basicBlock, llvm::ArrayRef<uint8_t>(code, size), true);
+  CHECK(cache.size() == 1);
+
+  std::vector<Patch> copy;
+  CHECK(cache.getBasicBlock(CPUMode::DEFAULT,
+                            llvm::ArrayRef<uint8_t>(code, size), address,
+                            copy));
+
+  // the range has been extended, the basic block must be patched again
+  CHECK_FALSE(cache.getBasicBlock(
+      CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code), address, copy));
+  CHECK(cache.size() == 0);
+}
+
+TEST_CASE("PatchCache-Eviction") {
+  LLVMCPUs llvmcpus("", {});
+  const LLVMCPU &llvmcpu = llvmcpus.getCPU(CPUMode::DEFAULT);
+  PatchCache cache;
+
+  const size_t nbBlocks = PatchCache::MAX_ENTRIES + 1;
+  std::vector<uint8_t> code;
+  for (size_t i = 0; i < nbBlocks; i++) {
+    code.insert(code.end(), codeA, codeA + sizeof(codeA));
+  }
+  rword address = reinterpret_cast<rword>(code.data());
+
+  llvm::MCInst inst;
+  uint64_t size = 0;
+  REQUIRE(llvmcpu.getInstruction(inst, size, llvm::ArrayRef<uint8_t>(code),
+                                 address));
+  REQUIRE(size == sizeof(codeA));
+
+  std::vector<Patch> basicBlock;
+  std::vector<Patch> copy;
+  for (size_t i = 0; i < nbBlocks - 1; i++) {
+    basicBlock.clear();
+    basicBlock.emplace_back(inst, address + i * size, size, llvmcpu);
+    cache.addBasicBlock(basicBlock,
+                        llvm::ArrayRef<uint8_t>(code).slice(i * size), false);
+  }
+  CHECK(cache.size() == PatchCache::MAX_ENTRIES);
+
+  // the first basic block is the most recently used
+  REQUIRE(cache.getBasicBlock(CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code),
+                              address, copy));
+
+  // the least recently used basic block is removed
+  basicBlock.clear();
+  basicBlock.emplace_back(inst, address + (nbBlocks - 1) * size, size,
+                          llvmcpu);
+  cache.addBasicBlock(
+      basicBlock, llvm::ArrayRef<uint8_t>(code).slice((nbBlocks - 1) * size),
+      false);
+  CHECK(cache.size() == PatchCache::MAX_ENTRIES);
+  CHECK(cache.getBasicBlock(CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code),
+                            address, copy));
+  CHECK_FALSE(cache.getBasicBlock(
+      CPUMode::DEFAULT, llvm::ArrayRef<uint8_t>(code).slice(size),
+      address + size, copy));
+  CHECK(cache.getBasicBlock(
+      CPUMode::DEFAULT,
+      llvm::ArrayRef<uint8_t>(code).slice((nbBlocks - 1) * size),
+      address + (nbBlocks - 1) * size, copy));
+
+  // only the basic blocks overlapping the range are removed
+  cache.clear(Range<rword>(address + 2 * size, address + 4 * size));
+  CHECK(cache.size() == PatchCache::MAX_ENTRIES - 2);
+  CHECK(cache.getBasicBlock(CPUMode::DEFAULT,
+                            llvm::ArrayRef<uint8_t>(code).slice(4 * size),
+                            address + 4 * size, copy));
+}
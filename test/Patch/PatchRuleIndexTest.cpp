@@ -0,0 +1,77 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+#include <vector>
+
+#include "Patch/PatchCondition.h"
+#include "Patch/PatchGenerator.h"
+#include "Patch/PatchRule.h"
+#include "Patch/PatchUtils.h"
+
+using namespace QBDI;
+
+static void addRule(std::vector<PatchRule> &rules,
+                    PatchCondition::UniquePtr &&condition) {
+  rules.emplace_back(std::move(condition),
+                     std::vector<std::unique_ptr<PatchGenerator>>());
+}
+
+TEST_CASE("PatchRuleIndex-Order") {
+  std::vector<PatchRule> rules;
+
+  // 0
+  addRule(rules, Or::unique(conv_unique<PatchCondition>(OpIs::unique(10),
+                                                        OpIs::unique(11))));
+  // 1
+  addRule(rules, UseReg::unique(Reg(0)));
+  // 2
+  addRule(rules, And::unique(conv_unique<PatchCondition>(
+                     OpIs::unique(11), UseReg::unique(Reg(0)))));
+  // 3
+  addRule(rules, Or::unique(conv_unique<PatchCondition>(
+                     OpIs::unique(12), UseReg::unique(Reg(0)))));
+  // 4
+  addRule(rules, Not::unique(OpIs::unique(10)));
+  // 5
+  addRule(rules, True::unique());
+
+  PatchRuleIndex index(rules);
+
+  CHECK(index.getRules(10) == std::vector<uint32_t>({0, 1, 3, 4, 5}));
+  CHECK(index.getRules(11) == std::vector<uint32_t>({0, 1, 2, 3, 4, 5}));
+  CHECK(index.getRules(12) == std::vector<uint32_t>({1, 3, 4, 5}));
+  CHECK(index.getRules(42) == std::vector<uint32_t>({1, 3, 4, 5}));
+}
+
+TEST_CASE("PatchRuleIndex-AndIntersection") {
+  std::vector<PatchRule> rules;
+
+  PatchCondition::UniquePtr left = Or::unique(
+      conv_unique<PatchCondition>(OpIs::unique(1), OpIs::unique(2)));
+  PatchCondition::UniquePtr right = Or::unique(
+      conv_unique<PatchCondition>(OpIs::unique(2), OpIs::unique(3)));
+  addRule(rules, And::unique(conv_unique<PatchCondition>(std::move(left),
+                                                         std::move(right))));
+  addRule(rules, True::unique());
+
+  PatchRuleIndex index(rules);
+
+  CHECK(index.getRules(1) == std::vector<uint32_t>({1}));
+  CHECK(index.getRules(2) == std::vector<uint32_t>({0, 1}));
+  CHECK(index.getRules(3) == std::vector<uint32_t>({1}));
+}
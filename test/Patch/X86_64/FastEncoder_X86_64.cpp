@@ -0,0 +1,134 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch.hpp>
+
+#include "X86InstrInfo.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCRegisterInfo.h"
+
+#include "TestSetup/LLVMTestEnv.h"
+#include "Patch/FastEncoder.h"
+#include "Patch/Utils.h"
+#include "Patch/X86_64/Layer2_X86_64.h"
+
+namespace {
+
+// Compare the fast encoder with the LLVM MCCodeEmitter. Returns false if the
+// instruction isn't supported by the fast encoder.
+bool checkFastEncoder(const QBDI::LLVMCPU &llvmcpu, const llvm::MCInst &inst) {
+  llvm::SmallVector<char, 16> fast;
+  llvm::SmallVector<char, 16> expected;
+
+  if (not QBDI::fastEncodeInstruction(inst, fast, llvmcpu.getMRI())) {
+    CHECK(fast.empty());
+    return false;
+  }
+  llvmcpu.writeInstructionMC(inst, expected);
+  INFO("Instruction " << llvmcpu.showInst(inst, 0));
+  CHECK(llvm::ArrayRef<char>(fast) == llvm::ArrayRef<char>(expected));
+  return true;
+}
+
+QBDI::RegLLVM randomGPR(const llvm::MCRegisterInfo &MRI) {
+  const llvm::MCRegisterClass &GR64 =
+      MRI.getRegClass(llvm::X86::GR64RegClassID);
+  unsigned reg;
+  do {
+    reg = GR64.getRegister(get_random() % GR64.getNumRegs());
+  } while (reg == llvm::X86::RIP);
+  return reg;
+}
+
+QBDI::rword randomDisplacement() {
+  switch (get_random() % 4) {
+    case 0:
+      return 0;
+    case 1:
+      return static_cast<int8_t>(get_random());
+    case 2:
+      return static_cast<int32_t>(get_random());
+    default:
+      return static_cast<int32_t>(get_random() % 600) - 300;
+  }
+}
+
+} // namespace
+
+TEST_CASE_METHOD(LLVMTestEnv, "FastEncoder_X86_64-CompareWithLLVM") {
+  INFO("TEST_SEED=" << seed_random());
+  const QBDI::LLVMCPU &llvmcpu = getCPU(QBDI::CPUMode::DEFAULT);
+  const llvm::MCRegisterInfo &MRI = llvmcpu.getMRI();
+
+  for (unsigned i = 0; i < 5000; i++) {
+    QBDI::RegLLVM dst = randomGPR(MRI);
+    QBDI::RegLLVM src = randomGPR(MRI);
+    QBDI::RegLLVM base = (get_random() % 6 == 0)
+                             ? QBDI::RegLLVM(llvm::X86::RIP)
+                             : randomGPR(MRI);
+    QBDI::rword disp = randomDisplacement();
+    llvm::MCInst inst;
+
+    switch (get_random() % 10) {
+      case 0:
+        inst = QBDI::mov64rm(dst, base, 1, 0, disp, 0);
+        break;
+      case 1:
+        inst = QBDI::mov64mr(base, 1, 0, disp, 0, src);
+        break;
+      case 2:
+        inst = QBDI::mov64rr(dst, src);
+        break;
+      case 3:
+        inst = QBDI::mov64ri(dst, get_random());
+        break;
+      case 4:
+        inst = QBDI::mov64ri32(dst, static_cast<int32_t>(get_random()));
+        break;
+      case 5:
+        inst = QBDI::push64r(src);
+        break;
+      case 6:
+        inst = QBDI::pop64r(dst);
+        break;
+      case 7:
+        inst = QBDI::jmp64m(base, disp);
+        break;
+      case 8:
+        inst = QBDI::jmp(disp);
+        break;
+      default:
+        inst = (get_random() % 2) ? QBDI::je(disp) : QBDI::jne(disp);
+        break;
+    }
+    CHECK(checkFastEncoder(llvmcpu, inst));
+  }
+}
+
+TEST_CASE_METHOD(LLVMTestEnv, "FastEncoder_X86_64-Unsupported") {
+  const QBDI::LLVMCPU &llvmcpu = getCPU(QBDI::CPUMode::DEFAULT);
+
+  // scaled index and segment register are left to LLVM
+  CHECK_FALSE(checkFastEncoder(
+      llvmcpu, QBDI::mov64rm(llvm::X86::RAX, llvm::X86::RBX, 8, llvm::X86::RCX,
+                             0x10, 0)));
+  CHECK_FALSE(checkFastEncoder(
+      llvmcpu, QBDI::mov64rm(llvm::X86::RAX, llvm::X86::RBX, 1, 0, 0x10,
+                             llvm::X86::FS)));
+  CHECK_FALSE(checkFastEncoder(llvmcpu, QBDI::pushf64()));
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "X86InstrInfo.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstBuilder.h"
+
+#include "TestSetup/LLVMTestEnv.h"
+#include "Patch/Patch.h"
+#include "Patch/Register.h"
+#include "Patch/X86_64/Layer2_X86_64.h"
+
+namespace {
+
+constexpr QBDI::rword bit(unsigned id) { return ((QBDI::rword)1) << id; }
+
+} // namespace
+
+TEST_CASE_METHOD(LLVMTestEnv, "RegisterLiveness_X86_64-KilledGPR") {
+  const QBDI::LLVMCPU &llvmcpu = getCPU(QBDI::CPUMode::DEFAULT);
+
+  // full and 32 bits writes overwrite the register
+  CHECK(QBDI::getKilledGPR(QBDI::mov64rr(llvm::X86::RBX, llvm::X86::RAX),
+                           llvmcpu) == bit(1));
+  CHECK(QBDI::getKilledGPR(QBDI::mov32ri(llvm::X86::ESI, 0), llvmcpu) ==
+        bit(4));
+  // a partial write keeps the upper bits
+  CHECK(QBDI::getKilledGPR(llvm::MCInstBuilder(llvm::X86::MOV8ri)
+                               .addReg(llvm::X86::DL)
+                               .addImm(1),
+                           llvmcpu) == 0);
+}
+
+TEST_CASE_METHOD(LLVMTestEnv, "RegisterLiveness_X86_64-DeadGPR") {
+  const QBDI::LLVMCPU &llvmcpu = getCPU(QBDI::CPUMode::DEFAULT);
+  std::vector<QBDI::Patch> basicBlock;
+  QBDI::rword address = 0x1000;
+
+  for (const llvm::MCInst &inst : {
+           // mov dl, 1
+           llvm::MCInst(llvm::MCInstBuilder(llvm::X86::MOV8ri)
+                            .addReg(llvm::X86::DL)
+                            .addImm(1)),
+           QBDI::mov64rr(llvm::X86::RBX, llvm::X86::RAX),
+           QBDI::mov32ri(llvm::X86::ESI, 0),
+           QBDI::mov64ri(llvm::X86::RDX, 0),
+           QBDI::addr64i(llvm::X86::RCX, llvm::X86::RCX, 1),
+       }) {
+    basicBlock.emplace_back(inst, address, 4, llvmcpu);
+    address += 4;
+  }
+
+  QBDI::computeDeadGPR(basicBlock);
+
+  // all the registers are alive at the end of the basic block
+  CHECK(basicBlock[4].deadGPR == 0);
+  CHECK(basicBlock[3].deadGPR == 0);
+  // RDX is overwritten by the next instruction
+  CHECK(basicBlock[2].deadGPR == bit(3));
+  CHECK(basicBlock[1].deadGPR == (bit(3) | bit(4)));
+  // the registers used by the instruction are never dead
+  CHECK(basicBlock[0].deadGPR == (bit(1) | bit(4)));
+}
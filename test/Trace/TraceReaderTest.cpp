@@ -0,0 +1,294 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <catch2/catch.hpp>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "QBDI/Memory.hpp"
+#include "QBDI/Platform.h"
+#include "QBDI/Trace.h"
+
+#include "API/APITest.h"
+
+#include "TraceDisassembler.h"
+#include "TraceReader.h"
+
+#define FAKE_RET_ADDR 0x666
+
+namespace {
+
+struct MemoryRecord {
+  QBDI::rword address;
+  uint32_t size;
+  bool write;
+
+  bool operator==(const MemoryRecord &other) const {
+    return address == other.address and size == other.size and
+           write == other.write;
+  }
+};
+
+class RecordVisitor : public QBDI::Trace::TraceVisitor {
+private:
+  const QBDI::Trace::TraceDisassembler *disassembler;
+
+public:
+  std::vector<QBDI::rword> sequences;
+  std::vector<QBDI::rword> instructions;
+  std::vector<MemoryRecord> accesses;
+
+  RecordVisitor(const QBDI::Trace::TraceDisassembler *disassembler = nullptr)
+      : disassembler(disassembler) {}
+
+  void onSequence(const QBDI::Trace::TraceBlock &block) override {
+    sequences.push_back(block.address);
+    if (disassembler != nullptr) {
+      for (const QBDI::Trace::TraceInstruction &inst :
+           disassembler->getInstructions(block)) {
+        instructions.push_back(inst.address);
+      }
+    }
+  }
+
+  void onMemoryAccess(const QBDI::Trace::TraceBlock *block,
+                      QBDI::rword address, uint32_t size,
+                      bool write) override {
+    accesses.push_back({address, size, write});
+  }
+};
+
+void appendVarint(std::string &buffer, uint64_t value) {
+  uint8_t tmp[16];
+  unsigned size = llvm::encodeULEB128(value, tmp);
+  buffer.append(reinterpret_cast<const char *>(tmp), size);
+}
+
+void appendDelta(std::string &buffer, QBDI::rword value,
+                 QBDI::rword previous) {
+  int64_t delta =
+      static_cast<std::make_signed_t<QBDI::rword>>(value - previous);
+  appendVarint(buffer, (static_cast<uint64_t>(delta) << 1) ^
+                           static_cast<uint64_t>(delta >> 63));
+}
+
+void appendSegment(std::string &file, QBDI::TraceSegmentKind kind,
+                   uint32_t number, const std::string &records) {
+  QBDI::TraceSegmentHeader header;
+  header.magic = QBDI_TRACE_SEGMENT_MAGIC;
+  header.kind = kind;
+  header.flags = 0;
+  header.size = records.size();
+  header.number = number;
+  file.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.append(records);
+}
+
+// expected content of a data segment of the generated trace
+constexpr QBDI::rword BLOCK_ADDRESS = 0x10000;
+constexpr size_t NB_ACCESSES = 50;
+
+QBDI::rword segmentBlock(size_t index) { return index % 2; }
+
+MemoryRecord segmentAccess(size_t index, size_t access) {
+  return {0x100000 + index * 0x1000 + access * 8, 8, access % 2 == 1};
+}
+
+} // anonymous namespace
+
+QBDI_DISABLE_ASAN QBDI_NOINLINE int traceFun(int *buffer, int n) {
+  volatile int *b = buffer;
+  int sum = 0;
+  for (int i = 0; i < n; i++) {
+    b[i] = i;
+    sum += b[i];
+  }
+  return sum;
+}
+
+TEST_CASE_METHOD(APITest, "TraceReader-RoundTrip") {
+  llvm::SmallString<128> path;
+  REQUIRE_FALSE(llvm::sys::fs::createTemporaryFile("qbdi", "trace", path));
+
+  std::vector<QBDI::rword> sequences;
+  std::vector<QBDI::rword> instructions;
+  std::vector<MemoryRecord> accesses;
+
+  vm.addVMEventCB(
+      QBDI::SEQUENCE_ENTRY,
+      [&sequences](QBDI::VMInstanceRef, const QBDI::VMState *vmState,
+                   QBDI::GPRState *, QBDI::FPRState *) {
+        sequences.push_back(vmState->sequenceStart);
+        return QBDI::VMAction::CONTINUE;
+      });
+  vm.addCodeCB(QBDI::InstPosition::PREINST,
+               [&instructions](QBDI::VMInstanceRef vm, QBDI::GPRState *,
+                               QBDI::FPRState *) {
+                 instructions.push_back(
+                     vm->getInstAnalysis(QBDI::ANALYSIS_INSTRUCTION)->address);
+                 return QBDI::VMAction::CONTINUE;
+               });
+  vm.addCodeCB(QBDI::InstPosition::POSTINST,
+               [&accesses](QBDI::VMInstanceRef vm, QBDI::GPRState *,
+                           QBDI::FPRState *) {
+                 for (const QBDI::MemoryAccess &m :
+                      vm->getInstMemoryAccess()) {
+                   uint32_t size = (m.flags & QBDI::MEMORY_UNKNOWN_SIZE)
+                                       ? 0
+                                       : m.size;
+                   accesses.push_back({m.accessAddress, size,
+                                       (m.type & QBDI::MEMORY_WRITE) != 0});
+                 }
+                 return QBDI::VMAction::CONTINUE;
+               });
+
+  int buffer[16];
+  REQUIRE(vm.startTraceRecording(path.c_str(),
+                                 QBDI::TRACE_SEQUENCE | QBDI::TRACE_MEMORY));
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {(QBDI::rword)buffer, 16});
+  REQUIRE(vm.run((QBDI::rword)traceFun, (QBDI::rword)FAKE_RET_ADDR));
+  vm.stopTraceRecording();
+  CHECK(QBDI_GPR_GET(vm.getGPRState(), QBDI::REG_RETURN) == 120);
+  REQUIRE(sequences.size() != 0);
+  REQUIRE(accesses.size() != 0);
+
+  std::string error;
+  std::unique_ptr<QBDI::Trace::TraceReader> reader =
+      QBDI::Trace::TraceReader::open(path.str().str(), error);
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->getNbDataSegments() != 0);
+
+  // the blocks keep the code of the sequences
+  for (const QBDI::Trace::TraceBlock &block : reader->getBlocks()) {
+    REQUIRE(block.code.size() == block.size);
+    CHECK(memcmp(block.code.data(),
+                 reinterpret_cast<const void *>(block.address),
+                 block.size) == 0);
+  }
+
+  QBDI::Trace::TraceDisassembler disassembler;
+  disassembler.disassemble(*reader);
+
+  RecordVisitor visitor{&disassembler};
+  for (size_t i = 0; i < reader->getNbDataSegments(); i++) {
+    REQUIRE(reader->decodeSegment(i, visitor, error));
+  }
+  CHECK(visitor.sequences == sequences);
+  CHECK(visitor.instructions == instructions);
+  CHECK(visitor.accesses == accesses);
+
+  llvm::sys::fs::remove(path);
+  SUCCEED();
+}
+
+TEST_CASE("TraceReader-DecodeParallel") {
+  llvm::SmallString<128> path;
+  REQUIRE_FALSE(llvm::sys::fs::createTemporaryFile("qbdi", "trace", path));
+
+  const size_t nbSegments = 37;
+  const uint8_t code[] = {0x1, 0x2, 0x3, 0x4};
+
+  std::string file;
+  QBDI::TraceFileHeader header;
+  memset(&header, 0, sizeof(header));
+  strncpy(header.magic, QBDI_TRACE_MAGIC, sizeof(header.magic));
+  header.version = QBDI_TRACE_VERSION;
+  header.rwordSize = sizeof(QBDI::rword);
+  file.append(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  uint32_t number = 0;
+  std::string records;
+  for (QBDI::rword id = 0; id < 2; id++) {
+    records.push_back(QBDI::TRACE_RECORD_BLOCK);
+    appendVarint(records, id);
+    appendVarint(records, 0);
+    appendVarint(records, BLOCK_ADDRESS + id * sizeof(code));
+    appendVarint(records, sizeof(code));
+    appendVarint(records, QBDI::CPUMode::DEFAULT);
+    records.append(reinterpret_cast<const char *>(code), sizeof(code));
+  }
+  appendSegment(file, QBDI::TRACE_SEGMENT_DICTIONARY, number++, records);
+
+  // the deltas begin with 0 in each data segment
+  for (size_t i = 0; i < nbSegments; i++) {
+    records.clear();
+    records.push_back(QBDI::TRACE_RECORD_SEQUENCE);
+    appendDelta(records, segmentBlock(i), 0);
+    QBDI::rword lastAddress = 0;
+    for (size_t j = 0; j < NB_ACCESSES; j++) {
+      MemoryRecord access = segmentAccess(i, j);
+      records.push_back(access.write ? QBDI::TRACE_RECORD_MEMORY_WRITE
+                                     : QBDI::TRACE_RECORD_MEMORY_READ);
+      appendDelta(records, access.address, lastAddress);
+      appendVarint(records, access.size);
+      lastAddress = access.address;
+    }
+    appendSegment(file, QBDI::TRACE_SEGMENT_DATA, number++, records);
+  }
+
+  {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec);
+    REQUIRE_FALSE(ec);
+    os << file;
+  }
+
+  std::string error;
+  std::unique_ptr<QBDI::Trace::TraceReader> reader =
+      QBDI::Trace::TraceReader::open(path.str().str(), error);
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->getBlocks().size() == 2);
+  REQUIRE(reader->getNbDataSegments() == nbSegments);
+
+  auto factory = [](size_t) { return std::make_unique<RecordVisitor>(); };
+
+  auto checkSegments = [&](size_t first, size_t count, unsigned nbThreads) {
+    std::vector<std::unique_ptr<QBDI::Trace::TraceVisitor>> visitors;
+    REQUIRE(reader->decodeParallel(first, count, nbThreads, factory, visitors,
+                                   error));
+    REQUIRE(visitors.size() == count);
+
+    // the visitors are returned in the order of the segments
+    for (size_t i = 0; i < count; i++) {
+      const RecordVisitor *visitor =
+          static_cast<const RecordVisitor *>(visitors[i].get());
+      REQUIRE(visitor != nullptr);
+      REQUIRE(visitor->sequences.size() == 1);
+      CHECK(visitor->sequences[0] ==
+            BLOCK_ADDRESS + segmentBlock(first + i) * sizeof(code));
+      REQUIRE(visitor->accesses.size() == NB_ACCESSES);
+      for (size_t j = 0; j < NB_ACCESSES; j++) {
+        CHECK(visitor->accesses[j] == segmentAccess(first + i, j));
+      }
+    }
+  };
+
+  checkSegments(0, nbSegments, 4);
+  checkSegments(0, nbSegments, 1);
+  checkSegments(5, 10, 0);
+
+  llvm::sys::fs::remove(path);
+  SUCCEED();
+}
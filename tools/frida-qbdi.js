@@ -303,8 +303,12 @@ var QBDI_C = Object.freeze({
     addCodeCB: _qbdibinder.bind('qbdi_addCodeCB', 'uint32', ['pointer', 'uint32', 'pointer', 'pointer', 'int32']),
     addCodeAddrCB: _qbdibinder.bind('qbdi_addCodeAddrCB', 'uint32', ['pointer', rword, 'uint32', 'pointer', 'pointer', 'int32']),
     addCodeRangeCB: _qbdibinder.bind('qbdi_addCodeRangeCB', 'uint32', ['pointer', rword, rword, 'uint32', 'pointer', 'pointer', 'int32']),
+    addCodeCBWithFlags: _qbdibinder.bind('qbdi_addCodeCBWithFlags', 'uint32', ['pointer', 'uint32', 'pointer', 'pointer', 'int32', 'uint32']),
+    addCodeAddrCBWithFlags: _qbdibinder.bind('qbdi_addCodeAddrCBWithFlags', 'uint32', ['pointer', rword, 'uint32', 'pointer', 'pointer', 'int32', 'uint32']),
+    addCodeRangeCBWithFlags: _qbdibinder.bind('qbdi_addCodeRangeCBWithFlags', 'uint32', ['pointer', rword, rword, 'uint32', 'pointer', 'pointer', 'int32', 'uint32']),
     addVMEventCB: _qbdibinder.bind('qbdi_addVMEventCB', 'uint32', ['pointer', 'uint32', 'pointer', 'pointer']),
     deleteInstrumentation: _qbdibinder.bind('qbdi_deleteInstrumentation', 'uchar', ['pointer', 'uint32']),
+    setInstrumentationEnabled: _qbdibinder.bind('qbdi_setInstrumentationEnabled', 'uchar', ['pointer', 'uint32', 'uchar']),
     deleteAllInstrumentations: _qbdibinder.bind('qbdi_deleteAllInstrumentations', 'void', ['pointer']),
     getInstAnalysis: _qbdibinder.bind('qbdi_getInstAnalysis', 'pointer', ['pointer', 'uint32']),
     getCachedInstAnalysis: _qbdibinder.bind('qbdi_getCachedInstAnalysis', 'pointer', ['pointer', rword, 'uint32']),
@@ -485,6 +489,27 @@ export var CallbackPriority = Object.freeze({
     PRIORITY_MEMACCESS_LIMIT: 0x1000000
 });
 
+/**
+ * Options of an InstCallback
+ *
+ * @enum {number}
+ * @readonly
+ */
+export var CallbackFlags = Object.freeze({
+    /**
+     * The callback is called from the VM after a break to the host.
+     */
+    CB_FLAG_NONE: 0,
+    /**
+     * The callback is called directly by the instrumented code. Only supported on X86 and X86_64 with OPT_ENABLE_INLINE_CALL.
+     */
+    CB_FLAG_INLINE_CALL: 1,
+    /**
+     * The callback is called at most once for each instrumented instruction.
+     */
+    CB_FLAG_ONE_SHOT: 2
+});
+
 /**
  * Events triggered by the virtual machine.
  *
@@ -795,6 +820,22 @@ export var Options = {
      * execblock doesn't used FPR.
      */
     OPT_DISABLE_OPTIONAL_FPR: 1 << 1,
+    /**
+     * Use the registers dead in the basic block as temporary registers of the
+     * instrumentation, without saving them. The value of these registers in
+     * the GPRState isn't reliable in the callbacks.
+     */
+    OPT_ENABLE_REGISTER_LIVENESS: 1 << 2,
+    /**
+     * Only record the address and the size of the memory accesses, not their
+     * value.
+     */
+    OPT_DISABLE_MEMORYACCESS_VALUE: 1 << 3,
+    /**
+     * Write-protect the pages of the translated code and invalidate the
+     * sequences of the modified pages.
+     */
+    OPT_DETECT_SELF_MODIFYING_CODE: 1 << 4,
 };
 if (Process.arch === 'x64') {
     /**
@@ -807,8 +848,14 @@ if (Process.arch === 'x64') {
      * supported by the operating system.
      */
     Options.OPT_ENABLE_FS_GS = 1 << 25;
+    /**
+     * Add the inline call stub in each ExecBlock. Needed by the callbacks
+     * registered with CB_FLAG_INLINE_CALL (for X86 and X86_64)
+     */
+    Options.OPT_ENABLE_INLINE_CALL = 1 << 26;
 } else if (Process.arch === 'ia32') {
     Options.OPT_ATT_SYNTAX = 1 << 24;
+    Options.OPT_ENABLE_INLINE_CALL = 1 << 26;
 } else if (Process.arch === 'arm64') {
     /**
      * Disable the emulation of the local monitor by QBDI
@@ -1412,13 +1459,14 @@ export class VM {
      * @param {InstCallback} cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}       data      User defined data passed to the callback.
      * @param {Int}          priority  The priority of the callback.
+     * @param {CallbackFlags} flags   The options of the callback.
      *
      * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
      */
-    addCodeCB(pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    addCodeCB(pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, flags = CallbackFlags.CB_FLAG_NONE) {
         var vm = this.#vm;
         return this._retainUserData(data, function (dataPtr) {
-            return QBDI_C.addCodeCB(vm, pos, cbk, dataPtr, priority);
+            return QBDI_C.addCodeCBWithFlags(vm, pos, cbk, dataPtr, priority, flags);
         });
     }
 
@@ -1430,13 +1478,14 @@ export class VM {
      * @param {InstCallback}  cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}        data      User defined data passed to the callback.
      * @param {Int}           priority  The priority of the callback.
+     * @param {CallbackFlags} flags    The options of the callback.
      *
      * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
      */
-    addCodeAddrCB(addr, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    addCodeAddrCB(addr, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, flags = CallbackFlags.CB_FLAG_NONE) {
         var vm = this.#vm;
         return this._retainUserData(data, function (dataPtr) {
-            return QBDI_C.addCodeAddrCB(vm, addr.toRword(), pos, cbk, dataPtr, priority);
+            return QBDI_C.addCodeAddrCBWithFlags(vm, addr.toRword(), pos, cbk, dataPtr, priority, flags);
         });
     }
 
@@ -1449,13 +1498,14 @@ export class VM {
      * @param {InstCallback}  cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}        data      User defined data passed to the callback.
      * @param {Int}           priority  The priority of the callback.
+     * @param {CallbackFlags} flags    The options of the callback.
      *
      * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
      */
-    addCodeRangeCB(start, end, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    addCodeRangeCB(start, end, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, flags = CallbackFlags.CB_FLAG_NONE) {
         var vm = this.#vm;
         return this._retainUserData(data, function (dataPtr) {
-            return QBDI_C.addCodeRangeCB(vm, start.toRword(), end.toRword(), pos, cbk, dataPtr, priority);
+            return QBDI_C.addCodeRangeCBWithFlags(vm, start.toRword(), end.toRword(), pos, cbk, dataPtr, priority, flags);
         });
     }
 
@@ -1486,6 +1536,17 @@ export class VM {
         return QBDI_C.deleteInstrumentation(this.#vm, id) == true;
     }
 
+    /**
+     * Enable or disable an instrumentation without flushing the cache.
+     *
+     * @param   {Number} id        The id of the instrumentation.
+     * @param   {bool}   enabled   The new state of the instrumentation.
+     * @return  {bool} True if the id is valid.
+     */
+    setInstrumentationEnabled(id, enabled) {
+        return QBDI_C.setInstrumentationEnabled(this.#vm, id, enabled ? 1 : 0) == true;
+    }
+
     /**
      * Remove all the registered instrumentations.
      */
@@ -32,6 +32,20 @@ void init_binding_Options(py::module_ &m) {
       .value("OPT_DISABLE_OPTIONAL_FPR", Options::OPT_DISABLE_OPTIONAL_FPR,
              "Disable context switch optimisation when the target execblock "
              "doesn't used FPR")
+      .value("OPT_ENABLE_REGISTER_LIVENESS",
+             Options::OPT_ENABLE_REGISTER_LIVENESS,
+             "Use the registers dead in the basic block as temporary "
+             "registers of the instrumentation, without saving them. The "
+             "value of these registers in the GPRState isn't reliable in the "
+             "callbacks")
+      .value("OPT_DISABLE_MEMORYACCESS_VALUE",
+             Options::OPT_DISABLE_MEMORYACCESS_VALUE,
+             "Only record the address and the size of the memory accesses, "
+             "not their value")
+      .value("OPT_DETECT_SELF_MODIFYING_CODE",
+             Options::OPT_DETECT_SELF_MODIFYING_CODE,
+             "Write-protect the pages of the translated code and invalidate "
+             "the sequences of the modified pages")
       .value("OPT_DISABLE_LOCAL_MONITOR", Options::OPT_DISABLE_LOCAL_MONITOR,
              "Disable the local monitor for instruction like stxr")
       .value("OPT_DISABLE_D16_D31", Options::OPT_DISABLE_D16_D31,
@@ -69,6 +69,20 @@ void init_binding_Callback(py::module_ &m) {
              "is used in the callback.")
       .export_values();
 
+  enum_int_flag_<CallbackFlags>(m, "CallbackFlags",
+                                "Options of an InstCallback", py::arithmetic())
+      .value("CB_FLAG_NONE", CallbackFlags::CB_FLAG_NONE,
+             "The callback is called from the VM after a break to the host.")
+      .value("CB_FLAG_INLINE_CALL", CallbackFlags::CB_FLAG_INLINE_CALL,
+             "The callback is called directly by the instrumented code. Only "
+             "supported on X86 and X86_64 with OPT_ENABLE_INLINE_CALL.")
+      .value("CB_FLAG_ONE_SHOT", CallbackFlags::CB_FLAG_ONE_SHOT,
+             "The callback is called at most once for each instrumented "
+             "instruction.")
+      .export_values()
+      .def_invert()
+      .def_repr_str();
+
   enum_int_flag_<VMEvent>(m, "VMEvent", py::arithmetic())
       .value("SEQUENCE_ENTRY", VMEvent::SEQUENCE_ENTRY,
              "Triggered when the execution enters a sequence.")
@@ -101,6 +115,16 @@ void init_binding_Callback(py::module_ &m) {
       .export_values()
       .def_invert();
 
+  enum_int_flag_<TraceFlags>(m, "TraceFlags",
+                             "Content of a trace recorded by the VM",
+                             py::arithmetic())
+      .value("TRACE_SEQUENCE", TraceFlags::TRACE_SEQUENCE,
+             "Record the executed sequences")
+      .value("TRACE_MEMORY", TraceFlags::TRACE_MEMORY,
+             "Record the address and the size of the memory accesses")
+      .export_values()
+      .def_invert();
+
   py::class_<VMState>(m, "VMState")
       .def_readonly("event", &VMState::event,
                     "The event(s) which triggered the callback (must be "
@@ -242,47 +242,49 @@ void init_binding_VM(py::module_ &m) {
       .def(
           "addCodeCB",
           [](VM &vm, InstPosition pos, PyInstCallback &cbk, py::object &obj,
-             int priority) {
+             int priority, CallbackFlags flags) {
             std::unique_ptr<TrampData<PyInstCallback>> data{
                 new TrampData<PyInstCallback>(cbk, obj)};
             uint32_t n =
                 vm.addCodeCB(pos, &trampoline_InstCallback,
-                             static_cast<void *>(data.get()), priority);
+                             static_cast<void *>(data.get()), priority, flags);
             data->id = n;
             return addTrampData(n, InstCallbackMap, std::move(data));
           },
           "Register a callback event for every instruction executed.", "pos"_a,
-          "cbk"_a, "data"_a, "priority"_a = PRIORITY_DEFAULT)
+          "cbk"_a, "data"_a, "priority"_a = PRIORITY_DEFAULT,
+          "flags"_a = CB_FLAG_NONE)
       .def(
           "addCodeAddrCB",
           [](VM &vm, rword address, InstPosition pos, PyInstCallback &cbk,
-             py::object &obj, int priority) {
+             py::object &obj, int priority, CallbackFlags flags) {
             std::unique_ptr<TrampData<PyInstCallback>> data{
                 new TrampData<PyInstCallback>(cbk, obj)};
-            uint32_t n =
-                vm.addCodeAddrCB(address, pos, &trampoline_InstCallback,
-                                 static_cast<void *>(data.get()), priority);
+            uint32_t n = vm.addCodeAddrCB(
+                address, pos, &trampoline_InstCallback,
+                static_cast<void *>(data.get()), priority, flags);
             data->id = n;
             return addTrampData(n, InstCallbackMap, std::move(data));
           },
           "Register a callback for when a specific address is executed.",
           "address"_a, "pos"_a, "cbk"_a, "data"_a,
-          "priority"_a = PRIORITY_DEFAULT)
+          "priority"_a = PRIORITY_DEFAULT, "flags"_a = CB_FLAG_NONE)
       .def(
           "addCodeRangeCB",
           [](VM &vm, rword start, rword end, InstPosition pos,
-             PyInstCallback &cbk, py::object &obj, int priority) {
+             PyInstCallback &cbk, py::object &obj, int priority,
+             CallbackFlags flags) {
             std::unique_ptr<TrampData<PyInstCallback>> data{
                 new TrampData<PyInstCallback>(cbk, obj)};
-            uint32_t n =
-                vm.addCodeRangeCB(start, end, pos, &trampoline_InstCallback,
-                                  static_cast<void *>(data.get()), priority);
+            uint32_t n = vm.addCodeRangeCB(
+                start, end, pos, &trampoline_InstCallback,
+                static_cast<void *>(data.get()), priority, flags);
             data->id = n;
             return addTrampData(n, InstCallbackMap, std::move(data));
           },
           "Register a callback for when a specific address range is executed.",
           "start"_a, "end"_a, "pos"_a, "cbk"_a, "data"_a,
-          "priority"_a = PRIORITY_DEFAULT)
+          "priority"_a = PRIORITY_DEFAULT, "flags"_a = CB_FLAG_NONE)
       .def(
           "addMemAccessCB",
           [](VM &vm, MemoryAccessType type, PyInstCallback &cbk,
@@ -357,6 +359,9 @@ void init_binding_VM(py::module_ &m) {
             removeTrampData(id, InstrumentInstCallbackMap);
           },
           "Remove an instrumentation.", "id"_a)
+      .def("setInstrumentationEnabled", &VM::setInstrumentationEnabled,
+           "Enable or disable an instrumentation without flushing the cache.",
+           "id"_a, "enabled"_a)
       .def(
           "deleteAllInstrumentations",
           [](VM &vm) {
@@ -401,6 +406,11 @@ void init_binding_VM(py::module_ &m) {
       .def("getBBMemoryAccess", &VM::getBBMemoryAccess,
            "Obtain the memory accesses made by the last executed sequence.",
            py::return_value_policy::copy)
+      .def("startTraceRecording", &VM::startTraceRecording,
+           "Record a compact binary trace of the execution in a file.",
+           "path"_a, "flags"_a = TraceFlags::TRACE_SEQUENCE)
+      .def("stopTraceRecording", &VM::stopTraceRecording,
+           "Write the pending records and close the current trace file.")
       .def("precacheBasicBlock", &VM::precacheBasicBlock,
            "Pre-cache a known basic block", "pc"_a)
       .def("clearCache", &VM::clearCache,
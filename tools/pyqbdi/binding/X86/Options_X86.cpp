@@ -32,8 +32,25 @@ void init_binding_Options(py::module_ &m) {
       .value("OPT_DISABLE_OPTIONAL_FPR", Options::OPT_DISABLE_OPTIONAL_FPR,
              "Disable context switch optimisation when the target execblock "
              "doesn't used FPR")
+      .value("OPT_ENABLE_REGISTER_LIVENESS",
+             Options::OPT_ENABLE_REGISTER_LIVENESS,
+             "Use the registers dead in the basic block as temporary "
+             "registers of the instrumentation, without saving them. The "
+             "value of these registers in the GPRState isn't reliable in the "
+             "callbacks")
+      .value("OPT_DISABLE_MEMORYACCESS_VALUE",
+             Options::OPT_DISABLE_MEMORYACCESS_VALUE,
+             "Only record the address and the size of the memory accesses, "
+             "not their value")
+      .value("OPT_DETECT_SELF_MODIFYING_CODE",
+             Options::OPT_DETECT_SELF_MODIFYING_CODE,
+             "Write-protect the pages of the translated code and invalidate "
+             "the sequences of the modified pages")
       .value("OPT_ATT_SYNTAX", Options::OPT_ATT_SYNTAX,
              "Used the AT&T syntax for instruction disassembly")
+      .value("OPT_ENABLE_INLINE_CALL", Options::OPT_ENABLE_INLINE_CALL,
+             "Add the inline call stub in each ExecBlock. Needed by the "
+             "callbacks registered with CB_FLAG_INLINE_CALL")
       .export_values()
       .def_invert()
       .def_repr_str();
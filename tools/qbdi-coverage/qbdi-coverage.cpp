@@ -0,0 +1,199 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "QBDI/Memory.hpp"
+#include "QBDI/Range.h"
+#include "QBDIPreload.h"
+
+// Coverage of the basic blocks in the drcov format.
+//
+// The blocks are recorded on BASIC_BLOCK_NEW. This event is only sent when a
+// block is translated, that is, at the first execution of the block (or after
+// a flush of the cache): the execution of a covered block doesn't return to
+// the coverage code.
+//
+// Environment:
+//  - QBDI_COVERAGE_OUTPUT: directory of the drcov files (default: current
+//    directory). The file is named drcov.<program>.<pid>.log.
+//  - QBDI_COVERAGE_MODULES: comma separated list of the modules to cover
+//    (default: all the executable memory)
+
+namespace {
+
+struct CovModule {
+  QBDI::Range<QBDI::rword> range;
+  std::string path;
+};
+
+struct CovBlock {
+  uint32_t start; // offset in the module
+  uint16_t size;
+  uint16_t moduleID;
+};
+
+std::vector<CovModule> modules;
+std::unordered_map<QBDI::rword, CovBlock> blocks;
+std::string programName = "unknown";
+
+// Search the module of an address. The memory maps are read again when the
+// address isn't in a known module, as a library may have been loaded.
+const CovModule *findModule(QBDI::rword address, uint16_t &id) {
+  for (int retry = 0; retry < 2; retry++) {
+    for (size_t i = 0; i < modules.size(); i++) {
+      if (modules[i].range.contains(address)) {
+        id = i;
+        return &modules[i];
+      }
+    }
+    if (retry != 0) {
+      break;
+    }
+    // a module is the union of the maps with the same path
+    std::vector<CovModule> maps;
+    for (const QBDI::MemoryMap &m : QBDI::getCachedProcessMaps(true)) {
+      if (m.name.empty() or m.name[0] != '/') {
+        continue;
+      }
+      auto it = std::find_if(maps.begin(), maps.end(), [&](const CovModule &c) {
+        return c.path == m.name;
+      });
+      if (it == maps.end()) {
+        maps.push_back({m.range, m.name});
+      } else {
+        it->range.setStart(std::min(it->range.start(), m.range.start()));
+        it->range.setEnd(std::max(it->range.end(), m.range.end()));
+      }
+    }
+    // keep the ids of the known modules
+    for (const CovModule &m : maps) {
+      if (std::none_of(modules.begin(), modules.end(),
+                       [&](const CovModule &c) {
+                         return c.path == m.path and c.range == m.range;
+                       })) {
+        modules.push_back(m);
+      }
+    }
+  }
+  return nullptr;
+}
+
+QBDI::VMAction onNewBasicBlock(QBDI::VMInstanceRef vm,
+                               const QBDI::VMState *vmState,
+                               QBDI::GPRState *gprState,
+                               QBDI::FPRState *fprState, void *data) {
+  // After a flush of the cache, the block can begin in the middle of a basic
+  // block already covered
+  QBDI::rword start = vmState->sequenceStart;
+  if (blocks.find(start) != blocks.end()) {
+    return QBDI::CONTINUE;
+  }
+  uint16_t id;
+  const CovModule *module = findModule(start, id);
+  if (module == nullptr) {
+    return QBDI::CONTINUE;
+  }
+  QBDI::rword size = std::min<QBDI::rword>(vmState->basicBlockEnd - start,
+                                           UINT16_MAX);
+  blocks[start] = CovBlock{static_cast<uint32_t>(start - module->range.start()),
+                           static_cast<uint16_t>(size), id};
+  return QBDI::CONTINUE;
+}
+
+void writeCoverage() {
+  const char *outputDir = getenv("QBDI_COVERAGE_OUTPUT");
+  std::string path = (outputDir != nullptr) ? outputDir : ".";
+  path += "/drcov." + programName + "." + std::to_string(getpid()) + ".log";
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "[qbdi-coverage] Cannot create %s\n", path.c_str());
+    return;
+  }
+  fprintf(file, "DRCOV VERSION: 2\n");
+  fprintf(file, "DRCOV FLAVOR: drcov\n");
+  fprintf(file, "Module Table: version 2, count %zu\n", modules.size());
+  fprintf(file, "Columns: id, base, end, entry, path\n");
+  for (size_t i = 0; i < modules.size(); i++) {
+    fprintf(file, "%2zu, 0x%" PRIRWORD ", 0x%" PRIRWORD
+                  ", 0x0000000000000000, %s\n",
+            i, modules[i].range.start(), modules[i].range.end(),
+            modules[i].path.c_str());
+  }
+  fprintf(file, "BB Table: %zu bbs\n", blocks.size());
+  for (const auto &e : blocks) {
+    // uint32_t start; uint16_t size; uint16_t id; in little endian
+    fwrite(&e.second, sizeof(CovBlock), 1, file);
+  }
+  fclose(file);
+}
+
+} // anonymous namespace
+
+extern "C" {
+
+QBDIPRELOAD_INIT;
+
+int qbdipreload_on_start(void *main) { return QBDIPRELOAD_NOT_HANDLED; }
+
+int qbdipreload_on_premain(void *gprCtx, void *fpuCtx) {
+  return QBDIPRELOAD_NOT_HANDLED;
+}
+
+int qbdipreload_on_main(int argc, char **argv) {
+  if (argc > 0 and argv[0] != nullptr) {
+    programName = argv[0];
+    programName = programName.substr(programName.find_last_of('/') + 1);
+  }
+  return QBDIPRELOAD_NOT_HANDLED;
+}
+
+int qbdipreload_on_run(QBDI::VMInstanceRef vm, QBDI::rword start,
+                       QBDI::rword stop) {
+  const char *modulesEnv = getenv("QBDI_COVERAGE_MODULES");
+  if (modulesEnv != nullptr) {
+    vm->removeAllInstrumentedRanges();
+    std::string list = modulesEnv;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+      size_t next = std::min(list.find(',', pos), list.size());
+      std::string name = list.substr(pos, next - pos);
+      if (not name.empty() and not vm->addInstrumentedModule(name)) {
+        fprintf(stderr, "[qbdi-coverage] Module %s not found\n", name.c_str());
+      }
+      pos = next + 1;
+    }
+  }
+  vm->addVMEventCB(QBDI::BASIC_BLOCK_NEW, onNewBasicBlock, nullptr);
+  vm->run(start, stop);
+  return QBDIPRELOAD_NO_ERROR;
+}
+
+int qbdipreload_on_exit(int status) {
+  writeCoverage();
+  return QBDIPRELOAD_NO_ERROR;
+}
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "llvm/ADT/StringRef.h"
+#include "llvm/MC/MCInst.h"
+
+#include "Engine/LLVMCPU.h"
+
+#include "TraceDisassembler.h"
+
+namespace QBDI {
+namespace Trace {
+
+TraceDisassembler::TraceDisassembler()
+    : llvmcpus(std::make_unique<LLVMCPUs>()) {}
+
+TraceDisassembler::~TraceDisassembler() = default;
+
+void TraceDisassembler::disassemble(const TraceReader &reader) {
+  const std::vector<TraceBlock> &blocks = reader.getBlocks();
+  cache.resize(blocks.size());
+
+  for (const TraceBlock &block : blocks) {
+    std::vector<TraceInstruction> &instructions = cache[block.id];
+    if (not instructions.empty()) {
+      continue;
+    }
+    const LLVMCPU &llvmcpu = llvmcpus->getCPU(block.cpuMode);
+    llvm::ArrayRef<uint8_t> code = block.code;
+    rword address = block.address;
+
+    while (not code.empty()) {
+      llvm::MCInst inst;
+      uint64_t size = 0;
+      if (not llvmcpu.getInstruction(inst, size, code, address) or
+          size == 0) {
+        instructions.push_back({address, static_cast<uint32_t>(code.size()),
+                                "<invalid>"});
+        break;
+      }
+      std::string disassembly = llvmcpu.showInst(inst, address);
+      instructions.push_back(
+          {address, static_cast<uint32_t>(size),
+           llvm::StringRef(disassembly).trim().str()});
+      code = code.drop_front(size);
+      address += size;
+    }
+  }
+}
+
+} // namespace Trace
+} // namespace QBDI
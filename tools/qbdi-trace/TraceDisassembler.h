@@ -0,0 +1,71 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QBDITRACE_TRACEDISASSEMBLER_H
+#define QBDITRACE_TRACEDISASSEMBLER_H
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "QBDI/State.h"
+
+#include "TraceReader.h"
+
+namespace QBDI {
+class LLVMCPUs;
+
+namespace Trace {
+
+struct TraceInstruction {
+  rword address;
+  uint32_t size;
+  std::string disassembly;
+};
+
+/*! Disassemble the code of the blocks of a trace. The code is disassembled
+ * once per block and the result is kept, so that the decoding threads can
+ * share it without locks.
+ */
+class TraceDisassembler {
+private:
+  std::unique_ptr<LLVMCPUs> llvmcpus;
+  std::vector<std::vector<TraceInstruction>> cache;
+
+public:
+  TraceDisassembler();
+
+  ~TraceDisassembler();
+
+  /*! Disassemble all the blocks of a trace
+   */
+  void disassemble(const TraceReader &reader);
+
+  /*! The instructions of a block. disassemble() must have been called with
+   * the reader of the block.
+   */
+  inline const std::vector<TraceInstruction> &
+  getInstructions(const TraceBlock &block) const {
+    return cache[block.id];
+  }
+};
+
+} // namespace Trace
+} // namespace QBDI
+
+#endif // QBDITRACE_TRACEDISASSEMBLER_H
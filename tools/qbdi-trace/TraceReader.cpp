@@ -0,0 +1,321 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+#include "llvm/Support/LEB128.h"
+
+#include "TraceReader.h"
+
+namespace QBDI {
+namespace Trace {
+
+namespace {
+
+class RecordCursor {
+private:
+  const uint8_t *pos;
+  const uint8_t *end;
+  const char *error;
+
+public:
+  RecordCursor(const uint8_t *begin, const uint8_t *end)
+      : pos(begin), end(end), error(nullptr) {}
+
+  inline bool atEnd() const { return pos >= end; }
+
+  inline bool failed() const { return error != nullptr; }
+
+  inline const char *getError() const { return error; }
+
+  uint8_t readTag() {
+    if (pos >= end) {
+      error = "unexpected end of segment";
+      return 0;
+    }
+    return *pos++;
+  }
+
+  uint64_t readVarint() {
+    unsigned n = 0;
+    uint64_t value = llvm::decodeULEB128(pos, &n, end, &error);
+    pos += n;
+    return value;
+  }
+
+  // zigzag decoding of a delta
+  rword readDelta(rword previous) {
+    uint64_t value = readVarint();
+    int64_t delta =
+        static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    return previous + static_cast<rword>(delta);
+  }
+
+  llvm::ArrayRef<uint8_t> readBytes(uint64_t size) {
+    if (failed() or size > static_cast<uint64_t>(end - pos)) {
+      error = "unexpected end of segment";
+      return {};
+    }
+    llvm::ArrayRef<uint8_t> bytes{pos, static_cast<size_t>(size)};
+    pos += size;
+    return bytes;
+  }
+};
+
+} // anonymous namespace
+
+TraceReader::TraceReader(std::unique_ptr<llvm::MemoryBuffer> &&buffer)
+    : buffer(std::move(buffer)) {}
+
+std::unique_ptr<TraceReader> TraceReader::open(const std::string &path,
+                                               std::string &error) {
+  // Large files are mapped in memory instead of being read
+  auto bufferOrErr = llvm::MemoryBuffer::getFile(
+      path, /* IsText */ false, /* RequiresNullTerminator */ false);
+  if (not bufferOrErr) {
+    error = "Cannot open " + path + ": " + bufferOrErr.getError().message();
+    return nullptr;
+  }
+  std::unique_ptr<TraceReader> reader{
+      new TraceReader(std::move(bufferOrErr.get()))};
+
+  const uint8_t *pos =
+      reinterpret_cast<const uint8_t *>(reader->buffer->getBufferStart());
+  const uint8_t *end =
+      reinterpret_cast<const uint8_t *>(reader->buffer->getBufferEnd());
+
+  TraceFileHeader header;
+  if (static_cast<size_t>(end - pos) < sizeof(header)) {
+    error = "Not a QBDI trace: file too small";
+    return nullptr;
+  }
+  memcpy(&header, pos, sizeof(header));
+  pos += sizeof(header);
+  if (strncmp(header.magic, QBDI_TRACE_MAGIC, sizeof(header.magic)) != 0) {
+    error = "Not a QBDI trace: invalid magic";
+    return nullptr;
+  }
+  if (header.version != QBDI_TRACE_VERSION) {
+    error = "Unsupported trace version " + std::to_string(header.version);
+    return nullptr;
+  }
+  if (header.rwordSize != sizeof(rword)) {
+    error = "The trace has been recorded on a " +
+            std::to_string(header.rwordSize * 8) + " bits architecture";
+    return nullptr;
+  }
+
+  // Index the segments. The dictionaries are small and are decoded now, in
+  // the order of the file.
+  while (pos < end) {
+    TraceSegmentHeader segHeader;
+    if (static_cast<size_t>(end - pos) < sizeof(segHeader)) {
+      error = "Truncated segment header";
+      return nullptr;
+    }
+    memcpy(&segHeader, pos, sizeof(segHeader));
+    pos += sizeof(segHeader);
+    if (segHeader.magic != QBDI_TRACE_SEGMENT_MAGIC or
+        segHeader.size > static_cast<size_t>(end - pos)) {
+      error = "Invalid segment " + std::to_string(segHeader.number);
+      return nullptr;
+    }
+    Segment segment{pos, pos + segHeader.size, segHeader.number};
+    pos += segHeader.size;
+
+    switch (segHeader.kind) {
+      case TRACE_SEGMENT_DICTIONARY:
+        if (not reader->readDictionary(segment, error)) {
+          return nullptr;
+        }
+        break;
+      case TRACE_SEGMENT_DATA:
+        reader->dataSegments.push_back(segment);
+        break;
+      default:
+        error = "Unknown kind of segment " + std::to_string(segHeader.kind);
+        return nullptr;
+    }
+  }
+  return reader;
+}
+
+bool TraceReader::readDictionary(const Segment &segment, std::string &error) {
+  RecordCursor cursor{segment.begin, segment.end};
+
+  while (not cursor.atEnd() and not cursor.failed()) {
+    uint8_t tag = cursor.readTag();
+    switch (tag) {
+      case TRACE_RECORD_MODULE: {
+        TraceModule module;
+        module.id = cursor.readVarint();
+        module.start = cursor.readVarint();
+        module.end = cursor.readVarint();
+        llvm::ArrayRef<uint8_t> name = cursor.readBytes(cursor.readVarint());
+        module.name.assign(name.begin(), name.end());
+        if (not cursor.failed() and module.id != modules.size()) {
+          error = "Unexpected module id " + std::to_string(module.id);
+          return false;
+        }
+        modules.push_back(std::move(module));
+        break;
+      }
+      case TRACE_RECORD_BLOCK: {
+        TraceBlock block;
+        block.id = cursor.readVarint();
+        block.module = cursor.readVarint();
+        block.address = cursor.readVarint();
+        block.size = cursor.readVarint();
+        block.cpuMode = static_cast<CPUMode>(cursor.readVarint());
+        block.code = cursor.readBytes(block.size);
+        if (cursor.failed()) {
+          break;
+        }
+        if (block.id != blocks.size() or block.module > modules.size() or
+            block.cpuMode >= CPUMode::COUNT) {
+          error = "Invalid block " + std::to_string(block.id);
+          return false;
+        }
+        blocks.push_back(block);
+        break;
+      }
+      default:
+        if (not cursor.failed()) {
+          error = "Unexpected record " + std::to_string(tag) +
+                  " in dictionary segment " + std::to_string(segment.number);
+          return false;
+        }
+    }
+  }
+  if (cursor.failed()) {
+    error = std::string("Invalid dictionary segment ") +
+            std::to_string(segment.number) + ": " + cursor.getError();
+    return false;
+  }
+  return true;
+}
+
+bool TraceReader::decodeSegment(size_t index, TraceVisitor &visitor,
+                                std::string &error) const {
+  const Segment &segment = dataSegments[index];
+  RecordCursor cursor{segment.begin, segment.end};
+
+  // the deltas begin with 0 in each data segment
+  rword blockID = 0;
+  rword lastAddress = 0;
+  const TraceBlock *block = nullptr;
+
+  while (not cursor.atEnd()) {
+    uint8_t tag = cursor.readTag();
+    switch (tag) {
+      case TRACE_RECORD_SEQUENCE:
+        blockID = cursor.readDelta(blockID);
+        if (cursor.failed()) {
+          break;
+        }
+        if (blockID >= blocks.size()) {
+          error = "Undefined block " + std::to_string(blockID) +
+                  " in segment " + std::to_string(segment.number);
+          return false;
+        }
+        block = &blocks[blockID];
+        visitor.onSequence(*block);
+        break;
+      case TRACE_RECORD_MEMORY_READ:
+      case TRACE_RECORD_MEMORY_WRITE: {
+        lastAddress = cursor.readDelta(lastAddress);
+        uint32_t size = cursor.readVarint();
+        if (cursor.failed()) {
+          break;
+        }
+        visitor.onMemoryAccess(block, lastAddress, size,
+                               tag == TRACE_RECORD_MEMORY_WRITE);
+        break;
+      }
+      default:
+        if (not cursor.failed()) {
+          error = "Unexpected record " + std::to_string(tag) +
+                  " in data segment " + std::to_string(segment.number);
+          return false;
+        }
+    }
+    if (cursor.failed()) {
+      error = std::string("Invalid data segment ") +
+              std::to_string(segment.number) + ": " + cursor.getError();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TraceReader::decodeParallel(
+    size_t first, size_t count, unsigned nbThreads,
+    const std::function<std::unique_ptr<TraceVisitor>(size_t)> &factory,
+    std::vector<std::unique_ptr<TraceVisitor>> &visitors,
+    std::string &error) const {
+
+  first = std::min(first, dataSegments.size());
+  size_t nbSegments = std::min(count, dataSegments.size() - first);
+  visitors.clear();
+  visitors.resize(nbSegments);
+
+  if (nbThreads == 0) {
+    nbThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  nbThreads = std::min<size_t>(nbThreads, nbSegments);
+
+  std::atomic<size_t> nextSegment{0};
+  std::atomic<bool> failed{false};
+  std::mutex errorLock;
+
+  // Each worker takes the next segment to decode, until the end of the trace
+  // or the first error.
+  auto worker = [&]() {
+    size_t index;
+    while (not failed and (index = nextSegment++) < nbSegments) {
+      std::string segmentError;
+      visitors[index] = factory(first + index);
+      if (not decodeSegment(first + index, *visitors[index], segmentError)) {
+        std::lock_guard<std::mutex> guard(errorLock);
+        if (not failed.exchange(true)) {
+          error = std::move(segmentError);
+        }
+      }
+    }
+  };
+
+  if (nbThreads <= 1) {
+    worker();
+  } else {
+    std::vector<std::thread> threads;
+    threads.reserve(nbThreads);
+    for (unsigned i = 0; i < nbThreads; i++) {
+      threads.emplace_back(worker);
+    }
+    for (std::thread &t : threads) {
+      t.join();
+    }
+  }
+  return not failed;
+}
+
+} // namespace Trace
+} // namespace QBDI
@@ -0,0 +1,154 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QBDITRACE_TRACEREADER_H
+#define QBDITRACE_TRACEREADER_H
+
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "QBDI/State.h"
+#include "QBDI/Trace.h"
+
+namespace QBDI {
+namespace Trace {
+
+struct TraceModule {
+  uint32_t id;
+  rword start;
+  rword end;
+  std::string name;
+};
+
+struct TraceBlock {
+  uint32_t id;
+  uint32_t module; // id of the module + 1, 0 if the module is unknown
+  rword address;
+  rword size;
+  CPUMode cpuMode;
+  llvm::ArrayRef<uint8_t> code; // points in the mapping of the trace
+};
+
+/*! Receive the records of a data segment, in the order of the execution.
+ */
+class TraceVisitor {
+public:
+  virtual ~TraceVisitor() = default;
+
+  virtual void onSequence(const TraceBlock &block) {}
+
+  /*! A memory access of the last sequence
+   *
+   * @param[in] block    The block of the sequence, or nullptr if the sequence
+   *                     has been recorded in the previous segment
+   * @param[in] address  The address of the access
+   * @param[in] size     The size of the access (0 if unknown)
+   * @param[in] write    The access is a write
+   */
+  virtual void onMemoryAccess(const TraceBlock *block, rword address,
+                              uint32_t size, bool write) {}
+};
+
+/*! Reader of a trace recorded with VM::startTraceRecording.
+ *
+ * The file is mapped in memory. The dictionaries are decoded when the trace
+ * is opened, the data segments are decoded on demand and independently from
+ * each other.
+ */
+class TraceReader {
+private:
+  struct Segment {
+    const uint8_t *begin;
+    const uint8_t *end;
+    uint32_t number;
+  };
+
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  std::vector<TraceModule> modules;
+  std::vector<TraceBlock> blocks;
+  std::vector<Segment> dataSegments;
+
+  TraceReader(std::unique_ptr<llvm::MemoryBuffer> &&buffer);
+
+  bool readDictionary(const Segment &segment, std::string &error);
+
+public:
+  /*! Open and index a trace file
+   *
+   * @param[in]  path   The path of the trace
+   * @param[out] error  The reason of the failure
+   *
+   * @return The reader, or nullptr on failure
+   */
+  static std::unique_ptr<TraceReader> open(const std::string &path,
+                                           std::string &error);
+
+  inline const std::vector<TraceModule> &getModules() const {
+    return modules;
+  }
+
+  inline const std::vector<TraceBlock> &getBlocks() const { return blocks; }
+
+  /*! The module of a block, or nullptr if the module is unknown
+   */
+  inline const TraceModule *getModule(const TraceBlock &block) const {
+    return (block.module == 0) ? nullptr : &modules[block.module - 1];
+  }
+
+  inline size_t getNbDataSegments() const { return dataSegments.size(); }
+
+  /*! Decode a data segment
+   *
+   * @param[in]  index    The index of the data segment
+   * @param[in]  visitor  The receiver of the records
+   * @param[out] error    The reason of the failure
+   *
+   * @return True if the whole segment has been decoded
+   */
+  bool decodeSegment(size_t index, TraceVisitor &visitor,
+                     std::string &error) const;
+
+  /*! Decode a range of data segments with a pool of threads. Each segment is
+   * decoded by a dedicated visitor, returned in the order of the segments.
+   *
+   * @param[in]  first      The index of the first data segment
+   * @param[in]  count      The number of data segments to decode
+   * @param[in]  nbThreads  The number of threads (0 for the number of cores)
+   * @param[in]  factory    Create the visitor of a segment
+   * @param[out] visitors   The visitors of the segments
+   * @param[out] error      The reason of the first failure
+   *
+   * @return True if all the segments have been decoded
+   */
+  bool decodeParallel(
+      size_t first, size_t count, unsigned nbThreads,
+      const std::function<std::unique_ptr<TraceVisitor>(size_t)> &factory,
+      std::vector<std::unique_ptr<TraceVisitor>> &visitors,
+      std::string &error) const;
+};
+
+} // namespace Trace
+} // namespace QBDI
+
+#endif // QBDITRACE_TRACEREADER_H
@@ -0,0 +1,357 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2024 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <inttypes.h>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "TraceDisassembler.h"
+#include "TraceReader.h"
+
+using namespace QBDI;
+using namespace QBDI::Trace;
+
+namespace {
+
+struct Query {
+  unsigned nbThreads = 0;
+  bool hasRange = false;
+  rword rangeStart = 0;
+  rword rangeEnd = 0;
+  std::string module;
+  bool dump = false;
+  size_t hotBlocks = 0;
+  size_t hotMemory = 0;
+  rword granularity = 1;
+};
+
+class QueryVisitor : public TraceVisitor {
+private:
+  const Query &query;
+  const TraceReader &reader;
+  const TraceDisassembler &disassembler;
+  const std::vector<char> &selectedBlocks;
+  std::string output;
+  llvm::raw_string_ostream os;
+
+  inline bool isSelected(rword address) const {
+    return not query.hasRange or
+           (query.rangeStart <= address and address < query.rangeEnd);
+  }
+
+public:
+  uint64_t nbSequences = 0;
+  uint64_t nbInstructions = 0;
+  uint64_t nbReads = 0;
+  uint64_t nbWrites = 0;
+  std::unordered_map<uint32_t, uint64_t> blockHits;
+  std::unordered_map<rword, uint64_t> memoryHits;
+
+  QueryVisitor(const Query &query, const TraceReader &reader,
+               const TraceDisassembler &disassembler,
+               const std::vector<char> &selectedBlocks)
+      : query(query), reader(reader), disassembler(disassembler),
+        selectedBlocks(selectedBlocks), os(output) {}
+
+  void onSequence(const TraceBlock &block) override {
+    if (not selectedBlocks[block.id]) {
+      return;
+    }
+    const std::vector<TraceInstruction> &instructions =
+        disassembler.getInstructions(block);
+    nbSequences++;
+    nbInstructions += instructions.size();
+    if (query.hotBlocks != 0) {
+      blockHits[block.id]++;
+    }
+    if (query.dump) {
+      const TraceModule *module = reader.getModule(block);
+      for (const TraceInstruction &inst : instructions) {
+        os << llvm::format_hex(inst.address, 2 + 2 * sizeof(rword));
+        if (module != nullptr) {
+          os << " [" << llvm::sys::path::filename(module->name) << '+'
+             << llvm::format_hex(inst.address - module->start, 0) << ']';
+        }
+        os << "  " << inst.disassembly << '\n';
+      }
+    }
+  }
+
+  void onMemoryAccess(const TraceBlock *block, rword address, uint32_t size,
+                      bool write) override {
+    if (not isSelected(address) or
+        (not query.module.empty() and
+         (block == nullptr or not selectedBlocks[block->id]))) {
+      return;
+    }
+    if (write) {
+      nbWrites++;
+    } else {
+      nbReads++;
+    }
+    if (query.hotMemory != 0) {
+      memoryHits[address - (address % query.granularity)]++;
+    }
+    if (query.dump) {
+      os << "    " << (write ? "W " : "R ")
+         << llvm::format_hex(address, 2 + 2 * sizeof(rword)) << " size "
+         << size << '\n';
+    }
+  }
+
+  // Move the results of another segment in this visitor
+  void merge(QueryVisitor &other) {
+    nbSequences += other.nbSequences;
+    nbInstructions += other.nbInstructions;
+    nbReads += other.nbReads;
+    nbWrites += other.nbWrites;
+    for (const auto &e : other.blockHits) {
+      blockHits[e.first] += e.second;
+    }
+    for (const auto &e : other.memoryHits) {
+      memoryHits[e.first] += e.second;
+    }
+    other.blockHits.clear();
+    other.memoryHits.clear();
+  }
+
+  void flushOutput() {
+    os.flush();
+    llvm::outs() << output;
+    output.clear();
+  }
+};
+
+template <typename K>
+std::vector<std::pair<K, uint64_t>>
+getTop(const std::unordered_map<K, uint64_t> &hits, size_t n) {
+  std::vector<std::pair<K, uint64_t>> top(hits.begin(), hits.end());
+  n = std::min(n, top.size());
+  std::partial_sort(top.begin(), top.begin() + n, top.end(),
+                    [](const auto &a, const auto &b) {
+                      return a.second > b.second or
+                             (a.second == b.second and a.first < b.first);
+                    });
+  top.resize(n);
+  return top;
+}
+
+void usage(const char *name) {
+  llvm::errs()
+      << "Usage: " << name << " [options] <trace>\n"
+      << "\n"
+      << "Decode a trace recorded with VM::startTraceRecording.\n"
+      << "\n"
+      << "Options:\n"
+      << "  -j, --threads <n>      Number of decoding threads (default: "
+         "number of cores)\n"
+      << "  -r, --range <a>-<b>    Only keep the blocks and the memory "
+         "accesses in [a, b)\n"
+      << "  -m, --module <name>    Only keep the blocks of the modules "
+         "whose path contains\n"
+      << "                         <name>, and their memory accesses\n"
+      << "  -d, --dump             Print the executed instructions and "
+         "memory accesses\n"
+      << "  -b, --hot-blocks <n>   Print the <n> most executed blocks\n"
+      << "  -a, --hot-memory <n>   Print the <n> most accessed addresses\n"
+      << "  -g, --granularity <n>  Size of the buckets of the memory "
+         "histogram (default: 1)\n"
+      << "  -h, --help             Print this help\n";
+}
+
+bool parseInteger(const char *str, uint64_t &value) {
+  char *end = nullptr;
+  value = strtoull(str, &end, 0);
+  return end != str and *end == '\0';
+}
+
+bool parseArgs(int argc, char **argv, Query &query, std::string &path) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    uint64_t value;
+
+    if (arg == "-h" or arg == "--help") {
+      return false;
+    } else if (arg == "-d" or arg == "--dump") {
+      query.dump = true;
+      continue;
+    } else if (arg[0] != '-') {
+      if (not path.empty()) {
+        llvm::errs() << "Only one trace can be decoded\n";
+        return false;
+      }
+      path = arg;
+      continue;
+    }
+
+    // options with a parameter
+    if (i + 1 >= argc) {
+      llvm::errs() << "Missing parameter for " << arg << '\n';
+      return false;
+    }
+    const char *param = argv[++i];
+    if (arg == "-m" or arg == "--module") {
+      query.module = param;
+    } else if (arg == "-r" or arg == "--range") {
+      const char *sep = strchr(param, '-');
+      uint64_t start, end;
+      if (sep == nullptr or
+          not parseInteger(std::string(param, sep).c_str(), start) or
+          not parseInteger(sep + 1, end) or start >= end) {
+        llvm::errs() << "Invalid range " << param << '\n';
+        return false;
+      }
+      query.hasRange = true;
+      query.rangeStart = start;
+      query.rangeEnd = end;
+    } else if (not parseInteger(param, value)) {
+      llvm::errs() << "Invalid integer " << param << '\n';
+      return false;
+    } else if (arg == "-j" or arg == "--threads") {
+      query.nbThreads = value;
+    } else if (arg == "-b" or arg == "--hot-blocks") {
+      query.hotBlocks = value;
+    } else if (arg == "-a" or arg == "--hot-memory") {
+      query.hotMemory = value;
+    } else if (arg == "-g" or arg == "--granularity") {
+      if (value == 0) {
+        llvm::errs() << "The granularity cannot be 0\n";
+        return false;
+      }
+      query.granularity = value;
+    } else {
+      llvm::errs() << "Unknown option " << arg << '\n';
+      return false;
+    }
+  }
+  return not path.empty();
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  Query query;
+  std::string path;
+  std::string error;
+
+  if (not parseArgs(argc, argv, query, path)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::unique_ptr<TraceReader> reader = TraceReader::open(path, error);
+  if (reader == nullptr) {
+    llvm::errs() << error << '\n';
+    return 1;
+  }
+
+  // The blocks are disassembled once, before the parallel decoding
+  TraceDisassembler disassembler;
+  disassembler.disassemble(*reader);
+
+  std::vector<char> selectedBlocks;
+  for (const TraceBlock &block : reader->getBlocks()) {
+    const TraceModule *module = reader->getModule(block);
+    bool selected =
+        not query.hasRange or (block.address < query.rangeEnd and
+                               query.rangeStart < block.address + block.size);
+    if (not query.module.empty()) {
+      selected = selected and module != nullptr and
+                 module->name.find(query.module) != std::string::npos;
+    }
+    selectedBlocks.push_back(selected);
+  }
+
+  auto factory = [&](size_t) {
+    return std::make_unique<QueryVisitor>(query, *reader, disassembler,
+                                          selectedBlocks);
+  };
+
+  // The dump is printed in the order of the trace: the segments are decoded
+  // by windows to bound the memory used by the pending output.
+  size_t nbSegments = reader->getNbDataSegments();
+  size_t window = nbSegments;
+  if (query.dump) {
+    window = 4 * std::max(1u, query.nbThreads == 0
+                                  ? std::thread::hardware_concurrency()
+                                  : query.nbThreads);
+  }
+
+  QueryVisitor result{query, *reader, disassembler, selectedBlocks};
+  std::vector<std::unique_ptr<TraceVisitor>> visitors;
+  for (size_t first = 0; first < nbSegments; first += window) {
+    if (not reader->decodeParallel(first, window, query.nbThreads, factory,
+                                   visitors, error)) {
+      llvm::errs() << error << '\n';
+      return 1;
+    }
+    for (std::unique_ptr<TraceVisitor> &visitor : visitors) {
+      QueryVisitor &segmentResult = static_cast<QueryVisitor &>(*visitor);
+      segmentResult.flushOutput();
+      result.merge(segmentResult);
+    }
+  }
+
+  llvm::raw_ostream &os = llvm::outs();
+  if (query.dump) {
+    os << '\n';
+  }
+  os << "Modules:         " << reader->getModules().size() << '\n'
+     << "Blocks:          " << reader->getBlocks().size() << '\n'
+     << "Data segments:   " << nbSegments << '\n'
+     << "Sequences:       " << result.nbSequences << '\n'
+     << "Instructions:    " << result.nbInstructions << '\n'
+     << "Memory reads:    " << result.nbReads << '\n'
+     << "Memory writes:   " << result.nbWrites << '\n';
+
+  if (query.hotBlocks != 0) {
+    os << "\nHot blocks:\n";
+    for (const auto &e : getTop(result.blockHits, query.hotBlocks)) {
+      const TraceBlock &block = reader->getBlocks()[e.first];
+      const TraceModule *module = reader->getModule(block);
+      os << llvm::format("%12" PRIu64, e.second) << "  "
+         << llvm::format_hex(block.address, 2 + 2 * sizeof(rword));
+      if (module != nullptr) {
+        os << " [" << llvm::sys::path::filename(module->name) << '+'
+           << llvm::format_hex(block.address - module->start, 0) << ']';
+      }
+      os << "  " << disassembler.getInstructions(block).size()
+         << " instructions\n";
+    }
+  }
+
+  if (query.hotMemory != 0) {
+    os << "\nHot memory addresses:\n";
+    for (const auto &e : getTop(result.memoryHits, query.hotMemory)) {
+      os << llvm::format("%12" PRIu64, e.second) << "  "
+         << llvm::format_hex(e.first, 2 + 2 * sizeof(rword)) << '\n';
+    }
+  }
+  return 0;
+}